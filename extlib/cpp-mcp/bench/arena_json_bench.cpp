@@ -0,0 +1,142 @@
+/**
+ * @file arena_json_bench.cpp
+ * @brief Heap allocations per tools/call, heap-backed arguments vs arena_json
+ *
+ * Replays the server side of a bulk set_sheet_range_content call: scan the
+ * envelope, find the arguments, build a DOM for them, walk every cell, and
+ * serialize the response frame. The "heap" path parses the arguments into
+ * mcp::json, the "arena" path parses them into arena_json inside an arena_scope,
+ * as a raw tool handler would.
+ *
+ * Usage: arena_json_bench [rows] [iterations]
+ */
+
+#include "mcp_envelope.h"
+#include "mcp_sse_frame.h"
+#include "bench_alloc_counter.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+namespace {
+
+using bench_clock = std::chrono::steady_clock;
+
+constexpr int columns = 100;
+
+std::string make_body(int rows) {
+    mcp::json values = mcp::json::array();
+    for (int r = 0; r < rows; ++r) {
+        mcp::json row = mcp::json::array();
+        for (int c = 0; c < columns; ++c) {
+            if (c % 2 == 0) {
+                row.push_back(r * columns + c);
+            } else {
+                row.push_back("r" + std::to_string(r) + "c" + std::to_string(c));
+            }
+        }
+        values.push_back(std::move(row));
+    }
+
+    mcp::json body = {
+        {"jsonrpc", "2.0"},
+        {"id", 1},
+        {"method", "tools/call"},
+        {"params", {
+            {"name", "set_sheet_range_content"},
+            {"arguments", {
+                {"file_path", "report.xlsx"},
+                {"sheet_name", "Sheet1"},
+                {"start_cell", "A1"},
+                {"values", std::move(values)}
+            }}
+        }}
+    };
+    return body.dump();
+}
+
+template<typename Json>
+size_t count_cells(const Json& args) {
+    size_t cells = 0;
+    for (const auto& row : args["values"]) {
+        cells += row.size();
+    }
+    return cells;
+}
+
+// One tools/call from body text to queued frame
+template<bool UseArena>
+size_t handle_call(const std::string& body) {
+    mcp::request_envelope env = mcp::request_envelope::scan(body);
+
+    std::string_view raw_arguments;
+    mcp::scan_json_object(env.params, [&](std::string_view key, std::string_view value) {
+        if (key == "\"arguments\"") {
+            raw_arguments = value;
+        }
+    });
+    mcp::tool_arguments args(raw_arguments);
+
+    size_t cells;
+    if constexpr (UseArena) {
+        mcp::arena_scope arena;
+        cells = count_cells(args.parse_arena());
+    } else {
+        cells = count_cells(args.parse());
+    }
+    mcp::json result = {
+        {"isError", false},
+        {"content", mcp::json::array({{{"type", "text"}, {"text", std::to_string(cells) + " cells written"}}})}
+    };
+
+    mcp::json response = mcp::response::create_success(env.id, std::move(result)).to_json();
+    mcp::sse_frame frame = mcp::make_sse_frame("message", response);
+    return frame ? cells : 0;
+}
+
+struct sample {
+    double allocations;
+    double bytes;
+    double ms;
+};
+
+template<bool UseArena>
+sample run(const std::string& body, int iterations) {
+    // Warm up the arena and the frame pool
+    handle_call<UseArena>(body);
+
+    uint64_t allocations_before = bench_alloc::allocation_count.load();
+    uint64_t bytes_before = bench_alloc::allocated_bytes.load();
+    auto start = bench_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        handle_call<UseArena>(body);
+    }
+    double ms = std::chrono::duration<double, std::milli>(bench_clock::now() - start).count();
+
+    return sample{
+        static_cast<double>(bench_alloc::allocation_count.load() - allocations_before) / iterations,
+        static_cast<double>(bench_alloc::allocated_bytes.load() - bytes_before) / iterations,
+        ms / iterations
+    };
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    int max_rows = argc > 1 ? std::atoi(argv[1]) : 1000;
+    int iterations = argc > 2 ? std::atoi(argv[2]) : 10;
+
+    std::printf("%-8s %-8s %14s %16s %12s\n", "cells", "path", "allocs/call", "heap B/call", "ms/call");
+    for (int rows = 10; rows <= max_rows; rows *= 10) {
+        std::string body = make_body(rows);
+        sample heap = run<false>(body, iterations);
+        sample arena = run<true>(body, iterations);
+
+        std::printf("%-8d %-8s %14.0f %16.0f %12.2f\n", rows * columns, "heap", heap.allocations, heap.bytes, heap.ms);
+        std::printf("%-8d %-8s %14.0f %16.0f %12.2f\n", rows * columns, "arena", arena.allocations, arena.bytes, arena.ms);
+    }
+
+    return 0;
+}
@@ -0,0 +1,54 @@
+/**
+ * @file bench_alloc_counter.h
+ * @brief Counts heap allocations of a benchmark by replacing global operator new
+ *
+ * Include from exactly one source file of a benchmark executable. The counters
+ * cover every allocation made through new, including those of the library and
+ * the standard containers.
+ */
+
+#ifndef MCP_BENCH_ALLOC_COUNTER_H
+#define MCP_BENCH_ALLOC_COUNTER_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+namespace bench_alloc {
+
+inline std::atomic<uint64_t> allocation_count{0};
+inline std::atomic<uint64_t> allocated_bytes{0};
+
+} // namespace bench_alloc
+
+// The replacements below pair malloc with free, which is correct for them. Once
+// GCC inlines operator delete into a caller it sees free() on a pointer that came
+// from operator new and reports -Wmismatched-new-delete, so it is silenced here.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void* operator new(size_t size) {
+    bench_alloc::allocation_count.fetch_add(1, std::memory_order_relaxed);
+    bench_alloc::allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    std::free(p);
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+#endif // MCP_BENCH_ALLOC_COUNTER_H
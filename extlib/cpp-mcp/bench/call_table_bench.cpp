@@ -0,0 +1,124 @@
+/**
+ * @file call_table_bench.cpp
+ * @brief Register and complete throughput of the client's pending-request table
+ *
+ * Each thread registers a window of requests, then answers them, as a sender
+ * and the transport's reader would. "map" is the previous table: one mutex
+ * over a std::map keyed by json, with a shared_ptr'd state per call. Both
+ * paths count heap allocations per call.
+ *
+ * Usage: call_table_bench [calls_per_thread] [window]
+ */
+
+#include "mcp_call.h"
+#include "bench_alloc_counter.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using bench_clock = std::chrono::steady_clock;
+
+// The table before striping, reduced to what a round trip touches
+class map_table {
+public:
+    struct state {
+        std::mutex mutex;
+        bool done = false;
+        mcp::json result;
+    };
+
+    std::shared_ptr<state> add(const mcp::json& id) {
+        auto s = std::make_shared<state>();
+        std::lock_guard<std::mutex> lock(mutex_);
+        calls_[id] = s;
+        return s;
+    }
+
+    void complete(const mcp::json& message) {
+        std::shared_ptr<state> s;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = calls_.find(message["id"]);
+            if (it == calls_.end()) {
+                return;
+            }
+            s = std::move(it->second);
+            calls_.erase(it);
+        }
+        std::lock_guard<std::mutex> lock(s->mutex);
+        s->done = true;
+        s->result = message["result"];
+    }
+
+private:
+    std::map<mcp::json, std::shared_ptr<state>> calls_;
+    std::mutex mutex_;
+};
+
+template<typename Table, typename Handle>
+void run(const char* name, int threads, int calls, int window) {
+    Table table;
+    std::atomic<int64_t> next_id{1};
+    uint64_t allocations = bench_alloc::allocation_count.load();
+    auto start = bench_clock::now();
+
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&]() {
+            std::vector<int64_t> ids(window);
+            std::vector<Handle> handles(window);
+            mcp::json response = {{"jsonrpc", "2.0"}, {"id", 0}, {"result", mcp::json::object()}};
+            for (int done = 0; done < calls; done += window) {
+                for (int i = 0; i < window; ++i) {
+                    ids[i] = next_id.fetch_add(1, std::memory_order_relaxed);
+                    handles[i] = table.add(ids[i]);
+                }
+                for (int i = 0; i < window; ++i) {
+                    response["id"] = ids[i];
+                    table.complete(response);
+                    handles[i] = Handle();
+                }
+            }
+        });
+    }
+    for (auto& w : workers) {
+        w.join();
+    }
+
+    double seconds = std::chrono::duration<double>(bench_clock::now() - start).count();
+    double total = static_cast<double>(threads) * calls;
+    std::printf("%-12s %8d %14.0f %14.2f\n", name, threads, total / seconds,
+                (bench_alloc::allocation_count.load() - allocations) / total);
+}
+
+struct striped_table {
+    mcp::call_table table{nullptr};
+
+    mcp::pending_call add(int64_t id) {
+        return table.add(id, std::chrono::milliseconds(0));
+    }
+
+    void complete(const mcp::json& message) {
+        table.complete(message);
+    }
+};
+
+} // namespace
+
+int main(int argc, char** argv) {
+    int calls = argc > 1 ? std::atoi(argv[1]) : 200000;
+    int window = argc > 2 ? std::atoi(argv[2]) : 64;
+
+    std::printf("%-12s %8s %14s %14s\n", "table", "threads", "calls/s", "allocs/call");
+    for (int threads : {1, 4, 8}) {
+        run<map_table, std::shared_ptr<map_table::state>>("map", threads, calls, window);
+        run<striped_table, mcp::pending_call>("call_table", threads, calls, window);
+    }
+    return 0;
+}
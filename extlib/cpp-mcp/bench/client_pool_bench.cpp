@@ -0,0 +1,96 @@
+/**
+ * @file client_pool_bench.cpp
+ * @brief Throughput of one sse_client shared by 1, 8 and 64 calling threads
+ *
+ * Each row runs the callers against a local server for a fixed time with a
+ * given number of POST connections. "serialized" runs them on one connection
+ * behind a client-wide lock held for the whole round trip, as sse_client did
+ * before requests were pooled.
+ *
+ * Usage: client_pool_bench [seconds] [port]
+ */
+
+#include "mcp_server.h"
+#include "mcp_sse_client.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using bench_clock = std::chrono::steady_clock;
+
+double requests_per_second(int port, size_t connections, int callers, double seconds, bool serialized) {
+    mcp::sse_client client("localhost", port);
+    client.set_connection_pool_size(connections);
+    if (!client.initialize("bench", "1.0.0")) {
+        std::fprintf(stderr, "Failed to initialize client\n");
+        return 0;
+    }
+
+    mcp::json arguments = {{"text", "ping"}};
+    std::mutex round_trip;
+    std::atomic<uint64_t> completed{0};
+    auto deadline = bench_clock::now() + std::chrono::duration_cast<bench_clock::duration>(std::chrono::duration<double>(seconds));
+    auto start = bench_clock::now();
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < callers; ++t) {
+        threads.emplace_back([&]() {
+            while (bench_clock::now() < deadline) {
+                try {
+                    if (serialized) {
+                        std::lock_guard<std::mutex> lock(round_trip);
+                        client.call_tool("echo", arguments);
+                    } else {
+                        client.call_tool("echo", arguments);
+                    }
+                    completed.fetch_add(1, std::memory_order_relaxed);
+                } catch (const std::exception& e) {
+                    std::fprintf(stderr, "Call failed: %s\n", e.what());
+                }
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    return completed.load() / std::chrono::duration<double>(bench_clock::now() - start).count();
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    double seconds = argc > 1 ? std::atof(argv[1]) : 3.0;
+    int port = argc > 2 ? std::atoi(argv[2]) : 8097;
+
+    mcp::set_log_level(mcp::log_level::error);
+
+    mcp::server server("localhost", port);
+    mcp::server_options options;
+    options.worker_threads = 8;
+    server.set_options(options);
+    server.register_tool(mcp::tool_builder("echo").with_string_param("text", "Text to echo").build(),
+        [](const mcp::json& args, const std::string&) -> mcp::json {
+            return mcp::json::array({{{"type", "text"}, {"text", args["text"]}}});
+        });
+    server.start(false);
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    std::printf("%-12s %12s %8s %12s\n", "mode", "connections", "callers", "req/s");
+    for (int callers : {1, 8, 64}) {
+        std::printf("%-12s %12d %8d %12.0f\n", "serialized", 1, callers, requests_per_second(port, 1, callers, seconds, true));
+        for (size_t connections : {1, 4, 8}) {
+            std::printf("%-12s %12zu %8d %12.0f\n", "pooled", connections, callers,
+                        requests_per_second(port, connections, callers, seconds, false));
+        }
+    }
+
+    server.stop();
+    return 0;
+}
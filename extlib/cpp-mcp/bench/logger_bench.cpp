@@ -0,0 +1,139 @@
+/**
+ * @file logger_bench.cpp
+ * @brief Logging cost per request, previous logger versus the current one
+ *
+ * A request logs three info lines in server::invoke_method ("Processing method
+ * call", "Calling method handler", "Method call successful"). Each path below
+ * does the same per request:
+ *
+ * - "legacy": the previous mcp::logger, a std::stringstream per line, std::localtime,
+ *   put_time, a global mutex and std::endl to stderr.
+ * - "async": LOG_INFO with the request's log_context, queued for the writer thread.
+ * - "sink": LOG_INFO handing message and context to a sink that formats a JSON line,
+ *   the work done on the request thread when the application installs one.
+ * - "filtered": LOG_INFO below the configured level.
+ *
+ * stderr is redirected to /dev/null so the numbers measure the caller, not the terminal.
+ *
+ * Usage: logger_bench [requests] [threads]
+ */
+
+#include "mcp_logger.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using bench_clock = std::chrono::steady_clock;
+
+std::mutex legacy_mutex;
+
+template<typename... Args>
+void legacy_log(Args&&... args) {
+    std::stringstream ss;
+    auto now = std::chrono::system_clock::now();
+    auto now_c = std::chrono::system_clock::to_time_t(now);
+    auto now_tm = std::localtime(&now_c);
+    ss << std::put_time(now_tm, "%Y-%m-%d %H:%M:%S") << " ";
+    ss << "\033[32m[INFO]\033[0m ";
+    (ss << ... << std::forward<Args>(args));
+
+    std::lock_guard<std::mutex> lock(legacy_mutex);
+    std::cerr << ss.str() << std::endl;
+}
+
+const std::string session_id = "6f1c2a7e-03b4-4c1d-9a55-2e8f0b7d4c31";
+const std::string method = "tools/call";
+
+void legacy_request() {
+    legacy_log("Processing method call: ", method);
+    legacy_log("Calling method handler: ", method);
+    legacy_log("Method call successful: ", method);
+}
+
+void current_request(int id) {
+    mcp::log_context context;
+    context.session_id = session_id;
+    context.method = method;
+    context.request_id = std::to_string(id);
+    context.tool = "get_time";
+    mcp::scoped_log_context scope(context);
+
+    LOG_INFO("Processing method call: ", method);
+    LOG_INFO("Calling method handler: ", method);
+    LOG_INFO("Method call successful: ", method);
+}
+
+template<typename Request>
+double ns_per_request(int requests, int threads, Request request) {
+    auto start = bench_clock::now();
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&]() {
+            for (int i = 0; i < requests / threads; ++i) {
+                request(i);
+            }
+        });
+    }
+    for (auto& w : workers) {
+        w.join();
+    }
+    double ns = std::chrono::duration<double, std::nano>(bench_clock::now() - start).count();
+    return ns * threads / ((requests / threads) * threads);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    int requests = argc > 1 ? std::atoi(argv[1]) : 100000;
+    int max_threads = argc > 2 ? std::atoi(argv[2]) : 4;
+
+    if (!std::freopen("/dev/null", "w", stderr)) {
+        std::perror("freopen");
+        return 1;
+    }
+
+    auto& log = mcp::logger::instance();
+    std::printf("%-10s %8s %16s\n", "path", "threads", "ns/request");
+    for (int threads = 1; threads <= max_threads; threads *= 2) {
+        double legacy = ns_per_request(requests, threads, [](int) { legacy_request(); });
+
+        log.set_level(mcp::log_level::info);
+        double async = ns_per_request(requests, threads, current_request);
+        log.flush();
+
+        log.set_sink([](mcp::log_level, std::string_view message, const mcp::log_context* context) {
+            static thread_local std::string line;
+            line.assign("{\"msg\":");
+            mcp::log_context::append_json_string(line, message);
+            if (context) {
+                line += ',';
+                context->append_json_fields(line);
+            }
+            line += '}';
+        });
+        double sink = ns_per_request(requests, threads, current_request);
+        log.set_sink(nullptr);
+
+        log.set_level(mcp::log_level::error);
+        double filtered = ns_per_request(requests, threads, current_request);
+        log.set_level(mcp::log_level::info);
+
+        std::printf("%-10s %8d %16.0f\n", "legacy", threads, legacy);
+        std::printf("%-10s %8d %16.0f\n", "async", threads, async);
+        std::printf("%-10s %8d %16.0f\n", "sink", threads, sink);
+        std::printf("%-10s %8d %16.0f\n", "filtered", threads, filtered);
+    }
+
+    return 0;
+}
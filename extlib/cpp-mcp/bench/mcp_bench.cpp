@@ -0,0 +1,355 @@
+/**
+ * @file mcp_bench.cpp
+ * @brief Load generator for the MCP server
+ *
+ * Starts an mcp::server in this process with synthetic tools and drives it with
+ * concurrent sse_clients over loopback, one thread per client calling a tool
+ * back to back. Each scenario reports requests per second, latency
+ * percentiles, heap allocations per request and resident memory.
+ *
+ * Tools:
+ *   echo   returns its argument
+ *   cpu    spins for --cpu-iterations rounds of arithmetic
+ *   sleep  sleeps for --sleep-ms
+ *   large  returns a --payload-bytes text block
+ *
+ * Allocations are counted for the whole process, so they include the in-process
+ * clients, which allocate for every call as well. Compare runs with each other
+ * rather than reading the number as the server's alone.
+ *
+ * Usage: mcp_bench [--clients N] [--duration SECONDS] [--tools echo,cpu,sleep,large]
+ *                  [--port PORT] [--workers N] [--sleep-ms MS] [--cpu-iterations N]
+ *                  [--payload-bytes N] [--json FILE] [--baseline FILE] [--tolerance PERCENT]
+ *
+ * --json writes the results as JSON ("-" for stdout). --baseline compares them to
+ * an earlier --json file and exits with status 2 if throughput dropped or p99
+ * latency rose by more than --tolerance percent (default 10).
+ */
+
+#include "mcp_server.h"
+#include "mcp_sse_client.h"
+#include "bench_alloc_counter.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using bench_clock = std::chrono::steady_clock;
+
+struct bench_options {
+    int clients = 8;
+    double duration = 5.0;
+    std::vector<std::string> tools = {"echo", "cpu", "sleep", "large"};
+    int port = 8096;
+    size_t workers = 0;
+    int sleep_ms = 5;
+    int cpu_iterations = 200000;
+    size_t payload_bytes = 64 * 1024;
+    std::string json_path;
+    std::string baseline_path;
+    double tolerance = 10.0;
+};
+
+struct scenario_result {
+    std::string tool;
+    int clients = 0;
+    uint64_t requests = 0;
+    uint64_t errors = 0;
+    double seconds = 0;
+    double p50_us = 0;
+    double p99_us = 0;
+    double p999_us = 0;
+    double max_us = 0;
+    double allocations_per_request = 0;
+    size_t rss_kb = 0;
+
+    double requests_per_second() const {
+        return seconds > 0 ? static_cast<double>(requests) / seconds : 0;
+    }
+};
+
+std::vector<std::string> split(const std::string& list) {
+    std::vector<std::string> items;
+    std::stringstream ss(list);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        if (!item.empty()) {
+            items.push_back(item);
+        }
+    }
+    return items;
+}
+
+bool parse_options(int argc, char** argv, bench_options& options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            std::fprintf(stderr, "Missing value for %s\n", arg.c_str());
+            return false;
+        }
+        std::string value = argv[++i];
+        if (arg == "--clients") {
+            options.clients = std::max(1, std::atoi(value.c_str()));
+        } else if (arg == "--duration") {
+            options.duration = std::atof(value.c_str());
+        } else if (arg == "--tools") {
+            options.tools = split(value);
+        } else if (arg == "--port") {
+            options.port = std::atoi(value.c_str());
+        } else if (arg == "--workers") {
+            options.workers = static_cast<size_t>(std::atoi(value.c_str()));
+        } else if (arg == "--sleep-ms") {
+            options.sleep_ms = std::atoi(value.c_str());
+        } else if (arg == "--cpu-iterations") {
+            options.cpu_iterations = std::atoi(value.c_str());
+        } else if (arg == "--payload-bytes") {
+            options.payload_bytes = static_cast<size_t>(std::atoll(value.c_str()));
+        } else if (arg == "--json") {
+            options.json_path = value;
+        } else if (arg == "--baseline") {
+            options.baseline_path = value;
+        } else if (arg == "--tolerance") {
+            options.tolerance = std::atof(value.c_str());
+        } else {
+            std::fprintf(stderr, "Unknown option %s\n", arg.c_str());
+            return false;
+        }
+    }
+    return true;
+}
+
+// Resident set size in KiB, 0 where /proc is not available
+size_t resident_kb() {
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.compare(0, 6, "VmRSS:") == 0) {
+            return static_cast<size_t>(std::atoll(line.c_str() + 6));
+        }
+    }
+    return 0;
+}
+
+void register_tools(mcp::server& server, const bench_options& options) {
+    server.register_tool(mcp::tool_builder("echo").with_string_param("text", "Text to echo").build(),
+        [](const mcp::json& args, const std::string&) -> mcp::json {
+            return mcp::json::array({{{"type", "text"}, {"text", args["text"]}}});
+        });
+
+    int iterations = options.cpu_iterations;
+    server.register_tool(mcp::tool_builder("cpu").build(),
+        [iterations](const mcp::json&, const std::string&) -> mcp::json {
+            uint64_t x = 88172645463325252ull;
+            for (int i = 0; i < iterations; ++i) {
+                x ^= x << 13;
+                x ^= x >> 7;
+                x ^= x << 17;
+            }
+            return mcp::json::array({{{"type", "text"}, {"text", std::to_string(x)}}});
+        });
+
+    int sleep_ms = options.sleep_ms;
+    server.register_tool(mcp::tool_builder("sleep").build(),
+        [sleep_ms](const mcp::json&, const std::string&) -> mcp::json {
+            std::this_thread::sleep_for(std::chrono::milliseconds(sleep_ms));
+            return mcp::json::array({{{"type", "text"}, {"text", "slept"}}});
+        });
+
+    std::string payload(options.payload_bytes, 'x');
+    server.register_tool(mcp::tool_builder("large").build(),
+        [payload](const mcp::json&, const std::string&) -> mcp::json {
+            return mcp::json::array({{{"type", "text"}, {"text", payload}}});
+        });
+}
+
+scenario_result run_scenario(const bench_options& options, const std::string& tool) {
+    scenario_result result;
+    result.tool = tool;
+    result.clients = options.clients;
+
+    std::vector<std::unique_ptr<mcp::sse_client>> clients;
+    for (int i = 0; i < options.clients; ++i) {
+        auto client = std::make_unique<mcp::sse_client>("localhost", options.port);
+        if (!client->initialize("mcp_bench", "1.0.0")) {
+            std::fprintf(stderr, "Client %d failed to initialize\n", i);
+            result.errors++;
+            continue;
+        }
+        clients.push_back(std::move(client));
+    }
+
+    mcp::json arguments = tool == "echo" ? mcp::json{{"text", "ping"}} : mcp::json::object();
+    std::vector<std::vector<double>> latencies(clients.size());
+    std::atomic<uint64_t> errors{0};
+    std::atomic<bool> go{false};
+
+    uint64_t allocations_before = bench_alloc::allocation_count.load(std::memory_order_relaxed);
+    auto start = bench_clock::now();
+    auto deadline = start + std::chrono::duration_cast<bench_clock::duration>(std::chrono::duration<double>(options.duration));
+
+    std::vector<std::thread> threads;
+    for (size_t c = 0; c < clients.size(); ++c) {
+        threads.emplace_back([&, c]() {
+            while (!go.load(std::memory_order_acquire)) {
+                std::this_thread::yield();
+            }
+            auto& samples = latencies[c];
+            samples.reserve(4096);
+            while (bench_clock::now() < deadline) {
+                auto call_start = bench_clock::now();
+                try {
+                    mcp::json response = clients[c]->call_tool(tool, arguments);
+                    if (response.value("isError", false)) {
+                        errors.fetch_add(1, std::memory_order_relaxed);
+                    }
+                } catch (const std::exception&) {
+                    errors.fetch_add(1, std::memory_order_relaxed);
+                }
+                samples.push_back(std::chrono::duration<double, std::micro>(bench_clock::now() - call_start).count());
+            }
+        });
+    }
+    go.store(true, std::memory_order_release);
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    result.seconds = std::chrono::duration<double>(bench_clock::now() - start).count();
+    uint64_t allocations = bench_alloc::allocation_count.load(std::memory_order_relaxed) - allocations_before;
+    result.rss_kb = resident_kb();
+
+    std::vector<double> all;
+    for (auto& samples : latencies) {
+        all.insert(all.end(), samples.begin(), samples.end());
+    }
+    std::sort(all.begin(), all.end());
+    result.requests = all.size();
+    result.errors += errors.load();
+    if (!all.empty()) {
+        auto at = [&all](double q) {
+            return all[std::min(all.size() - 1, static_cast<size_t>(q * all.size()))];
+        };
+        result.p50_us = at(0.50);
+        result.p99_us = at(0.99);
+        result.p999_us = at(0.999);
+        result.max_us = all.back();
+        result.allocations_per_request = static_cast<double>(allocations) / static_cast<double>(all.size());
+    }
+    return result;
+}
+
+mcp::json to_json(const bench_options& options, const std::vector<scenario_result>& results) {
+    mcp::json scenarios = mcp::json::array();
+    for (const auto& r : results) {
+        scenarios.push_back({
+            {"tool", r.tool},
+            {"clients", r.clients},
+            {"requests", r.requests},
+            {"errors", r.errors},
+            {"seconds", r.seconds},
+            {"requests_per_second", r.requests_per_second()},
+            {"latency_us", {{"p50", r.p50_us}, {"p99", r.p99_us}, {"p999", r.p999_us}, {"max", r.max_us}}},
+            {"allocations_per_request", r.allocations_per_request},
+            {"rss_kb", r.rss_kb}
+        });
+    }
+    return {
+        {"clients", options.clients},
+        {"duration", options.duration},
+        {"workers", options.workers},
+        {"hardware_concurrency", std::thread::hardware_concurrency()},
+        {"scenarios", scenarios}
+    };
+}
+
+// Returns false if any scenario regressed past the tolerance
+bool compare_to_baseline(const mcp::json& current, const std::string& path, double tolerance) {
+    std::ifstream in(path);
+    if (!in) {
+        std::fprintf(stderr, "Cannot read baseline %s\n", path.c_str());
+        return false;
+    }
+    mcp::json baseline = mcp::json::parse(in);
+
+    bool ok = true;
+    std::printf("\n%-8s %16s %16s %12s %12s\n", "tool", "baseline req/s", "req/s", "baseline p99", "p99");
+    for (const auto& now : current["scenarios"]) {
+        for (const auto& before : baseline["scenarios"]) {
+            if (before["tool"] != now["tool"]) {
+                continue;
+            }
+            double rps_before = before["requests_per_second"].get<double>();
+            double rps_now = now["requests_per_second"].get<double>();
+            double p99_before = before["latency_us"]["p99"].get<double>();
+            double p99_now = now["latency_us"]["p99"].get<double>();
+            bool slower = rps_now < rps_before * (1.0 - tolerance / 100.0);
+            bool later = p99_now > p99_before * (1.0 + tolerance / 100.0);
+            std::printf("%-8s %16.0f %16.0f %12.0f %12.0f%s\n", now["tool"].get<std::string>().c_str(),
+                        rps_before, rps_now, p99_before, p99_now, slower || later ? "  REGRESSION" : "");
+            ok = ok && !slower && !later;
+        }
+    }
+    return ok;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    bench_options options;
+    if (!parse_options(argc, argv, options)) {
+        return 1;
+    }
+
+    mcp::set_log_level(mcp::log_level::error);
+
+    mcp::server server("localhost", options.port);
+    mcp::server_options server_options;
+    if (options.workers > 0) {
+        server_options.worker_threads = options.workers;
+    }
+    server.set_options(server_options);
+    register_tools(server, options);
+    if (!server.start(false)) {
+        std::fprintf(stderr, "Failed to start server on port %d\n", options.port);
+        return 1;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    std::vector<scenario_result> results;
+    std::printf("%-8s %8s %10s %12s %10s %10s %10s %10s %12s %10s\n",
+                "tool", "clients", "requests", "req/s", "p50 us", "p99 us", "p999 us", "max us", "allocs/req", "rss KiB");
+    for (const auto& tool : options.tools) {
+        scenario_result r = run_scenario(options, tool);
+        std::printf("%-8s %8d %10llu %12.0f %10.0f %10.0f %10.0f %10.0f %12.1f %10zu\n",
+                    r.tool.c_str(), r.clients, static_cast<unsigned long long>(r.requests), r.requests_per_second(),
+                    r.p50_us, r.p99_us, r.p999_us, r.max_us, r.allocations_per_request, r.rss_kb);
+        if (r.errors > 0) {
+            std::printf("%-8s %llu errors\n", r.tool.c_str(), static_cast<unsigned long long>(r.errors));
+        }
+        results.push_back(std::move(r));
+    }
+
+    server.stop();
+
+    mcp::json report = to_json(options, results);
+    if (options.json_path == "-") {
+        std::printf("%s\n", report.dump(2).c_str());
+    } else if (!options.json_path.empty()) {
+        std::ofstream out(options.json_path);
+        out << report.dump(2) << "\n";
+    }
+
+    if (!options.baseline_path.empty() && !compare_to_baseline(report, options.baseline_path, options.tolerance)) {
+        return 2;
+    }
+    return 0;
+}
@@ -0,0 +1,106 @@
+/**
+ * @file session_id_bench.cpp
+ * @brief Session ids per second, random_device per id versus the per-thread generator
+ *
+ * The "legacy" path is the previous server::generate_session_id: a fresh
+ * std::random_device and std::mt19937 per id and one hex digit at a time through
+ * a std::stringstream. The "chacha20" path is session_key::generate() followed by
+ * to_string(), and "key only" skips the formatting, as the session table does
+ * when it keys sessions by their binary value.
+ *
+ * Usage: session_id_bench [ids] [threads]
+ */
+
+#include "mcp_session.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using bench_clock = std::chrono::steady_clock;
+
+std::string legacy_session_id() {
+    std::random_device rd;
+    std::mt19937 gen(rd());
+    std::uniform_int_distribution<> dis(0, 15);
+
+    std::stringstream ss;
+    ss << std::hex;
+    for (int i = 0; i < 8; ++i) {
+        ss << dis(gen);
+    }
+    ss << "-";
+    for (int i = 0; i < 4; ++i) {
+        ss << dis(gen);
+    }
+    ss << "-";
+    for (int i = 0; i < 4; ++i) {
+        ss << dis(gen);
+    }
+    ss << "-";
+    for (int i = 0; i < 4; ++i) {
+        ss << dis(gen);
+    }
+    ss << "-";
+    for (int i = 0; i < 12; ++i) {
+        ss << dis(gen);
+    }
+    return ss.str();
+}
+
+// Keeps the optimizer from dropping the generated ids
+std::atomic<uint64_t> sink{0};
+
+template<typename Generate>
+double ids_per_second(int ids, int threads, Generate generate) {
+    auto start = bench_clock::now();
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&]() {
+            uint64_t acc = 0;
+            for (int i = 0; i < ids / threads; ++i) {
+                acc += generate();
+            }
+            sink.fetch_add(acc, std::memory_order_relaxed);
+        });
+    }
+    for (auto& w : workers) {
+        w.join();
+    }
+    double seconds = std::chrono::duration<double>(bench_clock::now() - start).count();
+    return (ids / threads) * threads / seconds;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    int ids = argc > 1 ? std::atoi(argv[1]) : 200000;
+    int max_threads = argc > 2 ? std::atoi(argv[2]) : 4;
+
+    std::printf("%-10s %8s %16s\n", "path", "threads", "ids/s");
+    for (int threads = 1; threads <= max_threads; threads *= 2) {
+        double legacy = ids_per_second(ids, threads, []() {
+            return static_cast<uint64_t>(legacy_session_id()[0]);
+        });
+        double chacha = ids_per_second(ids, threads, []() {
+            return static_cast<uint64_t>(mcp::session_key::generate().to_string()[0]);
+        });
+        double key_only = ids_per_second(ids, threads, []() {
+            return mcp::session_key::generate().lo;
+        });
+
+        std::printf("%-10s %8d %16.0f\n", "legacy", threads, legacy);
+        std::printf("%-10s %8d %16.0f\n", "chacha20", threads, chacha);
+        std::printf("%-10s %8d %16.0f\n", "key only", threads, key_only);
+    }
+
+    return 0;
+}
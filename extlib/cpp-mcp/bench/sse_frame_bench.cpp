@@ -0,0 +1,119 @@
+/**
+ * @file sse_frame_bench.cpp
+ * @brief Bytes copied and time per SSE response, old string pipeline vs frame builder
+ *
+ * The old pipeline dumps the response to a string, streams it into a stringstream
+ * with the SSE prefix, copies the stream out and copies it again into the queue.
+ * Each of those steps allocates a fresh buffer of the full payload size, so the
+ * allocated bytes per response measure how often the payload was copied. The frame
+ * builder serializes once into a pooled buffer, which is reused after warm-up.
+ *
+ * Usage: sse_frame_bench [iterations]
+ */
+
+#include "mcp_server.h"
+#include "bench_alloc_counter.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+
+namespace {
+
+using bench_clock = std::chrono::steady_clock;
+
+// A tool result with one text block of the given size, like a large sheet or document dump
+mcp::json make_result(size_t payload_size) {
+    return mcp::json{
+        {"isError", false},
+        {"content", mcp::json::array({
+            {{"type", "text"}, {"text", std::string(payload_size, 'x')}}
+        })}
+    };
+}
+
+struct sample {
+    double bytes_per_response;
+    double allocations_per_response;
+    double us_per_response;
+    size_t frame_size;
+};
+
+template<class Send>
+sample run(size_t payload_size, int iterations, Send send) {
+    mcp::event_dispatcher dispatcher;
+    size_t written = 0;
+    httplib::DataSink sink;
+    sink.write = [&](const char*, size_t n) {
+        written += n;
+        return true;
+    };
+
+    // Warm up pools and allocator
+    for (int i = 0; i < 3; ++i) {
+        send(dispatcher, make_result(payload_size), i);
+        dispatcher.wait_event(&sink);
+    }
+
+    double total_us = 0;
+    uint64_t bytes = 0;
+    uint64_t allocations = 0;
+    for (int i = 0; i < iterations; ++i) {
+        mcp::json result = make_result(payload_size);
+        written = 0;
+
+        uint64_t bytes_before = bench_alloc::allocated_bytes.load();
+        uint64_t allocations_before = bench_alloc::allocation_count.load();
+        auto start = bench_clock::now();
+
+        send(dispatcher, std::move(result), i);
+        dispatcher.wait_event(&sink);
+
+        total_us += std::chrono::duration<double, std::micro>(bench_clock::now() - start).count();
+        bytes += bench_alloc::allocated_bytes.load() - bytes_before;
+        allocations += bench_alloc::allocation_count.load() - allocations_before;
+    }
+
+    return sample{
+        static_cast<double>(bytes) / iterations,
+        static_cast<double>(allocations) / iterations,
+        total_us / iterations,
+        written
+    };
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    int iterations = argc > 1 ? std::atoi(argv[1]) : 20;
+
+    std::printf("%-12s %12s %-8s %16s %12s %12s %10s\n",
+                "payload", "frame bytes", "path", "alloc B/resp", "copies", "allocs/resp", "us/resp");
+
+    for (size_t payload_size : {size_t(1) << 10, size_t(64) << 10, size_t(1) << 20, size_t(8) << 20}) {
+        // Previous server path: dump, stringstream, str(), copy into the queue
+        sample legacy = run(payload_size, iterations, [](mcp::event_dispatcher& d, mcp::json result, int id) {
+            mcp::json response_json = mcp::response::create_success(id, result).to_json();
+            std::stringstream ss;
+            ss << "event: message\r\ndata: " << response_json.dump() << "\r\n\r\n";
+            d.send_event(ss.str());
+        });
+
+        // Frame builder: moved result, serialized once into a pooled frame
+        sample framed = run(payload_size, iterations, [](mcp::event_dispatcher& d, mcp::json result, int id) {
+            mcp::json response_json = mcp::response::create_success(id, std::move(result)).to_json();
+            d.send_event(mcp::make_sse_frame("message", response_json));
+        });
+
+        for (auto [name, s] : {std::make_pair("legacy", legacy), std::make_pair("frame", framed)}) {
+            std::printf("%-12zu %12zu %-8s %16.0f %12.2f %12.1f %10.1f\n",
+                        payload_size, s.frame_size, name, s.bytes_per_response,
+                        s.bytes_per_response / static_cast<double>(s.frame_size),
+                        s.allocations_per_response, s.us_per_response);
+        }
+    }
+
+    return 0;
+}
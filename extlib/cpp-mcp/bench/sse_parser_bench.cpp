@@ -0,0 +1,119 @@
+/**
+ * @file sse_parser_bench.cpp
+ * @brief SSE receive path throughput and allocations, old string splitting vs sse_parser
+ *
+ * The old path appended each chunk to a string, rewrote CRLF in place, cut
+ * events out with substr + erase and re-split them through an istringstream.
+ * Both paths are fed the same stream in 4 KB chunks, as httplib delivers it,
+ * and count the bytes of every data payload they find.
+ *
+ * Usage: sse_parser_bench [small_events] [large_event_kb]
+ */
+
+#include "mcp_sse_parser.h"
+#include "bench_alloc_counter.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+using bench_clock = std::chrono::steady_clock;
+
+const size_t chunk_size = 4096;
+
+size_t legacy_event(const std::string& event) {
+    std::istringstream stream(event);
+    std::string line;
+    std::vector<std::string> data_lines;
+    while (std::getline(stream, line)) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        if (line.substr(0, 7) == "event: ") {
+            continue;
+        } else if (line.substr(0, 6) == "data: ") {
+            data_lines.push_back(line.substr(6));
+        } else if (line.empty()) {
+            break;
+        }
+    }
+    std::string data;
+    for (size_t i = 0; i < data_lines.size(); ++i) {
+        if (i > 0) data += '\n';
+        data += data_lines[i];
+    }
+    return data.size();
+}
+
+size_t legacy(const std::string& input) {
+    size_t bytes = 0;
+    std::string buffer;
+    for (size_t offset = 0; offset < input.size(); offset += chunk_size) {
+        buffer.append(input, offset, chunk_size);
+
+        size_t crlf_pos = buffer.find("\r\n");
+        while (crlf_pos != std::string::npos) {
+            buffer.replace(crlf_pos, 2, "\n");
+            crlf_pos = buffer.find("\r\n", crlf_pos + 1);
+        }
+
+        size_t start_pos = 0;
+        while ((start_pos = buffer.find("\n\n", start_pos)) != std::string::npos) {
+            std::string event = buffer.substr(0, start_pos);
+            buffer.erase(0, start_pos + 2);
+            start_pos = 0;
+            bytes += legacy_event(event);
+        }
+    }
+    return bytes;
+}
+
+size_t incremental(const std::string& input) {
+    size_t bytes = 0;
+    mcp::sse_parser parser;
+    for (size_t offset = 0; offset < input.size(); offset += chunk_size) {
+        parser.feed(input.data() + offset, std::min(chunk_size, input.size() - offset));
+        parser.consume([&bytes](const mcp::sse_event& event) {
+            bytes += event.data.size();
+        });
+    }
+    return bytes;
+}
+
+template<typename Parse>
+void run(const char* name, const char* stream_name, const std::string& input, Parse parse) {
+    uint64_t allocations = bench_alloc::allocation_count.load();
+    auto start = bench_clock::now();
+    size_t bytes = parse(input);
+    double seconds = std::chrono::duration<double>(bench_clock::now() - start).count();
+    allocations = bench_alloc::allocation_count.load() - allocations;
+    std::printf("%-12s %-8s %12zu %12.1f %14llu\n", name, stream_name, bytes,
+                input.size() / seconds / (1024 * 1024), static_cast<unsigned long long>(allocations));
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    int small_events = argc > 1 ? std::atoi(argv[1]) : 100000;
+    size_t large_kb = argc > 2 ? static_cast<size_t>(std::atoll(argv[2])) : 2048;
+
+    // Responses as the server frames them, CRLF line endings
+    std::string small;
+    for (int i = 0; i < small_events; ++i) {
+        small += "event: message\r\ndata: {\"jsonrpc\":\"2.0\",\"id\":" + std::to_string(i) + ",\"result\":{}}\r\n\r\n";
+    }
+    std::string large = "event: message\r\ndata: " + std::string(large_kb * 1024, 'x') + "\r\n\r\n";
+
+    std::printf("%-12s %-8s %12s %12s %14s\n", "path", "stream", "data bytes", "MiB/s", "allocations");
+    run("legacy", "small", small, legacy);
+    run("sse_parser", "small", small, incremental);
+    run("legacy", "large", large, legacy);
+    run("sse_parser", "large", large, incremental);
+    return 0;
+}
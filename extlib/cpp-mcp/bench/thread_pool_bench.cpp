@@ -0,0 +1,175 @@
+/**
+ * @file thread_pool_bench.cpp
+ * @brief Compare the work-stealing pool with the previous single-queue pool
+ *
+ * For 1 to 64 producer threads, submits small tasks and reports throughput and
+ * the delay between submission and the start of execution (p50/p99/p999).
+ *
+ * Usage: thread_pool_bench [tasks] [workers]
+ */
+
+#include "mcp_thread_pool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <queue>
+#include <string>
+#include <vector>
+
+namespace {
+
+using bench_clock = std::chrono::steady_clock;
+
+// The pool as it was before the work-stealing executor: one mutex, one queue
+class legacy_thread_pool {
+public:
+    explicit legacy_thread_pool(size_t num_threads) : stop_(false) {
+        for (size_t i = 0; i < num_threads; ++i) {
+            workers_.emplace_back([this] {
+                while (true) {
+                    std::function<void()> task;
+                    {
+                        std::unique_lock<std::mutex> lock(queue_mutex_);
+                        condition_.wait(lock, [this] { return stop_ || !tasks_.empty(); });
+                        if (stop_ && tasks_.empty()) {
+                            return;
+                        }
+                        task = std::move(tasks_.front());
+                        tasks_.pop();
+                    }
+                    task();
+                }
+            });
+        }
+    }
+
+    ~legacy_thread_pool() {
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex_);
+            stop_ = true;
+        }
+        condition_.notify_all();
+        for (std::thread& worker : workers_) {
+            worker.join();
+        }
+    }
+
+    template<class F, class... Args>
+    auto enqueue(F&& f, Args&&... args) -> std::future<typename std::invoke_result<F, Args...>::type> {
+        using return_type = typename std::invoke_result<F, Args...>::type;
+        auto task = std::make_shared<std::packaged_task<return_type()>>(
+            std::bind(std::forward<F>(f), std::forward<Args>(args)...)
+        );
+        std::future<return_type> result = task->get_future();
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex_);
+            tasks_.emplace([task]() { (*task)(); });
+        }
+        condition_.notify_one();
+        return result;
+    }
+
+private:
+    std::vector<std::thread> workers_;
+    std::queue<std::function<void()>> tasks_;
+    std::mutex queue_mutex_;
+    std::condition_variable condition_;
+    bool stop_;
+};
+
+struct result {
+    double tasks_per_sec;
+    double p50_us;
+    double p99_us;
+    double p999_us;
+};
+
+double percentile(std::vector<int64_t>& sorted, double p) {
+    size_t index = static_cast<size_t>(p * static_cast<double>(sorted.size() - 1));
+    return static_cast<double>(sorted[index]) / 1000.0;
+}
+
+// Submit is called as submit(pool, task) from every producer
+template<class Pool, class Submit>
+result run(size_t workers, size_t producers, size_t tasks, Submit submit) {
+    std::vector<int64_t> latency(tasks);
+    std::atomic<size_t> done{0};
+    const size_t per_producer = tasks / producers;
+    const size_t total = per_producer * producers;
+
+    bench_clock::time_point start;
+    bench_clock::time_point end;
+    {
+        Pool pool(workers);
+        std::vector<std::thread> threads;
+        std::atomic<bool> go{false};
+
+        for (size_t p = 0; p < producers; ++p) {
+            threads.emplace_back([&, p] {
+                while (!go.load(std::memory_order_acquire)) {
+                    std::this_thread::yield();
+                }
+                for (size_t i = 0; i < per_producer; ++i) {
+                    size_t slot = p * per_producer + i;
+                    auto submitted = bench_clock::now();
+                    submit(pool, [&latency, &done, slot, submitted] {
+                        latency[slot] = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                            bench_clock::now() - submitted).count();
+                        done.fetch_add(1, std::memory_order_release);
+                    });
+                }
+            });
+        }
+
+        start = bench_clock::now();
+        go.store(true, std::memory_order_release);
+        for (auto& t : threads) {
+            t.join();
+        }
+        while (done.load(std::memory_order_acquire) < total) {
+            std::this_thread::yield();
+        }
+        end = bench_clock::now();
+    }
+
+    latency.resize(total);
+    std::sort(latency.begin(), latency.end());
+    double seconds = std::chrono::duration<double>(end - start).count();
+    return result{
+        static_cast<double>(total) / seconds,
+        percentile(latency, 0.50),
+        percentile(latency, 0.99),
+        percentile(latency, 0.999)
+    };
+}
+
+void print(const char* name, size_t producers, const result& r) {
+    std::printf("%-16s %9zu %14.0f %10.1f %10.1f %10.1f\n",
+                name, producers, r.tasks_per_sec, r.p50_us, r.p99_us, r.p999_us);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    size_t tasks = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 200000;
+    size_t workers = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : std::thread::hardware_concurrency();
+    if (workers == 0) {
+        workers = 1;
+    }
+
+    std::printf("tasks=%zu workers=%zu\n", tasks, workers);
+    std::printf("%-16s %9s %14s %10s %10s %10s\n", "pool", "producers", "tasks/s", "p50(us)", "p99(us)", "p999(us)");
+
+    for (size_t producers : {1, 2, 4, 8, 16, 32, 64}) {
+        print("legacy enqueue", producers, run<legacy_thread_pool>(workers, producers, tasks,
+            [](legacy_thread_pool& pool, auto task) { pool.enqueue(std::move(task)); }));
+        print("ws enqueue", producers, run<mcp::thread_pool>(workers, producers, tasks,
+            [](mcp::thread_pool& pool, auto task) { pool.enqueue(std::move(task)); }));
+        print("ws post", producers, run<mcp::thread_pool>(workers, producers, tasks,
+            [](mcp::thread_pool& pool, auto task) { pool.post(std::move(task)); }));
+    }
+
+    return 0;
+}
@@ -0,0 +1,102 @@
+/**
+ * @file transport_latency_bench.cpp
+ * @brief Round-trip latency of a tools/call, /sse + /message versus streamable HTTP
+ *
+ * Both transports are served by the same server. The SSE pair posts the request,
+ * gets 202 Accepted and waits for the response event on the session stream; the
+ * streamable HTTP endpoint returns the response in the POST body.
+ *
+ * Usage: transport_latency_bench [calls] [port]
+ */
+
+#include "mcp_server.h"
+#include "mcp_sse_client.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+namespace {
+
+using bench_clock = std::chrono::steady_clock;
+
+void report(const char* name, std::vector<double> us) {
+    std::sort(us.begin(), us.end());
+    double total = 0;
+    for (double v : us) {
+        total += v;
+    }
+    auto at = [&us](double q) {
+        return us[std::min(us.size() - 1, static_cast<size_t>(q * us.size()))];
+    };
+    std::printf("%-12s %8zu %10.1f %10.1f %10.1f %10.1f\n", name, us.size(), total / us.size(), at(0.5), at(0.99), us.back());
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    int calls = argc > 1 ? std::atoi(argv[1]) : 2000;
+    int port = argc > 2 ? std::atoi(argv[2]) : 8095;
+
+    mcp::set_log_level(mcp::log_level::error);
+
+    mcp::server server("localhost", port);
+    server.set_streamable_http_endpoint("/mcp");
+    server.register_tool(mcp::tool_builder("echo").with_string_param("text", "Text to echo").build(),
+        [](const mcp::json& args, const std::string&) -> mcp::json {
+            return mcp::json::array({{{"type", "text"}, {"text", args["text"]}}});
+        });
+    server.start(false);
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    mcp::json arguments = {{"text", "ping"}};
+
+    // /sse + /message through the SSE client
+    std::vector<double> sse_us;
+    {
+        mcp::sse_client client("localhost", port);
+        if (!client.initialize("bench", "1.0.0")) {
+            std::fprintf(stderr, "SSE client failed to initialize\n");
+            return 1;
+        }
+        for (int i = 0; i < calls; ++i) {
+            auto start = bench_clock::now();
+            client.call_tool("echo", arguments);
+            sse_us.push_back(std::chrono::duration<double, std::micro>(bench_clock::now() - start).count());
+        }
+    }
+
+    // Streamable HTTP on one keep-alive connection
+    std::vector<double> http_us;
+    {
+        httplib::Client http("localhost", port);
+        http.set_keep_alive(true);
+        http.set_tcp_nodelay(true);
+        auto init = http.Post("/mcp", mcp::request::create_with_id(0, "initialize", {{"protocolVersion", mcp::MCP_VERSION}}).to_json().dump(),
+                              "application/json");
+        if (!init || init->status != 200) {
+            std::fprintf(stderr, "Streamable HTTP initialize failed\n");
+            return 1;
+        }
+        httplib::Headers headers = {{"Mcp-Session-Id", init->get_header_value("Mcp-Session-Id")}};
+        http.Post("/mcp", headers, mcp::request::create_notification("initialized").to_json().dump(), "application/json");
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+        for (int i = 1; i <= calls; ++i) {
+            std::string body = mcp::request::create_with_id(i, "tools/call", {{"name", "echo"}, {"arguments", arguments}}).to_json().dump();
+            auto start = bench_clock::now();
+            auto res = http.Post("/mcp", headers, body, "application/json");
+            mcp::json response = mcp::json::parse(res->body);
+            http_us.push_back(std::chrono::duration<double, std::micro>(bench_clock::now() - start).count());
+        }
+    }
+
+    std::printf("%-12s %8s %10s %10s %10s %10s\n", "transport", "calls", "mean us", "p50 us", "p99 us", "max us");
+    report("sse", std::move(sse_us));
+    report("streamable", std::move(http_us));
+
+    server.stop();
+    return 0;
+}
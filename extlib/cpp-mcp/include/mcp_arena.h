@@ -0,0 +1,231 @@
+/**
+ * @file mcp_arena.h
+ * @brief Request-scoped arena and an arena-backed JSON type
+ *
+ * Each worker thread owns a monotonic arena. While an arena_scope is open on the
+ * thread, arena_json nodes, arrays, object members, keys and string values are
+ * carved from it, freeing them is a no-op, and closing the outermost scope
+ * releases everything by resetting the arena cursor. Outside a scope arena_json
+ * falls back to the heap.
+ *
+ * The allocator is stateless: where memory comes from depends on the scope open
+ * when it is allocated, and a block is recognized as arena memory by its address
+ * in the calling thread's arena. So every arena_json that allocated inside a
+ * scope, including one created before the scope and grown inside it, must be
+ * destroyed on the same thread before the scope closes. A heap-backed value
+ * that is only read or released inside a scope is fine.
+ *
+ * mcp::json stays heap-backed, handlers and the registry keep those values around.
+ */
+
+#ifndef MCP_ARENA_H
+#define MCP_ARENA_H
+
+#include "json.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+namespace mcp {
+
+/**
+ * @class request_arena
+ * @brief Monotonic chunk allocator, reset in one step
+ */
+class request_arena {
+public:
+    // Size of the first chunk, later chunks double
+    static constexpr size_t initial_chunk_size = 64 * 1024;
+
+    // Chunks beyond this total are returned to the heap on reset
+    static constexpr size_t max_retained = 4 * 1024 * 1024;
+
+    request_arena() = default;
+    request_arena(const request_arena&) = delete;
+    request_arena& operator=(const request_arena&) = delete;
+
+    ~request_arena() {
+        for (auto& c : chunks_) {
+            std::free(c.data);
+        }
+    }
+
+    /**
+     * @brief Allocate memory that lives until the next reset
+     * @param size Number of bytes
+     * @param alignment Required alignment, a power of two
+     */
+    void* allocate(size_t size, size_t alignment) {
+        while (current_ < chunks_.size()) {
+            chunk& c = chunks_[current_];
+            size_t offset = (offset_ + alignment - 1) & ~(alignment - 1);
+            if (offset + size <= c.size) {
+                offset_ = offset + size;
+                return c.data + offset;
+            }
+            ++current_;
+            offset_ = 0;
+        }
+
+        // Every retained chunk is full, add one large enough for the request
+        size_t chunk_size = chunks_.empty() ? initial_chunk_size : chunks_.back().size * 2;
+        chunk_size = std::max(chunk_size, size + alignment);
+        char* data = static_cast<char*>(std::malloc(chunk_size));
+        if (!data) {
+            throw std::bad_alloc();
+        }
+        chunks_.push_back(chunk{data, chunk_size});
+        current_ = chunks_.size() - 1;
+        offset_ = 0;
+        return allocate(size, alignment);
+    }
+
+    // Whether p lies in one of this arena's chunks
+    bool owns(const void* p) const {
+        auto addr = reinterpret_cast<uintptr_t>(p);
+        for (size_t i = chunks_.size(); i-- > 0;) {
+            auto begin = reinterpret_cast<uintptr_t>(chunks_[i].data);
+            if (addr >= begin && addr < begin + chunks_[i].size) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * @brief Release every allocation at once
+     */
+    void reset() {
+        current_ = 0;
+        offset_ = 0;
+
+        // Keep the chunks a typical request fills, give back what an outlier grew
+        size_t retained = 0;
+        size_t keep = 0;
+        while (keep < chunks_.size() && retained + chunks_[keep].size <= max_retained) {
+            retained += chunks_[keep].size;
+            ++keep;
+        }
+        for (size_t i = std::max<size_t>(keep, 1); i < chunks_.size(); ++i) {
+            std::free(chunks_[i].data);
+        }
+        chunks_.resize(std::min(chunks_.size(), std::max<size_t>(keep, 1)));
+    }
+
+    // Bytes reserved from the heap
+    size_t capacity() const {
+        size_t total = 0;
+        for (const auto& c : chunks_) {
+            total += c.size;
+        }
+        return total;
+    }
+
+    // Arena of the calling thread
+    static request_arena& for_thread() {
+        static thread_local request_arena arena;
+        return arena;
+    }
+
+    // Arena allocations are served from, nullptr outside an arena_scope
+    static request_arena*& current() {
+        static thread_local request_arena* arena = nullptr;
+        return arena;
+    }
+
+private:
+    struct chunk {
+        char* data;
+        size_t size;
+    };
+
+    std::vector<chunk> chunks_;
+    size_t current_ = 0;
+    size_t offset_ = 0;
+};
+
+/**
+ * @class arena_scope
+ * @brief Serves arena_json allocations on this thread from its arena until destroyed
+ *
+ * Scopes nest, only the outermost one resets the arena.
+ */
+class arena_scope {
+public:
+    arena_scope() : outermost_(request_arena::current() == nullptr) {
+        if (outermost_) {
+            request_arena::current() = &request_arena::for_thread();
+        }
+    }
+
+    ~arena_scope() {
+        if (outermost_) {
+            request_arena::current() = nullptr;
+            request_arena::for_thread().reset();
+        }
+    }
+
+    arena_scope(const arena_scope&) = delete;
+    arena_scope& operator=(const arena_scope&) = delete;
+
+private:
+    bool outermost_;
+};
+
+/**
+ * @brief Stateless allocator drawing from the current request arena
+ *
+ * Blocks are released to the heap unless they lie in the calling thread's
+ * arena, see the lifetime rules above.
+ */
+template<typename T>
+struct arena_allocator {
+    using value_type = T;
+
+    arena_allocator() noexcept = default;
+
+    template<typename U>
+    arena_allocator(const arena_allocator<U>&) noexcept {}
+
+    T* allocate(size_t n) {
+        if (request_arena* arena = request_arena::current()) {
+            return static_cast<T*>(arena->allocate(n * sizeof(T), alignof(T)));
+        }
+        return std::allocator<T>().allocate(n);
+    }
+
+    void deallocate(T* p, size_t n) noexcept {
+        // Arena memory is released by the reset, not one by one
+        if (request_arena::for_thread().owns(p)) {
+            return;
+        }
+        std::allocator<T>().deallocate(p, n);
+    }
+
+    template<typename U>
+    bool operator==(const arena_allocator<U>&) const noexcept {
+        return true;
+    }
+
+    template<typename U>
+    bool operator!=(const arena_allocator<U>&) const noexcept {
+        return false;
+    }
+};
+
+// String whose characters are taken from the request arena
+using arena_string = std::basic_string<char, std::char_traits<char>, arena_allocator<char>>;
+
+// Same layout as mcp::json, with nodes, arrays, objects and strings taken from the request arena
+using arena_json = nlohmann::basic_json<nlohmann::ordered_map, std::vector, arena_string, bool,
+                                        std::int64_t, std::uint64_t, double, arena_allocator>;
+
+} // namespace mcp
+
+#endif // MCP_ARENA_H
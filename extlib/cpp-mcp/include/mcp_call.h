@@ -0,0 +1,720 @@
+/**
+ * @file mcp_call.h
+ * @brief Requests in flight on a client, with deadlines and cancellation
+ *
+ * A client registers every request it sends in a call_table before writing it
+ * and hands the caller a pending_call. The transport's reader completes the call
+ * when the response arrives, the table's timer fails it at its deadline, and
+ * pending_call::cancel() fails it at once and tells the server with
+ * notifications/cancelled. The caller waits on the handle, or attaches a
+ * callback, so one thread can keep any number of requests in flight.
+ *
+ * Calls are keyed by their integer id in preallocated open-addressed stripes,
+ * each behind its own lock. Consecutive ids land in different stripes, so
+ * concurrent senders and the reader rarely contend. Ids that are not integers,
+ * or whose stripe is full, go to a small overflow map. The state a call shares
+ * with its handle is reference counted and recycled through a per-thread cache
+ * rather than allocated for every request.
+ *
+ * Locking: no table lock is held while a call's mutex is taken, except that
+ * cancel() holds it while it takes cancel_mutex_. cancel() reads the call's
+ * owner under the call's mutex, and ~call_table() cannot detach a call still in
+ * the table without that mutex, so the table is alive when cancel_mutex_ is
+ * taken. The destructor then takes cancel_mutex_ itself, which waits for a
+ * cancel that has already removed its call and is queuing the notification.
+ *
+ * notifications/cancelled may be a blocking write or HTTP POST, so it is never
+ * sent from the timer thread or under a lock. The table queues it to a thread of
+ * its own, started with the first cancellation.
+ */
+
+#ifndef MCP_CALL_H
+#define MCP_CALL_H
+
+#include "mcp_message.h"
+#include "mcp_logger.h"
+#include "mcp_thread_pool.h"
+#include "mcp_timer_wheel.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace mcp {
+
+class call_table;
+
+/**
+ * @struct call_options
+ * @brief Per-request settings for the asynchronous client API
+ */
+struct call_options {
+    // Time allowed for the response, zero uses the client's timeout
+    std::chrono::milliseconds timeout{0};
+};
+
+namespace detail {
+
+// Shared between the handle, the table and the transport's reader
+struct call_state {
+    using callback = std::function<void(const json&, const mcp_exception*)>;
+
+    std::atomic<int> refs{0};
+    std::mutex mutex;
+    std::condition_variable cv;
+    json id;
+    bool done = false;
+    json result;
+    bool failed = false;
+    error_code code = error_code::internal_error;
+    std::string message;
+    std::vector<callback> callbacks;
+    timer_service::timer_id timer = 0;
+    bool has_timer = false;
+    call_table* owner = nullptr;
+
+    // Sets the outcome and runs the callbacks; false if the call had already finished
+    bool finish(json value, bool is_error, error_code error, std::string error_message) {
+        std::vector<callback> run;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (done) {
+                return false;
+            }
+            done = true;
+            owner = nullptr;
+            result = std::move(value);
+            failed = is_error;
+            code = error;
+            message = std::move(error_message);
+            run.swap(callbacks);
+        }
+        cv.notify_all();
+        invoke(run);
+        return true;
+    }
+
+    void invoke(const std::vector<callback>& run) {
+        if (run.empty()) {
+            return;
+        }
+        mcp_exception error(code, message);
+        for (const auto& cb : run) {
+            try {
+                cb(result, failed ? &error : nullptr);
+            } catch (const std::exception& e) {
+                LOG_ERROR("Exception in call completion callback: ", e.what());
+            }
+        }
+    }
+
+    // Clears the outcome for the next call
+    void reset() {
+        id = nullptr;
+        done = false;
+        result = nullptr;
+        failed = false;
+        code = error_code::internal_error;
+        message.clear();
+        callbacks.clear();
+        has_timer = false;
+        owner = nullptr;
+    }
+};
+
+// Finished call states of this thread, reused before allocating new ones
+class call_state_cache {
+public:
+    ~call_state_cache() {
+        alive() = false;
+        for (call_state* state : free_) {
+            delete state;
+        }
+    }
+
+    static call_state* acquire() {
+        if (!alive()) {
+            return new call_state();
+        }
+        auto& free = instance().free_;
+        if (free.empty()) {
+            return new call_state();
+        }
+        call_state* state = free.back();
+        free.pop_back();
+        return state;
+    }
+
+    static void release(call_state* state) {
+        // Past the cache's destruction at thread exit, or holding enough already
+        if (!alive() || instance().free_.size() >= 256) {
+            delete state;
+            return;
+        }
+        state->reset();
+        instance().free_.push_back(state);
+    }
+
+private:
+    static call_state_cache& instance() {
+        static thread_local call_state_cache cache;
+        return cache;
+    }
+
+    static bool& alive() {
+        static thread_local bool flag = true;
+        return flag;
+    }
+
+    std::vector<call_state*> free_;
+};
+
+// Counted reference to a call_state, the last one returns it to the cache
+class call_ref {
+public:
+    call_ref() = default;
+
+    explicit call_ref(call_state* state) : state_(state) {
+        if (state_) {
+            state_->refs.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    call_ref(const call_ref& other) : call_ref(other.state_) {}
+
+    call_ref(call_ref&& other) noexcept : state_(other.state_) {
+        other.state_ = nullptr;
+    }
+
+    call_ref& operator=(call_ref other) noexcept {
+        std::swap(state_, other.state_);
+        return *this;
+    }
+
+    ~call_ref() {
+        if (state_ && state_->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            call_state_cache::release(state_);
+        }
+    }
+
+    static call_ref create() {
+        return call_ref(call_state_cache::acquire());
+    }
+
+    call_state* get() const {
+        return state_;
+    }
+
+    call_state* operator->() const {
+        return state_;
+    }
+
+    call_state& operator*() const {
+        return *state_;
+    }
+
+    explicit operator bool() const {
+        return state_ != nullptr;
+    }
+
+private:
+    call_state* state_ = nullptr;
+};
+
+} // namespace detail
+
+/**
+ * @class pending_call
+ * @brief Handle to a request in flight
+ *
+ * Copies share the same request. Waiting, get() and then() may be used from
+ * any thread.
+ */
+class pending_call {
+public:
+    /**
+     * @brief Completion callback, error is null on success
+     */
+    using callback = std::function<void(const json& result, const mcp_exception* error)>;
+
+    pending_call() = default;
+
+    /**
+     * @brief Whether the handle refers to a request
+     */
+    bool valid() const {
+        return static_cast<bool>(state_);
+    }
+
+    /**
+     * @brief The JSON-RPC id of the request
+     */
+    json id() const {
+        return state_ ? state_->id : json();
+    }
+
+    /**
+     * @brief Whether the request has finished, successfully or not
+     */
+    bool ready() const {
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        return state_->done;
+    }
+
+    /**
+     * @brief Block until the request finishes
+     */
+    void wait() const {
+        std::unique_lock<std::mutex> lock(state_->mutex);
+        state_->cv.wait(lock, [this] { return state_->done; });
+    }
+
+    /**
+     * @brief Block until the request finishes or the timeout passes
+     * @return True if the request finished
+     */
+    template<typename Rep, typename Period>
+    bool wait_for(const std::chrono::duration<Rep, Period>& timeout) const {
+        std::unique_lock<std::mutex> lock(state_->mutex);
+        return state_->cv.wait_for(lock, timeout, [this] { return state_->done; });
+    }
+
+    /**
+     * @brief Wait for the request and return its result
+     * @return The result member of the response
+     * @throws mcp_exception with the server's error, or on timeout, cancellation or disconnect
+     */
+    json get() const {
+        wait();
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        if (state_->failed) {
+            throw mcp_exception(state_->code, state_->message);
+        }
+        return state_->result;
+    }
+
+    /**
+     * @brief Run a callback when the request finishes
+     *
+     * Runs at once on this thread if the request has already finished, otherwise
+     * on the thread that finishes it: the transport's reader or the deadline
+     * timer. The callback must not block.
+     * @param cb The callback
+     */
+    void then(callback cb) const {
+        {
+            std::lock_guard<std::mutex> lock(state_->mutex);
+            if (!state_->done) {
+                state_->callbacks.push_back(std::move(cb));
+                return;
+            }
+        }
+        state_->invoke({std::move(cb)});
+    }
+
+    /**
+     * @brief Abandon the request
+     *
+     * Fails the call with "Request cancelled" and queues notifications/cancelled
+     * so the server can stop working on it. The send does not block the caller.
+     * @param reason Optional reason passed to the server
+     * @return True if the request was still in flight
+     */
+    bool cancel(const std::string& reason = "") const;
+
+private:
+    friend class call_table;
+
+    explicit pending_call(detail::call_ref state) : state_(std::move(state)) {}
+
+    detail::call_ref state_;
+};
+
+/**
+ * @class call_table
+ * @brief Requests a client is waiting on, by id
+ */
+class call_table {
+public:
+    /**
+     * @brief Sends notifications/cancelled for an abandoned request
+     */
+    using cancel_sender = std::function<void(const json& id, const std::string& reason)>;
+
+    /**
+     * @brief Constructor
+     * @param send_cancel Called when a request is cancelled or times out, on a
+     *        thread of the table's own
+     */
+    explicit call_table(cancel_sender send_cancel) : send_cancel_(std::move(send_cancel)) {}
+
+    ~call_table() {
+        // Waits for a cancel in progress; later ones and queued notifications are
+        // moot once the client closes, a send already running finishes
+        {
+            std::lock_guard<std::mutex> lock(cancel_mutex_);
+            closing_.store(true, std::memory_order_release);
+        }
+        timers_.stop();
+        fail_all(error_code::internal_error, "Client closed");
+        cancel_sends_.reset();
+    }
+
+    call_table(const call_table&) = delete;
+    call_table& operator=(const call_table&) = delete;
+
+    /**
+     * @brief Register a request before it is written
+     * @param id The request id
+     * @param timeout Time allowed for the response, zero for none
+     * @return Handle for the caller
+     */
+    pending_call add(const json& id, std::chrono::milliseconds timeout) {
+        detail::call_ref state = detail::call_ref::create();
+        state->id = id;
+        state->owner = this;
+        insert(id, state);
+
+        if (timeout.count() > 0) {
+            timers_.start();
+            // The timer holds a reference until it fires or is cancelled
+            auto timer = timers_.schedule(timeout, [this, state]() {
+                expire(state);
+            });
+            std::lock_guard<std::mutex> lock(state->mutex);
+            state->timer = timer;
+            state->has_timer = true;
+        }
+        return pending_call(std::move(state));
+    }
+
+    /**
+     * @brief Finish the request a JSON-RPC response answers
+     * @param message The response, with "result" or "error"
+     * @return False if no request with its id is waiting
+     */
+    bool complete(const json& message) {
+        auto it = message.find("id");
+        if (it == message.end()) {
+            return false;
+        }
+        detail::call_ref state = take(*it);
+        if (!state) {
+            return false;
+        }
+        cancel_timer(*state);
+
+        // Nothing here may throw, the call is out of the table and has no deadline left
+        auto error = message.find("error");
+        if (error != message.end() && error->is_object()) {
+            error_code code = error_code::internal_error;
+            auto code_it = error->find("code");
+            if (code_it != error->end() && code_it->is_number_integer()) {
+                code = static_cast<error_code>(code_it->get<int64_t>());
+            }
+            std::string text;
+            auto message_it = error->find("message");
+            if (message_it != error->end() && message_it->is_string()) {
+                text = message_it->get<std::string>();
+            }
+            state->finish(json(), true, code, std::move(text));
+        } else {
+            auto result = message.find("result");
+            state->finish(result != message.end() ? *result : json::object(), false, error_code::internal_error, "");
+        }
+        return true;
+    }
+
+    /**
+     * @brief Finish a request with a result obtained some other way
+     * @param id The request id
+     * @param result The result
+     */
+    void resolve(const json& id, json result) {
+        if (detail::call_ref state = take(id)) {
+            cancel_timer(*state);
+            state->finish(std::move(result), false, error_code::internal_error, "");
+        }
+    }
+
+    /**
+     * @brief Fail one request, e.g. when writing it failed
+     * @param id The request id
+     * @param code Error code reported to the caller
+     * @param message Error message reported to the caller
+     */
+    void fail(const json& id, error_code code, const std::string& message) {
+        if (detail::call_ref state = take(id)) {
+            cancel_timer(*state);
+            state->finish(json(), true, code, message);
+        }
+    }
+
+    /**
+     * @brief Fail every request, e.g. when the connection is lost
+     * @param code Error code reported to the callers
+     * @param message Error message reported to the callers
+     */
+    void fail_all(error_code code, const std::string& message) {
+        std::vector<detail::call_ref> calls;
+        for (auto& s : stripes_) {
+            std::lock_guard<std::mutex> lock(s.mutex);
+            for (auto& entry : s.slots) {
+                if (entry.state) {
+                    calls.push_back(std::move(entry.state));
+                }
+                entry.key = empty_key;
+            }
+            s.size = 0;
+        }
+        {
+            std::lock_guard<std::mutex> lock(overflow_mutex_);
+            for (auto& [id, state] : overflow_) {
+                calls.push_back(std::move(state));
+            }
+            overflow_.clear();
+        }
+        for (auto& state : calls) {
+            cancel_timer(*state);
+            state->finish(json(), true, code, message);
+        }
+    }
+
+    /**
+     * @brief Number of requests in flight
+     */
+    size_t size() const {
+        size_t total = 0;
+        for (const auto& s : stripes_) {
+            std::lock_guard<std::mutex> lock(s.mutex);
+            total += s.size;
+        }
+        std::lock_guard<std::mutex> lock(overflow_mutex_);
+        return total + overflow_.size();
+    }
+
+private:
+    friend class pending_call;
+
+    static constexpr size_t stripe_count = 16;
+    static constexpr size_t stripe_slots = 256;
+    static constexpr int64_t empty_key = std::numeric_limits<int64_t>::min();
+    static constexpr int64_t deleted_key = empty_key + 1;
+
+    struct slot {
+        int64_t key = empty_key;
+        detail::call_ref state;
+    };
+
+    // An open-addressed, linearly probed array behind one lock
+    struct alignas(64) stripe {
+        mutable std::mutex mutex;
+        std::array<slot, stripe_slots> slots;
+        size_t size = 0;
+    };
+
+    // The key of an id the stripes can hold
+    static bool integer_key(const json& id, int64_t& key) {
+        if (!id.is_number_integer()) {
+            return false;
+        }
+        if (id.is_number_unsigned() && id.get<uint64_t>() > static_cast<uint64_t>(std::numeric_limits<int64_t>::max())) {
+            return false;
+        }
+        key = id.get<int64_t>();
+        return key != empty_key && key != deleted_key;
+    }
+
+    stripe& stripe_of(int64_t key) {
+        return stripes_[static_cast<uint64_t>(key) % stripe_count];
+    }
+
+    static size_t home_of(int64_t key) {
+        return static_cast<size_t>(static_cast<uint64_t>(key) / stripe_count) % stripe_slots;
+    }
+
+    void insert(const json& id, const detail::call_ref& state) {
+        int64_t key;
+        if (integer_key(id, key)) {
+            stripe& s = stripe_of(key);
+            std::lock_guard<std::mutex> lock(s.mutex);
+            size_t home = home_of(key);
+            for (size_t i = 0; i < stripe_slots; ++i) {
+                slot& entry = s.slots[(home + i) % stripe_slots];
+                if (entry.key == empty_key || entry.key == deleted_key) {
+                    entry.key = key;
+                    entry.state = state;
+                    ++s.size;
+                    return;
+                }
+            }
+        }
+        std::lock_guard<std::mutex> lock(overflow_mutex_);
+        overflow_[id] = state;
+    }
+
+    // Removes the call with this id, only if it is expected when that is given
+    detail::call_ref take(const json& id, const detail::call_state* expected = nullptr) {
+        int64_t key;
+        if (integer_key(id, key)) {
+            stripe& s = stripe_of(key);
+            std::lock_guard<std::mutex> lock(s.mutex);
+            size_t home = home_of(key);
+            for (size_t i = 0; i < stripe_slots; ++i) {
+                size_t index = (home + i) % stripe_slots;
+                slot& entry = s.slots[index];
+                if (entry.key == empty_key) {
+                    break;
+                }
+                if (entry.key != key) {
+                    continue;
+                }
+                if (expected && entry.state.get() != expected) {
+                    return detail::call_ref();
+                }
+                detail::call_ref state = std::move(entry.state);
+                --s.size;
+                entry.key = deleted_key;
+                // A tombstone run ending at an empty slot ends no probe chain
+                if (s.slots[(index + 1) % stripe_slots].key == empty_key) {
+                    for (size_t j = 0; j < stripe_slots; ++j) {
+                        slot& previous = s.slots[(index + stripe_slots - j) % stripe_slots];
+                        if (previous.key != deleted_key) {
+                            break;
+                        }
+                        previous.key = empty_key;
+                    }
+                }
+                return state;
+            }
+        }
+        std::lock_guard<std::mutex> lock(overflow_mutex_);
+        auto it = overflow_.find(id);
+        if (it == overflow_.end() || (expected && it->second.get() != expected)) {
+            return detail::call_ref();
+        }
+        detail::call_ref state = std::move(it->second);
+        overflow_.erase(it);
+        return state;
+    }
+
+    void cancel_timer(detail::call_state& state) {
+        timer_service::timer_id timer;
+        {
+            std::lock_guard<std::mutex> lock(state.mutex);
+            if (!state.has_timer) {
+                return;
+            }
+            state.has_timer = false;
+            timer = state.timer;
+        }
+        timers_.cancel(timer);
+    }
+
+    // Runs on the timer thread
+    void expire(const detail::call_ref& state) {
+        if (!take(state->id, state.get())) {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            state->has_timer = false;
+        }
+        if (state->finish(json(), true, error_code::internal_error, "Timeout waiting for response")) {
+            notify_cancelled(state->id, "Timeout");
+        }
+    }
+
+    // Called by pending_call::cancel with the call's mutex held. Queuing the
+    // notification only takes the pool's inbox lock; cancel_mutex_ keeps the
+    // destructor waiting until it is done.
+    bool cancel_locked(detail::call_state& state, const std::string& reason) {
+        std::lock_guard<std::mutex> lock(cancel_mutex_);
+        if (closing_.load(std::memory_order_relaxed) || !take(state.id, &state)) {
+            return false;
+        }
+        if (state.has_timer) {
+            state.has_timer = false;
+            timers_.cancel(state.timer);
+        }
+        queue_cancel(state.id, reason);
+        return true;
+    }
+
+    void notify_cancelled(const json& id, const std::string& reason) {
+        std::lock_guard<std::mutex> lock(cancel_mutex_);
+        if (!closing_.load(std::memory_order_relaxed)) {
+            queue_cancel(id, reason);
+        }
+    }
+
+    // Queues notifications/cancelled with cancel_mutex_ held, the send runs on cancel_sends_
+    void queue_cancel(const json& id, const std::string& reason) {
+        if (!send_cancel_) {
+            return;
+        }
+        if (!cancel_sends_) {
+            cancel_sends_ = std::make_unique<thread_pool>(1);
+        }
+        cancel_sends_->post([this, id, reason]() {
+            if (closing_.load(std::memory_order_acquire)) {
+                return;
+            }
+            try {
+                send_cancel_(id, reason);
+            } catch (const std::exception& e) {
+                LOG_WARNING("Failed to send cancellation for request ", id.dump(), ": ", e.what());
+            }
+        });
+    }
+
+    // Sends notifications/cancelled
+    cancel_sender send_cancel_;
+
+    // Runs send_cancel_ off the timer thread and the callers' locks, started by
+    // the first cancellation
+    std::unique_ptr<thread_pool> cancel_sends_;
+
+    // Guards starting cancel_sends_, posting to it and closing_
+    std::mutex cancel_mutex_;
+
+    // Set by the destructor, later and queued cancellations are dropped
+    std::atomic<bool> closing_{false};
+
+    // Requests in flight with integer ids
+    std::array<stripe, stripe_count> stripes_;
+
+    // Requests with other ids, or whose stripe was full
+    std::map<json, detail::call_ref> overflow_;
+    mutable std::mutex overflow_mutex_;
+
+    // Deadlines, the thread starts with the first request that has one
+    timer_service timers_;
+};
+
+inline bool pending_call::cancel(const std::string& reason) const {
+    if (!state_) {
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        if (state_->done || !state_->owner || !state_->owner->cancel_locked(*state_, reason)) {
+            return false;
+        }
+    }
+    state_->finish(json(), true, error_code::internal_error, "Request cancelled");
+    return true;
+}
+
+} // namespace mcp
+
+#endif // MCP_CALL_H
@@ -12,6 +12,7 @@
 #include "mcp_message.h"
 #include "mcp_tool.h"
 #include "mcp_logger.h"
+#include "mcp_call.h"
 
 #include <string>
 #include <vector>
@@ -62,6 +63,33 @@ public:
      */
     virtual response send_request(const std::string& method, const json& params = json::object()) = 0;
     
+    /**
+     * @brief Send a request without waiting for the response
+     * @param method The method to call
+     * @param params The parameters to pass
+     * @param options Deadline for this request
+     * @return Handle to wait on, attach a callback to, or cancel
+     * @throws mcp_exception if the request cannot be sent
+     */
+    virtual pending_call send_request_async(const std::string& method, const json& params = json::object(),
+                                            const call_options& options = call_options()) = 0;
+
+    /**
+     * @brief Call a tool without waiting for the result
+     * @param tool_name The name of the tool to call
+     * @param arguments The arguments to pass to the tool
+     * @param options Deadline for this call
+     * @return Handle to wait on, attach a callback to, or cancel
+     * @throws mcp_exception if the request cannot be sent
+     */
+    pending_call call_tool_async(const std::string& tool_name, const json& arguments = json::object(),
+                                 const call_options& options = call_options()) {
+        return send_request_async("tools/call", {
+            {"name", tool_name},
+            {"arguments", arguments}
+        }, options);
+    }
+
     /**
      * @brief Send a notification (no response expected)
      * @param method The method to call
@@ -0,0 +1,229 @@
+/**
+ * @file mcp_envelope.h
+ * @brief JSON-RPC envelope scanning without building a DOM
+ *
+ * Incoming requests are scanned once to pull out "jsonrpc", "id" and "method".
+ * The "params" member is kept as a view into the request body and only parsed
+ * when a handler asks for it, so large tool arguments are never copied between
+ * trees. Tools registered with a raw handler receive their arguments as text
+ * and can stream them through a SAX parser.
+ */
+
+#ifndef MCP_ENVELOPE_H
+#define MCP_ENVELOPE_H
+
+#include "mcp_message.h"
+#include "mcp_arena.h"
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace mcp {
+
+namespace detail {
+
+// Index of the first non-whitespace character at or after pos
+size_t skip_json_whitespace(std::string_view text, size_t pos);
+
+// End of the JSON value starting at pos, checks structure but not scalar syntax.
+// Throws mcp_exception(parse_error) if the value is malformed.
+size_t skip_json_value(std::string_view text, size_t pos);
+
+} // namespace detail
+
+/**
+ * @brief Decode a raw JSON string token, including its quotes
+ * @param token The token text, e.g. "\"tools/call\""
+ */
+std::string decode_json_string(std::string_view token);
+
+/**
+ * @brief Visit the members of a JSON object without parsing their values
+ * @param text JSON text of an object
+ * @param visit Called as visit(std::string_view raw_key, std::string_view raw_value),
+ *              the key still has its quotes and escapes
+ * @return false if text is not an object
+ * @throws mcp_exception(parse_error) if the text is malformed
+ */
+template<typename Visitor>
+bool scan_json_object(std::string_view text, Visitor&& visit) {
+    size_t pos = detail::skip_json_whitespace(text, 0);
+    if (pos >= text.size() || text[pos] != '{') {
+        if (pos < text.size()) {
+            // Still reject trailing garbage after a non-object value
+            pos = detail::skip_json_value(text, pos);
+            if (detail::skip_json_whitespace(text, pos) != text.size()) {
+                throw mcp_exception(error_code::parse_error, "Unexpected data after JSON value");
+            }
+        }
+        return false;
+    }
+
+    pos = detail::skip_json_whitespace(text, pos + 1);
+    if (pos < text.size() && text[pos] == '}') {
+        pos = pos + 1;
+    } else {
+        while (true) {
+            if (pos >= text.size() || text[pos] != '"') {
+                throw mcp_exception(error_code::parse_error, "Expected object key");
+            }
+            size_t key_end = detail::skip_json_value(text, pos);
+            std::string_view key = text.substr(pos, key_end - pos);
+
+            pos = detail::skip_json_whitespace(text, key_end);
+            if (pos >= text.size() || text[pos] != ':') {
+                throw mcp_exception(error_code::parse_error, "Expected ':' after object key");
+            }
+            pos = detail::skip_json_whitespace(text, pos + 1);
+            size_t value_end = detail::skip_json_value(text, pos);
+            visit(key, text.substr(pos, value_end - pos));
+
+            pos = detail::skip_json_whitespace(text, value_end);
+            if (pos < text.size() && text[pos] == ',') {
+                pos = detail::skip_json_whitespace(text, pos + 1);
+                continue;
+            }
+            if (pos < text.size() && text[pos] == '}') {
+                pos = pos + 1;
+                break;
+            }
+            throw mcp_exception(error_code::parse_error, "Expected ',' or '}' in object");
+        }
+    }
+
+    if (detail::skip_json_whitespace(text, pos) != text.size()) {
+        throw mcp_exception(error_code::parse_error, "Unexpected data after JSON object");
+    }
+    return true;
+}
+
+/**
+ * @brief Parse a JSON value held as text
+ * @throws mcp_exception with the given code if the text is not valid JSON
+ */
+json parse_json_view(std::string_view text, error_code code = error_code::parse_error);
+
+/**
+ * @struct request_envelope
+ * @brief A JSON-RPC message with its params left unparsed in the body
+ */
+struct request_envelope {
+    // Request body, owns the text params points into
+    std::shared_ptr<const std::string> body;
+
+    std::string jsonrpc;
+    std::string method;
+
+    // Null for notifications
+    json id;
+
+    // Raw params value, empty when absent
+    std::string_view params;
+
+    // Whether jsonrpc and method were present as strings
+    bool has_jsonrpc = false;
+    bool has_method = false;
+
+    bool is_notification() const {
+        return id.is_null();
+    }
+
+    // Whether the envelope is a valid request object
+    bool is_valid() const {
+        return has_jsonrpc && has_method;
+    }
+
+    /**
+     * @brief Parse the params into a DOM
+     * @return The params, or an empty object when absent
+     * @throws mcp_exception(invalid_params) if the params are not valid JSON
+     */
+    json parse_params() const;
+
+    /**
+     * @brief Build a request with parsed params
+     */
+    request to_request() const;
+
+    /**
+     * @brief Scan a request body
+     * @param body The JSON text of the request
+     * @throws mcp_exception(parse_error) if the body is not valid JSON
+     * @throws mcp_exception(invalid_request) if the body is not an object
+     */
+    static request_envelope scan(std::string body);
+
+    /**
+     * @brief Whether a body holds a JSON-RPC batch, i.e. starts with '['
+     */
+    static bool is_batch(std::string_view body);
+
+    /**
+     * @brief Scan a batch body into its members, which share the body
+     * @param body The JSON text of the batch
+     * @return The members in order, members that are not objects are returned invalid
+     * @throws mcp_exception(parse_error) if the body is not a valid JSON array
+     */
+    static std::vector<request_envelope> scan_batch(std::string body);
+};
+
+/**
+ * @class tool_arguments
+ * @brief Tool call arguments as JSON text, for tools that do not want an ordered_json copy
+ *
+ * Arguments sent as a JSON-encoded string are unwrapped, absent arguments read as "{}".
+ */
+class tool_arguments {
+public:
+    explicit tool_arguments(std::string_view raw_value);
+
+    // Points into itself when the arguments had to be unwrapped
+    tool_arguments(const tool_arguments&) = delete;
+    tool_arguments& operator=(const tool_arguments&) = delete;
+
+    // JSON text of the arguments
+    std::string_view raw() const {
+        return text_;
+    }
+
+    /**
+     * @brief Stream the arguments through a nlohmann SAX handler
+     * @return false if the handler stopped the parse or the text is invalid
+     */
+    template<typename SAX>
+    bool sax_parse(SAX* sax) const {
+        return json::sax_parse(text_.begin(), text_.end(), sax);
+    }
+
+    /**
+     * @brief Visit the top-level members without parsing their values
+     * @see scan_json_object
+     */
+    template<typename Visitor>
+    bool for_each_member(Visitor&& visit) const {
+        return scan_json_object(text_, std::forward<Visitor>(visit));
+    }
+
+    /**
+     * @brief Parse the arguments into a DOM
+     * @throws mcp_exception(invalid_params) if the arguments are not valid JSON
+     */
+    json parse() const;
+
+    /**
+     * @brief Parse the arguments into a DOM taken from the request arena
+     * @note The result must not outlive the handler call
+     * @throws mcp_exception(invalid_params) if the arguments are not valid JSON
+     */
+    arena_json parse_arena() const;
+
+private:
+    std::string unwrapped_;
+    std::string_view text_;
+};
+
+} // namespace mcp
+
+#endif // MCP_ENVELOPE_H
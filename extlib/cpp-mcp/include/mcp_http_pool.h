@@ -0,0 +1,129 @@
+/**
+ * @file mcp_http_pool.h
+ * @brief A fixed set of keep-alive HTTP connections shared by concurrent callers
+ *
+ * httplib::Client runs one request at a time on its connection, so callers that
+ * share one wait for each other. The pool holds several clients and leases the
+ * one with the fewest requests outstanding, preferring the lowest index on a
+ * tie: a single caller keeps reusing one warm connection, and further
+ * connections are opened only when callers overlap.
+ */
+
+#ifndef MCP_HTTP_POOL_H
+#define MCP_HTTP_POOL_H
+
+#include "httplib.h"
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace mcp {
+
+/**
+ * @class http_client_pool
+ * @brief Least-outstanding selection over N keep-alive httplib clients
+ */
+class http_client_pool {
+public:
+    using factory = std::function<std::unique_ptr<httplib::Client>()>;
+
+    /**
+     * @class lease
+     * @brief A client reserved for one request, released on destruction
+     */
+    class lease {
+    public:
+        lease(lease&& other) noexcept : client_(other.client_), outstanding_(other.outstanding_) {
+            other.outstanding_ = nullptr;
+        }
+
+        lease(const lease&) = delete;
+        lease& operator=(const lease&) = delete;
+        lease& operator=(lease&&) = delete;
+
+        ~lease() {
+            if (outstanding_) {
+                outstanding_->fetch_sub(1, std::memory_order_relaxed);
+            }
+        }
+
+        httplib::Client* operator->() const {
+            return client_;
+        }
+
+        httplib::Client& operator*() const {
+            return *client_;
+        }
+
+    private:
+        friend class http_client_pool;
+
+        lease(httplib::Client* client, std::atomic<size_t>* outstanding) : client_(client), outstanding_(outstanding) {}
+
+        httplib::Client* client_;
+        std::atomic<size_t>* outstanding_;
+    };
+
+    /**
+     * @brief Constructor
+     * @param size Number of connections, at least one
+     * @param make Creates a configured client; connections open on first use
+     */
+    http_client_pool(size_t size, const factory& make) : slots_(size > 0 ? size : 1) {
+        for (auto& slot : slots_) {
+            slot.client = make();
+            slot.client->set_keep_alive(true);
+            slot.client->set_tcp_nodelay(true);
+        }
+    }
+
+    http_client_pool(const http_client_pool&) = delete;
+    http_client_pool& operator=(const http_client_pool&) = delete;
+
+    /**
+     * @brief Reserve the client with the fewest requests outstanding
+     */
+    lease acquire() {
+        slot* best = &slots_[0];
+        size_t best_count = best->outstanding.load(std::memory_order_relaxed);
+        for (size_t i = 1; i < slots_.size() && best_count > 0; ++i) {
+            size_t count = slots_[i].outstanding.load(std::memory_order_relaxed);
+            if (count < best_count) {
+                best = &slots_[i];
+                best_count = count;
+            }
+        }
+        best->outstanding.fetch_add(1, std::memory_order_relaxed);
+        return lease(best->client.get(), &best->outstanding);
+    }
+
+    /**
+     * @brief Number of connections
+     */
+    size_t size() const {
+        return slots_.size();
+    }
+
+    /**
+     * @brief Requests in progress on one connection
+     * @param index Connection index, below size()
+     */
+    size_t outstanding(size_t index) const {
+        return slots_[index].outstanding.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct slot {
+        std::unique_ptr<httplib::Client> client;
+        std::atomic<size_t> outstanding{0};
+    };
+
+    std::vector<slot> slots_;
+};
+
+} // namespace mcp
+
+#endif // MCP_HTTP_POOL_H
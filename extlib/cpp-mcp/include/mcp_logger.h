@@ -1,17 +1,46 @@
 /**
  * @file mcp_logger.h
  * @brief Simple logger
+ *
+ * The LOG_* macros test the level before their arguments are evaluated, and
+ * levels below MCP_LOG_MIN_LEVEL are compiled out. Lines are formatted into a
+ * per-thread buffer and, in asynchronous mode (the default), handed to a
+ * background thread through a bounded lock-free ring, so the calling thread
+ * never takes a lock or waits on stderr.
+ *
+ * While a request is being handled its log_context is current on the handling
+ * thread. Built-in output appends its fields to each line; an application that
+ * installs a sink with logger::set_sink() receives them with every message.
  */
 
 #ifndef MCP_LOGGER_H
 #define MCP_LOGGER_H
 
-#include <iostream>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <functional>
+#include <memory>
+#include <mutex>
 #include <sstream>
 #include <string>
-#include <mutex>
-#include <chrono>
-#include <iomanip>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+
+// Lowest level compiled in: 0 debug, 1 info, 2 warning, 3 error, 4 none
+#ifndef MCP_LOG_MIN_LEVEL
+#define MCP_LOG_MIN_LEVEL 0
+#endif
 
 namespace mcp {
 
@@ -22,99 +51,508 @@ enum class log_level {
     error
 };
 
+/**
+ * @struct log_context
+ * @brief Fields of the request the current thread is working on
+ *
+ * session_id and method view strings owned by the request, which outlive the
+ * scope the context is current in.
+ */
+struct log_context {
+    std::string_view session_id;
+    std::string_view method;
+    std::string request_id;
+    std::string tool;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    // Microseconds since the request started
+    int64_t elapsed_us() const {
+        return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // Context of the calling thread, null outside a request
+    static log_context* current() {
+        return slot();
+    }
+
+    /**
+     * @brief Append the fields as members of a JSON object, without braces
+     * @param out Buffer to append to, e.g. `"session_id":"...","method":"..."`
+     */
+    void append_json_fields(std::string& out) const {
+        append_json_member(out, "session_id", session_id, false);
+        append_json_member(out, "request_id", request_id, true);
+        append_json_member(out, "method", method, true);
+        append_json_member(out, "tool", tool, true);
+        out += ",\"elapsed_us\":";
+        char digits[24];
+        auto result = std::to_chars(digits, digits + sizeof(digits), elapsed_us());
+        out.append(digits, result.ptr);
+    }
+
+    // Append a string as a quoted JSON string
+    static void append_json_string(std::string& out, std::string_view value) {
+        static const char hex[] = "0123456789abcdef";
+        out += '"';
+        for (char c : value) {
+            switch (c) {
+                case '"': out += "\\\""; break;
+                case '\\': out += "\\\\"; break;
+                case '\n': out += "\\n"; break;
+                case '\r': out += "\\r"; break;
+                case '\t': out += "\\t"; break;
+                default:
+                    if (static_cast<unsigned char>(c) < 0x20) {
+                        out += "\\u00";
+                        out += hex[(c >> 4) & 0xf];
+                        out += hex[c & 0xf];
+                    } else {
+                        out += c;
+                    }
+            }
+        }
+        out += '"';
+    }
+
+private:
+    friend class scoped_log_context;
+
+    static log_context*& slot() {
+        static thread_local log_context* current = nullptr;
+        return current;
+    }
+
+    static void append_json_member(std::string& out, const char* key, std::string_view value, bool comma) {
+        if (comma) {
+            out += ',';
+        }
+        out += '"';
+        out += key;
+        out += "\":";
+        append_json_string(out, value);
+    }
+};
+
+/**
+ * @class scoped_log_context
+ * @brief Makes a log_context current on this thread for the lifetime of the scope
+ */
+class scoped_log_context {
+public:
+    explicit scoped_log_context(log_context& context) : previous_(log_context::slot()) {
+        log_context::slot() = &context;
+    }
+
+    ~scoped_log_context() {
+        log_context::slot() = previous_;
+    }
+
+    scoped_log_context(const scoped_log_context&) = delete;
+    scoped_log_context& operator=(const scoped_log_context&) = delete;
+
+private:
+    log_context* previous_;
+};
+
 class logger {
 public:
+    // Receives each message without timestamp or level prefix, on the logging thread
+    using sink = std::function<void(log_level level, std::string_view message, const log_context* context)>;
+
     static logger& instance() {
-        static logger instance;
-        return instance;
+        // Never destroyed, so static destructors and detached threads can still log at exit
+        static logger* instance = new logger();
+        return *instance;
     }
-    
+
     void set_level(log_level level) {
-        std::lock_guard<std::mutex> lock(mutex_);
-        level_ = level;
+        level_.store(level, std::memory_order_relaxed);
+    }
+
+    // Whether a message at this level would be written
+    bool enabled(log_level level) const {
+        return level >= level_.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Switch between the background writer and writing on the calling thread
+     * @param async True to queue lines for the background thread
+     */
+    void set_async(bool async) {
+        if (async) {
+            start_writer();
+        } else {
+            stop_writer();
+        }
     }
-    
+
+    /**
+     * @brief Send messages to a sink instead of stderr
+     * @param s The sink, or an empty function for the built-in output
+     *
+     * Install the sink before other threads log; it is not swapped atomically.
+     * The sink is called on the logging thread, so it should queue the message
+     * rather than write it, as an asynchronous spdlog logger does.
+     */
+    void set_sink(sink s) {
+        flush();
+        sink_ = std::move(s);
+        has_sink_.store(static_cast<bool>(sink_), std::memory_order_release);
+        set_async(!has_sink_.load(std::memory_order_relaxed));
+    }
+
+    /**
+     * @brief Wait until every queued line has been written
+     */
+    void flush() {
+        if (!async_.load(std::memory_order_acquire)) {
+            return;
+        }
+        size_t target = head_.load(std::memory_order_acquire);
+        wake_writer();
+        std::unique_lock<std::mutex> lock(wake_mutex_);
+        written_cv_.wait_for(lock, std::chrono::seconds(5), [&] {
+            return written_.load(std::memory_order_acquire) >= target || !async_.load(std::memory_order_acquire);
+        });
+    }
+
     template<typename... Args>
     void debug(Args&&... args) {
         log(log_level::debug, std::forward<Args>(args)...);
     }
-    
+
     template<typename... Args>
     void info(Args&&... args) {
         log(log_level::info, std::forward<Args>(args)...);
     }
-    
+
     template<typename... Args>
     void warning(Args&&... args) {
         log(log_level::warning, std::forward<Args>(args)...);
     }
-    
+
     template<typename... Args>
     void error(Args&&... args) {
         log(log_level::error, std::forward<Args>(args)...);
     }
-    
+
 private:
-    logger() : level_(log_level::info) {}
-    
+    // Lines the ring holds before debug and info lines are dropped
+    static constexpr size_t ring_size = 8192;
+
+    struct slot {
+        std::atomic<size_t> sequence;
+        std::string text;
+    };
+
+    logger() : level_(log_level::info), ring_(new slot[ring_size]) {
+        for (size_t i = 0; i < ring_size; ++i) {
+            ring_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+
+        // Write out what is queued when the process exits, later lines are written directly
+        std::atexit([]() { logger::instance().stop_writer(); });
+#ifndef _WIN32
+        // The writer thread does not exist in a forked child
+        pthread_atfork(nullptr, nullptr, []() {
+            logger& self = logger::instance();
+            self.async_.store(false, std::memory_order_release);
+            self.forked_ = true;
+        });
+#endif
+        start_writer();
+    }
+
+    // Per-thread buffer each line is formatted into
+    static std::string& line_buffer() {
+        static thread_local std::string buffer;
+        return buffer;
+    }
+
+    static void append(std::string& out, const std::string& value) {
+        out += value;
+    }
+
+    static void append(std::string& out, const char* value) {
+        if (value) {
+            out += value;
+        }
+    }
+
     template<typename T>
-    void log_impl(std::stringstream& ss, T&& arg) {
-        ss << std::forward<T>(arg);
+    static void append(std::string& out, const T& value) {
+        using type = std::decay_t<T>;
+        if constexpr (std::is_same_v<type, bool>) {
+            out += value ? '1' : '0';
+        } else if constexpr (std::is_same_v<type, char> || std::is_same_v<type, signed char> || std::is_same_v<type, unsigned char>) {
+            out += static_cast<char>(value);
+        } else if constexpr (std::is_integral_v<type>) {
+            char digits[24];
+            auto result = std::to_chars(digits, digits + sizeof(digits), value);
+            out.append(digits, result.ptr);
+        } else if constexpr (std::is_floating_point_v<type>) {
+            char digits[32];
+            int n = std::snprintf(digits, sizeof(digits), "%g", static_cast<double>(value));
+            out.append(digits, n > 0 ? static_cast<size_t>(n) : 0);
+        } else if constexpr (std::is_convertible_v<const T&, std::string_view>) {
+            out += std::string_view(value);
+        } else {
+            // Anything else goes through its stream operator
+            static thread_local std::ostringstream ss;
+            ss.str(std::string());
+            ss.clear();
+            ss << value;
+            out += ss.str();
+        }
+    }
+
+    // Local time to the second, formatted once per second per thread
+    static void append_timestamp(std::string& out) {
+        static thread_local std::time_t last_second = 0;
+        static thread_local char stamp[32] = {0};
+
+        std::time_t now = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+        if (now != last_second) {
+            std::tm now_tm;
+#ifdef _WIN32
+            localtime_s(&now_tm, &now);
+#else
+            localtime_r(&now, &now_tm);
+#endif
+            std::strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S", &now_tm);
+            last_second = now;
+        }
+        out += stamp;
+        out += ' ';
     }
-    
-    template<typename T, typename... Args>
-    void log_impl(std::stringstream& ss, T&& arg, Args&&... args) {
-        ss << std::forward<T>(arg);
-        log_impl(ss, std::forward<Args>(args)...);
+
+    // Request fields after the message, e.g. " [session=... id=3 method=tools/call tool=echo 120us]"
+    static void append_context(std::string& out, const log_context& context) {
+        out += " [session=";
+        out += context.session_id;
+        if (!context.request_id.empty()) {
+            out += " id=";
+            out += context.request_id;
+        }
+        out += " method=";
+        out += context.method;
+        if (!context.tool.empty()) {
+            out += " tool=";
+            out += context.tool;
+        }
+        out += ' ';
+        append(out, context.elapsed_us());
+        out += "us]";
     }
-    
+
     template<typename... Args>
     void log(log_level level, Args&&... args) {
-        if (level < level_) {
+        if (!enabled(level)) {
             return;
         }
-        
-        std::stringstream ss;
-        
-        // Add timestamp
-        auto now = std::chrono::system_clock::now();
-        auto now_c = std::chrono::system_clock::to_time_t(now);
-        auto now_tm = std::localtime(&now_c);
-        
-        ss << std::put_time(now_tm, "%Y-%m-%d %H:%M:%S") << " ";
-        
+
+        std::string& line = line_buffer();
+        line.clear();
+        const log_context* context = log_context::current();
+
+        if (has_sink_.load(std::memory_order_acquire)) {
+            (append(line, args), ...);
+            sink_(level, line, context);
+            return;
+        }
+
+        append_timestamp(line);
+
         // Add log level and color
         switch (level) {
             case log_level::debug:
-                ss << "\033[36m[DEBUG]\033[0m ";  // Cyan
+                line += "\033[36m[DEBUG]\033[0m ";  // Cyan
                 break;
             case log_level::info:
-                ss << "\033[32m[INFO]\033[0m ";   // Green
+                line += "\033[32m[INFO]\033[0m ";   // Green
                 break;
             case log_level::warning:
-                ss << "\033[33m[WARNING]\033[0m "; // Yellow
+                line += "\033[33m[WARNING]\033[0m "; // Yellow
                 break;
             case log_level::error:
-                ss << "\033[31m[ERROR]\033[0m ";   // Red
+                line += "\033[31m[ERROR]\033[0m ";   // Red
                 break;
         }
-        
+
         // Add log content
-        log_impl(ss, std::forward<Args>(args)...);
-        
+        (append(line, args), ...);
+        if (context) {
+            append_context(line, *context);
+        }
+        line += '\n';
+
         // Output log
-        std::lock_guard<std::mutex> lock(mutex_);
-        std::cerr << ss.str() << std::endl;
+        if (async_.load(std::memory_order_acquire) && try_push(line)) {
+            return;
+        }
+        if (level < log_level::warning && async_.load(std::memory_order_acquire)) {
+            // Ring is full, drop chatter rather than stall the caller
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        write_now(line);
+    }
+
+    void write_now(const std::string& line) {
+        std::lock_guard<std::mutex> lock(output_mutex_);
+        std::fwrite(line.data(), 1, line.size(), stderr);
+        std::fflush(stderr);
+    }
+
+    // Bounded MPSC ring after Vyukov. The line is swapped into the slot, so the
+    // caller's buffer gets back the capacity of a line the writer already wrote.
+    bool try_push(std::string& line) {
+        size_t pos = head_.load(std::memory_order_relaxed);
+        for (;;) {
+            slot& s = ring_[pos % ring_size];
+            size_t sequence = s.sequence.load(std::memory_order_acquire);
+            auto diff = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(pos);
+            if (diff == 0) {
+                if (head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    s.text.swap(line);
+                    s.sequence.store(pos + 1, std::memory_order_release);
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = head_.load(std::memory_order_relaxed);
+            }
+        }
+
+        // Pairs with the fence in the writer between setting sleeping_ and checking the ring
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (sleeping_.load(std::memory_order_relaxed)) {
+            wake_writer();
+        }
+        return true;
+    }
+
+    bool ready() const {
+        return ring_[tail_ % ring_size].sequence.load(std::memory_order_acquire) == tail_ + 1;
+    }
+
+    // Write everything queued, only ever called by one thread at a time
+    size_t drain() {
+        size_t count = 0;
+        {
+            std::lock_guard<std::mutex> lock(output_mutex_);
+            while (ready()) {
+                slot& s = ring_[tail_ % ring_size];
+                std::fwrite(s.text.data(), 1, s.text.size(), stderr);
+                s.text.clear();
+                s.sequence.store(tail_ + ring_size, std::memory_order_release);
+                ++tail_;
+                ++count;
+            }
+            size_t dropped = dropped_.exchange(0, std::memory_order_relaxed);
+            if (dropped > 0) {
+                std::fprintf(stderr, "\033[33m[WARNING]\033[0m %zu log messages dropped\n", dropped);
+            }
+            if (count > 0 || dropped > 0) {
+                std::fflush(stderr);
+            }
+        }
+        written_.store(tail_, std::memory_order_release);
+        return count;
     }
-    
-    log_level level_;
-    std::mutex mutex_;
+
+    void wake_writer() {
+        std::lock_guard<std::mutex> lock(wake_mutex_);
+        wake_cv_.notify_one();
+    }
+
+    void run_writer() {
+        std::unique_lock<std::mutex> lock(wake_mutex_);
+        while (!stopping_) {
+            lock.unlock();
+            bool wrote = drain() > 0;
+            lock.lock();
+            written_cv_.notify_all();
+            if (wrote) {
+                continue;
+            }
+
+            sleeping_.store(true, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            // The timeout only matters if a wakeup is missed
+            wake_cv_.wait_for(lock, std::chrono::milliseconds(100), [this] { return stopping_ || ready(); });
+            sleeping_.store(false, std::memory_order_relaxed);
+        }
+    }
+
+    void start_writer() {
+        std::lock_guard<std::mutex> lock(control_mutex_);
+        if (writer_.joinable() || forked_) {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> wake_lock(wake_mutex_);
+            stopping_ = false;
+        }
+        writer_ = std::thread([this]() { run_writer(); });
+        async_.store(true, std::memory_order_release);
+    }
+
+    void stop_writer() {
+        std::lock_guard<std::mutex> lock(control_mutex_);
+        async_.store(false, std::memory_order_release);
+        if (!writer_.joinable() || forked_) {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> wake_lock(wake_mutex_);
+            stopping_ = true;
+        }
+        wake_cv_.notify_one();
+        writer_.join();
+
+        // Lines queued while the writer was stopping
+        drain();
+        written_cv_.notify_all();
+    }
+
+    std::atomic<log_level> level_;
+    std::atomic<bool> async_{false};
+
+    sink sink_;
+    std::atomic<bool> has_sink_{false};
+
+    std::unique_ptr<slot[]> ring_;
+    alignas(64) std::atomic<size_t> head_{0};
+    alignas(64) size_t tail_ = 0;               // Writer only
+    std::atomic<size_t> written_{0};           // Lines written so far, for flush()
+    std::atomic<size_t> dropped_{0};
+
+    std::mutex output_mutex_;                  // Serializes direct writes with the writer
+    std::mutex wake_mutex_;
+    std::condition_variable wake_cv_;
+    std::condition_variable written_cv_;
+    std::atomic<bool> sleeping_{false};
+    bool stopping_ = false;                    // Guarded by wake_mutex_
+
+    std::mutex control_mutex_;
+    std::thread writer_;
+    bool forked_ = false;
 };
 
-#define LOG_DEBUG(...) mcp::logger::instance().debug(__VA_ARGS__)
-#define LOG_INFO(...) mcp::logger::instance().info(__VA_ARGS__)
-#define LOG_WARNING(...) mcp::logger::instance().warning(__VA_ARGS__)
-#define LOG_ERROR(...) mcp::logger::instance().error(__VA_ARGS__)
+#define MCP_LOG_AT(level, method, ...)                                             \
+    do {                                                                           \
+        if (static_cast<int>(level) >= MCP_LOG_MIN_LEVEL &&                        \
+            mcp::logger::instance().enabled(level)) {                              \
+            mcp::logger::instance().method(__VA_ARGS__);                           \
+        }                                                                          \
+    } while (0)
+
+#define LOG_DEBUG(...) MCP_LOG_AT(mcp::log_level::debug, debug, __VA_ARGS__)
+#define LOG_INFO(...) MCP_LOG_AT(mcp::log_level::info, info, __VA_ARGS__)
+#define LOG_WARNING(...) MCP_LOG_AT(mcp::log_level::warning, warning, __VA_ARGS__)
+#define LOG_ERROR(...) MCP_LOG_AT(mcp::log_level::error, error, __VA_ARGS__)
 
 inline void set_log_level(log_level level) {
     mcp::logger::instance().set_level(level);
@@ -122,4 +560,4 @@ inline void set_log_level(log_level level) {
 
 } // namespace mcp
 
-#endif // MCP_LOGGER_H 
\ No newline at end of file
+#endif // MCP_LOGGER_H
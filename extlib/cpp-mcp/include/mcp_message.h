@@ -9,6 +9,8 @@
 #ifndef MCP_MESSAGE_H
 #define MCP_MESSAGE_H
 
+#include <atomic>
+#include <cstdint>
 #include <string>
 #include <vector>
 #include <map>
@@ -122,8 +124,8 @@ struct request {
 private:
     // Generate a unique ID
     static json generate_id() {
-        static int next_id = 1;
-        return next_id++;
+        static std::atomic<int64_t> next_id{1};
+        return next_id.fetch_add(1, std::memory_order_relaxed);
     }
 };
 
@@ -135,11 +137,11 @@ struct response {
     json error;
     
     // Create a success response
-    static response create_success(const json& req_id, const json& result_data = json::object()) {
+    static response create_success(const json& req_id, json result_data = json::object()) {
         response res;
         res.jsonrpc = "2.0";
         res.id = req_id;
-        res.result = result_data;
+        res.result = std::move(result_data);
         return res;
     }
     
@@ -166,7 +168,7 @@ struct response {
     }
     
     // Convert to JSON
-    json to_json() const {
+    json to_json() const & {
         json j = {
             {"jsonrpc", jsonrpc},
             {"id", id}
@@ -180,6 +182,22 @@ struct response {
         
         return j;
     }
+    
+    // Convert to JSON, moving the result instead of copying it
+    json to_json() && {
+        json j = {
+            {"jsonrpc", jsonrpc},
+            {"id", id}
+        };
+        
+        if (is_error()) {
+            j["error"] = std::move(error);
+        } else {
+            j["result"] = std::move(result);
+        }
+        
+        return j;
+    }
 
     static response from_json(const json& j) {
         response res;
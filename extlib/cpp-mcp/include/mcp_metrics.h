@@ -0,0 +1,416 @@
+/**
+ * @file mcp_metrics.h
+ * @brief Request latency histograms per stage, method and tool
+ *
+ * Each request records how long it spent in every stage it went through into
+ * log-linear histograms: eight linear sub-buckets per power of two, so any
+ * recorded value is reported within 12.5%. Recording is a handful of relaxed
+ * atomic increments, and series are found in an open-addressed table that is
+ * only ever appended to, so no lock is taken on the request path.
+ */
+
+#ifndef MCP_METRICS_H
+#define MCP_METRICS_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace mcp {
+
+// Stages of a request, in the order it goes through them
+enum class request_stage {
+    session_lookup,  // Finding the session named by the request
+    parse,           // Scanning the JSON-RPC envelope
+    queue_wait,      // Waiting for an executor worker
+    handler,         // Running the method or tool handler
+    serialize,       // Turning the response into the bytes that are sent
+    delivery,        // From a queued response to its write to the connection
+    total            // From receiving the request to the serialized response
+};
+
+constexpr size_t request_stage_count = 7;
+
+inline const char* to_string(request_stage stage) {
+    static const char* const names[request_stage_count] = {
+        "session_lookup", "parse", "queue_wait", "handler", "serialize", "delivery", "total"
+    };
+    return names[static_cast<size_t>(stage)];
+}
+
+// Latency percentiles of one stage
+struct stage_stats {
+    uint64_t count = 0;
+    std::chrono::microseconds sum{0};
+    std::chrono::microseconds p50{0};
+    std::chrono::microseconds p90{0};
+    std::chrono::microseconds p99{0};
+    std::chrono::microseconds p999{0};
+    std::chrono::microseconds max{0};
+};
+
+// Stages of the requests of one method, and tool for tools/call
+struct method_stats {
+    std::string method;
+    std::string tool;
+    std::array<stage_stats, request_stage_count> stages;
+
+    const stage_stats& stage(request_stage s) const {
+        return stages[static_cast<size_t>(s)];
+    }
+};
+
+// Snapshot returned by server::stats()
+struct server_stats {
+    std::vector<method_stats> methods;
+
+    /**
+     * @brief Find the entry of a method
+     * @param method The method, e.g. "tools/call"
+     * @param tool The tool name for tools/call, empty for other methods
+     * @return The entry, or null if no such request was recorded
+     */
+    const method_stats* find(std::string_view method, std::string_view tool = std::string_view()) const {
+        for (const auto& m : methods) {
+            if (m.method == method && m.tool == tool) {
+                return &m;
+            }
+        }
+        return nullptr;
+    }
+};
+
+/**
+ * @class latency_histogram
+ * @brief Lock-free log-linear histogram of durations in microseconds
+ */
+class latency_histogram {
+public:
+    static constexpr unsigned sub_bits = 3;
+    static constexpr uint64_t sub_count = uint64_t(1) << sub_bits;
+    static constexpr unsigned max_bits = 40;  // About 12 days
+    static constexpr size_t bucket_count = (max_bits - sub_bits + 1) * sub_count;
+
+    void record(std::chrono::microseconds duration) {
+        uint64_t us = duration.count() > 0 ? static_cast<uint64_t>(duration.count()) : 0;
+        buckets_[bucket_of(us)].fetch_add(1, std::memory_order_relaxed);
+        count_.fetch_add(1, std::memory_order_relaxed);
+        sum_.fetch_add(us, std::memory_order_relaxed);
+        uint64_t seen = max_.load(std::memory_order_relaxed);
+        while (us > seen && !max_.compare_exchange_weak(seen, us, std::memory_order_relaxed)) {
+        }
+    }
+
+    // Counts per bucket, read without stopping writers
+    struct snapshot {
+        std::array<uint64_t, bucket_count> buckets{};
+        uint64_t count = 0;
+        uint64_t sum = 0;
+        uint64_t max = 0;
+
+        // Upper bound of the bucket holding the p-th value, capped at the maximum
+        std::chrono::microseconds percentile(double p) const {
+            if (count == 0) {
+                return std::chrono::microseconds(0);
+            }
+            uint64_t rank = static_cast<uint64_t>(p * static_cast<double>(count - 1)) + 1;
+            uint64_t seen = 0;
+            for (size_t i = 0; i < bucket_count; ++i) {
+                seen += buckets[i];
+                if (seen >= rank) {
+                    uint64_t upper = upper_bound(i);
+                    return std::chrono::microseconds(static_cast<int64_t>(upper < max ? upper : max));
+                }
+            }
+            return std::chrono::microseconds(static_cast<int64_t>(max));
+        }
+
+        // Number of values no larger than a bound, counting a bucket once its upper bound fits
+        uint64_t count_at_most(uint64_t bound) const {
+            uint64_t n = 0;
+            for (size_t i = 0; i < bucket_count && upper_bound(i) <= bound; ++i) {
+                n += buckets[i];
+            }
+            return n;
+        }
+    };
+
+    snapshot read() const {
+        snapshot s;
+        for (size_t i = 0; i < bucket_count; ++i) {
+            s.buckets[i] = buckets_[i].load(std::memory_order_relaxed);
+            s.count += s.buckets[i];
+        }
+        s.sum = sum_.load(std::memory_order_relaxed);
+        s.max = max_.load(std::memory_order_relaxed);
+        return s;
+    }
+
+    uint64_t count() const {
+        return count_.load(std::memory_order_relaxed);
+    }
+
+    static size_t bucket_of(uint64_t us) {
+        if (us < sub_count) {
+            return static_cast<size_t>(us);
+        }
+        if (us >= (uint64_t(1) << max_bits)) {
+            return bucket_count - 1;
+        }
+        unsigned msb = 63;
+        while (!(us >> msb)) {
+            --msb;
+        }
+        unsigned shift = msb - sub_bits;
+        return static_cast<size_t>(shift * sub_count + (us >> shift));
+    }
+
+    // Largest value that lands in a bucket
+    static uint64_t upper_bound(size_t bucket) {
+        if (bucket < 2 * sub_count) {
+            return bucket;
+        }
+        uint64_t shift = bucket / sub_count - 1;
+        uint64_t mantissa = bucket % sub_count + sub_count;
+        return ((mantissa + 1) << shift) - 1;
+    }
+
+private:
+    std::array<std::atomic<uint64_t>, bucket_count> buckets_{};
+    std::atomic<uint64_t> count_{0};
+    std::atomic<uint64_t> sum_{0};
+    std::atomic<uint64_t> max_{0};
+};
+
+// Where a request spent its time, stages that did not happen stay unset
+struct request_timing {
+    using clock = std::chrono::steady_clock;
+
+    std::string method;
+    std::string tool;
+
+    clock::time_point received;
+    clock::time_point queued;
+    clock::time_point started;
+    clock::time_point handled;
+    clock::time_point completed;  // Serialized response handed to the transport
+
+    // Measured around the calls, the transports run these steps in different orders
+    std::chrono::microseconds session_lookup{-1};
+    std::chrono::microseconds parse{-1};
+    std::chrono::microseconds serialize{-1};
+    std::chrono::microseconds delivery{-1};
+
+    static std::chrono::microseconds since(clock::time_point start) {
+        return std::chrono::duration_cast<std::chrono::microseconds>(clock::now() - start);
+    }
+};
+
+/**
+ * @class request_metrics
+ * @brief Histograms of every stage, one series per method and tool
+ */
+class request_metrics {
+public:
+    // Distinct method and tool pairs, later ones are recorded as method "other"
+    static constexpr size_t max_series = 256;
+
+    struct series {
+        std::string method;
+        std::string tool;
+        std::array<latency_histogram, request_stage_count> stages;
+    };
+
+    request_metrics() : overflow_(new series{"other", "", {}}) {}
+
+    ~request_metrics() {
+        for (auto& slot : table_) {
+            delete slot.load(std::memory_order_acquire);
+        }
+    }
+
+    request_metrics(const request_metrics&) = delete;
+    request_metrics& operator=(const request_metrics&) = delete;
+
+    /**
+     * @brief Series of a method and tool, created on first use
+     * @param method The method, e.g. "tools/call"
+     * @param tool The tool name, empty for other methods
+     */
+    series& get(std::string_view method, std::string_view tool = std::string_view()) {
+        size_t hash = std::hash<std::string_view>()(method) * 31 + std::hash<std::string_view>()(tool);
+        series* created = nullptr;
+        for (size_t probe = 0; probe < max_series; ++probe) {
+            auto& slot = table_[(hash + probe) % max_series];
+            series* existing = slot.load(std::memory_order_acquire);
+            if (!existing) {
+                if (!created) {
+                    created = new series{std::string(method), std::string(tool), {}};
+                }
+                if (slot.compare_exchange_strong(existing, created, std::memory_order_acq_rel)) {
+                    return *created;
+                }
+                // Another thread filled the slot first, existing now holds its series
+            }
+            if (existing->method == method && existing->tool == tool) {
+                delete created;
+                return *existing;
+            }
+        }
+        delete created;
+        return *overflow_;
+    }
+
+    /**
+     * @brief Record the stages a request went through
+     * @param timing Points in time the request passed, stages with an unset end are skipped
+     */
+    void record(const request_timing& timing) {
+        series& s = get(timing.method, timing.tool);
+        auto measured = [&s](request_stage st, std::chrono::microseconds duration) {
+            if (duration.count() >= 0) {
+                s.stages[static_cast<size_t>(st)].record(duration);
+            }
+        };
+        auto between = [&measured](request_stage st, request_timing::clock::time_point from, request_timing::clock::time_point to) {
+            if (from != request_timing::clock::time_point() && to != request_timing::clock::time_point()) {
+                measured(st, std::chrono::duration_cast<std::chrono::microseconds>(to - from));
+            }
+        };
+        measured(request_stage::session_lookup, timing.session_lookup);
+        measured(request_stage::parse, timing.parse);
+        between(request_stage::queue_wait, timing.queued, timing.started);
+        between(request_stage::handler, timing.started, timing.handled);
+        measured(request_stage::serialize, timing.serialize);
+        measured(request_stage::delivery, timing.delivery);
+        between(request_stage::total, timing.received, timing.completed);
+    }
+
+    // Record one stage outside a request, e.g. delivery of server-initiated messages
+    void record(request_stage stage, std::string_view method, std::chrono::microseconds duration) {
+        get(method).stages[static_cast<size_t>(stage)].record(duration);
+    }
+
+    /**
+     * @brief Percentiles of every series with recorded values
+     */
+    server_stats stats() const {
+        server_stats result;
+        for_each_series([&result](const series& s) {
+            method_stats m;
+            m.method = s.method;
+            m.tool = s.tool;
+            for (size_t i = 0; i < request_stage_count; ++i) {
+                auto snap = s.stages[i].read();
+                stage_stats& st = m.stages[i];
+                st.count = snap.count;
+                st.sum = std::chrono::microseconds(static_cast<int64_t>(snap.sum));
+                st.p50 = snap.percentile(0.50);
+                st.p90 = snap.percentile(0.90);
+                st.p99 = snap.percentile(0.99);
+                st.p999 = snap.percentile(0.999);
+                st.max = std::chrono::microseconds(static_cast<int64_t>(snap.max));
+            }
+            if (m.stage(request_stage::total).count > 0 || m.stage(request_stage::handler).count > 0 ||
+                m.stage(request_stage::delivery).count > 0) {
+                result.methods.push_back(std::move(m));
+            }
+        });
+        return result;
+    }
+
+    /**
+     * @brief Append the histograms in Prometheus text exposition format
+     * @param out Buffer to append to
+     *
+     * Writes mcp_request_duration_seconds as a histogram and its p50, p99 and
+     * p999 as mcp_request_duration_quantile_seconds, labelled by stage, method
+     * and tool.
+     */
+    void write_prometheus(std::string& out) const {
+        static const uint64_t bounds_us[] = {
+            50, 100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000,
+            100000, 250000, 500000, 1000000, 2500000, 5000000, 10000000
+        };
+
+        std::string quantiles;
+        out += "# HELP mcp_request_duration_seconds Time requests spent in each stage\n";
+        out += "# TYPE mcp_request_duration_seconds histogram\n";
+        quantiles += "# HELP mcp_request_duration_quantile_seconds Percentiles of the time requests spent in each stage\n";
+        quantiles += "# TYPE mcp_request_duration_quantile_seconds gauge\n";
+
+        for_each_series([&](const series& s) {
+            for (size_t i = 0; i < request_stage_count; ++i) {
+                auto snap = s.stages[i].read();
+                if (snap.count == 0) {
+                    continue;
+                }
+                std::string labels = "stage=\"" + std::string(to_string(static_cast<request_stage>(i))) + "\",method=";
+                append_label_value(labels, s.method);
+                labels += ",tool=";
+                append_label_value(labels, s.tool);
+
+                for (uint64_t bound : bounds_us) {
+                    out += "mcp_request_duration_seconds_bucket{" + labels + ",le=\"" + seconds(bound) + "\"} ";
+                    out += std::to_string(snap.count_at_most(bound)) + "\n";
+                }
+                out += "mcp_request_duration_seconds_bucket{" + labels + ",le=\"+Inf\"} " + std::to_string(snap.count) + "\n";
+                out += "mcp_request_duration_seconds_sum{" + labels + "} " + seconds(snap.sum) + "\n";
+                out += "mcp_request_duration_seconds_count{" + labels + "} " + std::to_string(snap.count) + "\n";
+
+                const std::pair<const char*, double> points[] = {{"0.5", 0.50}, {"0.99", 0.99}, {"0.999", 0.999}};
+                for (const auto& [name, p] : points) {
+                    quantiles += "mcp_request_duration_quantile_seconds{" + labels + ",quantile=\"" + name + "\"} ";
+                    quantiles += seconds(static_cast<uint64_t>(snap.percentile(p).count())) + "\n";
+                }
+            }
+        });
+        out += quantiles;
+    }
+
+private:
+    template<typename F>
+    void for_each_series(F&& f) const {
+        for (const auto& slot : table_) {
+            if (const series* s = slot.load(std::memory_order_acquire)) {
+                f(*s);
+            }
+        }
+        f(*overflow_);
+    }
+
+    static std::string seconds(uint64_t us) {
+        char buffer[32];
+        std::snprintf(buffer, sizeof(buffer), "%.6f", static_cast<double>(us) / 1e6);
+        return buffer;
+    }
+
+    static void append_label_value(std::string& out, const std::string& value) {
+        out += '"';
+        for (char c : value) {
+            if (c == '\\' || c == '"') {
+                out += '\\';
+                out += c;
+            } else if (c == '\n') {
+                out += "\\n";
+            } else {
+                out += c;
+            }
+        }
+        out += '"';
+    }
+
+    std::array<std::atomic<series*>, max_series> table_{};
+    std::unique_ptr<series> overflow_;
+};
+
+} // namespace mcp
+
+#endif // MCP_METRICS_H
@@ -0,0 +1,265 @@
+/**
+ * @file mcp_request_scheduler.h
+ * @brief Priority lanes and per-session fairness on top of the thread pool
+ *
+ * Requests are classified into control, metadata and heavy lanes. Whenever a worker
+ * becomes free it takes the next request from the highest non-empty lane, rotating
+ * over the sessions queued in that lane, so one busy client cannot delay the pings
+ * and listings of everyone else. Heavy requests never occupy every worker.
+ */
+
+#ifndef MCP_REQUEST_SCHEDULER_H
+#define MCP_REQUEST_SCHEDULER_H
+
+#include "mcp_thread_pool.h"
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace mcp {
+
+// Priority lanes, highest first
+enum class request_lane {
+    control,   // ping, initialize, notifications
+    metadata,  // listings and other short requests
+    heavy      // tool calls
+};
+
+// Per-lane counters and queue wait times
+struct lane_stats {
+    size_t queued = 0;       // Requests waiting for a worker
+    size_t running = 0;      // Requests currently executing
+    size_t sessions = 0;     // Sessions with queued requests
+    uint64_t submitted = 0;
+    uint64_t completed = 0;
+    // Time between submission and start of execution, percentiles are bucket upper bounds
+    std::chrono::microseconds wait_p50{0};
+    std::chrono::microseconds wait_p99{0};
+    std::chrono::microseconds wait_max{0};
+};
+
+namespace detail {
+
+// Power-of-two histogram of wait times in microseconds
+class wait_histogram {
+public:
+    void record(std::chrono::microseconds wait) {
+        uint64_t us = wait.count() > 0 ? static_cast<uint64_t>(wait.count()) : 0;
+        size_t bucket = 0;
+        while (bucket + 1 < buckets_.size() && (uint64_t(1) << bucket) <= us) {
+            ++bucket;
+        }
+        ++buckets_[bucket];
+        ++count_;
+        if (wait > max_) {
+            max_ = wait;
+        }
+    }
+
+    std::chrono::microseconds percentile(double p) const {
+        if (count_ == 0) {
+            return std::chrono::microseconds(0);
+        }
+        uint64_t rank = static_cast<uint64_t>(p * static_cast<double>(count_ - 1)) + 1;
+        uint64_t seen = 0;
+        for (size_t i = 0; i < buckets_.size(); ++i) {
+            seen += buckets_[i];
+            if (seen >= rank) {
+                auto upper = std::chrono::microseconds(int64_t(1) << i);
+                return upper < max_ ? upper : max_;
+            }
+        }
+        return max_;
+    }
+
+    std::chrono::microseconds max() const {
+        return max_;
+    }
+
+private:
+    std::array<uint64_t, 40> buckets_{};
+    uint64_t count_ = 0;
+    std::chrono::microseconds max_{0};
+};
+
+} // namespace detail
+
+class request_scheduler {
+public:
+    using clock = std::chrono::steady_clock;
+
+    /**
+     * @brief Constructor
+     * @param pool Executor the requests run on, must outlive queued requests
+     * @param heavy_limit Maximum concurrent heavy requests, 0 leaves one worker free for the other lanes
+     */
+    explicit request_scheduler(thread_pool& pool, size_t heavy_limit = 0)
+        : state_(std::make_shared<state>()) {
+        state_->pool = &pool;
+        if (heavy_limit == 0) {
+            heavy_limit = pool.size() > 1 ? pool.size() - 1 : 1;
+        }
+        state_->heavy_limit = heavy_limit;
+    }
+
+    /**
+     * @brief Pick the lane for a JSON-RPC method
+     * @param method The method name
+     */
+    static request_lane classify(const std::string& method) {
+        if (method == "ping" || method == "initialize" || method.compare(0, 14, "notifications/") == 0) {
+            return request_lane::control;
+        }
+        if (method == "tools/call") {
+            return request_lane::heavy;
+        }
+        return request_lane::metadata;
+    }
+
+    /**
+     * @brief Queue a request
+     * @param lane Priority lane
+     * @param session_id Session the request belongs to
+     * @param f Work to run, exceptions it throws are discarded
+     */
+    template<class F>
+    void submit(request_lane lane, const std::string& session_id, F&& f) {
+        {
+            std::lock_guard<std::mutex> lock(state_->mutex);
+            lane_queue& q = state_->lanes[static_cast<size_t>(lane)];
+            auto& session_tasks = q.sessions[session_id];
+            if (session_tasks.empty()) {
+                q.rotation.push_back(session_id);
+            }
+            session_tasks.push_back(queued_task{detail::task_function(std::forward<F>(f)), clock::now()});
+            ++q.queued;
+            ++q.submitted;
+        }
+
+        std::shared_ptr<state> st = state_;
+        st->pool->post([st]() { drain(st); });
+    }
+
+    /**
+     * @brief Snapshot of the counters of a lane
+     * @param lane The lane
+     */
+    lane_stats stats(request_lane lane) const {
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        const lane_queue& q = state_->lanes[static_cast<size_t>(lane)];
+
+        lane_stats s;
+        s.queued = q.queued;
+        s.running = q.running;
+        s.sessions = q.rotation.size();
+        s.submitted = q.submitted;
+        s.completed = q.completed;
+        s.wait_p50 = q.waits.percentile(0.50);
+        s.wait_p99 = q.waits.percentile(0.99);
+        s.wait_max = q.waits.max();
+        return s;
+    }
+
+    /**
+     * @brief Maximum number of heavy requests running at once
+     */
+    size_t heavy_limit() const {
+        return state_->heavy_limit;
+    }
+
+private:
+    struct queued_task {
+        detail::task_function fn;
+        clock::time_point enqueued;
+    };
+
+    struct lane_queue {
+        // Pending requests per session and the order sessions are served in
+        std::unordered_map<std::string, std::deque<queued_task>> sessions;
+        std::deque<std::string> rotation;
+
+        size_t queued = 0;
+        size_t running = 0;
+        uint64_t submitted = 0;
+        uint64_t completed = 0;
+        detail::wait_histogram waits;
+    };
+
+    // Shared with the drain tasks in the pool, which may outlive the scheduler
+    struct state {
+        std::mutex mutex;
+        std::array<lane_queue, 3> lanes;
+        thread_pool* pool = nullptr;
+        size_t heavy_limit = 1;
+    };
+
+    // Take the next request, highest lane first and round-robin over sessions within a lane
+    static bool take_next(state& st, queued_task& out, size_t& lane_index) {
+        for (size_t i = 0; i < st.lanes.size(); ++i) {
+            lane_queue& q = st.lanes[i];
+            if (q.rotation.empty()) {
+                continue;
+            }
+            if (i == static_cast<size_t>(request_lane::heavy) && q.running >= st.heavy_limit) {
+                continue;
+            }
+
+            std::string session_id = std::move(q.rotation.front());
+            q.rotation.pop_front();
+
+            auto it = q.sessions.find(session_id);
+            out = std::move(it->second.front());
+            it->second.pop_front();
+            if (it->second.empty()) {
+                q.sessions.erase(it);
+            } else {
+                q.rotation.push_back(std::move(session_id));
+            }
+
+            --q.queued;
+            ++q.running;
+            q.waits.record(std::chrono::duration_cast<std::chrono::microseconds>(clock::now() - out.enqueued));
+            lane_index = i;
+            return true;
+        }
+        return false;
+    }
+
+    // Runs on a pool worker; every submit posts one, extra ones find nothing and return
+    static void drain(const std::shared_ptr<state>& st) {
+        while (true) {
+            queued_task task;
+            size_t lane_index = 0;
+            {
+                std::lock_guard<std::mutex> lock(st->mutex);
+                if (!take_next(*st, task, lane_index)) {
+                    return;
+                }
+            }
+
+            try {
+                task.fn();
+            } catch (...) {
+                // Handlers report errors through their own responses
+            }
+
+            // Continuing the loop also picks up heavy requests skipped while at the limit
+            std::lock_guard<std::mutex> lock(st->mutex);
+            lane_queue& q = st->lanes[lane_index];
+            --q.running;
+            ++q.completed;
+        }
+    }
+
+    std::shared_ptr<state> state_;
+};
+
+} // namespace mcp
+
+#endif // MCP_REQUEST_SCHEDULER_H
@@ -13,13 +13,24 @@
 #include "mcp_resource.h"
 #include "mcp_tool.h"
 #include "mcp_thread_pool.h"
+#include "mcp_request_scheduler.h"
 #include "mcp_logger.h"
+#include "mcp_sse_reactor.h"
+#include "mcp_session.h"
+#include "mcp_sse_frame.h"
+#include "mcp_envelope.h"
+#include "mcp_timer_wheel.h"
+#include "mcp_stop_token.h"
+#include "mcp_metrics.h"
 
 // Include the HTTP library
 #include "httplib.h"
 
 #include <string>
 #include <map>
+#include <algorithm>
+#include <unordered_map>
+#include <deque>
 #include <vector>
 #include <memory>
 #include <mutex>
@@ -35,62 +46,144 @@ namespace mcp {
 
 using method_handler = std::function<json(const json&, const std::string&)>;
 using tool_handler = method_handler;
+using raw_tool_handler = std::function<json(const tool_arguments&, const std::string&)>;
 using notification_handler = std::function<void(const json&, const std::string&)>;
 using auth_handler = std::function<bool(const std::string&, const std::string&)>;
 using session_cleanup_handler = std::function<void(const std::string&)>;
+using response_callback = std::function<void(const json&)>;
+
+// Kind of a server-sent event frame, used to decide what can be dropped under pressure
+enum class event_kind {
+    message,    // JSON-RPC response, request or notification (never dropped)
+    heartbeat,  // Connection keep-alive, safe to drop
+    endpoint    // Session endpoint announcement
+};
+
+// What send_event does when a session's event queue is full
+enum class backpressure_policy {
+    block,            // Wait (up to block_timeout) for the consumer to drain the queue
+    drop_heartbeats,  // Drop queued or incoming heartbeats first, then block
+    close_session     // Close the session
+};
+
+// How SSE connections are served
+enum class sse_transport {
+    threaded,   // One HTTP worker plus one heartbeat thread per session
+    event_loop  // All sessions share a single epoll loop (Linux only, falls back to threaded elsewhere)
+};
+
+// Per-session event queue settings
+struct event_queue_options {
+    size_t capacity = 1024;                                      // Maximum number of pending frames
+    backpressure_policy policy = backpressure_policy::drop_heartbeats;
+    std::chrono::milliseconds block_timeout{5000};               // Maximum time a producer waits for room
+};
+
+// Listener, executor and session settings, checked when the server starts
+struct server_options {
+    // HTTP listener
+    size_t listener_threads = CPPHTTPLIB_THREAD_POOL_COUNT;              // Workers serving HTTP connections, SSE streams hold one each
+    size_t listener_queue_limit = 0;                                     // Accepted connections waiting for a worker, 0 for no limit
+    size_t keep_alive_max_count = CPPHTTPLIB_KEEPALIVE_MAX_COUNT;        // Requests served on one connection before it is closed
+    std::chrono::seconds keep_alive_timeout{CPPHTTPLIB_KEEPALIVE_TIMEOUT_SECOND}; // Idle time before a kept-alive connection is closed
+    std::chrono::seconds read_timeout{CPPHTTPLIB_SERVER_READ_TIMEOUT_SECOND};
+    std::chrono::seconds write_timeout{CPPHTTPLIB_SERVER_WRITE_TIMEOUT_SECOND};
+    size_t payload_max_length = 0;                                       // Largest request body in bytes, 0 for no limit
+    bool tcp_nodelay = true;                                             // Do not let Nagle hold a response body back
+
+    // Executor for method handlers
+    size_t worker_threads = std::max(1u, std::thread::hardware_concurrency());
+    size_t heavy_limit = 0;                                              // Concurrent tools/call requests, 0 leaves one worker free
+
+    // Sessions
+    sse_transport transport = sse_transport::threaded;
+    event_queue_options event_queue;
+    std::chrono::seconds session_idle_timeout{3600};                     // Inactive sessions are closed after this long
+    std::chrono::milliseconds request_timeout{0};                        // Requests unanswered after this long get an error, 0 for no limit
+    std::chrono::milliseconds drain_timeout{5000};                       // Time stop() gives in-flight requests to finish
+    std::string streamable_http_endpoint;                                // Empty to disable the streamable HTTP transport
+    std::string metrics_endpoint = "/metrics";                           // Prometheus text format for loopback clients, empty to disable
+
+    /**
+     * @brief Check for settings the server cannot run with
+     * @return Description of the first problem, empty if the options are valid
+     */
+    std::string validate() const;
+
+    /**
+     * @brief Describe the effective settings on one line
+     */
+    std::string describe() const;
+};
 
 class event_dispatcher {
 public:
-    event_dispatcher() {
-        message_.reserve(128); // Pre-allocate space for messages
+    explicit event_dispatcher(const event_queue_options& options = event_queue_options())
+        : options_(options) {
+        if (options_.capacity == 0) {
+            options_.capacity = 1;
+        }
     }
     
     ~event_dispatcher() {
         close();
     }
 
+    // Frames below this size are merged into one write, larger ones are written in place
+    static constexpr size_t coalesce_limit = 16 * 1024;
+
+    // Wait for pending frames and write them to the sink, small frames in a single batch
     bool wait_event(httplib::DataSink* sink, const std::chrono::milliseconds& timeout = std::chrono::milliseconds(10000)) {
         if (!sink || closed_.load(std::memory_order_acquire)) {
             return false;
         }
         
-        std::string message_copy;
+        std::deque<frame> frames;
         {
             std::unique_lock<std::mutex> lk(m_);
             
-            if (closed_.load(std::memory_order_acquire)) {
-                return false;
-            }
-            
-            int id = id_.load(std::memory_order_relaxed);
-            
             bool result = cv_.wait_for(lk, timeout, [&] { 
-                return cid_.load(std::memory_order_relaxed) == id || closed_.load(std::memory_order_acquire); 
+                return !queue_.empty() || closed_.load(std::memory_order_acquire); 
             });
             
-            if (closed_.load(std::memory_order_acquire)) {
+            if (closed_.load(std::memory_order_acquire) || !result) {
                 return false;
             }
             
-            if (!result) {
-                return false;
-            }
-            
-            // Only copy the message if there is one
-            if (!message_.empty()) {
-                message_copy.swap(message_);
-            } else {
-                return true; // No message but condition satisfied
-            }
+            frames.swap(queue_);
         }
         
+        // Wake up producers blocked on a full queue
+        not_full_cv_.notify_all();
+        
         try {
-            if (!message_copy.empty()) {
-                if (!sink->write(message_copy.data(), message_copy.size())) {
-                    close();
-                    return false;
+            std::string batch;
+            auto flush_batch = [&]() {
+                if (batch.empty()) {
+                    return true;
+                }
+                bool ok = sink->write(batch.data(), batch.size());
+                batch.clear();
+                return ok;
+            };
+            
+            report_delivery(frames);
+            for (const auto& f : frames) {
+                const std::string& data = *f.data;
+                if (frames.size() == 1 || data.size() >= coalesce_limit) {
+                    if (!flush_batch() || !sink->write(data.data(), data.size())) {
+                        close();
+                        return false;
+                    }
+                } else {
+                    batch.append(data);
                 }
             }
+            
+            if (!flush_batch()) {
+                close();
+                return false;
+            }
             return true;
         } catch (...) {
             close();
@@ -98,30 +191,72 @@ public:
         }
     }
 
-    bool send_event(const std::string& message) {
+    bool send_event(const std::string& message, event_kind kind = event_kind::message) {
         if (closed_.load(std::memory_order_acquire) || message.empty()) {
             return false;
         }
+        return send_event(std::make_shared<const std::string>(message), kind);
+    }
+    
+    // Queue a prebuilt frame, the frame itself is shared rather than copied
+    bool send_event(sse_frame message, event_kind kind = event_kind::message) {
+        if (closed_.load(std::memory_order_acquire) || !message || message->empty()) {
+            return false;
+        }
         
         try {
-            std::lock_guard<std::mutex> lk(m_);
+            std::unique_lock<std::mutex> lk(m_);
             
             if (closed_.load(std::memory_order_acquire)) {
                 return false;
             }
             
-            // Efficiently set the message and allocate space as needed
-            if (message.size() > message_.capacity()) {
-                message_.reserve(message.size() + 64); // Pre-allocate extra space to avoid frequent reallocations
+            if (queue_.size() >= options_.capacity && !make_room(lk, kind)) {
+                return false;
             }
-            message_ = message;
             
-            cid_.store(id_.fetch_add(1, std::memory_order_relaxed), std::memory_order_relaxed);
+            queue_.push_back(frame{kind, std::move(message), std::chrono::steady_clock::now()});
             cv_.notify_one(); // Notify waiting threads
-            return true;
         } catch (...) {
             return false;
         }
+        
+        if (notify_) {
+            notify_();
+        }
+        return true;
+    }
+    
+    // Move every pending frame into out without waiting, returns the number of frames drained
+    size_t drain(std::vector<sse_frame>& out) {
+        std::deque<frame> frames;
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            frames.swap(queue_);
+        }
+        
+        if (frames.empty()) {
+            return 0;
+        }
+        not_full_cv_.notify_all();
+        report_delivery(frames);
+        
+        for (auto& f : frames) {
+            out.push_back(std::move(f.data));
+        }
+        return frames.size();
+    }
+    
+    // Set a callback invoked after a frame is queued or the dispatcher is closed.
+    // Used by event-loop transports instead of wait_event; must be set before the session is published.
+    void set_notify_handler(std::function<void()> handler) {
+        notify_ = std::move(handler);
+    }
+    
+    // Set a callback told how long each message frame waited in the queue before it was taken
+    // for writing; must be set before the session is published.
+    void set_delivery_observer(std::function<void(std::chrono::microseconds)> observer) {
+        delivery_observer_ = std::move(observer);
     }
     
     void close() {
@@ -131,36 +266,111 @@ public:
         }
         
         try {
+            // Take the lock so a waiter cannot miss the wakeup between its check and its wait
+            std::lock_guard<std::mutex> lk(m_);
             cv_.notify_all();
+            not_full_cv_.notify_all();
+            closed_cv_.notify_all();
         } catch (...) {
             // Ignore exceptions
         }
+        
+        if (notify_) {
+            notify_();
+        }
     }
     
     bool is_closed() const {
         return closed_.load(std::memory_order_acquire);
     }
     
-    // Get the last activity time
-    std::chrono::steady_clock::time_point last_activity() const {
-        std::lock_guard<std::mutex> lk(m_);
-        return last_activity_;
+    // Sleep until the dispatcher is closed or the timeout expires, returns true if closed
+    bool wait_closed(std::chrono::milliseconds timeout) {
+        std::unique_lock<std::mutex> lk(m_);
+        return closed_cv_.wait_for(lk, timeout, [&] { return closed_.load(std::memory_order_acquire); });
     }
     
-    // Update the activity time (when sending or receiving a message)
-    void update_activity() {
+    // Number of frames waiting to be written
+    size_t pending() const {
         std::lock_guard<std::mutex> lk(m_);
-        last_activity_ = std::chrono::steady_clock::now();
+        return queue_.size();
+    }
+    
+    // Number of frames dropped because of backpressure
+    size_t dropped() const {
+        return dropped_.load(std::memory_order_relaxed);
     }
 
 private:
+    struct frame {
+        event_kind kind;
+        sse_frame data;
+        std::chrono::steady_clock::time_point queued;
+    };
+    
+    void report_delivery(const std::deque<frame>& frames) const {
+        if (!delivery_observer_) {
+            return;
+        }
+        auto now = std::chrono::steady_clock::now();
+        for (const auto& f : frames) {
+            if (f.kind == event_kind::message) {
+                delivery_observer_(std::chrono::duration_cast<std::chrono::microseconds>(now - f.queued));
+            }
+        }
+    }
+    
+    // Apply the backpressure policy to a full queue, returns true if the new frame may be queued
+    bool make_room(std::unique_lock<std::mutex>& lk, event_kind kind) {
+        // A full queue already tells the client the session is alive, never wait to add a heartbeat
+        if (kind == event_kind::heartbeat && options_.policy != backpressure_policy::close_session) {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        
+        switch (options_.policy) {
+            case backpressure_policy::close_session:
+                dropped_.fetch_add(1, std::memory_order_relaxed);
+                lk.unlock();
+                close();
+                return false;
+                
+            case backpressure_policy::drop_heartbeats: {
+                for (auto it = queue_.begin(); it != queue_.end(); ++it) {
+                    if (it->kind == event_kind::heartbeat) {
+                        queue_.erase(it);
+                        dropped_.fetch_add(1, std::memory_order_relaxed);
+                        return true;
+                    }
+                }
+                break; // Nothing to drop, fall back to blocking
+            }
+            
+            case backpressure_policy::block:
+                break;
+        }
+        
+        bool has_room = not_full_cv_.wait_for(lk, options_.block_timeout, [&] {
+            return queue_.size() < options_.capacity || closed_.load(std::memory_order_acquire);
+        });
+        
+        if (!has_room || closed_.load(std::memory_order_acquire)) {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        return true;
+    }
+    
+    event_queue_options options_;
     mutable std::mutex m_;
     std::condition_variable cv_;
-    std::atomic<int> id_{0};
-    std::atomic<int> cid_{-1};
-    std::string message_;
+    std::condition_variable not_full_cv_;
+    std::condition_variable closed_cv_;
+    std::deque<frame> queue_;
+    std::atomic<size_t> dropped_{0};
     std::atomic<bool> closed_{false};
-    std::chrono::steady_clock::time_point last_activity_{std::chrono::steady_clock::now()};
+    std::function<void()> notify_;
+    std::function<void(std::chrono::microseconds)> delivery_observer_;
 };
 
 /**
@@ -211,6 +421,12 @@ public:
      */
     bool is_running() const;
     
+    /**
+     * @brief Get a token that is signalled when stop() begins
+     * @return Token that long-running handlers can poll to return early
+     */
+    stop_token get_stop_token() const;
+    
     /**
      * @brief Set server information
      * @param name The name of the server
@@ -252,6 +468,16 @@ public:
      */
     void register_tool(const tool& tool, tool_handler handler);
 
+    /**
+     * @brief Register a tool that reads its arguments as JSON text
+     * @param tool The tool to register
+     * @param handler The function to call when the tool is invoked, the arguments
+     *                point into the request body and are only valid during the call;
+     *                the call runs in an arena_scope, so tool_arguments::parse_arena()
+     *                allocates from the request arena
+     */
+    void register_tool(const tool& tool, raw_tool_handler handler);
+
     /**
      * @brief Register a session cleanup handler
      * @param key Tool or resource name to be cleaned up
@@ -289,6 +515,59 @@ public:
      */
     bool set_mount_point(const std::string& mount_point, const std::string& dir, httplib::Headers headers = httplib::Headers());
 
+    /**
+     * @brief Replace the listener, executor and session settings
+     * @param options The settings, validated by start()
+     * @note Must be called before start()
+     */
+    void set_options(const server_options& options);
+
+    /**
+     * @brief Get the current settings
+     */
+    server_options get_options() const;
+
+    /**
+     * @brief Set the event queue options used for new SSE sessions
+     * @param options Queue capacity and backpressure policy
+     */
+    void set_event_queue_options(const event_queue_options& options);
+
+    /**
+     * @brief Select how SSE connections are served
+     * @param transport The transport mode
+     * @note Must be called before start()
+     */
+    void set_sse_transport(sse_transport transport);
+
+    /**
+     * @brief Serve the streamable HTTP transport on an endpoint
+     * @param endpoint The endpoint path, e.g. "/mcp", or empty to disable it
+     * @note Must be called before start(), the SSE and message endpoints keep working
+     */
+    void set_streamable_http_endpoint(const std::string& endpoint);
+
+    /**
+     * @brief Get queue depth and wait time counters of a request lane
+     * @param lane The lane
+     * @return Snapshot of the lane counters
+     */
+    lane_stats get_lane_stats(request_lane lane) const;
+
+    /**
+     * @brief Get the counters of every live session
+     * @return One entry per session
+     */
+    std::vector<session_stats> get_session_stats() const;
+    
+    /**
+     * @brief Get request latency percentiles per stage, method and tool
+     * @return Snapshot of every method with recorded requests
+     * @note Responses sent over SSE are timed in the queue without knowing their method,
+     *       their delivery stage is reported under an empty method name
+     */
+    server_stats stats() const;
+
 private:
     std::string host_;
     int port_;
@@ -297,35 +576,113 @@ private:
     json capabilities_;
     
     // The HTTP server
-    std::unique_ptr<httplib::Server> http_server_;
+    std::unique_ptr<http_listener> http_server_;
+
+    // Listener, executor and session settings
+    server_options options_;
+
+    // Event loop used by sse_transport::event_loop
+    std::unique_ptr<sse_reactor> sse_reactor_;
     
     // Server thread (for non-blocking mode)
     std::unique_ptr<std::thread> server_thread_;
 
-    // SSE thread
-    std::map<std::string, std::unique_ptr<std::thread>> sse_threads_;
+    // Heartbeats, idle expiry and request deadlines of every session
+    timer_service timers_;
 
     // Event dispatcher for server-sent events
     event_dispatcher sse_dispatcher_;
     
-    // Session-specific event dispatchers
-    std::map<std::string, std::shared_ptr<event_dispatcher>> session_dispatchers_;
+    // Live sessions with their dispatchers and initialization state
+    session_table sessions_;
+    
+    // Latency histograms of every request stage
+    request_metrics metrics_;
 
     // Server-sent events endpoint
     std::string sse_endpoint_;
     std::string msg_endpoint_;
     
-    // Method handlers
-    std::map<std::string, method_handler> method_handlers_;
+    // Messages of one streamable HTTP request, read by the HTTP worker that answers it
+    struct request_stream {
+        explicit request_stream(std::string session) : session_id(std::move(session)) {}
+        
+        // Queue a message the handler sent while the request runs
+        void push(const json& message) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                events.push_back(message);
+            }
+            cv.notify_all();
+        }
+        
+        // Set the final response, always the last message on the stream
+        void finish(json result, bool with_timing = false) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                response = std::move(result);
+                done = true;
+                timed = with_timing;
+                finished = std::chrono::steady_clock::now();
+            }
+            cv.notify_all();
+        }
+        
+        // Wake the reader so it sees a stop request
+        void wake() {
+            std::lock_guard<std::mutex> l(mutex);
+            cv.notify_all();
+        }
+        
+        // Wait with mutex held for messages or the response. Once the server stops the
+        // handler gets drain_timeout to finish; returns false if it did not.
+        bool wait(std::unique_lock<std::mutex>& lock, const stop_token& token, std::chrono::milliseconds drain_timeout) {
+            auto ready = [this] { return done || !events.empty(); };
+            cv.wait(lock, [&] { return ready() || token.stop_requested(); });
+            return ready() || cv.wait_for(lock, drain_timeout, ready);
+        }
+        
+        std::string session_id;
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::deque<json> events;
+        json response;
+        bool done = false;
+        std::chrono::steady_clock::time_point finished;
+        bool timed = false;  // The response comes with the request's timing
+    };
+    
+    // Registered handlers, published as immutable snapshots so requests can look them up without a lock
+    struct handler_registry {
+        std::unordered_map<std::string, method_handler> methods;
+        std::unordered_map<std::string, notification_handler> notifications;
+        
+        // Resources map (path -> resource)
+        std::map<std::string, std::shared_ptr<resource>> resources;
+        
+        // Tools map (name -> tool and one of its handlers)
+        struct registered_tool {
+            tool info;
+            tool_handler handler;
+            raw_tool_handler raw_handler;
+        };
+        std::unordered_map<std::string, registered_tool> tools;
+        
+        // Whether tools/call is served by the built-in tool dispatch
+        bool builtin_tool_call = false;
+        
+        // Tools sorted by name and the cached tools/list result
+        std::vector<tool> tool_list;
+        json tool_list_json = json::array();
+    };
     
-    // Notification handlers
-    std::map<std::string, notification_handler> notification_handlers_;
+    std::shared_ptr<const handler_registry> registry_;
     
-    // Resources map (path -> resource)
-    std::map<std::string, std::shared_ptr<resource>> resources_;
+    // Unique across all servers, lets each thread keep the snapshot it loaded last
+    std::atomic<uint64_t> registry_generation_{0};
     
-    // Tools map (name -> handler)
-    std::map<std::string, std::pair<tool, tool_handler>> tools_;
+    // Serializes registrations
+    std::mutex registry_mutex_;
     
     // Authentication handler
     auth_handler auth_handler_;
@@ -334,25 +691,76 @@ private:
     mutable std::mutex mutex_;
     
     // Running flag
-    bool running_ = false;
+    std::atomic<bool> running_{false};
     
-    // Thread pool for async method handlers
-    thread_pool thread_pool_;
+    // Requested when stop() begins
+    stop_source stop_source_;
     
-    // Map to track session initialization status (session_id -> initialized)
-    std::map<std::string, bool> session_initialized_;
+    // Thread pool for async method handlers, sized from the options at start()
+    std::unique_ptr<thread_pool> thread_pool_;
 
+    // Orders requests by lane and session before they reach the thread pool
+    std::unique_ptr<request_scheduler> scheduler_;
+
+    // Sends the errors of timed out requests, off the timer thread and the busy handler workers
+    std::unique_ptr<thread_pool> reply_pool_;
+
+    // Current registry snapshot
+    std::shared_ptr<const handler_registry> registry() const;
+    
+    // Copy the registry, apply the change and publish the result
+    void update_registry(const std::function<void(handler_registry&)>& change);
+    
     // Handle SSE requests
     void handle_sse(const httplib::Request& req, httplib::Response& res);
+
+    // Create a session for a connection served by the SSE event loop
+    sse_reactor::session_handle open_event_loop_session(std::function<void()> notify);
     
     // Handle incoming JSON-RPC requests
     void handle_jsonrpc(const httplib::Request& req, httplib::Response& res);
 
+    // Handle streamable HTTP requests, streams and session termination
+    void handle_streamable_post(const httplib::Request& req, httplib::Response& res);
+    void handle_streamable_get(const httplib::Request& req, httplib::Response& res);
+    void handle_streamable_delete(const httplib::Request& req, httplib::Response& res);
+    
+    // Stream of the streamable HTTP request running on this thread, if any
+    static request_stream*& current_stream();
+    
+    // Timing of the request running on this thread, if any
+    static request_timing*& current_timing();
+    
+    // Create the event dispatcher of a new session
+    std::shared_ptr<event_dispatcher> make_dispatcher();
+    
+    // Serve the latency histograms in Prometheus text format
+    void handle_metrics(const httplib::Request& req, httplib::Response& res);
+
     // Send a JSON-RPC message to a client
     void send_jsonrpc(const std::string& session_id, const json& message);
     
-    // Process a JSON-RPC request
-    json process_request(const request& req, const std::string& session_id);
+    // Process a JSON-RPC request on the current worker and pass the response to on_response.
+    // Never blocks on other thread pool tasks, so the pool cannot starve itself.
+    void process_request(const request_envelope& req, const std::string& session_id, const response_callback& on_response);
+    
+    // Run the members of a JSON-RPC batch and pass all their responses to on_response at once.
+    // on_response is not called when the batch holds only notifications.
+    // Messages the members send go to stream when one is given.
+    void process_batch(std::vector<request_envelope> members, const std::string& session_id, response_callback on_response,
+                       std::shared_ptr<request_stream> stream = nullptr);
+    
+    // Whether a batch member may run alongside the others, true unless it calls a tool that is not read-only
+    bool runs_in_parallel(const request_envelope& req) const;
+    
+    // Run the method of a request and build its JSON-RPC response
+    json invoke_method(const request_envelope& req, const std::string& session_id);
+    
+    // Add the tools/list and tools/call methods unless they were registered already
+    void install_tool_methods(handler_registry& reg);
+    
+    // Run a tools/call, reading the tool name and arguments straight from the params text
+    json call_tool(const handler_registry& registry, std::string_view params, const std::string& session_id);
     
     // Handle initialization request
     json handle_initialize(const request& req, const std::string& session_id);
@@ -363,9 +771,6 @@ private:
     // Set session initialization status
     void set_session_initialized(const std::string& session_id, bool initialized);
 
-    // Generate a random session ID
-    std::string generate_session_id() const;
-    
     // Auxiliary function to create an async handler from a regular handler
     template<typename F>
     std::function<std::future<json>(const json&, const std::string&)> make_async_handler(F&& handler) {
@@ -391,7 +796,16 @@ private:
 
     // Session management and maintenance
     void check_inactive_sessions();
-    std::unique_ptr<std::thread> maintenance_thread_;
+    
+    // Queue the next heartbeat of a threaded SSE session
+    void schedule_heartbeat(const std::shared_ptr<session>& sess, uint64_t count);
+    
+    // Queue the next idle expiry sweep
+    void schedule_idle_check();
+    
+    // Answer with an error if send has not been called within the request timeout; a send
+    // that may block is called from reply_pool_ instead of the timer thread
+    response_callback with_deadline(const json& id, response_callback send, bool send_may_block);
 
     // Session cleanup handler
     std::map<std::string, session_cleanup_handler> session_cleanup_handler_;
@@ -0,0 +1,245 @@
+/**
+ * @file mcp_session.h
+ * @brief Server-side sessions and the sharded table that holds them
+ *
+ * A session bundles everything the server tracks per client connection: the event
+ * dispatcher, the initialization flag, activity time and counters. Sessions are
+ * keyed by the 128-bit value of their id and spread over independently locked
+ * shards. Each shard keeps its sessions in least-recently-active order, so idle
+ * expiry only looks at the sessions that actually expired.
+ */
+
+#ifndef MCP_SESSION_H
+#define MCP_SESSION_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace mcp {
+
+class event_dispatcher;
+
+// Binary form of a session id in 8-4-4-4-12 hex format
+struct session_key {
+    uint64_t hi = 0;
+    uint64_t lo = 0;
+
+    bool operator==(const session_key& other) const {
+        return hi == other.hi && lo == other.lo;
+    }
+
+    /**
+     * @brief Parse a session id
+     * @param id Session id, e.g. "0f1e2d3c-4b5a-6978-8796-a5b4c3d2e1f0"
+     * @param key Receives the parsed key
+     * @return False if the id is malformed
+     */
+    static bool parse(const std::string& id, session_key& key);
+
+    /**
+     * @brief Draw a random key from the calling thread's generator
+     */
+    static session_key generate();
+
+    /**
+     * @brief Format the key as a session id in 8-4-4-4-12 hex format
+     */
+    std::string to_string() const;
+};
+
+struct session_key_hash {
+    size_t operator()(const session_key& key) const {
+        // Ids are random, mixing the halves is enough
+        return static_cast<size_t>(key.hi ^ (key.lo * 0x9E3779B97F4A7C15ULL));
+    }
+};
+
+// Snapshot of the counters of a session
+struct session_stats {
+    std::string session_id;
+    bool initialized = false;
+    uint64_t requests = 0;
+    uint64_t notifications = 0;
+    size_t pending_events = 0;
+    size_t dropped_events = 0;
+    std::chrono::steady_clock::duration age{0};
+    std::chrono::steady_clock::duration idle{0};
+};
+
+class session {
+public:
+    using clock = std::chrono::steady_clock;
+
+    session(const std::string& id, const session_key& key, std::shared_ptr<event_dispatcher> dispatcher)
+        : id_(id), key_(key), dispatcher_(std::move(dispatcher)),
+          created_(clock::now()), last_activity_(created_.time_since_epoch().count()) {}
+
+    const std::string& id() const {
+        return id_;
+    }
+
+    const session_key& key() const {
+        return key_;
+    }
+
+    const std::shared_ptr<event_dispatcher>& dispatcher() const {
+        return dispatcher_;
+    }
+
+    bool is_initialized() const {
+        return initialized_.load(std::memory_order_acquire);
+    }
+
+    void set_initialized(bool initialized) {
+        initialized_.store(initialized, std::memory_order_release);
+    }
+
+    clock::time_point last_activity() const {
+        return clock::time_point(clock::duration(last_activity_.load(std::memory_order_relaxed)));
+    }
+
+    // Pending heartbeat timer of the session, 0 when it has none
+    uint64_t heartbeat_timer() const {
+        return heartbeat_timer_.load(std::memory_order_acquire);
+    }
+
+    void set_heartbeat_timer(uint64_t timer) {
+        heartbeat_timer_.store(timer, std::memory_order_release);
+    }
+
+    // Count an incoming JSON-RPC message
+    void count_message(bool notification) {
+        (notification ? notifications_ : requests_).fetch_add(1, std::memory_order_relaxed);
+    }
+
+    session_stats stats() const;
+
+private:
+    friend class session_table;
+
+    std::string id_;
+    session_key key_;
+    std::shared_ptr<event_dispatcher> dispatcher_;
+    clock::time_point created_;
+
+    std::atomic<bool> initialized_{false};
+    std::atomic<clock::rep> last_activity_;
+    std::atomic<uint64_t> requests_{0};
+    std::atomic<uint64_t> notifications_{0};
+    std::atomic<uint64_t> heartbeat_timer_{0};
+
+    // Intrusive activity list, guarded by the shard mutex
+    session* lru_prev_ = nullptr;
+    session* lru_next_ = nullptr;
+};
+
+/**
+ * @class session_table
+ * @brief Sharded map of live sessions with per-shard activity order
+ */
+class session_table {
+public:
+    /**
+     * @brief Constructor
+     * @param shard_count Number of independently locked shards
+     */
+    explicit session_table(size_t shard_count = 16);
+
+    session_table(const session_table&) = delete;
+    session_table& operator=(const session_table&) = delete;
+
+    /**
+     * @brief Add a session
+     * @param id Session id in 8-4-4-4-12 hex format
+     * @param dispatcher Event dispatcher of the session
+     * @return The new session, or nullptr if the id is malformed or taken
+     */
+    std::shared_ptr<session> insert(const std::string& id, std::shared_ptr<event_dispatcher> dispatcher);
+
+    /**
+     * @brief Add a session under a fresh random id
+     * @param dispatcher Event dispatcher of the session
+     * @return The new session, its id() is the generated id
+     */
+    std::shared_ptr<session> insert_new(std::shared_ptr<event_dispatcher> dispatcher);
+
+    /**
+     * @brief Look up a session
+     * @param id Session id
+     * @return The session, or nullptr if unknown
+     */
+    std::shared_ptr<session> find(const std::string& id) const;
+
+    /**
+     * @brief Look up a session and mark it active
+     * @param id Session id
+     * @return The session, or nullptr if unknown
+     */
+    std::shared_ptr<session> touch(const std::string& id);
+
+    /**
+     * @brief Mark a session active
+     * @param s The session
+     */
+    void touch(session& s);
+
+    /**
+     * @brief Remove a session
+     * @param id Session id
+     * @return The removed session, or nullptr if unknown
+     */
+    std::shared_ptr<session> erase(const std::string& id);
+
+    /**
+     * @brief Remove every session
+     * @return The removed sessions
+     */
+    std::vector<std::shared_ptr<session>> clear();
+
+    /**
+     * @brief Ids of sessions inactive for longer than timeout, oldest first per shard
+     * @param timeout Idle limit
+     * @param now Current time
+     */
+    std::vector<std::string> idle_sessions(std::chrono::steady_clock::duration timeout,
+                                           std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now()) const;
+
+    /**
+     * @brief Snapshot of the counters of every session
+     */
+    std::vector<session_stats> stats() const;
+
+    /**
+     * @brief Number of sessions
+     */
+    size_t size() const;
+
+private:
+    struct shard {
+        mutable std::mutex mutex;
+        std::unordered_map<session_key, std::shared_ptr<session>, session_key_hash> sessions;
+
+        // Least recently active at the head, most recent at the tail
+        session* lru_head = nullptr;
+        session* lru_tail = nullptr;
+
+        void link_back(session* s);
+        void unlink(session* s);
+    };
+
+    shard& shard_for(const session_key& key) const {
+        return shards_[session_key_hash()(key) % shards_.size()];
+    }
+
+    mutable std::vector<shard> shards_;
+};
+
+} // namespace mcp
+
+#endif // MCP_SESSION_H
@@ -13,6 +13,8 @@
 #include "mcp_message.h"
 #include "mcp_tool.h"
 #include "mcp_logger.h"
+#include "mcp_http_pool.h"
+#include "mcp_sse_parser.h"
 
 // Include the HTTP library
 #include "httplib.h"
@@ -87,9 +89,22 @@ public:
     /**
      * @brief Set timeout for requests
      * @param timeout_seconds Timeout in seconds
+     * @note Later messages go out on new connections; the SSE stream uses the
+     *       timeout when it next connects
      */
     void set_timeout(int timeout_seconds);
 
+    /**
+     * @brief Set the number of keep-alive connections used to post messages
+     *
+     * Concurrent requests go out on the connection with the fewest requests in
+     * progress; the SSE stream keeps its own connection. Connections open when
+     * first needed, so a single caller only ever uses one. Each open connection
+     * occupies one of the server's listener threads.
+     * @param size Number of connections, default 4
+     */
+    void set_connection_pool_size(size_t size);
+
     /**
      * @brief Set client capabilities
      * @param capabilities The capabilities of the client
@@ -105,6 +120,17 @@ public:
      */
     response send_request(const std::string& method, const json& params = json::object()) override;
     
+    /**
+     * @brief Send a request without waiting for the response
+     * @param method The method to call
+     * @param params The parameters to pass
+     * @param options Deadline for this request
+     * @return Handle to wait on, attach a callback to, or cancel
+     * @throws mcp_exception if the request cannot be sent
+     */
+    pending_call send_request_async(const std::string& method, const json& params = json::object(),
+                                    const call_options& options = call_options()) override;
+
     /**
      * @brief Send a notification (no response expected)
      * @param method The method to call
@@ -179,16 +205,25 @@ private:
     // Initialize HTTP client
     void init_client(const std::string& host, int port);
     void init_client(const std::string& base_url);
+
+    // Create a client for the message endpoint with the current settings
+    std::unique_ptr<httplib::Client> make_http_client() const;
     
     // Open SSE connection
     void open_sse_connection();
     
-    // Parse SSE data
-    bool parse_sse_data(const char* data, size_t length);
+    // Handle one event from the SSE stream
+    bool handle_sse_event(const sse_event& event);
     
     // Close SSE connection
     void close_sse_connection();
     
+    // POST one message to the message endpoint
+    httplib::Result post_message(const std::string& body);
+
+    // Register a request, then post it
+    pending_call send_async(const request& req, std::chrono::milliseconds timeout);
+
     // Send JSON-RPC request
     json send_jsonrpc(const request& req);
     
@@ -205,8 +240,11 @@ private:
     // Message endpoint
     std::string msg_endpoint_;
     
-    // HTTP client
-    std::unique_ptr<httplib::Client> http_client_;
+    // Connections for posting messages, replaced as a whole when resized
+    std::shared_ptr<http_client_pool> post_pool_;
+
+    // Number of connections in post_pool_
+    size_t pool_size_ = 4;
     
     // SSE HTTP client
     std::unique_ptr<httplib::Client> sse_client_;
@@ -238,14 +276,8 @@ private:
     // Condition variable, used to wait for message endpoint setting
     std::condition_variable endpoint_cv_;
     
-    // Request ID to Promise mapping, used for asynchronous waiting for responses
-    std::map<json, std::promise<json>> pending_requests_;
-    
-    // Response processing mutex
-    std::mutex response_mutex_;
-    
-    // Response condition variable
-    std::condition_variable response_cv_;
+    // Requests waiting for a response on the SSE stream, destroyed first so its timer stops before the HTTP clients go
+    call_table calls_;
 };
 
 } // namespace mcp
@@ -0,0 +1,147 @@
+/**
+ * @file mcp_sse_frame.h
+ * @brief Pooled, reference-counted SSE frames
+ *
+ * A frame holds one complete server-sent event ("event: ...\r\ndata: ...\r\n\r\n").
+ * JSON payloads are serialized straight into the frame after the event prefix, so a
+ * response is written into memory once and then only passed around by reference
+ * until it reaches the socket. Frame buffers are recycled with their capacity, so
+ * repeated large responses do not regrow a fresh string every time.
+ */
+
+#ifndef MCP_SSE_FRAME_H
+#define MCP_SSE_FRAME_H
+
+#include "mcp_message.h"
+
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace mcp {
+
+// Immutable, shared SSE frame
+using sse_frame = std::shared_ptr<const std::string>;
+
+/**
+ * @class frame_pool
+ * @brief Free list of frame buffers
+ */
+class frame_pool {
+public:
+    // Buffers kept for reuse, and the capacity they may hold in total
+    static constexpr size_t max_pooled = 64;
+    static constexpr size_t max_pooled_bytes = 4 * 1024 * 1024;
+
+    static frame_pool& instance() {
+        // Never destroyed, frames may be released during static destruction
+        static frame_pool* pool = new frame_pool();
+        return *pool;
+    }
+
+    /**
+     * @brief Take an empty buffer
+     * @param size_hint Expected frame size
+     */
+    std::string acquire(size_t size_hint = 0) {
+        std::string buffer;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!free_.empty()) {
+                buffer = std::move(free_.back());
+                free_.pop_back();
+                pooled_bytes_ -= buffer.capacity();
+                reused_.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+        buffer.clear();
+        if (buffer.capacity() < size_hint) {
+            buffer.reserve(size_hint);
+        }
+        return buffer;
+    }
+
+    /**
+     * @brief Return a buffer for reuse
+     * @param buffer The buffer, its contents are discarded
+     */
+    void release(std::string&& buffer) {
+        size_t capacity = buffer.capacity();
+        if (capacity > max_pooled_bytes) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        // A burst of large frames would otherwise stay resident after it is over
+        if (free_.size() < max_pooled && pooled_bytes_ + capacity <= max_pooled_bytes) {
+            pooled_bytes_ += capacity;
+            free_.push_back(std::move(buffer));
+        }
+    }
+
+    /**
+     * @brief Publish a filled buffer as a frame that returns to the pool when released
+     * @param buffer The frame contents
+     */
+    sse_frame publish(std::string&& buffer) {
+        return sse_frame(new std::string(std::move(buffer)), [](const std::string* p) {
+            frame_pool::instance().release(std::move(*const_cast<std::string*>(p)));
+            delete p;
+        });
+    }
+
+    // Number of acquisitions served from the free list
+    uint64_t reused() const {
+        return reused_.load(std::memory_order_relaxed);
+    }
+
+    // Capacity held by the free list
+    size_t pooled_bytes() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return pooled_bytes_;
+    }
+
+private:
+    frame_pool() = default;
+
+    std::mutex mutex_;
+    std::vector<std::string> free_;
+    size_t pooled_bytes_ = 0;
+    std::atomic<uint64_t> reused_{0};
+};
+
+/**
+ * @brief Build an SSE frame from a JSON payload without intermediate strings
+ * @param event Event name, e.g. "message"
+ * @param data Payload, serialized compactly on a single data line
+ * @param size_hint Expected payload size
+ */
+inline sse_frame make_sse_frame(const char* event, const json& data, size_t size_hint = 0) {
+    std::string buffer = frame_pool::instance().acquire(size_hint + std::strlen(event) + 16);
+    buffer.append("event: ").append(event).append("\r\ndata: ");
+
+    // Same serializer json::dump() uses, appending to the frame instead of a new string
+    nlohmann::detail::serializer<json> serializer(
+        nlohmann::detail::output_adapter<char, std::string>(buffer), ' ', json::error_handler_t::strict);
+    serializer.dump(data, false, false, 0);
+
+    buffer.append("\r\n\r\n");
+    return frame_pool::instance().publish(std::move(buffer));
+}
+
+/**
+ * @brief Build an SSE frame from a text payload
+ * @param event Event name, e.g. "endpoint"
+ * @param data Payload, must not contain line breaks
+ */
+inline sse_frame make_sse_frame(const char* event, const std::string& data) {
+    std::string buffer = frame_pool::instance().acquire(data.size() + std::strlen(event) + 16);
+    buffer.append("event: ").append(event).append("\r\ndata: ").append(data).append("\r\n\r\n");
+    return frame_pool::instance().publish(std::move(buffer));
+}
+
+} // namespace mcp
+
+#endif // MCP_SSE_FRAME_H
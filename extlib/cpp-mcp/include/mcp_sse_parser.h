@@ -0,0 +1,269 @@
+/**
+ * @file mcp_sse_parser.h
+ * @brief Incremental tokenizer for a text/event-stream
+ *
+ * Bytes are read straight into the parser's buffer and scanned once: the line
+ * scan resumes where the previous chunk ended, and an event stays in place
+ * until its blank line arrives, so the type and a single-line payload are
+ * handed out as views into the buffer. Only a payload spread over several
+ * data: lines is joined, into a string the parser reuses. Consumed events are
+ * dropped by moving the unfinished one to the front when the tail runs out of
+ * room, which keeps the cost linear in the stream length for events of any size.
+ *
+ * Follows the HTML event-stream rules: lines end in CRLF, LF or CR, a colon
+ * starts a comment, one space after a field's colon is dropped, and an event
+ * without data is not dispatched.
+ */
+
+#ifndef MCP_SSE_PARSER_H
+#define MCP_SSE_PARSER_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace mcp {
+
+/**
+ * @struct sse_event
+ * @brief One dispatched event, valid until the parser is next written to
+ */
+struct sse_event {
+    // Event type, "message" when the event names none
+    std::string_view type;
+
+    // Data lines joined with "\n"
+    std::string_view data;
+
+    // The event's id field, empty if it has none
+    std::string_view id;
+};
+
+/**
+ * @class sse_parser
+ * @brief Splits a byte stream into server-sent events
+ */
+class sse_parser {
+public:
+    /**
+     * @brief Make room for at least min_free bytes at the tail
+     * @param min_free Bytes the caller is about to write
+     * @return Pointer to the writable tail
+     */
+    char* prepare(size_t min_free) {
+        if (buffer_.size() - end_ < min_free) {
+            compact();
+            if (buffer_.size() - end_ < min_free) {
+                buffer_.resize(std::max(buffer_.size() * 2, end_ + min_free));
+            }
+        }
+        return buffer_.data() + end_;
+    }
+
+    /**
+     * @brief Mark bytes written to the tail as part of the stream
+     * @param count Number of bytes written after prepare()
+     */
+    void commit(size_t count) {
+        end_ += count;
+    }
+
+    /**
+     * @brief Copy a chunk into the stream
+     * @param data The chunk
+     * @param length Its length
+     */
+    void feed(const char* data, size_t length) {
+        if (length > 0) {
+            std::memcpy(prepare(length), data, length);
+            commit(length);
+        }
+    }
+
+    /**
+     * @brief Call on_event(const sse_event&) for every complete event
+     * @param on_event Receives each event; the views are valid during the call
+     * @return Number of events dispatched
+     */
+    template<typename F>
+    size_t consume(F&& on_event) {
+        size_t dispatched = 0;
+        while (scan_ < end_) {
+            const char* base = buffer_.data();
+
+            // A CR ended the previous line; an LF right after it belongs to that line
+            if (skip_lf_) {
+                skip_lf_ = false;
+                if (base[scan_] == '\n') {
+                    if (event_begin_ == scan_) {
+                        ++event_begin_;
+                    }
+                    ++scan_;
+                    line_begin_ = scan_;
+                    continue;
+                }
+            }
+
+            size_t eol = find_line_end(scan_);
+            if (eol == end_) {
+                scan_ = end_;
+                break;
+            }
+            skip_lf_ = base[eol] == '\r';
+            size_t line = line_begin_;
+            scan_ = line_begin_ = eol + 1;
+
+            if (eol == line) {
+                // Blank line: dispatch
+                if (data_lines_ > 0) {
+                    sse_event event;
+                    event.type = has_type_ ? view(type_) : std::string_view("message");
+                    event.data = data_lines_ == 1 ? view(data_) : std::string_view(joined_);
+                    event.id = view(id_);
+                    on_event(event);
+                    ++dispatched;
+                }
+                reset_event();
+                event_begin_ = line_begin_;
+                continue;
+            }
+            field(line, eol);
+        }
+        if (event_begin_ == end_) {
+            event_begin_ = line_begin_ = scan_ = end_ = 0;
+        }
+        return dispatched;
+    }
+
+    /**
+     * @brief Bytes held for the event in progress
+     */
+    size_t pending() const {
+        return end_ - event_begin_;
+    }
+
+    /**
+     * @brief Drop everything buffered, e.g. when the connection is reopened
+     */
+    void reset() {
+        event_begin_ = line_begin_ = scan_ = end_ = 0;
+        skip_lf_ = false;
+        reset_event();
+    }
+
+private:
+    // Offset and length of a field value in buffer_
+    struct span {
+        size_t offset = 0;
+        size_t length = 0;
+    };
+
+    std::string_view view(const span& s) const {
+        return std::string_view(buffer_.data() + s.offset, s.length);
+    }
+
+    // Position of the next CR or LF at or after from, end_ if none
+    size_t find_line_end(size_t from) const {
+        const char* begin = buffer_.data() + from;
+        size_t length = end_ - from;
+        const char* lf = static_cast<const char*>(std::memchr(begin, '\n', length));
+        size_t before_lf = lf ? static_cast<size_t>(lf - begin) : length;
+        const char* cr = static_cast<const char*>(std::memchr(begin, '\r', before_lf));
+        if (cr) {
+            return from + static_cast<size_t>(cr - begin);
+        }
+        return from + before_lf;
+    }
+
+    // Handle one non-blank line [line, eol)
+    void field(size_t line, size_t eol) {
+        const char* text = buffer_.data() + line;
+        size_t length = eol - line;
+        if (text[0] == ':') {
+            return;
+        }
+        const char* colon = static_cast<const char*>(std::memchr(text, ':', length));
+        size_t name_length = colon ? static_cast<size_t>(colon - text) : length;
+        span value;
+        if (colon) {
+            value.offset = line + name_length + 1;
+            if (value.offset < eol && buffer_[value.offset] == ' ') {
+                ++value.offset;
+            }
+            value.length = eol - value.offset;
+        } else {
+            value.offset = eol;
+        }
+        std::string_view name(text, name_length);
+
+        if (name == "data") {
+            if (data_lines_ == 0) {
+                data_ = value;
+            } else {
+                if (data_lines_ == 1) {
+                    joined_.assign(buffer_.data() + data_.offset, data_.length);
+                }
+                joined_ += '\n';
+                joined_.append(buffer_.data() + value.offset, value.length);
+            }
+            ++data_lines_;
+        } else if (name == "event") {
+            type_ = value;
+            has_type_ = true;
+        } else if (name == "id") {
+            id_ = value;
+        }
+        // retry and unknown fields are ignored
+    }
+
+    void reset_event() {
+        data_lines_ = 0;
+        has_type_ = false;
+        type_ = data_ = id_ = span();
+    }
+
+    // Move the event in progress to the front of the buffer
+    void compact() {
+        if (event_begin_ == 0) {
+            return;
+        }
+        size_t shift = event_begin_;
+        std::memmove(buffer_.data(), buffer_.data() + shift, end_ - shift);
+        end_ -= shift;
+        scan_ -= shift;
+        line_begin_ -= shift;
+        event_begin_ = 0;
+        for (span* s : {&type_, &data_, &id_}) {
+            s->offset = s->offset >= shift ? s->offset - shift : 0;
+        }
+    }
+
+    // Storage, grown but never shrunk
+    std::vector<char> buffer_;
+
+    // Start of the event in progress, of the current line, where scanning resumes, end of data
+    size_t event_begin_ = 0;
+    size_t line_begin_ = 0;
+    size_t scan_ = 0;
+    size_t end_ = 0;
+
+    // The last line ended in CR, skip a following LF
+    bool skip_lf_ = false;
+
+    // Fields of the event in progress
+    span type_;
+    span data_;
+    span id_;
+    bool has_type_ = false;
+    size_t data_lines_ = 0;
+
+    // Payload of an event with several data lines
+    std::string joined_;
+};
+
+} // namespace mcp
+
+#endif // MCP_SSE_PARSER_H
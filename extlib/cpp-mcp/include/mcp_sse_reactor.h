@@ -0,0 +1,225 @@
+/**
+ * @file mcp_sse_reactor.h
+ * @brief Event-loop transport for server-sent events
+ *
+ * Instead of pinning one HTTP worker and one heartbeat thread per SSE session,
+ * the reactor keeps every idle SSE socket in a single epoll loop. Queued frames
+ * are written when the socket is writable and heartbeats are driven by a timer wheel.
+ * Only available on Linux; elsewhere is_supported() returns false and the server
+ * keeps using the threaded transport.
+ */
+
+#ifndef MCP_SSE_REACTOR_H
+#define MCP_SSE_REACTOR_H
+
+#include "mcp_timer_wheel.h"
+
+// Include the HTTP library
+#include "httplib.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace mcp {
+
+class event_dispatcher;
+
+/**
+ * @class http_listener
+ * @brief httplib::Server that can hand accepted connections over to another transport
+ *
+ * When a handover is installed, the first request line of every new connection is
+ * peeked; connections starting with the given prefix are passed to the handler,
+ * all others are served by httplib as usual.
+ */
+class http_listener : public httplib::Server {
+public:
+    using handover_handler = std::function<void(socket_t)>;
+
+    /**
+     * @brief Install a handover
+     * @param request_prefix Request line prefix to match, e.g. "GET /sse"
+     * @param handler Takes ownership of matching sockets
+     */
+    void set_handover(const std::string& request_prefix, handover_handler handler) {
+        handover_prefix_ = request_prefix;
+        handover_ = std::move(handler);
+    }
+
+private:
+    bool process_and_close_socket(socket_t sock) override {
+        if (handover_ && matches_handover(sock)) {
+            handover_(sock);
+            return true;
+        }
+
+        // Same as httplib::Server::process_and_close_socket
+        std::string remote_addr;
+        int remote_port = 0;
+        httplib::detail::get_remote_ip_and_port(sock, remote_addr, remote_port);
+
+        std::string local_addr;
+        int local_port = 0;
+        httplib::detail::get_local_ip_and_port(sock, local_addr, local_port);
+
+        auto ret = httplib::detail::process_server_socket(
+            svr_sock_, sock, keep_alive_max_count_, keep_alive_timeout_sec_,
+            read_timeout_sec_, read_timeout_usec_, write_timeout_sec_,
+            write_timeout_usec_,
+            [&](httplib::Stream& strm, bool close_connection, bool& connection_closed) {
+                return process_request(strm, remote_addr, remote_port, local_addr,
+                                       local_port, close_connection, connection_closed,
+                                       nullptr);
+            });
+
+        httplib::detail::shutdown_socket(sock);
+        httplib::detail::close_socket(sock);
+        return ret;
+    }
+
+    // Peek at the request line without consuming it
+    bool matches_handover(socket_t sock) const {
+        const size_t need = handover_prefix_.size() + 1;
+        char buf[256];
+        if (need > sizeof(buf)) {
+            return false;
+        }
+
+        // Requests that already differ from the prefix are served without waiting
+        if (httplib::detail::select_read(sock, read_timeout_sec_, read_timeout_usec_) <= 0) {
+            return false;
+        }
+        ssize_t n = recv(sock, buf, static_cast<int>(need), MSG_PEEK);
+        if (n <= 0 || std::memcmp(buf, handover_prefix_.data(), std::min(static_cast<size_t>(n), handover_prefix_.size())) != 0) {
+            return false;
+        }
+
+        // Otherwise block in the kernel until the whole prefix has arrived, bounded
+        // by the SO_RCVTIMEO the listener sets on accepted sockets
+        do {
+            n = recv(sock, buf, static_cast<int>(need), MSG_PEEK | MSG_WAITALL);
+        } while (n < 0 && errno == EINTR);
+        if (n < 0 || static_cast<size_t>(n) < need) {
+            return false;
+        }
+        char next = buf[handover_prefix_.size()];
+        return std::memcmp(buf, handover_prefix_.data(), handover_prefix_.size()) == 0 &&
+               (next == ' ' || next == '?');
+    }
+
+    std::string handover_prefix_;
+    handover_handler handover_;
+};
+
+/**
+ * @class sse_reactor
+ * @brief Single-threaded epoll loop serving SSE sessions
+ */
+class sse_reactor {
+public:
+    // A session opened for an adopted connection
+    struct session_handle {
+        std::string session_id;
+        std::shared_ptr<event_dispatcher> dispatcher;
+        // Marks the session active, called from the loop thread
+        std::function<void()> touch;
+    };
+
+    // Create a session; notify must be installed on the dispatcher before it is published
+    using open_handler = std::function<session_handle(std::function<void()> notify)>;
+    // Called when the connection of a session goes away
+    using close_handler = std::function<void(const std::string& session_id)>;
+
+    /**
+     * @brief Constructor
+     * @param on_open Creates the session for a new SSE connection
+     * @param on_close Releases the session when its connection closes
+     * @param heartbeat_interval Interval between heartbeat events
+     */
+    sse_reactor(open_handler on_open, close_handler on_close,
+                std::chrono::milliseconds heartbeat_interval = std::chrono::seconds(5));
+
+    /**
+     * @brief Destructor
+     */
+    ~sse_reactor();
+
+    /**
+     * @brief Check if the reactor can run on this platform
+     */
+    static bool is_supported();
+
+    /**
+     * @brief Start the event loop thread
+     * @return True if the loop is running
+     */
+    bool start();
+
+    /**
+     * @brief Stop the event loop and close every connection it holds
+     */
+    void stop();
+
+    /**
+     * @brief Take ownership of an accepted socket whose request has not been read yet
+     * @param sock The socket
+     */
+    void adopt(socket_t sock);
+
+    /**
+     * @brief Number of connections held by the loop
+     */
+    size_t connection_count() const {
+        return connection_count_.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct connection;
+
+    void run();
+    void notify(uint64_t conn_id);
+    void wake();
+    void accept_pending();
+    void handle_events(uint64_t conn_id, uint32_t events);
+    void handle_readable(connection& conn);
+    bool open_session(connection& conn);
+    void flush_session(connection& conn);
+    bool write_pending(connection& conn);
+    void schedule_heartbeat(uint64_t conn_id, std::chrono::milliseconds delay);
+    void close_connection(uint64_t conn_id);
+
+    open_handler on_open_;
+    close_handler on_close_;
+    std::chrono::milliseconds heartbeat_interval_;
+
+    int epoll_fd_ = -1;
+    // Written by start() and the destructor, read by any thread that wakes the loop
+    std::atomic<int> wake_fd_{-1};
+    std::unique_ptr<std::thread> thread_;
+    std::atomic<bool> running_{false};
+
+    // Sockets adopted by HTTP workers and sessions with queued frames, handed to the loop thread
+    std::mutex pending_mutex_;
+    std::vector<socket_t> adopted_;
+    std::vector<uint64_t> ready_;
+
+    // Owned by the loop thread
+    std::unordered_map<uint64_t, std::unique_ptr<connection>> connections_;
+    timer_wheel timers_;
+    uint64_t next_conn_id_ = 1;
+    std::atomic<size_t> connection_count_{0};
+};
+
+} // namespace mcp
+
+#endif // MCP_SSE_REACTOR_H
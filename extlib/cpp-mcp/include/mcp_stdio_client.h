@@ -15,6 +15,8 @@
 #include "mcp_tool.h"
 #include "mcp_logger.h"
 
+#include <algorithm>
+#include <cstring>
 #include <string>
 #include <map>
 #include <vector>
@@ -32,6 +34,94 @@
 
 namespace mcp {
 
+/**
+ * @class line_buffer
+ * @brief Byte buffer that splits a stream into newline-terminated lines
+ *
+ * Data is read straight into the tail (prepare() then commit()) and each complete
+ * line is handed out in place. The scan resumes where the previous one stopped,
+ * and the unfinished line is moved to the front only when the tail runs out of
+ * room, so a burst of any size costs time linear in its length.
+ */
+class line_buffer {
+public:
+    /**
+     * @brief Make room for at least min_free bytes at the tail
+     * @param min_free Bytes the caller is about to write
+     * @return Pointer to the writable tail
+     */
+    char* prepare(size_t min_free) {
+        if (data_.size() - end_ < min_free) {
+            if (begin_ > 0) {
+                std::memmove(data_.data(), data_.data() + begin_, end_ - begin_);
+                end_ -= begin_;
+                scan_ -= begin_;
+                begin_ = 0;
+            }
+            if (data_.size() - end_ < min_free) {
+                data_.resize(std::max(data_.size() * 2, end_ + min_free));
+            }
+        }
+        return data_.data() + end_;
+    }
+
+    /**
+     * @brief Mark bytes written to the tail as part of the buffer
+     * @param count Number of bytes written after prepare()
+     */
+    void commit(size_t count) {
+        end_ += count;
+    }
+
+    /**
+     * @brief Call on_line(const char*, size_t) for every complete line
+     * @param on_line Receives each line without its "\n" or "\r\n"; empty lines are skipped
+     */
+    template<typename F>
+    void consume_lines(F&& on_line) {
+        while (scan_ < end_) {
+            const char* start = data_.data() + scan_;
+            const char* newline = static_cast<const char*>(std::memchr(start, '\n', end_ - scan_));
+            if (!newline) {
+                scan_ = end_;
+                break;
+            }
+            const char* line = data_.data() + begin_;
+            size_t length = static_cast<size_t>(newline - line);
+            begin_ = scan_ = static_cast<size_t>(newline - data_.data()) + 1;
+            if (length > 0 && line[length - 1] == '\r') {
+                --length;
+            }
+            if (length > 0) {
+                on_line(line, length);
+            }
+        }
+        if (begin_ == end_) {
+            begin_ = scan_ = end_ = 0;
+        }
+    }
+
+    /**
+     * @brief Bytes of the unfinished line
+     */
+    size_t pending() const {
+        return end_ - begin_;
+    }
+
+private:
+    // Storage, grown but never shrunk
+    std::vector<char> data_;
+
+    // Start of the first unconsumed line
+    size_t begin_ = 0;
+
+    // Where the next newline search starts
+    size_t scan_ = 0;
+
+    // End of the data
+    size_t end_ = 0;
+};
+
 /**
  * @class stdio_client
  * @brief Client for connecting to MCP servers using stdio transport
@@ -63,6 +153,13 @@ public:
      */
     void set_environment_variables(const json& env_vars);
     
+    /**
+     * @brief Set the longest line the server may send
+     * @param max_length Limit in bytes; a longer line ends the connection
+     * @note This must be called before initialize()
+     */
+    void set_max_line_length(size_t max_length);
+    
     /**
      * @brief Initialize the connection with the server
      * @param client_name The name of the client
@@ -92,6 +189,17 @@ public:
      */
     response send_request(const std::string& method, const json& params = json::object()) override;
     
+    /**
+     * @brief Send a request without waiting for the response
+     * @param method The method to call
+     * @param params The parameters to pass
+     * @param options Deadline for this request
+     * @return Handle to wait on, attach a callback to, or cancel
+     * @throws mcp_exception if the request cannot be sent
+     */
+    pending_call send_request_async(const std::string& method, const json& params = json::object(),
+                                    const call_options& options = call_options()) override;
+
     /**
      * @brief Send a notification (no response expected)
      * @param method The method to call
@@ -171,6 +279,15 @@ private:
     
     // Read thread function
     void read_thread_func();
+
+    // Dispatch one line received from the server
+    void handle_line(const char* data, size_t length);
+
+    // Write one message to the server's stdin, false if the pipe is gone
+    bool write_message(const std::string& message);
+
+    // Register a request, then write it
+    pending_call send_async(const request& req, std::chrono::milliseconds timeout);
     
     // Send JSON-RPC request
     json send_jsonrpc(const request& req);
@@ -194,11 +311,17 @@ private:
     
     // Standard output pipe (POSIX)
     int stdout_pipe_[2] = {-1, -1};
+
+    // Wakes the read thread for shutdown; an eventfd in both slots on Linux, a pipe elsewhere
+    int wake_fd_[2] = {-1, -1};
 #endif
     
     // Read thread
     std::unique_ptr<std::thread> read_thread_;
     
+    // Longest line accepted from the server
+    size_t max_line_length_ = 64 * 1024 * 1024;
+    
     // Running status
     std::atomic<bool> running_{false};
     
@@ -211,11 +334,11 @@ private:
     // Mutex
     mutable std::mutex mutex_;
     
-    // Request ID to Promise mapping, used for asynchronous waiting for responses
-    std::map<json, std::promise<json>> pending_requests_;
-    
-    // Response processing mutex
-    std::mutex response_mutex_;
+    // False once the server's output has ended
+    std::atomic<bool> connected_{false};
+
+    // Serializes writes so concurrent requests do not interleave on the pipe
+    std::mutex write_mutex_;
     
     // Initialization status
     std::atomic<bool> initialized_{false};
@@ -225,6 +348,9 @@ private:
     
     // Environment variables
     json env_vars_;
+
+    // Requests waiting for a response, destroyed first so its timer stops before the pipes go
+    call_table calls_;
 };
 
 } // namespace mcp
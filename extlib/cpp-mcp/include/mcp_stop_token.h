@@ -0,0 +1,159 @@
+/**
+ * @file mcp_stop_token.h
+ * @brief Cooperative cancellation for C++17
+ *
+ * A subset of C++20 std::stop_source, std::stop_token and std::stop_callback.
+ * The owner of a stop_source requests a stop once; code holding a token either
+ * polls stop_requested() or registers a stop_callback, typically to notify the
+ * condition variable it is waiting on.
+ */
+
+#ifndef MCP_STOP_TOKEN_H
+#define MCP_STOP_TOKEN_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace mcp {
+
+namespace detail {
+
+struct stop_node {
+    std::function<void()> callback;
+    bool listed = false;  // Guarded by the state mutex
+};
+
+struct stop_state {
+    std::atomic<bool> requested{false};
+    std::mutex mutex;
+    std::condition_variable done_cv;
+
+    // Callbacks not run yet
+    std::list<stop_node*> callbacks;
+
+    // Callback being invoked by request_stop() and the thread invoking it
+    stop_node* running = nullptr;
+    std::thread::id requester;
+};
+
+} // namespace detail
+
+class stop_token {
+public:
+    stop_token() = default;
+
+    // Whether a stop has been requested
+    bool stop_requested() const {
+        return state_ && state_->requested.load(std::memory_order_acquire);
+    }
+
+    // Whether a stop can ever be requested through this token
+    bool stop_possible() const {
+        return state_ != nullptr;
+    }
+
+private:
+    friend class stop_source;
+    friend class stop_callback;
+
+    explicit stop_token(std::shared_ptr<detail::stop_state> state) : state_(std::move(state)) {}
+
+    std::shared_ptr<detail::stop_state> state_;
+};
+
+class stop_source {
+public:
+    stop_source() : state_(std::make_shared<detail::stop_state>()) {}
+
+    stop_token get_token() const {
+        return stop_token(state_);
+    }
+
+    bool stop_requested() const {
+        return state_->requested.load(std::memory_order_acquire);
+    }
+
+    /**
+     * @brief Request a stop and run the registered callbacks on this thread
+     * @return False if a stop had already been requested
+     */
+    bool request_stop() {
+        std::unique_lock<std::mutex> lock(state_->mutex);
+        if (state_->requested.exchange(true, std::memory_order_acq_rel)) {
+            return false;
+        }
+
+        state_->requester = std::this_thread::get_id();
+        while (!state_->callbacks.empty()) {
+            detail::stop_node* node = state_->callbacks.front();
+            state_->callbacks.pop_front();
+            node->listed = false;
+            state_->running = node;
+            lock.unlock();
+            node->callback();
+            lock.lock();
+            state_->running = nullptr;
+            state_->done_cv.notify_all();
+        }
+        return true;
+    }
+
+private:
+    std::shared_ptr<detail::stop_state> state_;
+};
+
+/**
+ * @class stop_callback
+ * @brief Runs a callback when a stop is requested, or right away if it already was
+ *
+ * The destructor deregisters the callback and waits if it is running on another thread.
+ */
+class stop_callback {
+public:
+    template<typename F>
+    stop_callback(const stop_token& token, F&& f) : state_(token.state_) {
+        node_.callback = std::forward<F>(f);
+        if (!state_) {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(state_->mutex);
+            if (!state_->requested.load(std::memory_order_acquire)) {
+                it_ = state_->callbacks.insert(state_->callbacks.end(), &node_);
+                node_.listed = true;
+                return;
+            }
+        }
+        node_.callback();
+    }
+
+    ~stop_callback() {
+        if (!state_) {
+            return;
+        }
+        std::unique_lock<std::mutex> lock(state_->mutex);
+        if (node_.listed) {
+            state_->callbacks.erase(it_);
+        } else if (state_->running == &node_ && state_->requester != std::this_thread::get_id()) {
+            // Running on the requesting thread, wait for it to finish
+            state_->done_cv.wait(lock, [this] { return state_->running != &node_; });
+        }
+    }
+
+    stop_callback(const stop_callback&) = delete;
+    stop_callback& operator=(const stop_callback&) = delete;
+
+private:
+    std::shared_ptr<detail::stop_state> state_;
+    detail::stop_node node_;
+    std::list<detail::stop_node*>::iterator it_;
+};
+
+} // namespace mcp
+
+#endif // MCP_STOP_TOKEN_H
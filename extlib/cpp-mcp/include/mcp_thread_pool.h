@@ -1,73 +1,403 @@
 /**
  * @file mcp_thread_pool.h
- * @brief Simple thread pool implementation
+ * @brief Work-stealing thread pool implementation
+ *
+ * Every worker owns a Chase-Lev deque: tasks submitted from a worker go to its own
+ * deque, idle workers steal from the others. Tasks submitted from outside the pool
+ * are spread over per-worker inboxes, so producers do not share a single lock.
+ * Idle workers park on an event count and are only woken when there is work.
+ * Tasks travel in intrusive nodes that are recycled through per-thread caches,
+ * so submitting a small closure does not allocate once the caches are warm.
  */
 
 #ifndef MCP_THREAD_POOL_H
 #define MCP_THREAD_POOL_H
 
 #include <vector>
-#include <queue>
+#include <chrono>
 #include <thread>
 #include <mutex>
 #include <condition_variable>
 #include <functional>
 #include <future>
 #include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <tuple>
 #include <type_traits>
+#include <stdexcept>
+#include <utility>
 
 namespace mcp {
 
+namespace detail {
+
+/**
+ * @class task_function
+ * @brief Move-only callable with inline storage for small closures
+ */
+class task_function {
+public:
+    // Closures up to this size are stored without a separate allocation
+    static constexpr size_t inline_size = 64;
+
+    task_function() noexcept = default;
+
+    template<class F, class = std::enable_if_t<!std::is_same<std::decay_t<F>, task_function>::value>>
+    task_function(F&& f) {
+        using fn_type = std::decay_t<F>;
+        if constexpr (sizeof(fn_type) <= inline_size &&
+                      alignof(fn_type) <= alignof(std::max_align_t) &&
+                      std::is_nothrow_move_constructible<fn_type>::value) {
+            new (&storage_) fn_type(std::forward<F>(f));
+            ops_ = &inline_ops<fn_type>;
+        } else {
+            *reinterpret_cast<fn_type**>(&storage_) = new fn_type(std::forward<F>(f));
+            ops_ = &heap_ops<fn_type>;
+        }
+    }
+
+    task_function(task_function&& other) noexcept {
+        move_from(other);
+    }
+
+    task_function& operator=(task_function&& other) noexcept {
+        if (this != &other) {
+            reset();
+            move_from(other);
+        }
+        return *this;
+    }
+
+    task_function(const task_function&) = delete;
+    task_function& operator=(const task_function&) = delete;
+
+    ~task_function() {
+        reset();
+    }
+
+    void operator()() {
+        ops_->invoke(&storage_);
+    }
+
+    explicit operator bool() const noexcept {
+        return ops_ != nullptr;
+    }
+
+private:
+    struct operations {
+        void (*invoke)(void*);
+        void (*move)(void* dst, void* src) noexcept;
+        void (*destroy)(void*) noexcept;
+    };
+
+    template<class F>
+    static constexpr operations inline_ops = {
+        [](void* p) { (*static_cast<F*>(p))(); },
+        [](void* dst, void* src) noexcept {
+            new (dst) F(std::move(*static_cast<F*>(src)));
+            static_cast<F*>(src)->~F();
+        },
+        [](void* p) noexcept { static_cast<F*>(p)->~F(); }
+    };
+
+    template<class F>
+    static constexpr operations heap_ops = {
+        [](void* p) { (**static_cast<F**>(p))(); },
+        [](void* dst, void* src) noexcept {
+            *static_cast<F**>(dst) = *static_cast<F**>(src);
+        },
+        [](void* p) noexcept { delete *static_cast<F**>(p); }
+    };
+
+    void move_from(task_function& other) noexcept {
+        ops_ = other.ops_;
+        if (ops_) {
+            ops_->move(&storage_, &other.storage_);
+            other.ops_ = nullptr;
+        }
+    }
+
+    void reset() noexcept {
+        if (ops_) {
+            ops_->destroy(&storage_);
+            ops_ = nullptr;
+        }
+    }
+
+    std::aligned_storage_t<inline_size, alignof(std::max_align_t)> storage_;
+    const operations* ops_ = nullptr;
+};
+
+// A queued task, linked into an inbox or held by a deque
+struct task_node {
+    task_function fn;
+    task_node* next = nullptr;
+};
+
+/**
+ * @class task_node_cache
+ * @brief Recycles task nodes through per-thread lists and a shared depot
+ *
+ * Nodes are usually taken on a producer thread and returned on a worker, so
+ * each thread moves them to and from the depot in batches: the depot lock is
+ * taken once per batch, not once per task.
+ */
+class task_node_cache {
+public:
+    static task_node* acquire(task_function&& fn) {
+        local_list& local = local_cache();
+        if (!local.head) {
+            instance().take_batch(local);
+        }
+        task_node* node = local.head;
+        if (node) {
+            local.head = node->next;
+            --local.count;
+            node->next = nullptr;
+            node->fn = std::move(fn);
+            return node;
+        }
+        return new task_node{std::move(fn), nullptr};
+    }
+
+    static void release(task_node* node) {
+        node->fn = task_function();
+        local_list& local = local_cache();
+        node->next = local.head;
+        local.head = node;
+        if (++local.count >= local_limit) {
+            instance().give_batch(local, batch_size);
+        }
+    }
+
+private:
+    // Nodes kept per thread, and moved to or from the depot at a time
+    static constexpr size_t local_limit = 128;
+    static constexpr size_t batch_size = 64;
+
+    // Nodes the depot keeps, beyond that they are freed
+    static constexpr size_t depot_limit = 4096;
+
+    struct local_list {
+        task_node* head = nullptr;
+        size_t count = 0;
+
+        ~local_list() {
+            instance().give_batch(*this, count);
+        }
+    };
+
+    static local_list& local_cache() {
+        static thread_local local_list list;
+        return list;
+    }
+
+    // Never destroyed, threads that exit after static destruction still return their nodes
+    static task_node_cache& instance() {
+        static task_node_cache* depot = new task_node_cache();
+        return *depot;
+    }
+
+    void take_batch(local_list& local) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        while (head_ && local.count < batch_size) {
+            task_node* node = head_;
+            head_ = node->next;
+            --count_;
+            node->next = local.head;
+            local.head = node;
+            ++local.count;
+        }
+    }
+
+    void give_batch(local_list& local, size_t n) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (size_t i = 0; i < n && local.head; ++i) {
+            task_node* node = local.head;
+            local.head = node->next;
+            --local.count;
+            if (count_ < depot_limit) {
+                node->next = head_;
+                head_ = node;
+                ++count_;
+            } else {
+                delete node;
+            }
+        }
+    }
+
+    std::mutex mutex_;
+    task_node* head_ = nullptr;
+    size_t count_ = 0;
+};
+
+/**
+ * @class work_stealing_deque
+ * @brief Chase-Lev deque of task pointers
+ *
+ * The owning worker pushes and pops at the bottom, other workers steal from the top.
+ * Follows "Correct and Efficient Work-Stealing for Weak Memory Models" (Le et al., 2013).
+ */
+class work_stealing_deque {
+public:
+    explicit work_stealing_deque(int64_t capacity = 256)
+        : array_(new ring(capacity)) {
+        retired_.emplace_back(array_.load(std::memory_order_relaxed));
+    }
+
+    work_stealing_deque(const work_stealing_deque&) = delete;
+    work_stealing_deque& operator=(const work_stealing_deque&) = delete;
+
+    // Owner only
+    void push(task_node* task) {
+        int64_t b = bottom_.load(std::memory_order_relaxed);
+        int64_t t = top_.load(std::memory_order_acquire);
+        ring* a = array_.load(std::memory_order_relaxed);
+
+        if (b - t > a->capacity - 1) {
+            a = grow(a, b, t);
+        }
+
+        a->put(b, task);
+        std::atomic_thread_fence(std::memory_order_release);
+        bottom_.store(b + 1, std::memory_order_relaxed);
+    }
+
+    // Owner only
+    task_node* pop() {
+        int64_t b = bottom_.load(std::memory_order_relaxed) - 1;
+        ring* a = array_.load(std::memory_order_relaxed);
+        bottom_.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = top_.load(std::memory_order_relaxed);
+
+        if (t > b) {
+            bottom_.store(b + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+
+        task_node* task = a->get(b);
+        if (t == b) {
+            // Last element, race against thieves
+            if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                task = nullptr;
+            }
+            bottom_.store(b + 1, std::memory_order_relaxed);
+        }
+        return task;
+    }
+
+    // Any thread
+    task_node* steal() {
+        int64_t t = top_.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b = bottom_.load(std::memory_order_acquire);
+
+        if (t >= b) {
+            return nullptr;
+        }
+
+        ring* a = array_.load(std::memory_order_acquire);
+        task_node* task = a->get(t);
+        if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+            return nullptr; // Lost the race, the caller may retry elsewhere
+        }
+        return task;
+    }
+
+    bool empty() const {
+        int64_t b = bottom_.load(std::memory_order_relaxed);
+        int64_t t = top_.load(std::memory_order_relaxed);
+        return b <= t;
+    }
+
+private:
+    struct ring {
+        explicit ring(int64_t cap) : capacity(cap), mask(cap - 1), slots(new std::atomic<task_node*>[cap]) {}
+
+        void put(int64_t i, task_node* task) {
+            slots[i & mask].store(task, std::memory_order_relaxed);
+        }
+
+        task_node* get(int64_t i) const {
+            return slots[i & mask].load(std::memory_order_relaxed);
+        }
+
+        int64_t capacity;
+        int64_t mask;
+        std::unique_ptr<std::atomic<task_node*>[]> slots;
+    };
+
+    ring* grow(ring* old, int64_t b, int64_t t) {
+        auto bigger = std::make_unique<ring>(old->capacity * 2);
+        for (int64_t i = t; i < b; ++i) {
+            bigger->put(i, old->get(i));
+        }
+        ring* raw = bigger.get();
+        // Thieves may still read the old ring, keep it until the deque goes away
+        retired_.push_back(std::move(bigger));
+        array_.store(raw, std::memory_order_release);
+        return raw;
+    }
+
+    alignas(64) std::atomic<int64_t> top_{0};
+    alignas(64) std::atomic<int64_t> bottom_{0};
+    std::atomic<ring*> array_;
+    std::vector<std::unique_ptr<ring>> retired_;
+};
+
+} // namespace detail
+
 class thread_pool {
 public:
     /**
      * @brief Constructor
      * @param num_threads Number of threads in the thread pool
      */
-    explicit thread_pool(size_t num_threads = std::thread::hardware_concurrency()) : stop_(false) {
+    explicit thread_pool(size_t num_threads = std::thread::hardware_concurrency()) {
+        if (num_threads == 0) {
+            num_threads = 1;
+        }
+
+        workers_.reserve(num_threads);
         for (size_t i = 0; i < num_threads; ++i) {
-            workers_.emplace_back([this] {
-                while (true) {
-                    std::function<void()> task;
-                    
-                    {
-                        std::unique_lock<std::mutex> lock(queue_mutex_);
-                        condition_.wait(lock, [this] { 
-                            return stop_ || !tasks_.empty(); 
-                        });
-                        
-                        if (stop_ && tasks_.empty()) {
-                            return;
-                        }
-                        
-                        task = std::move(tasks_.front());
-                        tasks_.pop();
-                    }
-                    
-                    task();
-                }
-            });
+            workers_.emplace_back(std::make_unique<worker>());
+        }
+        for (size_t i = 0; i < num_threads; ++i) {
+            workers_[i]->thread = std::thread([this, i] { run(i); });
         }
     }
-    
+
     /**
      * @brief Destructor
+     * @note Tasks already submitted are still executed before the workers exit
      */
     ~thread_pool() {
         {
-            std::unique_lock<std::mutex> lock(queue_mutex_);
-            stop_ = true;
-        }
-        
-        condition_.notify_all();
-        
-        for (std::thread& worker : workers_) {
-            if (worker.joinable()) {
-                worker.join();
+            std::lock_guard<std::mutex> lock(park_mutex_);
+            stop_.store(true, std::memory_order_seq_cst);
+            epoch_.fetch_add(1, std::memory_order_seq_cst);
+        }
+
+        park_cv_.notify_all();
+
+        for (auto& w : workers_) {
+            if (w->thread.joinable()) {
+                w->thread.join();
+            }
+        }
+
+        // A submit that passed its stop check as the last worker exited left its task here
+        for (auto& w : workers_) {
+            while (detail::task_node* task = take_from_inbox(*w)) {
+                execute(task);
             }
         }
     }
-    
+
     /**
      * @brief Submit task to thread pool
      * @param f Task function
@@ -77,42 +407,232 @@ public:
     template<class F, class... Args>
     auto enqueue(F&& f, Args&&... args) -> std::future<typename std::invoke_result<F, Args...>::type> {
         using return_type = typename std::invoke_result<F, Args...>::type;
-        
-        auto task = std::make_shared<std::packaged_task<return_type()>>(
-            std::bind(std::forward<F>(f), std::forward<Args>(args)...)
+
+        std::packaged_task<return_type()> task(
+            [f = std::forward<F>(f), args = std::make_tuple(std::forward<Args>(args)...)]() mutable -> return_type {
+                return std::apply(std::move(f), std::move(args));
+            }
         );
-        
-        std::future<return_type> result = task->get_future();
-        
-        {
-            std::unique_lock<std::mutex> lock(queue_mutex_);
-            
-            if (stop_) {
-                throw std::runtime_error("Thread pool stopped, cannot add task");
+
+        std::future<return_type> result = task.get_future();
+        submit(detail::task_function(std::move(task)));
+        return result;
+    }
+
+    /**
+     * @brief Submit a task without a future
+     * @param f Task function, exceptions it throws are discarded
+     * @note Cheaper than enqueue() when the result is not needed
+     */
+    template<class F>
+    void post(F&& f) {
+        submit(detail::task_function(
+            [f = std::forward<F>(f)]() mutable {
+                try {
+                    f();
+                } catch (...) {
+                    // Same as dropping the future returned by enqueue()
+                }
             }
-            
-            tasks_.emplace([task]() { (*task)(); });
+        ));
+    }
+
+    /**
+     * @brief Number of worker threads
+     */
+    size_t size() const {
+        return workers_.size();
+    }
+
+    /**
+     * @brief Wait until every submitted task has run
+     * @param timeout Maximum time to wait
+     * @return True if the pool is idle, false on timeout or when called from a worker
+     */
+    bool wait_idle(std::chrono::milliseconds timeout) {
+        if (current_worker().pool == this) {
+            return pending_.load(std::memory_order_acquire) == 0;
         }
-        
-        condition_.notify_one();
-        return result;
+        std::unique_lock<std::mutex> lock(idle_mutex_);
+        return idle_cv_.wait_for(lock, timeout, [this] {
+            return pending_.load(std::memory_order_acquire) == 0;
+        });
     }
-    
+
 private:
+    struct worker {
+        detail::work_stealing_deque deque;
+
+        // Tasks submitted from outside the pool, oldest first
+        std::mutex inbox_mutex;
+        detail::task_node* inbox_head = nullptr;
+        detail::task_node* inbox_tail = nullptr;
+
+        // Tasks in the inbox, read without the lock to skip empty inboxes
+        std::atomic<size_t> inbox_size{0};
+
+        std::thread thread;
+    };
+
+    // Identifies the pool and worker the current thread belongs to
+    struct worker_context {
+        const thread_pool* pool = nullptr;
+        size_t index = 0;
+    };
+
+    static worker_context& current_worker() {
+        static thread_local worker_context context;
+        return context;
+    }
+
+    void submit(detail::task_function&& fn) {
+        if (stop_.load(std::memory_order_acquire)) {
+            throw std::runtime_error("Thread pool stopped, cannot add task");
+        }
+
+        worker_context& context = current_worker();
+        if (context.pool == this) {
+            pending_.fetch_add(1, std::memory_order_relaxed);
+            workers_[context.index]->deque.push(detail::task_node_cache::acquire(std::move(fn)));
+        } else {
+            size_t index = next_inbox_.fetch_add(1, std::memory_order_relaxed) % workers_.size();
+            worker& w = *workers_[index];
+            detail::task_node* task = detail::task_node_cache::acquire(std::move(fn));
+            {
+                std::lock_guard<std::mutex> lock(w.inbox_mutex);
+                if (stop_.load(std::memory_order_acquire)) {
+                    detail::task_node_cache::release(task);
+                    throw std::runtime_error("Thread pool stopped, cannot add task");
+                }
+                pending_.fetch_add(1, std::memory_order_relaxed);
+                if (w.inbox_tail) {
+                    w.inbox_tail->next = task;
+                } else {
+                    w.inbox_head = task;
+                }
+                w.inbox_tail = task;
+                w.inbox_size.fetch_add(1, std::memory_order_release);
+            }
+        }
+
+        wake_one();
+    }
+
+    void wake_one() {
+        epoch_.fetch_add(1, std::memory_order_seq_cst);
+        if (sleepers_.load(std::memory_order_seq_cst) > 0) {
+            std::lock_guard<std::mutex> lock(park_mutex_);
+            park_cv_.notify_one();
+        }
+    }
+
+    detail::task_node* take_from_inbox(worker& w) {
+        // Idle workers scan every inbox, only lock the ones with something in them
+        if (w.inbox_size.load(std::memory_order_acquire) == 0) {
+            return nullptr;
+        }
+        std::lock_guard<std::mutex> lock(w.inbox_mutex);
+        detail::task_node* task = w.inbox_head;
+        if (!task) {
+            return nullptr;
+        }
+        w.inbox_head = task->next;
+        if (!w.inbox_head) {
+            w.inbox_tail = nullptr;
+        }
+        w.inbox_size.fetch_sub(1, std::memory_order_relaxed);
+        task->next = nullptr;
+        return task;
+    }
+
+    void execute(detail::task_node* task) {
+        task->fn();
+        detail::task_node_cache::release(task);
+        if (pending_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            std::lock_guard<std::mutex> lock(idle_mutex_);
+            idle_cv_.notify_all();
+        }
+    }
+
+    detail::task_node* find_task(size_t index) {
+        worker& self = *workers_[index];
+
+        if (auto* task = self.deque.pop()) {
+            return task;
+        }
+        if (auto* task = take_from_inbox(self)) {
+            return task;
+        }
+
+        // Steal from the other workers, starting with the next one
+        const size_t n = workers_.size();
+        for (size_t k = 1; k < n; ++k) {
+            worker& victim = *workers_[(index + k) % n];
+            if (auto* task = victim.deque.steal()) {
+                return task;
+            }
+            if (auto* task = take_from_inbox(victim)) {
+                return task;
+            }
+        }
+        return nullptr;
+    }
+
+    void run(size_t index) {
+        current_worker() = worker_context{this, index};
+
+        while (true) {
+            uint64_t epoch = epoch_.load(std::memory_order_seq_cst);
+
+            detail::task_node* task = nullptr;
+            for (int spin = 0; spin < 64 && !task; ++spin) {
+                task = find_task(index);
+                if (!task) {
+                    std::this_thread::yield();
+                }
+            }
+
+            if (task) {
+                execute(task);
+                continue;
+            }
+
+            if (stop_.load(std::memory_order_acquire)) {
+                return; // Nothing left anywhere
+            }
+
+            // Park until a producer bumps the epoch; a submit that raced with the scan above
+            // has already changed it, so the wait returns immediately
+            std::unique_lock<std::mutex> lock(park_mutex_);
+            sleepers_.fetch_add(1, std::memory_order_seq_cst);
+            park_cv_.wait(lock, [&] {
+                return epoch_.load(std::memory_order_seq_cst) != epoch || stop_.load(std::memory_order_acquire);
+            });
+            sleepers_.fetch_sub(1, std::memory_order_seq_cst);
+        }
+    }
+
     // Worker threads
-    std::vector<std::thread> workers_;
-    
-    // Task queue
-    std::queue<std::function<void()>> tasks_;
-    
-    // Mutex and condition variable
-    std::mutex queue_mutex_;
-    std::condition_variable condition_;
-    
+    std::vector<std::unique_ptr<worker>> workers_;
+
+    // Round-robin cursor for external submissions
+    std::atomic<size_t> next_inbox_{0};
+
+    // Event count used to park idle workers
+    std::atomic<uint64_t> epoch_{0};
+    std::atomic<int> sleepers_{0};
+    std::mutex park_mutex_;
+    std::condition_variable park_cv_;
+
+    // Tasks submitted and not finished, wait_idle() waits for zero
+    std::atomic<size_t> pending_{0};
+    std::mutex idle_mutex_;
+    std::condition_variable idle_cv_;
+
     // Stop flag
-    std::atomic<bool> stop_;
+    std::atomic<bool> stop_{false};
 };
 
 } // namespace mcp
 
-#endif // MCP_THREAD_POOL_H 
\ No newline at end of file
+#endif // MCP_THREAD_POOL_H
@@ -0,0 +1,351 @@
+/**
+ * @file mcp_timer_wheel.h
+ * @brief Hierarchical timer wheel and a thread that drives one
+ *
+ * Timers are bucketed by expiry tick, so scheduling and cancelling are O(1).
+ * Near timers live on the innermost wheel; timers further out sit on coarser
+ * wheels and cascade inward as their slot comes round, so a wheel of a few
+ * hundred slots covers hours without a timer revisiting its bucket every
+ * revolution.
+ *
+ * timer_wheel is not thread-safe: its owner drives it by calling advance().
+ * timer_service wraps one with a lock and a thread for callers on any thread.
+ */
+
+#ifndef MCP_TIMER_WHEEL_H
+#define MCP_TIMER_WHEEL_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace mcp {
+
+class timer_wheel {
+public:
+    using clock = std::chrono::steady_clock;
+    using timer_id = uint64_t;
+    using callback = std::function<void()>;
+
+    /**
+     * @brief Constructor
+     * @param tick Resolution of the wheel
+     * @param slots Number of buckets per level, the innermost level covers tick * slots
+     * @param levels Number of levels, each covering slots times the one inside it
+     */
+    explicit timer_wheel(std::chrono::milliseconds tick = std::chrono::milliseconds(100), size_t slots = 512, size_t levels = 4)
+        : tick_(tick.count() > 0 ? tick : std::chrono::milliseconds(1)),
+          slots_(slots > 1 ? slots : 2),
+          levels_(levels > 0 ? levels : 1, std::vector<std::list<entry>>(slots_)),
+          current_tick_time_(clock::now()) {
+        spans_.push_back(1);
+        for (size_t i = 1; i <= levels_.size(); ++i) {
+            spans_.push_back(spans_.back() * slots_);
+        }
+    }
+
+    /**
+     * @brief Schedule a callback
+     * @param delay Time from now until the callback fires
+     * @param cb The callback
+     * @return Handle that can be passed to cancel()
+     */
+    timer_id schedule(std::chrono::milliseconds delay, callback cb) {
+        // An idle wheel may not have been advanced for a while, catch up first
+        if (index_.empty()) {
+            advance();
+        }
+
+        // Count from the wheel's own position and round up, so a timer never fires early
+        auto ahead = std::chrono::duration_cast<std::chrono::milliseconds>(clock::now() + delay - current_tick_time_);
+        uint64_t ticks = ahead.count() > 0
+            ? static_cast<uint64_t>((ahead.count() + tick_.count() - 1) / tick_.count())
+            : 0;
+        if (ticks == 0) {
+            ticks = 1;
+        }
+
+        timer_id id = next_id_++;
+        std::list<entry> single;
+        single.push_back(entry{id, now_tick_ + ticks, std::move(cb)});
+        place(single, single.begin());
+        return id;
+    }
+
+    /**
+     * @brief Cancel a pending timer
+     * @param id Handle returned by schedule()
+     * @return True if the timer was pending
+     */
+    bool cancel(timer_id id) {
+        auto it = index_.find(id);
+        if (it == index_.end()) {
+            return false;
+        }
+        levels_[it->second.level][it->second.slot].erase(it->second.it);
+        index_.erase(it);
+        return true;
+    }
+
+    /**
+     * @brief Fire every timer that is due
+     * @param now Current time
+     * @return Number of callbacks invoked
+     */
+    size_t advance(clock::time_point now = clock::now()) {
+        if (index_.empty()) {
+            // Nothing to cascade or fire, jump straight to the current tick
+            if (current_tick_time_ + tick_ <= now) {
+                auto ticks = static_cast<uint64_t>((now - current_tick_time_) / tick_);
+                now_tick_ += ticks;
+                current_tick_time_ += tick_ * ticks;
+            }
+            return 0;
+        }
+
+        size_t fired = 0;
+        while (current_tick_time_ + tick_ <= now) {
+            current_tick_time_ += tick_;
+            ++now_tick_;
+
+            // Bring timers from the outer levels whose slot came round, outermost first
+            for (size_t level = levels_.size() - 1; level > 0; --level) {
+                if (now_tick_ % spans_[level] == 0) {
+                    // Take the whole bucket first, far timers may land in it again
+                    std::list<entry> cascading;
+                    cascading.splice(cascading.end(), levels_[level][(now_tick_ / spans_[level]) % slots_]);
+                    while (!cascading.empty()) {
+                        place(cascading, cascading.begin());
+                    }
+                }
+            }
+
+            // Detach due entries first, callbacks may schedule or cancel timers
+            std::list<entry> due;
+            auto& bucket = levels_[0][now_tick_ % slots_];
+            for (auto it = bucket.begin(); it != bucket.end();) {
+                auto next = std::next(it);
+                if (it->expiry <= now_tick_) {
+                    index_.erase(it->id);
+                    due.splice(due.end(), bucket, it);
+                }
+                it = next;
+            }
+
+            for (auto& e : due) {
+                e.cb();
+                ++fired;
+            }
+        }
+        return fired;
+    }
+
+    /**
+     * @brief Time until advance() next has work to do
+     * @param now Current time
+     */
+    std::chrono::milliseconds next_timeout(clock::time_point now = clock::now()) const {
+        // Skip ticks whose inner bucket is empty, up to the next cascade from the outer levels
+        uint64_t ticks = 1;
+        for (; ticks < slots_; ++ticks) {
+            uint64_t t = now_tick_ + ticks;
+            if (!levels_[0][t % slots_].empty() || (levels_.size() > 1 && t % spans_[1] == 0)) {
+                break;
+            }
+        }
+
+        auto next = current_tick_time_ + tick_ * ticks;
+        if (next <= now) {
+            return std::chrono::milliseconds(0);
+        }
+        return std::chrono::duration_cast<std::chrono::milliseconds>(next - now) + std::chrono::milliseconds(1);
+    }
+
+    /**
+     * @brief Number of pending timers
+     */
+    size_t size() const {
+        return index_.size();
+    }
+
+private:
+    struct entry {
+        timer_id id;
+        uint64_t expiry;  // Absolute tick the timer fires on
+        callback cb;
+    };
+
+    struct location {
+        size_t level;
+        size_t slot;
+        std::list<entry>::iterator it;
+    };
+
+    // Move an entry into the bucket its distance to expiry calls for
+    void place(std::list<entry>& from, std::list<entry>::iterator it) {
+        uint64_t distance = it->expiry > now_tick_ ? it->expiry - now_tick_ : 0;
+        size_t level = 0;
+        while (level + 1 < levels_.size() && distance >= spans_[level + 1]) {
+            ++level;
+        }
+        // Anything beyond the outermost level waits in it and is placed again when visited
+        size_t slot = static_cast<size_t>((it->expiry / spans_[level]) % slots_);
+
+        auto& bucket = levels_[level][slot];
+        bucket.splice(bucket.end(), from, it);
+        index_[bucket.back().id] = location{level, slot, std::prev(bucket.end())};
+    }
+
+    std::chrono::milliseconds tick_;
+    size_t slots_;
+    std::vector<std::vector<std::list<entry>>> levels_;
+    std::vector<uint64_t> spans_;  // Ticks covered by one slot of each level
+    std::unordered_map<timer_id, location> index_;
+    uint64_t now_tick_ = 0;
+    timer_id next_id_ = 1;
+    clock::time_point current_tick_time_;
+};
+
+/**
+ * @class timer_service
+ * @brief A timer wheel driven by its own thread
+ *
+ * Callbacks run on the service thread outside the lock, so they may schedule
+ * and cancel timers, but must not block: every timer of the service waits
+ * behind them.
+ */
+class timer_service {
+public:
+    using timer_id = timer_wheel::timer_id;
+    using callback = timer_wheel::callback;
+
+    /**
+     * @brief Constructor
+     * @param tick Resolution of the wheel
+     */
+    explicit timer_service(std::chrono::milliseconds tick = std::chrono::milliseconds(10))
+        : tick_(tick), wheel_(tick, 256, 4) {}
+
+    ~timer_service() {
+        stop();
+    }
+
+    timer_service(const timer_service&) = delete;
+    timer_service& operator=(const timer_service&) = delete;
+
+    /**
+     * @brief Start the service thread
+     */
+    void start() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (thread_.joinable()) {
+            return;
+        }
+        stopping_ = false;
+        thread_ = std::thread([this]() { run(); });
+    }
+
+    /**
+     * @brief Stop the service thread, pending timers are dropped without firing
+     */
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!thread_.joinable()) {
+                return;
+            }
+            stopping_ = true;
+        }
+        cv_.notify_all();
+        if (thread_.get_id() == std::this_thread::get_id()) {
+            thread_.detach();
+        } else {
+            thread_.join();
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        wheel_ = timer_wheel(tick_, 256, 4);
+        due_.clear();
+    }
+
+    /**
+     * @brief Schedule a callback
+     * @param delay Time from now until the callback fires
+     * @param cb The callback
+     * @return Handle that can be passed to cancel()
+     */
+    timer_id schedule(std::chrono::milliseconds delay, callback cb) {
+        timer_id id;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            id = wheel_.schedule(delay, [this, cb = std::move(cb)]() mutable {
+                due_.push_back(std::move(cb));
+            });
+        }
+        cv_.notify_all();
+        return id;
+    }
+
+    /**
+     * @brief Cancel a pending timer
+     * @param id Handle returned by schedule()
+     * @return True if the timer was pending, false if it fired or is about to
+     */
+    bool cancel(timer_id id) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return wheel_.cancel(id);
+    }
+
+    /**
+     * @brief Number of pending timers
+     */
+    size_t size() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return wheel_.size();
+    }
+
+private:
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (!stopping_) {
+            if (wheel_.size() == 0) {
+                cv_.wait(lock, [this] { return stopping_ || wheel_.size() > 0; });
+                continue;
+            }
+            cv_.wait_for(lock, wheel_.next_timeout());
+            if (stopping_) {
+                break;
+            }
+
+            wheel_.advance();
+            if (due_.empty()) {
+                continue;
+            }
+            std::vector<callback> due;
+            due.swap(due_);
+            lock.unlock();
+            for (auto& cb : due) {
+                cb();
+            }
+            lock.lock();
+        }
+    }
+
+    std::chrono::milliseconds tick_;
+    timer_wheel wheel_;
+    std::vector<callback> due_;
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    std::thread thread_;
+    bool stopping_ = false;
+};
+
+} // namespace mcp
+
+#endif // MCP_TIMER_WHEEL_H
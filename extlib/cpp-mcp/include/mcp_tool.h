@@ -25,13 +25,20 @@ struct tool {
     std::string description;
     json parameters_schema;
     
+    // The tool does not modify its environment, so calls may run concurrently
+    bool read_only = false;
+    
     // Convert to JSON for API documentation
     json to_json() const {
-        return {
+        json j = {
             {"name", name},
             {"description", description},
             {"inputSchema", parameters_schema} // You may need `parameters` instead of `inputSchema` for OAI format
         };
+        if (read_only) {
+            j["annotations"] = {{"readOnlyHint", true}};
+        }
+        return j;
     }
 };
 
@@ -57,6 +64,13 @@ public:
      */
     tool_builder& with_description(const std::string& description);
     
+    /**
+     * @brief Mark the tool as read-only
+     * @param read_only Whether the tool leaves its environment unchanged
+     * @return Reference to this builder
+     */
+    tool_builder& with_read_only(bool read_only = true);
+    
     /**
      * @brief Add a string parameter
      * @param name The parameter name
@@ -125,6 +139,7 @@ public:
 private:
     std::string name_;
     std::string description_;
+    bool read_only_ = false;
     json parameters_;
     std::vector<std::string> required_params_;
     
@@ -0,0 +1,320 @@
+/**
+ * @file mcp_envelope.cpp
+ * @brief Implementation of JSON-RPC envelope scanning
+ */
+
+#include "mcp_envelope.h"
+
+namespace mcp {
+
+namespace {
+
+// Deeper nesting is rejected instead of risking the stack
+constexpr int max_depth = 512;
+
+bool is_whitespace(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+[[noreturn]] void malformed(const char* what) {
+    throw mcp_exception(error_code::parse_error, what);
+}
+
+bool is_digit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+bool is_hex_digit(char c) {
+    return is_digit(c) || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+}
+
+size_t skip_string(std::string_view text, size_t pos) {
+    // pos is at the opening quote
+    for (size_t i = pos + 1; i < text.size(); ++i) {
+        unsigned char c = static_cast<unsigned char>(text[i]);
+        if (c == '"') {
+            return i + 1;
+        }
+        if (c == '\\') {
+            if (++i >= text.size()) {
+                break;
+            }
+            switch (text[i]) {
+                case '"': case '\\': case '/': case 'b': case 'f': case 'n': case 'r': case 't':
+                    break;
+                case 'u':
+                    if (i + 4 >= text.size() || !is_hex_digit(text[i + 1]) || !is_hex_digit(text[i + 2]) ||
+                        !is_hex_digit(text[i + 3]) || !is_hex_digit(text[i + 4])) {
+                        malformed("Invalid unicode escape in JSON string");
+                    }
+                    i += 4;
+                    break;
+                default:
+                    malformed("Invalid escape in JSON string");
+            }
+        } else if (c < 0x20) {
+            malformed("Control character in JSON string");
+        }
+    }
+    malformed("Unterminated JSON string");
+}
+
+// Skips digits, false if there were none
+bool skip_digits(std::string_view text, size_t& pos) {
+    size_t start = pos;
+    while (pos < text.size() && is_digit(text[pos])) {
+        ++pos;
+    }
+    return pos > start;
+}
+
+// true, false, null or a number; what follows is checked by the caller
+size_t skip_scalar(std::string_view text, size_t pos) {
+    for (std::string_view literal : {std::string_view("true"), std::string_view("false"), std::string_view("null")}) {
+        if (text.compare(pos, literal.size(), literal) == 0) {
+            return pos + literal.size();
+        }
+    }
+
+    // -? (0 | [1-9][0-9]*) (. [0-9]+)? ([eE] [+-]? [0-9]+)?
+    size_t end = pos;
+    if (text[end] == '-') {
+        ++end;
+    }
+    if (end < text.size() && text[end] == '0') {
+        ++end;
+    } else if (!skip_digits(text, end)) {
+        malformed("Unexpected character in JSON value");
+    }
+    if (end < text.size() && text[end] == '.') {
+        ++end;
+        if (!skip_digits(text, end)) {
+            malformed("Expected digits after decimal point");
+        }
+    }
+    if (end < text.size() && (text[end] == 'e' || text[end] == 'E')) {
+        ++end;
+        if (end < text.size() && (text[end] == '+' || text[end] == '-')) {
+            ++end;
+        }
+        if (!skip_digits(text, end)) {
+            malformed("Expected digits in exponent");
+        }
+    }
+    return end;
+}
+
+size_t skip_value(std::string_view text, size_t pos, int depth) {
+    pos = detail::skip_json_whitespace(text, pos);
+    if (pos >= text.size()) {
+        malformed("Unexpected end of JSON input");
+    }
+    if (depth > max_depth) {
+        malformed("JSON nesting too deep");
+    }
+
+    char c = text[pos];
+    if (c == '"') {
+        return skip_string(text, pos);
+    }
+    if (c != '{' && c != '[') {
+        return skip_scalar(text, pos);
+    }
+
+    bool is_object = c == '{';
+    char close = is_object ? '}' : ']';
+    pos = detail::skip_json_whitespace(text, pos + 1);
+    if (pos < text.size() && text[pos] == close) {
+        return pos + 1;
+    }
+
+    while (true) {
+        if (is_object) {
+            if (pos >= text.size() || text[pos] != '"') {
+                malformed("Expected object key");
+            }
+            pos = detail::skip_json_whitespace(text, skip_string(text, pos));
+            if (pos >= text.size() || text[pos] != ':') {
+                malformed("Expected ':' after object key");
+            }
+            ++pos;
+        }
+        pos = detail::skip_json_whitespace(text, skip_value(text, pos, depth + 1));
+        if (pos >= text.size()) {
+            malformed("Unexpected end of JSON input");
+        }
+        if (text[pos] == close) {
+            return pos + 1;
+        }
+        if (text[pos] != ',') {
+            malformed("Expected ',' between JSON values");
+        }
+        pos = detail::skip_json_whitespace(text, pos + 1);
+    }
+}
+
+} // namespace
+
+namespace detail {
+
+size_t skip_json_whitespace(std::string_view text, size_t pos) {
+    while (pos < text.size() && is_whitespace(text[pos])) {
+        ++pos;
+    }
+    return pos;
+}
+
+size_t skip_json_value(std::string_view text, size_t pos) {
+    return skip_value(text, pos, 0);
+}
+
+} // namespace detail
+
+std::string decode_json_string(std::string_view token) {
+    if (token.size() < 2 || token.front() != '"' || token.back() != '"') {
+        throw mcp_exception(error_code::parse_error, "Expected JSON string");
+    }
+
+    // Most keys and methods have nothing to unescape
+    std::string_view inner = token.substr(1, token.size() - 2);
+    if (inner.find('\\') == std::string_view::npos) {
+        return std::string(inner);
+    }
+    return parse_json_view(token).get<std::string>();
+}
+
+json parse_json_view(std::string_view text, error_code code) {
+    try {
+        return json::parse(text.begin(), text.end());
+    } catch (const json::exception& e) {
+        throw mcp_exception(code, e.what());
+    }
+}
+
+json request_envelope::parse_params() const {
+    if (params.empty()) {
+        return json::object();
+    }
+    return parse_json_view(params, error_code::invalid_params);
+}
+
+request request_envelope::to_request() const {
+    request req;
+    req.jsonrpc = jsonrpc;
+    req.id = id;
+    req.method = method;
+    if (!params.empty()) {
+        req.params = parse_params();
+    }
+    return req;
+}
+
+namespace {
+
+// Scan one request object, returns false if text is not an object
+bool scan_member(std::string_view text, request_envelope& env) {
+    return scan_json_object(text, [&env](std::string_view raw_key, std::string_view value) {
+        std::string decoded;
+        std::string_view key = raw_key.substr(1, raw_key.size() - 2);
+        if (key.find('\\') != std::string_view::npos) {
+            decoded = decode_json_string(raw_key);
+            key = decoded;
+        }
+
+        bool is_string = value.front() == '"';
+        if (key == "jsonrpc") {
+            env.has_jsonrpc = is_string;
+            if (is_string) {
+                env.jsonrpc = decode_json_string(value);
+            }
+        } else if (key == "method") {
+            env.has_method = is_string;
+            if (is_string) {
+                env.method = decode_json_string(value);
+            }
+        } else if (key == "id") {
+            env.id = value == "null" ? json() : parse_json_view(value);
+        } else if (key == "params") {
+            env.params = value;
+        }
+    });
+}
+
+} // namespace
+
+request_envelope request_envelope::scan(std::string body) {
+    request_envelope env;
+    env.body = std::make_shared<const std::string>(std::move(body));
+
+    if (!scan_member(*env.body, env)) {
+        throw mcp_exception(error_code::invalid_request, "Request must be a JSON object");
+    }
+    return env;
+}
+
+bool request_envelope::is_batch(std::string_view body) {
+    size_t pos = detail::skip_json_whitespace(body, 0);
+    return pos < body.size() && body[pos] == '[';
+}
+
+std::vector<request_envelope> request_envelope::scan_batch(std::string body) {
+    auto shared_body = std::make_shared<const std::string>(std::move(body));
+    std::string_view text(*shared_body);
+
+    size_t pos = detail::skip_json_whitespace(text, 0);
+    if (pos >= text.size() || text[pos] != '[') {
+        throw mcp_exception(error_code::parse_error, "Expected a JSON array");
+    }
+    // Validates the whole batch before any member runs
+    size_t end = detail::skip_json_value(text, pos);
+    if (detail::skip_json_whitespace(text, end) != text.size()) {
+        throw mcp_exception(error_code::parse_error, "Unexpected data after JSON array");
+    }
+
+    std::vector<request_envelope> members;
+    pos = detail::skip_json_whitespace(text, pos + 1);
+    while (pos < end - 1) {
+        size_t member_end = detail::skip_json_value(text, pos);
+        request_envelope env;
+        env.body = shared_body;
+        if (!scan_member(text.substr(pos, member_end - pos), env)) {
+            // Not an object, stays invalid
+            env = request_envelope();
+            env.body = shared_body;
+        }
+        members.push_back(std::move(env));
+
+        // Past the ',' or onto the closing ']'
+        pos = detail::skip_json_whitespace(text, member_end);
+        if (text[pos] == ',') {
+            pos = detail::skip_json_whitespace(text, pos + 1);
+        }
+    }
+    return members;
+}
+
+tool_arguments::tool_arguments(std::string_view raw_value) {
+    if (raw_value.empty()) {
+        text_ = "{}";
+    } else if (raw_value.front() == '"') {
+        // Some clients send the arguments as a JSON-encoded string
+        unwrapped_ = decode_json_string(raw_value);
+        text_ = unwrapped_;
+    } else {
+        text_ = raw_value;
+    }
+}
+
+json tool_arguments::parse() const {
+    return parse_json_view(text_, error_code::invalid_params);
+}
+
+arena_json tool_arguments::parse_arena() const {
+    try {
+        return arena_json::parse(text_.begin(), text_.end());
+    } catch (const arena_json::exception& e) {
+        throw mcp_exception(error_code::invalid_params, e.what());
+    }
+}
+
+} // namespace mcp
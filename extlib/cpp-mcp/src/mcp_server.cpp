@@ -7,12 +7,109 @@
  */
 
 #include "mcp_server.h"
+#include "mcp_random.h"
 
 namespace mcp {
 
+namespace {
+
+// Points a thread-local slot at a value for the lifetime of the binding
+template<typename T>
+class scoped_binding {
+public:
+    scoped_binding(T*& slot, T* value) : slot_(slot), previous_(slot) {
+        slot_ = value;
+    }
+    
+    ~scoped_binding() {
+        slot_ = previous_;
+    }
+    
+    scoped_binding(const scoped_binding&) = delete;
+    scoped_binding& operator=(const scoped_binding&) = delete;
+    
+private:
+    T*& slot_;
+    T* previous_;
+};
+
+// Whether initialize params name the protocol version, the one thing it cannot do without
+bool has_protocol_version(const json& params) {
+    return params.is_object() && params.contains("protocolVersion") && params["protocolVersion"].is_string();
+}
+
+} // namespace
+
+std::string server_options::validate() const {
+    if (listener_threads == 0) {
+        return "listener_threads must be at least 1";
+    }
+    if (keep_alive_max_count == 0) {
+        return "keep_alive_max_count must be at least 1";
+    }
+    if (keep_alive_timeout.count() <= 0 || read_timeout.count() <= 0 || write_timeout.count() <= 0) {
+        return "keep_alive_timeout, read_timeout and write_timeout must be positive";
+    }
+    if (worker_threads == 0) {
+        return "worker_threads must be at least 1";
+    }
+    if (heavy_limit > worker_threads) {
+        return "heavy_limit must not exceed worker_threads";
+    }
+    if (event_queue.capacity == 0) {
+        return "event_queue.capacity must be at least 1";
+    }
+    if (session_idle_timeout.count() <= 0) {
+        return "session_idle_timeout must be positive";
+    }
+    if (request_timeout.count() < 0) {
+        return "request_timeout must not be negative";
+    }
+    if (drain_timeout.count() < 0) {
+        return "drain_timeout must not be negative";
+    }
+    if (!streamable_http_endpoint.empty() && streamable_http_endpoint[0] != '/') {
+        return "streamable_http_endpoint must start with '/'";
+    }
+    if (!metrics_endpoint.empty() && metrics_endpoint[0] != '/') {
+        return "metrics_endpoint must start with '/'";
+    }
+    if (!metrics_endpoint.empty() && metrics_endpoint == streamable_http_endpoint) {
+        return "metrics_endpoint must differ from streamable_http_endpoint";
+    }
+    return std::string();
+}
+
+std::string server_options::describe() const {
+    size_t effective_heavy_limit = heavy_limit;
+    if (effective_heavy_limit == 0) {
+        effective_heavy_limit = worker_threads > 1 ? worker_threads - 1 : 1;
+    }
+    
+    std::stringstream ss;
+    ss << "listener_threads=" << listener_threads
+       << " listener_queue_limit=" << (listener_queue_limit ? std::to_string(listener_queue_limit) : "unlimited")
+       << " keep_alive=" << keep_alive_max_count << "/" << keep_alive_timeout.count() << "s"
+       << " read_timeout=" << read_timeout.count() << "s"
+       << " write_timeout=" << write_timeout.count() << "s"
+       << " payload_max_length=" << (payload_max_length ? std::to_string(payload_max_length) : "unlimited")
+       << " tcp_nodelay=" << (tcp_nodelay ? "on" : "off")
+       << " worker_threads=" << worker_threads
+       << " heavy_limit=" << effective_heavy_limit
+       << " transport=" << (transport == sse_transport::event_loop ? "event_loop" : "threaded")
+       << " event_queue_capacity=" << event_queue.capacity
+       << " session_idle_timeout=" << session_idle_timeout.count() << "s"
+       << " request_timeout=" << (request_timeout.count() ? std::to_string(request_timeout.count()) + "ms" : "off")
+       << " drain_timeout=" << drain_timeout.count() << "ms"
+       << " streamable_http_endpoint=" << (streamable_http_endpoint.empty() ? "off" : streamable_http_endpoint)
+       << " metrics_endpoint=" << (metrics_endpoint.empty() ? "off" : metrics_endpoint);
+    return ss.str();
+}
+
 server::server(const std::string& host, int port, const std::string& name, const std::string& version, const std::string& sse_endpoint, const std::string& msg_endpoint)
     : host_(host), port_(port), name_(name), version_(version), sse_endpoint_(sse_endpoint), msg_endpoint_(msg_endpoint) {
-    http_server_ = std::make_unique<httplib::Server>();
+    http_server_ = std::make_unique<http_listener>();
+    update_registry([](handler_registry&) {});
 }
 
 server::~server() {
@@ -26,11 +123,53 @@ bool server::start(bool blocking) {
     
     LOG_INFO("Starting MCP server on ", host_, ":", port_);
     
+    std::string invalid = options_.validate();
+    if (invalid.empty() && (options_.streamable_http_endpoint == sse_endpoint_ || options_.streamable_http_endpoint == msg_endpoint_)) {
+        invalid = "streamable_http_endpoint must differ from the SSE and message endpoints";
+    }
+    if (!invalid.empty()) {
+        LOG_ERROR("Invalid server options: ", invalid);
+        return false;
+    }
+    LOG_INFO("Server options: ", options_.describe());
+    
+    // Size the listener separately from the handler executor
+    const size_t listener_threads = options_.listener_threads;
+    const size_t listener_queue_limit = options_.listener_queue_limit;
+    http_server_->new_task_queue = [listener_threads, listener_queue_limit] {
+        return new httplib::ThreadPool(listener_threads, listener_queue_limit);
+    };
+    http_server_->set_keep_alive_max_count(options_.keep_alive_max_count);
+    http_server_->set_keep_alive_timeout(options_.keep_alive_timeout.count());
+    http_server_->set_read_timeout(options_.read_timeout);
+    http_server_->set_write_timeout(options_.write_timeout);
+    if (options_.payload_max_length > 0) {
+        http_server_->set_payload_max_length(options_.payload_max_length);
+    }
+    http_server_->set_tcp_nodelay(options_.tcp_nodelay);
+    
+    if (!thread_pool_) {
+        thread_pool_ = std::make_unique<thread_pool>(options_.worker_threads);
+        scheduler_ = std::make_unique<request_scheduler>(*thread_pool_, options_.heavy_limit);
+        reply_pool_ = std::make_unique<thread_pool>(2);
+    }
+    
+    // Requests that slip in on an open connection while stopping are turned away
+    http_server_->set_pre_routing_handler([this](const httplib::Request&, httplib::Response& res) {
+        if (running_) {
+            return httplib::Server::HandlerResponse::Unhandled;
+        }
+        res.status = 503;
+        res.set_header("Connection", "close");
+        res.set_content("{\"error\":\"Server is stopping\"}", "application/json");
+        return httplib::Server::HandlerResponse::Handled;
+    });
+    
     // Setup CORS handling
     http_server_->Options(".*", [](const httplib::Request& req, httplib::Response& res) {
         res.set_header("Access-Control-Allow-Origin", "*");
-        res.set_header("Access-Control-Allow-Methods", "GET, POST, OPTIONS");
-        res.set_header("Access-Control-Allow-Headers", "Content-Type");
+        res.set_header("Access-Control-Allow-Methods", "GET, POST, DELETE, OPTIONS");
+        res.set_header("Access-Control-Allow-Headers", "Content-Type, Mcp-Session-Id");
         res.status = 204; // No Content
     });
     
@@ -46,25 +185,54 @@ bool server::start(bool blocking) {
         LOG_INFO(req.remote_addr, ":", req.remote_port, " - \"GET ", req.path, " HTTP/1.1\" ", res.status);
     });
     
-    // Start resource check thread (only start in non-blocking mode)
-    if (!blocking) {
-        maintenance_thread_ = std::make_unique<std::thread>([this]() {
-            while (running_) {
-                // Check inactive sessions every 60 seconds
-                std::this_thread::sleep_for(std::chrono::seconds(60));
-                if (running_) {
-                    try {
-                        check_inactive_sessions();
-                    } catch (const std::exception& e) {
-                        LOG_ERROR("Exception in maintenance thread: ", e.what());
-                    } catch (...) {
-                        LOG_ERROR("Unknown exception in maintenance thread");
-                    }
-                }
-            }
+    // Setup streamable HTTP endpoint
+    if (!options_.streamable_http_endpoint.empty()) {
+        http_server_->Post(options_.streamable_http_endpoint.c_str(), [this](const httplib::Request& req, httplib::Response& res) {
+            this->handle_streamable_post(req, res);
+            LOG_INFO(req.remote_addr, ":", req.remote_port, " - \"POST ", req.path, " HTTP/1.1\" ", res.status);
+        });
+        http_server_->Get(options_.streamable_http_endpoint.c_str(), [this](const httplib::Request& req, httplib::Response& res) {
+            this->handle_streamable_get(req, res);
+            LOG_INFO(req.remote_addr, ":", req.remote_port, " - \"GET ", req.path, " HTTP/1.1\" ", res.status);
+        });
+        http_server_->Delete(options_.streamable_http_endpoint.c_str(), [this](const httplib::Request& req, httplib::Response& res) {
+            this->handle_streamable_delete(req, res);
+            LOG_INFO(req.remote_addr, ":", req.remote_port, " - \"DELETE ", req.path, " HTTP/1.1\" ", res.status);
+        });
+    }
+    
+    // Setup metrics endpoint
+    if (!options_.metrics_endpoint.empty()) {
+        http_server_->Get(options_.metrics_endpoint.c_str(), [this](const httplib::Request& req, httplib::Response& res) {
+            this->handle_metrics(req, res);
         });
     }
     
+    // Serve SSE connections from the event loop if requested
+    if (options_.transport == sse_transport::event_loop) {
+        if (!sse_reactor::is_supported()) {
+            LOG_WARNING("SSE event loop is not supported on this platform, using threaded SSE transport");
+        } else {
+            sse_reactor_ = std::make_unique<sse_reactor>(
+                [this](std::function<void()> notify) { return open_event_loop_session(std::move(notify)); },
+                [this](const std::string& session_id) { close_session(session_id); });
+            
+            if (sse_reactor_->start()) {
+                http_server_->set_handover("GET " + sse_endpoint_, [this](socket_t sock) {
+                    sse_reactor_->adopt(sock);
+                });
+            } else {
+                LOG_WARNING("Failed to start SSE event loop, using threaded SSE transport");
+                sse_reactor_.reset();
+            }
+        }
+    }
+    
+    // Heartbeats, idle expiry and request deadlines share one timer thread
+    stop_source_ = stop_source();
+    timers_.start();
+    schedule_idle_check();
+    
     // Start server
     if (blocking) {
         running_ = true;
@@ -96,126 +264,57 @@ void server::stop() {
     }
     
     LOG_INFO("Stopping MCP server on ", host_, ":", port_);
+    auto stop_started = std::chrono::steady_clock::now();
     running_ = false;
     
-    // Close maintenance thread
-    if (maintenance_thread_ && maintenance_thread_->joinable()) {
-        try {
-            maintenance_thread_->join();
-        } catch (...) {
-            maintenance_thread_->detach();
-        }
-    }
+    // Stop accepting before the drain, connections already open finish their current request
+    http_server_->stop();
     
-    // Copy all dispatchers and threads to avoid holding the lock for too long
-    std::vector<std::shared_ptr<event_dispatcher>> dispatchers_to_close;
-    std::vector<std::unique_ptr<std::thread>> threads_to_join;
+    // Wake everything waiting on the server, handlers can poll the token to finish early
+    stop_source_.request_stop();
     
-    {
-        std::lock_guard<std::mutex> lock(mutex_);
-        
-        // Copy all dispatchers
-        dispatchers_to_close.reserve(session_dispatchers_.size());
-        for (const auto& [_, dispatcher] : session_dispatchers_) {
-            dispatchers_to_close.push_back(dispatcher);
-        }
-        
-        // Copy all threads
-        threads_to_join.reserve(sse_threads_.size());
-        for (auto& [_, thread] : sse_threads_) {
-            if (thread && thread->joinable()) {
-                threads_to_join.push_back(std::move(thread));
-            }
-        }
-        
-        // Clear the maps
-        session_dispatchers_.clear();
-        sse_threads_.clear();
-        session_initialized_.clear();
-    }
+    // Drop pending heartbeats, idle checks and deadlines
+    timers_.stop();
     
-    // Close all sessions
-    for (const auto& [session_id, _] : session_dispatchers_) {
-        close_session(session_id);
+    // Let in-flight requests finish so their responses still reach the clients
+    if (thread_pool_ && !thread_pool_->wait_idle(options_.drain_timeout)) {
+        LOG_WARNING("Requests still running after ", options_.drain_timeout.count(), " ms, stopping anyway");
+    }
+    if (reply_pool_) {
+        reply_pool_->wait_idle(options_.drain_timeout);
     }
     
-    // Give threads some time to handle close events
-    std::this_thread::sleep_for(std::chrono::milliseconds(300));
-    
-    // Wait for threads to finish outside the lock (with timeout limit)
-    const auto timeout_point = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+    // Take all sessions to avoid holding the lock for too long
+    std::vector<std::shared_ptr<session>> sessions_to_close = sessions_.clear();
     
-    for (auto& thread : threads_to_join) {
-        if (!thread || !thread->joinable()) {
-            continue;
-        }
-        
-        if (std::chrono::steady_clock::now() >= timeout_point) {
-            // If timeout reached, detach remaining threads
-            LOG_WARNING("Thread join timeout reached, detaching remaining threads");
-            thread->detach();
-            continue;
-        }
-        
-        // Try using timeout join
-        bool joined = false;
-        try {
-            // Create future and promise for timeout join
-            std::promise<void> thread_done;
-            auto future = thread_done.get_future();
-            
-            // Try join in another thread
-            std::thread join_helper([&thread, &thread_done]() {
-                try {
-                    thread->join();
-                    thread_done.set_value();
-                } catch (...) {
-                    try {
-                        thread_done.set_exception(std::current_exception());
-                    } catch (...) {}
-                }
-            });
-            
-            // Wait for join to complete or timeout
-            if (future.wait_for(std::chrono::milliseconds(100)) == std::future_status::ready) {
-                future.get(); // Get possible exception
-                joined = true;
-            }
-            
-            // Process join_helper thread
-            if (join_helper.joinable()) {
-                if (joined) {
-                    join_helper.join();
-                } else {
-                    join_helper.detach();
-                }
-            }
-        } catch (...) {
-            joined = false;
-        }
-        
-        // If join fails, then detach
-        if (!joined) {
-            try {
-                thread->detach();
-            } catch (...) {
-                // Ignore exceptions
-            }
+    // Close all sessions, this wakes their SSE writers
+    for (const auto& s : sessions_to_close) {
+        if (!s->dispatcher()->is_closed()) {
+            s->dispatcher()->close();
         }
     }
     
+    // Stop the SSE event loop, this closes every connection it holds
+    if (sse_reactor_) {
+        sse_reactor_->stop();
+    }
+    
+    // The listener is closed and keep-alive loops and content providers were all
+    // woken above, so the join does not wait on timeouts
     if (server_thread_ && server_thread_->joinable()) {
-        http_server_->stop();
         try {
             server_thread_->join();
         } catch (...) {
             server_thread_->detach();
         }
-    } else {
-        http_server_->stop();
     }
     
-    LOG_INFO("MCP server stopped");
+    LOG_INFO("MCP server stopped in ", std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - stop_started).count(), " ms");
+}
+
+stop_token server::get_stop_token() const {
+    return stop_source_.get_token();
 }
 
 bool server::is_running() const {
@@ -234,140 +333,182 @@ void server::set_capabilities(const json& capabilities) {
 }
 
 void server::register_method(const std::string& method, method_handler handler) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    method_handlers_[method] = handler;
+    update_registry([&](handler_registry& reg) {
+        reg.methods[method] = handler;
+        if (method == "tools/call") {
+            reg.builtin_tool_call = false;
+        }
+    });
 }
 
 void server::register_notification(const std::string& method, notification_handler handler) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    notification_handlers_[method] = handler;
+    update_registry([&](handler_registry& reg) {
+        reg.notifications[method] = handler;
+    });
 }
 
 void server::register_resource(const std::string& path, std::shared_ptr<resource> resource) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    resources_[path] = resource;
-    
-    // Register methods for resource access
-    if (method_handlers_.find("resources/read") == method_handlers_.end()) {
-        method_handlers_["resources/read"] = [this](const json& params, const std::string& session_id) -> json {
-            if (!params.contains("uri")) {
-                throw mcp_exception(error_code::invalid_params, "Missing 'uri' parameter");
-            }
-            
-            std::string uri = params["uri"];
-            auto it = resources_.find(uri);
-            if (it == resources_.end()) {
-                throw mcp_exception(error_code::invalid_params, "Resource not found: " + uri);
-            }
-            
-            json contents = json::array();
-            contents.push_back(it->second->read());
-            
-            return json{
-                {"contents", contents}
+    update_registry([&](handler_registry& reg) {
+        reg.resources[path] = resource;
+        
+        // Register methods for resource access
+        if (reg.methods.find("resources/read") == reg.methods.end()) {
+            reg.methods["resources/read"] = [this](const json& params, const std::string& session_id) -> json {
+                if (!params.contains("uri")) {
+                    throw mcp_exception(error_code::invalid_params, "Missing 'uri' parameter");
+                }
+                
+                std::string uri = params["uri"];
+                auto snapshot = registry();
+                auto it = snapshot->resources.find(uri);
+                if (it == snapshot->resources.end()) {
+                    throw mcp_exception(error_code::invalid_params, "Resource not found: " + uri);
+                }
+                
+                json contents = json::array();
+                contents.push_back(it->second->read());
+                
+                return json{
+                    {"contents", contents}
+                };
             };
-        };
-    }
-    
-    if (method_handlers_.find("resources/list") == method_handlers_.end()) {
-        method_handlers_["resources/list"] = [this](const json& params, const std::string& session_id) -> json {
-            json resources = json::array();
+        }
         
-            for (const auto& [uri, res] : resources_) {
-                resources.push_back(res->get_metadata());
-            }
+        if (reg.methods.find("resources/list") == reg.methods.end()) {
+            reg.methods["resources/list"] = [this](const json& params, const std::string& session_id) -> json {
+                json resources = json::array();
             
-            json result = {
-                {"resources", resources}
+                for (const auto& [uri, res] : registry()->resources) {
+                    resources.push_back(res->get_metadata());
+                }
+                
+                json result = {
+                    {"resources", resources}
+                };
+                
+                if (params.contains("cursor")) {
+                    result["nextCursor"] = "";
+                }
+                
+                return result;
             };
-            
-            if (params.contains("cursor")) {
-                result["nextCursor"] = "";
-            }
-            
-            return result;
-        };
-    }
-    
-    if (method_handlers_.find("resources/subscribe") == method_handlers_.end()) {
-        method_handlers_["resources/subscribe"] = [this](const json& params, const std::string& session_id) -> json {
-            if (!params.contains("uri")) {
-                throw mcp_exception(error_code::invalid_params, "Missing 'uri' parameter");
-            }
-            
-            std::string uri = params["uri"];
-            auto it = resources_.find(uri);
-            if (it == resources_.end()) {
-                throw mcp_exception(error_code::invalid_params, "Resource not found: " + uri);
-            }
-            
-            return json::object();
+        }
+        
+        if (reg.methods.find("resources/subscribe") == reg.methods.end()) {
+            reg.methods["resources/subscribe"] = [this](const json& params, const std::string& session_id) -> json {
+                if (!params.contains("uri")) {
+                    throw mcp_exception(error_code::invalid_params, "Missing 'uri' parameter");
+                }
+                
+                std::string uri = params["uri"];
+                auto snapshot = registry();
+                if (snapshot->resources.find(uri) == snapshot->resources.end()) {
+                    throw mcp_exception(error_code::invalid_params, "Resource not found: " + uri);
+                }
+                
+                return json::object();
+            };
+        }
+        
+        if (reg.methods.find("resources/templates/list") == reg.methods.end()) {
+            reg.methods["resources/templates/list"] = [](const json& params, const std::string& session_id) -> json {
+                return json::array();
+            };
+        }
+    });
+}
+
+void server::register_tool(const tool& tool, tool_handler handler) {
+    update_registry([&](handler_registry& reg) {
+        reg.tools[tool.name] = handler_registry::registered_tool{tool, handler, nullptr};
+        install_tool_methods(reg);
+    });
+}
+
+void server::register_tool(const tool& tool, raw_tool_handler handler) {
+    update_registry([&](handler_registry& reg) {
+        reg.tools[tool.name] = handler_registry::registered_tool{tool, nullptr, handler};
+        install_tool_methods(reg);
+    });
+}
+
+void server::install_tool_methods(handler_registry& reg) {
+    // Register methods for tool listing and calling
+    if (reg.methods.find("tools/list") == reg.methods.end()) {
+        reg.methods["tools/list"] = [this](const json& params, const std::string& session_id) -> json {
+            return json{{"tools", registry()->tool_list_json}};
         };
     }
     
-    if (method_handlers_.find("resources/templates/list") == method_handlers_.end()) {
-        method_handlers_["resources/templates/list"] = [this](const json& params, const std::string& session_id) -> json {
-            return json::array();
+    if (reg.methods.find("tools/call") == reg.methods.end()) {
+        // Requests are dispatched by call_tool from the params text, this serves callers that hold a DOM
+        reg.methods["tools/call"] = [this](const json& params, const std::string& session_id) -> json {
+            return call_tool(*registry(), params.dump(), session_id);
         };
+        reg.builtin_tool_call = true;
     }
 }
 
-void server::register_tool(const tool& tool, tool_handler handler) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    tools_[tool.name] = std::make_pair(tool, handler);
+json server::call_tool(const handler_registry& registry, std::string_view params, const std::string& session_id) {
+    std::string tool_name;
+    std::string_view raw_arguments;
+    bool has_name = false;
+    bool is_object = !params.empty() && scan_json_object(params, [&](std::string_view key, std::string_view value) {
+        if (key == "\"name\"" && value.front() == '"') {
+            tool_name = decode_json_string(value);
+            has_name = true;
+        } else if (key == "\"arguments\"") {
+            raw_arguments = value;
+        }
+    });
+    if (!is_object || !has_name) {
+        throw mcp_exception(error_code::invalid_params, "Missing 'name' parameter");
+    }
     
-    // Register methods for tool listing and calling
-    if (method_handlers_.find("tools/list") == method_handlers_.end()) {
-        method_handlers_["tools/list"] = [this](const json& params, const std::string& session_id) -> json {
-            json tools_json = json::array();
-            for (const auto& [name, tool_pair] : tools_) {
-                tools_json.push_back(tool_pair.first.to_json());
-            }
-            return json{{"tools", tools_json}};
-        };
+    if (log_context* context = log_context::current()) {
+        context->tool = tool_name;
     }
     
-    if (method_handlers_.find("tools/call") == method_handlers_.end()) {
-        method_handlers_["tools/call"] = [this](const json& params, const std::string& session_id) -> json {
-            if (!params.contains("name")) {
-                throw mcp_exception(error_code::invalid_params, "Missing 'name' parameter");
-            }
-            
-            std::string tool_name = params["name"];
-            auto it = tools_.find(tool_name);
-            if (it == tools_.end()) {
-                throw mcp_exception(error_code::invalid_params, "Tool not found: " + tool_name);
-            }
-            
-            json tool_args = params.contains("arguments") ? params["arguments"] : json::array();
-
-            if (tool_args.is_string()) {
-                try {
-                    tool_args = json::parse(tool_args.get<std::string>());
-                } catch (const json::exception& e) {
-                    throw mcp_exception(error_code::invalid_params, "Invalid JSON arguments: " + std::string(e.what()));
-                }
-            }
+    auto it = registry.tools.find(tool_name);
+    if (it == registry.tools.end()) {
+        throw mcp_exception(error_code::invalid_params, "Tool not found: " + tool_name);
+    }
+    if (request_timing* timing = current_timing()) {
+        timing->tool = tool_name;
+    }
+    const auto& entry = it->second;
+    
+    // Malformed arguments are an invalid request, not a tool error
+    tool_arguments raw_args(raw_arguments);
+    json tool_args;
+    if (!entry.raw_handler) {
+        // Parse only the arguments, straight into the tree the handler reads
+        tool_args = raw_arguments.empty() ? json::array() : raw_args.parse();
+    }
 
-            json tool_result = {
-                {"isError", false}
-            };
+    json tool_result = {
+        {"isError", false}
+    };
 
-            try {
-                tool_result["content"] = it->second.second(tool_args, session_id);
-            } catch (const std::exception& e) {
-                tool_result["isError"] = true;
-                tool_result["content"] = json::array({
-                    {
-                        {"type", "text"},
-                        {"text", e.what()}
-                    }
-                });
+    try {
+        if (entry.raw_handler) {
+            // Only raw handlers can parse into the arena, the default path allocates json from the heap
+            arena_scope arena;
+            tool_result["content"] = entry.raw_handler(raw_args, session_id);
+        } else {
+            tool_result["content"] = entry.handler(tool_args, session_id);
+        }
+    } catch (const std::exception& e) {
+        tool_result["isError"] = true;
+        tool_result["content"] = json::array({
+            {
+                {"type", "text"},
+                {"text", e.what()}
             }
-
-            return tool_result;
-        };
+        });
     }
+
+    return tool_result;
 }
 
 void server::register_session_cleanup(const std::string& key, session_cleanup_handler handler) {
@@ -376,14 +517,52 @@ void server::register_session_cleanup(const std::string& key, session_cleanup_ha
 }
 
 std::vector<tool> server::get_tools() const {
-    std::lock_guard<std::mutex> lock(mutex_);
-    std::vector<tool> tools;
+    return registry()->tool_list;
+}
+
+namespace {
+// Generations are unique across servers, so a cached snapshot is never mistaken for another server's
+std::atomic<uint64_t> next_registry_generation{0};
+}
+
+std::shared_ptr<const server::handler_registry> server::registry() const {
+    struct cached_registry {
+        uint64_t generation = 0;
+        std::shared_ptr<const handler_registry> snapshot;
+    };
+    static thread_local cached_registry cache;
+    
+    // Fast path: one atomic load while nothing has been registered since this thread last looked
+    uint64_t generation = registry_generation_.load(std::memory_order_acquire);
+    if (cache.generation != generation) {
+        cache.snapshot = std::atomic_load_explicit(&registry_, std::memory_order_acquire);
+        cache.generation = generation;
+    }
+    return cache.snapshot;
+}
+
+void server::update_registry(const std::function<void(handler_registry&)>& change) {
+    std::lock_guard<std::mutex> lock(registry_mutex_);
     
-    for (const auto& [name, tool_pair] : tools_) {
-        tools.push_back(tool_pair.first);
+    auto current = std::atomic_load_explicit(&registry_, std::memory_order_acquire);
+    auto next = current ? std::make_shared<handler_registry>(*current) : std::make_shared<handler_registry>();
+    change(*next);
+    
+    // Rebuild the derived tool listings
+    next->tool_list.clear();
+    for (const auto& [name, entry] : next->tools) {
+        next->tool_list.push_back(entry.info);
+    }
+    std::sort(next->tool_list.begin(), next->tool_list.end(), [](const tool& a, const tool& b) {
+        return a.name < b.name;
+    });
+    next->tool_list_json = json::array();
+    for (const auto& t : next->tool_list) {
+        next->tool_list_json.push_back(t.to_json());
     }
     
-    return tools;
+    std::atomic_store_explicit(&registry_, std::shared_ptr<const handler_registry>(std::move(next)), std::memory_order_release);
+    registry_generation_.store(next_registry_generation.fetch_add(1, std::memory_order_relaxed) + 1, std::memory_order_release);
 }
 
 void server::set_auth_handler(auth_handler handler) {
@@ -392,9 +571,6 @@ void server::set_auth_handler(auth_handler handler) {
 }
 
 void server::handle_sse(const httplib::Request& req, httplib::Response& res) {
-    std::string session_id = generate_session_id();
-    std::string session_uri = msg_endpoint_ + "?session_id=" + session_id;
-    
     // Setup SSE response headers
     res.set_header("Content-Type", "text/event-stream");
     res.set_header("Cache-Control", "no-cache");
@@ -402,224 +578,633 @@ void server::handle_sse(const httplib::Request& req, httplib::Response& res) {
     res.set_header("Access-Control-Allow-Origin", "*");
     
     // Create session-specific event dispatcher
-    auto session_dispatcher = std::make_shared<event_dispatcher>();
+    std::shared_ptr<event_dispatcher> session_dispatcher = make_dispatcher();
+    
+    // Add session to the session table under a fresh id
+    std::shared_ptr<session> sess = sessions_.insert_new(session_dispatcher);
+    std::string session_id = sess->id();
+    std::string session_uri = msg_endpoint_ + "?session_id=" + session_id;
     
-    // Initialize activity time
-    session_dispatcher->update_activity();
+    // Announce the message endpoint, the frame waits in the queue until the stream starts
+    session_dispatcher->send_event(make_sse_frame("endpoint", session_uri), event_kind::endpoint);
+    sessions_.touch(*sess);
     
-    // Add session dispatcher to mapping table
-    {
-        std::lock_guard<std::mutex> lock(mutex_);
-        session_dispatchers_[session_id] = session_dispatcher;
-    }
+    // Send periodic heartbeats to detect connection status
+    schedule_heartbeat(sess, 0);
     
-    // Create session thread
-    auto thread = std::make_unique<std::thread>([this, res, session_id, session_uri, session_dispatcher]() {
+    // Setup chunked content provider
+    res.set_chunked_content_provider("text/event-stream", [this, session_id, session_dispatcher, sess](size_t /* offset */, httplib::DataSink& sink) {
         try {
-            // Send initial session URI
-            std::this_thread::sleep_for(std::chrono::milliseconds(500));
-            std::stringstream ss;
-            ss << "event: endpoint\r\ndata: " << session_uri << "\r\n\r\n";
-            session_dispatcher->send_event(ss.str());
-            
-            // Update activity time (after sending message)
-            session_dispatcher->update_activity();
+            // Check if session is closed - directly get status from dispatcher, reduce lock contention
+            if (session_dispatcher->is_closed()) {
+                return false;
+            }
             
-            // Send periodic heartbeats to detect connection status
-            int heartbeat_count = 0;
-            while (running_ && !session_dispatcher->is_closed()) {
-               std::this_thread::sleep_for(std::chrono::seconds(5) + std::chrono::milliseconds(rand() % 500)); // NOTE: DO NOT set it the same as the timeout of wait_event
-                
-                if (session_dispatcher->is_closed() || !running_) {
-                    break;
-                }
+            // Wait for event
+            bool result = session_dispatcher->wait_event(&sink);
+            if (!result) {
+                LOG_WARNING("Failed to wait for event, closing connection: ", session_id);
                 
-                std::stringstream heartbeat;
-                heartbeat << "event: heartbeat\r\ndata: " << heartbeat_count++ << "\r\n\r\n";
+                close_session(session_id);
                 
-                try {
-                    bool sent = session_dispatcher->send_event(heartbeat.str());
-                    if (!sent) {
-                        LOG_WARNING("Failed to send heartbeat, client may have closed connection: ", session_id);
-                        break;
-                    }
-                    
-                    // Update activity time (heartbeat successful)
-                    session_dispatcher->update_activity();
-                } catch (const std::exception& e) {
-                    LOG_ERROR("Failed to send heartbeat: ", e.what());
-                    break;
-                }
+                return false;
             }
+            
+            // Update activity time (successfully received message)
+            sessions_.touch(*sess);
+
+            return true;
         } catch (const std::exception& e) {
-            LOG_ERROR("SSE session thread exception: ", session_id, ", ", e.what());
+            LOG_ERROR("SSE content provider exception: ", e.what());
+            
+            close_session(session_id);
+            
+            return false;
+        }
+    });
+}
+
+sse_reactor::session_handle server::open_event_loop_session(std::function<void()> notify) {
+    std::shared_ptr<event_dispatcher> session_dispatcher = make_dispatcher();
+    session_dispatcher->set_notify_handler(std::move(notify));
+    
+    std::shared_ptr<session> sess = sessions_.insert_new(session_dispatcher);
+    const std::string& session_id = sess->id();
+    
+    // The event loop writes queued frames as soon as the connection is writable,
+    // so the endpoint can be announced right away
+    session_dispatcher->send_event(make_sse_frame("endpoint", msg_endpoint_ + "?session_id=" + session_id), event_kind::endpoint);
+    
+    return {session_id, session_dispatcher, [this, sess]() { sessions_.touch(*sess); }};
+}
+
+void server::handle_jsonrpc(const httplib::Request& req, httplib::Response& res) {
+    // Setup response headers
+    res.set_header("Content-Type", "application/json");
+    res.set_header("Access-Control-Allow-Origin", "*");
+    res.set_header("Access-Control-Allow-Methods", "POST, OPTIONS");
+    res.set_header("Access-Control-Allow-Headers", "Content-Type");
+    
+    // Handle OPTIONS request (CORS pre-flight)
+    if (req.method == "OPTIONS") {
+        res.status = 204; // No Content
+        return;
+    }
+    
+    auto timing = std::make_shared<request_timing>();
+    timing->received = request_timing::clock::now();
+    
+    // Get session ID
+    auto it = req.params.find("session_id");
+    std::string session_id = it != req.params.end() ? it->second : "";
+
+    // Resolve the session and update its activity time
+    std::shared_ptr<session> sess = session_id.empty() ? nullptr : sessions_.touch(session_id);
+    timing->session_lookup = request_timing::since(timing->received);
+    
+    // A JSON array is a batch, its responses go out together as one SSE event
+    if (request_envelope::is_batch(req.body)) {
+        std::vector<request_envelope> members;
+        try {
+            members = request_envelope::scan_batch(req.body);
+        } catch (const mcp_exception& e) {
+            LOG_ERROR("Failed to parse JSON batch: ", e.what());
+            res.status = 400;
+            res.set_content("{\"error\":\"Invalid JSON\"}", "application/json");
+            return;
+        }
+        if (members.empty()) {
+            res.status = 400;
+            res.set_content("{\"error\":\"Invalid request format\"}", "application/json");
+            return;
+        }
+        if (!sess) {
+            LOG_ERROR("Session not found: ", session_id);
+            res.status = 404;
+            res.set_content("{\"error\":\"Session not found\"}", "application/json");
+            return;
+        }
+        
+        for (const auto& member : members) {
+            sess->count_message(member.is_notification());
+        }
+        
+        std::shared_ptr<event_dispatcher> dispatcher = sess->dispatcher();
+        process_batch(std::move(members), session_id, [session_id, dispatcher](const json& responses) {
+            if (!dispatcher->send_event(make_sse_frame("message", responses))) {
+                LOG_ERROR("Failed to send batch response via SSE: session_id=", session_id);
+            }
+        });
+        
+        res.status = 202;
+        res.set_content("Accepted", "text/plain");
+        return;
+    }
+    
+    // Scan the envelope, params stay unparsed in the body until a handler needs them
+    request_envelope mcp_req;
+    auto parse_start = request_timing::clock::now();
+    try {
+        mcp_req = request_envelope::scan(req.body);
+        timing->parse = request_timing::since(parse_start);
+        timing->method = mcp_req.method;
+    } catch (const mcp_exception& e) {
+        LOG_ERROR("Failed to parse JSON request: ", e.what());
+        res.status = 400;
+        if (e.code() == error_code::parse_error) {
+            res.set_content("{\"error\":\"Invalid JSON\"}", "application/json");
+        } else {
+            res.set_content("{\"error\":\"Invalid request format\"}", "application/json");
+        }
+        return;
+    }
+    
+    // Check if session exists
+    if (!sess) {
+        // Handle ping request
+        if (mcp_req.method == "ping") {
+            res.status = 202;
+            res.set_content("Accepted", "text/plain");
+            return;
+        }
+        LOG_ERROR("Session not found: ", session_id);
+        res.status = 404;
+        res.set_content("{\"error\":\"Session not found\"}", "application/json");
+        return;
+    }
+    std::shared_ptr<event_dispatcher> dispatcher = sess->dispatcher();
+    
+    if (!mcp_req.is_valid()) {
+        LOG_ERROR("Failed to create request object: missing jsonrpc or method");
+        res.status = 400;
+        res.set_content("{\"error\":\"Invalid request format\"}", "application/json");
+        return;
+    }
+    
+    sess->count_message(mcp_req.is_notification());
+    
+    // If it is a notification (no ID), process it directly and return 202 status code
+    if (mcp_req.is_notification()) {
+        // Process it asynchronously in the thread pool
+        timing->queued = request_timing::clock::now();
+        scheduler_->submit(request_scheduler::classify(mcp_req.method), session_id, [this, mcp_req, session_id, timing]() {
+            timing->started = request_timing::clock::now();
+            scoped_binding<request_timing> timing_binding(current_timing(), timing.get());
+            process_request(mcp_req, session_id, nullptr);
+            metrics_.record(*timing);
+        });
+        
+        // Return 202 Accepted
+        res.status = 202;
+        res.set_content("Accepted", "text/plain");
+        return;
+    }
+    
+    // For requests with ID, process it asynchronously in the thread pool and return the result via SSE
+    response_callback send_response = with_deadline(mcp_req.id, [session_id, dispatcher](const json& response_json) {
+        // Send response via SSE
+        // Serialized once, straight into the frame that is queued for the socket
+        auto serialize_start = request_timing::clock::now();
+        sse_frame frame = make_sse_frame("message", response_json);
+        
+        // Timed on the worker only, a response to a timed out request comes from the timer thread
+        if (request_timing* timing = current_timing()) {
+            timing->serialize = request_timing::since(serialize_start);
+            timing->completed = request_timing::clock::now();
+        }
+        bool result = dispatcher->send_event(std::move(frame));
+        
+        if (!result) {
+            LOG_ERROR("Failed to send response via SSE: session_id=", session_id);
+        }
+    }, true);
+    timing->queued = request_timing::clock::now();
+    scheduler_->submit(request_scheduler::classify(mcp_req.method), session_id, [this, mcp_req, session_id, send_response, timing]() {
+        timing->started = request_timing::clock::now();
+        scoped_binding<request_timing> timing_binding(current_timing(), timing.get());
+        process_request(mcp_req, session_id, send_response);
+        metrics_.record(*timing);
+    });
+    
+    // Return 202 Accepted
+    res.status = 202;
+    res.set_content("Accepted", "text/plain");
+}
+
+void server::handle_streamable_post(const httplib::Request& req, httplib::Response& res) {
+    res.set_header("Access-Control-Allow-Origin", "*");
+    res.set_header("Access-Control-Expose-Headers", "Mcp-Session-Id");
+    
+    // Errors before a request runs are answered with a JSON-RPC error without an id
+    auto reject = [&res](int status, error_code code, const std::string& message) {
+        res.status = status;
+        res.set_content(response::create_error(json(), code, message).to_json().dump(), "application/json");
+    };
+    
+    auto timing = std::make_shared<request_timing>();
+    timing->received = request_timing::clock::now();
+    
+    bool batch = request_envelope::is_batch(req.body);
+    std::vector<request_envelope> members;
+    try {
+        if (batch) {
+            members = request_envelope::scan_batch(req.body);
+        } else {
+            members.push_back(request_envelope::scan(req.body));
+        }
+    } catch (const mcp_exception& e) {
+        LOG_ERROR("Failed to parse JSON request: ", e.what());
+        reject(400, e.code(), e.what());
+        return;
+    }
+    if (members.empty() || (!batch && !members[0].is_valid())) {
+        reject(400, error_code::invalid_request, "Invalid Request");
+        return;
+    }
+    timing->parse = request_timing::since(timing->received);
+    
+    auto lookup_start = request_timing::clock::now();
+    
+    // An initialize request opens a session, every other request names its session in the header
+    std::string session_id = req.get_header_value("Mcp-Session-Id");
+    std::shared_ptr<session> sess;
+    if (!batch && members[0].method == "initialize") {
+        // Checked before the session exists, a failed initialize must not leave one behind
+        if (members[0].is_notification()) {
+            reject(400, error_code::invalid_request, "Invalid Request");
+            return;
+        }
+        json params;
+        try {
+            params = members[0].parse_params();
+        } catch (const mcp_exception&) {
+        }
+        if (!has_protocol_version(params)) {
+            res.status = 200;
+            res.set_content(response::create_error(members[0].id, error_code::invalid_params,
+                "Expected string for 'protocolVersion' parameter").to_json().dump(), "application/json");
+            return;
+        }
+        sess = sessions_.insert_new(make_dispatcher());
+        session_id = sess->id();
+        res.set_header("Mcp-Session-Id", session_id);
+    } else if (session_id.empty()) {
+        reject(400, error_code::invalid_request, "Missing Mcp-Session-Id header");
+        return;
+    } else if (!(sess = sessions_.touch(session_id))) {
+        reject(404, error_code::invalid_request, "Session not found");
+        return;
+    }
+    timing->session_lookup = request_timing::since(lookup_start);
+    
+    bool expects_response = false;
+    for (const auto& member : members) {
+        sess->count_message(member.is_notification());
+        expects_response = expects_response || !member.is_valid() || !member.is_notification();
+    }
+    
+    // Only notifications: nothing answers on this request, so they get no stream to send on
+    if (!expects_response) {
+        for (auto& member : members) {
+            std::shared_ptr<request_timing> member_timing = batch ? nullptr : timing;
+            if (member_timing) {
+                member_timing->method = member.method;
+                member_timing->queued = request_timing::clock::now();
+            }
+            scheduler_->submit(request_scheduler::classify(member.method), session_id, [this, member, session_id, member_timing]() {
+                if (!member_timing) {
+                    process_request(member, session_id, nullptr);
+                    return;
+                }
+                member_timing->started = request_timing::clock::now();
+                scoped_binding<request_timing> timing_binding(current_timing(), member_timing.get());
+                process_request(member, session_id, nullptr);
+                metrics_.record(*member_timing);
+            });
+        }
+        res.status = 202;
+        return;
+    }
+    
+    auto stream = std::make_shared<request_stream>(session_id);
+    if (batch) {
+        process_batch(std::move(members), session_id, [stream](const json& responses) {
+            stream->finish(responses);
+        }, stream);
+    } else {
+        request_envelope member = std::move(members[0]);
+        response_callback finish = with_deadline(member.id, [stream](const json& response_json) {
+            // Only a response from the worker has a complete timing, not one from the deadline timer
+            stream->finish(response_json, current_timing() != nullptr);
+        }, false);
+        timing->method = member.method;
+        timing->queued = request_timing::clock::now();
+        scheduler_->submit(request_scheduler::classify(member.method), session_id, [this, stream, member, session_id, finish, timing]() {
+            timing->started = request_timing::clock::now();
+            scoped_binding<request_stream> binding(current_stream(), stream.get());
+            scoped_binding<request_timing> timing_binding(current_timing(), timing.get());
+            json response_json = invoke_method(member, session_id);
+            timing->handled = request_timing::clock::now();
+            finish(std::move(response_json));
+        });
+    }
+    
+    // Answer in the body unless the handler sends messages before it finishes
+    {
+        stop_token token = stop_source_.get_token();
+        stop_callback wake(token, [stream]() { stream->wake(); });
+        
+        std::unique_lock<std::mutex> lock(stream->mutex);
+        if (!stream->wait(lock, token, options_.drain_timeout)) {
+            reject(503, error_code::internal_error, "Server is stopping");
+            return;
+        }
+        if (stream->events.empty()) {
+            // The worker is done with the timing once it has set the response
+            bool timed = stream->timed;
+            auto serialize_start = request_timing::clock::now();
+            res.status = 200;
+            res.set_content(stream->response.dump(), "application/json");
+            if (timed) {
+                timing->delivery = std::chrono::duration_cast<std::chrono::microseconds>(serialize_start - stream->finished);
+                timing->serialize = request_timing::since(serialize_start);
+                timing->completed = request_timing::clock::now();
+                metrics_.record(*timing);
+            }
+            return;
         }
-        
-        close_session(session_id);
-    });
-    
-    // Store thread
-    {
-        std::lock_guard<std::mutex> lock(mutex_);
-        sse_threads_[session_id] = std::move(thread);
     }
     
-    // Setup chunked content provider
-    res.set_chunked_content_provider("text/event-stream", [this, session_id, session_dispatcher](size_t /* offset */, httplib::DataSink& sink) {
-        try {
-            // Check if session is closed - directly get status from dispatcher, reduce lock contention
-            if (session_dispatcher->is_closed()) {
+    // Upgrade to an SSE stream, the messages come first and the response last
+    res.set_header("Cache-Control", "no-cache");
+    res.set_chunked_content_provider("text/event-stream", [this, stream](size_t /* offset */, httplib::DataSink& sink) {
+        std::deque<json> events;
+        bool done;
+        {
+            stop_token token = stop_source_.get_token();
+            stop_callback wake(token, [stream]() { stream->wake(); });
+            
+            std::unique_lock<std::mutex> lock(stream->mutex);
+            if (!stream->wait(lock, token, options_.drain_timeout)) {
                 return false;
             }
-            
-            // Update activity time (received request)
-            session_dispatcher->update_activity();
-            
-            // Wait for event
-            bool result = session_dispatcher->wait_event(&sink);
-            if (!result) {
-                LOG_WARNING("Failed to wait for event, closing connection: ", session_id);
-                
-                close_session(session_id);
-                
+            events.swap(stream->events);
+            done = stream->done;
+        }
+        
+        for (const auto& event : events) {
+            sse_frame frame = make_sse_frame("message", event);
+            if (!sink.write(frame->data(), frame->size())) {
                 return false;
             }
-            
-            // Update activity time (successfully received message)
-            session_dispatcher->update_activity();
-
+        }
+        if (done) {
+            // Set once before done, never written again
+            sse_frame frame = make_sse_frame("message", stream->response);
+            if (!sink.write(frame->data(), frame->size())) {
+                return false;
+            }
+            sink.done();
             return true;
-        } catch (const std::exception& e) {
-            LOG_ERROR("SSE content provider exception: ", e.what());
-            
-            close_session(session_id);
-            
-            return false;
         }
+        return true;
     });
 }
 
-void server::handle_jsonrpc(const httplib::Request& req, httplib::Response& res) {
-    // Setup response headers
-    res.set_header("Content-Type", "application/json");
+void server::handle_streamable_get(const httplib::Request& req, httplib::Response& res) {
     res.set_header("Access-Control-Allow-Origin", "*");
-    res.set_header("Access-Control-Allow-Methods", "POST, OPTIONS");
-    res.set_header("Access-Control-Allow-Headers", "Content-Type");
     
-    // Handle OPTIONS request (CORS pre-flight)
-    if (req.method == "OPTIONS") {
-        res.status = 204; // No Content
+    std::string session_id = req.get_header_value("Mcp-Session-Id");
+    std::shared_ptr<session> sess = session_id.empty() ? nullptr : sessions_.touch(session_id);
+    if (!sess) {
+        res.status = session_id.empty() ? 400 : 404;
+        res.set_content(session_id.empty() ? "{\"error\":\"Missing Mcp-Session-Id header\"}" : "{\"error\":\"Session not found\"}",
+                        "application/json");
         return;
     }
     
-    // Get session ID
-    auto it = req.params.find("session_id");
-    std::string session_id = it != req.params.end() ? it->second : "";
-
-    // Update session activity time
-    if (!session_id.empty()) {
-        std::shared_ptr<event_dispatcher> dispatcher;
-        {
-            std::lock_guard<std::mutex> lock(mutex_);
-            auto disp_it = session_dispatchers_.find(session_id);
-            if (disp_it != session_dispatchers_.end()) {
-                dispatcher = disp_it->second;
-            }
+    // Server-initiated messages of the session, no heartbeat thread, idle periods send a comment
+    std::shared_ptr<event_dispatcher> session_dispatcher = sess->dispatcher();
+    res.set_header("Cache-Control", "no-cache");
+    res.set_chunked_content_provider("text/event-stream", [this, session_dispatcher, sess](size_t /* offset */, httplib::DataSink& sink) {
+        if (session_dispatcher->wait_event(&sink, std::chrono::seconds(15))) {
+            sessions_.touch(*sess);
+            return true;
         }
-        
-        if (dispatcher) {
-            dispatcher->update_activity();
+        if (session_dispatcher->is_closed() || !running_) {
+            return false;
         }
-    }
+        static const char keepalive[] = ": keepalive\r\n\r\n";
+        return sink.write(keepalive, sizeof(keepalive) - 1);
+    });
+}
+
+void server::handle_streamable_delete(const httplib::Request& req, httplib::Response& res) {
+    res.set_header("Access-Control-Allow-Origin", "*");
     
-    // Parse request
-    json req_json;
-    try {
-        req_json = json::parse(req.body);
-    } catch (const json::exception& e) {
-        LOG_ERROR("Failed to parse JSON request: ", e.what());
+    std::string session_id = req.get_header_value("Mcp-Session-Id");
+    if (session_id.empty()) {
         res.status = 400;
-        res.set_content("{\"error\":\"Invalid JSON\"}", "application/json");
         return;
     }
-    
-    // Check if session exists
+    if (!sessions_.find(session_id)) {
+        res.status = 404;
+        return;
+    }
+    close_session(session_id);
+    res.status = 200;
+}
+
+server::request_stream*& server::current_stream() {
+    static thread_local request_stream* stream = nullptr;
+    return stream;
+}
+
+request_timing*& server::current_timing() {
+    static thread_local request_timing* timing = nullptr;
+    return timing;
+}
+
+std::shared_ptr<event_dispatcher> server::make_dispatcher() {
     std::shared_ptr<event_dispatcher> dispatcher;
     {
         std::lock_guard<std::mutex> lock(mutex_);
-        auto disp_it = session_dispatchers_.find(session_id);
-        if (disp_it == session_dispatchers_.end()) {
-            // Handle ping request
-            if (req_json["method"] == "ping") {
-                res.status = 202;
-                res.set_content("Accepted", "text/plain");
-                return;
+        dispatcher = std::make_shared<event_dispatcher>(options_.event_queue);
+    }
+    // Responses are queued without their method, so queue time is reported on its own
+    dispatcher->set_delivery_observer([this](std::chrono::microseconds waited) {
+        metrics_.record(request_stage::delivery, "", waited);
+    });
+    return dispatcher;
+}
+
+void server::handle_metrics(const httplib::Request& req, httplib::Response& res) {
+    // Only local scrapers, the labels name the tools and methods clients call
+    if (req.remote_addr != "127.0.0.1" && req.remote_addr != "::1" && req.remote_addr != "::ffff:127.0.0.1") {
+        res.status = 403;
+        return;
+    }
+    
+    std::string body;
+    metrics_.write_prometheus(body);
+    body += "# HELP mcp_sessions Live sessions\n# TYPE mcp_sessions gauge\nmcp_sessions " + std::to_string(sessions_.size()) + "\n";
+    res.set_content(body, "text/plain; version=0.0.4");
+}
+
+server_stats server::stats() const {
+    return metrics_.stats();
+}
+
+void server::process_request(const request_envelope& req, const std::string& session_id, const response_callback& on_response) {
+    json response_json = invoke_method(req, session_id);
+    if (request_timing* timing = current_timing()) {
+        timing->handled = request_timing::clock::now();
+    }
+    
+    // Continue with the response on the same worker, nothing waits for it
+    if (on_response && !req.is_notification()) {
+        on_response(response_json);
+    }
+}
+
+void server::process_batch(std::vector<request_envelope> members, const std::string& session_id, response_callback on_response,
+                           std::shared_ptr<request_stream> stream) {
+    // Responses in batch order, sent by whichever member finishes last
+    struct batch_state {
+        std::mutex mutex;
+        json responses = json::array();
+        size_t remaining = 0;
+        response_callback on_response;
+        
+        void complete(size_t slot, json response) {
+            bool done;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                responses[slot] = std::move(response);
+                done = --remaining == 0;
+            }
+            if (done) {
+                on_response(responses);
             }
-            LOG_ERROR("Session not found: ", session_id);
-            res.status = 404;
-            res.set_content("{\"error\":\"Session not found\"}", "application/json");
-            return;
         }
-        dispatcher = disp_it->second;
-    }
+    };
     
-    // Create request object
-    request mcp_req;
-    try {
-        mcp_req.jsonrpc = req_json["jsonrpc"].get<std::string>();
-        if (req_json.contains("id") && !req_json["id"].is_null()) {
-            mcp_req.id = req_json["id"];
+    auto state = std::make_shared<batch_state>();
+    state->on_response = std::move(on_response);
+    
+    // Read-only work runs concurrently, calls to other tools keep their batch order
+    std::vector<std::pair<request_envelope, size_t>> parallel;
+    std::vector<std::pair<request_envelope, size_t>> serial;
+    for (auto& member : members) {
+        if (!member.is_valid()) {
+            state->responses.push_back(response::create_error(
+                member.id, error_code::invalid_request, "Invalid Request").to_json());
+            continue;
+        }
+        if (member.is_notification()) {
+            scheduler_->submit(request_scheduler::classify(member.method), session_id, [this, member, session_id]() {
+                process_request(member, session_id, nullptr);
+            });
+            continue;
         }
-        mcp_req.method = req_json["method"].get<std::string>();
-        if (req_json.contains("params")) {
-            mcp_req.params = req_json["params"];
+        
+        size_t slot = state->responses.size();
+        state->responses.push_back(nullptr);
+        ++state->remaining;
+        (runs_in_parallel(member) ? parallel : serial).emplace_back(std::move(member), slot);
+    }
+    
+    if (state->remaining == 0) {
+        // Nothing left to run, only errors or notifications
+        if (!state->responses.empty()) {
+            state->on_response(state->responses);
         }
-    } catch (const std::exception& e) {
-        LOG_ERROR("Failed to create request object: ", e.what());
-        res.status = 400;
-        res.set_content("{\"error\":\"Invalid request format\"}", "application/json");
         return;
     }
     
-    // If it is a notification (no ID), process it directly and return 202 status code
-    if (mcp_req.is_notification()) {
-        // Process it asynchronously in the thread pool
-        thread_pool_.enqueue([this, mcp_req, session_id]() {
-            process_request(mcp_req, session_id);
+    auto run = [this, state, session_id, stream](const request_envelope& member, size_t slot) {
+        scoped_binding<request_stream> binding(current_stream(), stream.get());
+        state->complete(slot, invoke_method(member, session_id));
+    };
+    
+    for (auto& [member, slot] : parallel) {
+        request_lane lane = request_scheduler::classify(member.method);
+        scheduler_->submit(lane, session_id, [run, member = std::move(member), slot = slot]() {
+            run(member, slot);
         });
-        
-        // Return 202 Accepted
-        res.status = 202;
-        res.set_content("Accepted", "text/plain");
-        return;
     }
     
-    // For requests with ID, process it asynchronously in the thread pool and return the result via SSE
-    thread_pool_.enqueue([this, mcp_req, session_id, dispatcher]() {
-        // Process the request
-        json response_json = process_request(mcp_req, session_id);
-        
-        // Send response via SSE
-        std::stringstream ss;
-        ss << "event: message\r\ndata: " << response_json.dump() << "\r\n\r\n";
-        bool result = dispatcher->send_event(ss.str());
-        
-        if (!result) {
-            LOG_ERROR("Failed to send response via SSE: session_id=", session_id);
-        }
-    });
+    if (!serial.empty()) {
+        scheduler_->submit(request_lane::heavy, session_id, [run, serial = std::move(serial)]() {
+            for (const auto& [member, slot] : serial) {
+                run(member, slot);
+            }
+        });
+    }
+}
+
+bool server::runs_in_parallel(const request_envelope& req) const {
+    if (req.method != "tools/call") {
+        return true;
+    }
     
-    // Return 202 Accepted
-    res.status = 202;
-    res.set_content("Accepted", "text/plain");
+    auto snapshot = registry();
+    if (!snapshot->builtin_tool_call) {
+        return false;
+    }
+    
+    std::string tool_name;
+    try {
+        scan_json_object(req.params, [&tool_name](std::string_view key, std::string_view value) {
+            if (key == "\"name\"" && value.front() == '"') {
+                tool_name = decode_json_string(value);
+            }
+        });
+    } catch (const mcp_exception&) {
+        // Reported when the call runs
+        return false;
+    }
+    
+    auto it = snapshot->tools.find(tool_name);
+    return it != snapshot->tools.end() && it->second.info.read_only;
 }
 
-json server::process_request(const request& req, const std::string& session_id) {
+json server::invoke_method(const request_envelope& req, const std::string& session_id) {
+    // Every line logged while handling the request carries its fields
+    log_context context;
+    context.session_id = session_id;
+    context.method = req.method;
+    if (!req.is_notification()) {
+        context.request_id = req.id.is_string() ? req.id.get<std::string>() : req.id.dump();
+    }
+    scoped_log_context log_scope(context);
+    
+    // The snapshot keeps the handlers alive during the call
+    auto snapshot = registry();
+    
+    // Only methods the server handles get a metrics series of their own, so a
+    // client cannot fill the table with made-up names
+    if (request_timing* timing = current_timing()) {
+        bool known = req.is_notification()
+            ? req.method == "notifications/initialized" || snapshot->notifications.count(req.method) > 0
+            : req.method == "initialize" || req.method == "ping" || snapshot->methods.count(req.method) > 0;
+        timing->method = known ? req.method : "unknown";
+    }
+    
     // Check if it is a notification
     if (req.is_notification()) {
         if (req.method == "notifications/initialized") {
             set_session_initialized(session_id, true);
         }
+        
+        auto it = snapshot->notifications.find(req.method);
+        if (it != snapshot->notifications.end()) {
+            try {
+                it->second(req.parse_params(), session_id);
+            } catch (const std::exception& e) {
+                LOG_ERROR("Exception in notification handler ", req.method, ": ", e.what());
+            }
+        }
         return json::object();
     }
     
@@ -629,7 +1214,7 @@ json server::process_request(const request& req, const std::string& session_id)
         
         // Special case: initialization
         if (req.method == "initialize") {
-            return handle_initialize(req, session_id);
+            return handle_initialize(req.to_request(), session_id);
         } else if (req.method == "ping") {
             return response::create_success(req.id, json::object()).to_json();
         }
@@ -644,26 +1229,18 @@ json server::process_request(const request& req, const std::string& session_id)
         }
         
         // Find registered method handler
-        method_handler handler;
-        {
-            std::lock_guard<std::mutex> lock(mutex_);
-            auto it = method_handlers_.find(req.method);
-            if (it != method_handlers_.end()) {
-                handler = it->second;
-            }
-        }
+        auto it = snapshot->methods.find(req.method);
         
-        if (handler) {
-            // Call handler
+        if (it != snapshot->methods.end()) {
+            // Call handler on the current worker, it is already running on the thread pool
             LOG_INFO("Calling method handler: ", req.method);
-            auto future = thread_pool_.enqueue([handler, params = req.params, session_id]() -> json {
-                return handler(params, session_id);
-            });
-            json result = future.get();
+            json result = snapshot->builtin_tool_call && req.method == "tools/call"
+                ? call_tool(*snapshot, req.params, session_id)
+                : it->second(req.parse_params(), session_id);
             
             // Create success response
             LOG_INFO("Method call successful: ", req.method);
-            return response::create_success(req.id, result).to_json();
+            return response::create_success(req.id, std::move(result)).to_json();
         }
         
         // Method not found
@@ -704,7 +1281,7 @@ json server::handle_initialize(const request& req, const std::string& session_id
     const json& params = req.params;
 
     // Version negotiation
-    if (!params.contains("protocolVersion") || !params["protocolVersion"].is_string()) {
+    if (!has_protocol_version(params)) {
         LOG_ERROR("Missing or invalid protocolVersion parameter");
         return response::create_error(
             req.id, 
@@ -760,7 +1337,7 @@ json server::handle_initialize(const request& req, const std::string& session_id
 
     LOG_INFO("Initialization successful, waiting for notifications/initialized notification");
     
-    return response::create_success(req.id, result).to_json();
+    return response::create_success(req.id, std::move(result)).to_json();
 }
 
 void server::send_jsonrpc(const std::string& session_id, const json& message) {
@@ -769,18 +1346,21 @@ void server::send_jsonrpc(const std::string& session_id, const json& message) {
         LOG_WARNING("Cannot send message to empty session_id");
         return;
     }
+    
+    // Messages sent while a streamable HTTP request runs go out with its response
+    request_stream* stream = current_stream();
+    if (stream && stream->session_id == session_id) {
+        stream->push(message);
+        return;
+    }
 
     // Get session dispatcher
-    std::shared_ptr<event_dispatcher> dispatcher;
-    {
-        std::lock_guard<std::mutex> lock(mutex_);
-        auto it = session_dispatchers_.find(session_id);
-        if (it == session_dispatchers_.end()) {
-            LOG_ERROR("Session not found: ", session_id);
-            return;
-        }
-        dispatcher = it->second;
+    std::shared_ptr<session> sess = sessions_.find(session_id);
+    if (!sess) {
+        LOG_ERROR("Session not found: ", session_id);
+        return;
     }
+    std::shared_ptr<event_dispatcher> dispatcher = sess->dispatcher();
     
     // Confirm dispatcher is still valid
     if (!dispatcher || dispatcher->is_closed()) {
@@ -789,9 +1369,7 @@ void server::send_jsonrpc(const std::string& session_id, const json& message) {
     }
     
     // Send message
-    std::stringstream ss;
-    ss << "event: message\r\ndata: " << message.dump() << "\r\n\r\n";
-    bool result = dispatcher->send_event(ss.str());
+    bool result = dispatcher->send_event(make_sse_frame("message", message));
     
     if (!result) {
         LOG_ERROR("Failed to send message to session: ", session_id);
@@ -808,14 +1386,8 @@ bool server::is_session_initialized(const std::string& session_id) const {
         return false;
     }
     
-    try {
-        std::lock_guard<std::mutex> lock(mutex_);
-        auto it = session_initialized_.find(session_id);
-        return (it != session_initialized_.end() && it->second);
-    } catch (const std::exception& e) {
-        LOG_ERROR("Exception checking if session is initialized: ", e.what());
-        return false;
-    }
+    std::shared_ptr<session> sess = sessions_.find(session_id);
+    return sess && sess->is_initialized();
 }
 
 void server::set_session_initialized(const std::string& session_id, bool initialized) {
@@ -825,73 +1397,94 @@ void server::set_session_initialized(const std::string& session_id, bool initial
         return;
     }
     
-    try {
-        std::lock_guard<std::mutex> lock(mutex_);
-        // Check if session still exists
-        auto it = session_dispatchers_.find(session_id);
-        if (it == session_dispatchers_.end()) {
-            LOG_WARNING("Cannot set initialization state for non-existent session: ", session_id);
-            return;
-        }
-        session_initialized_[session_id] = initialized;
-    } catch (const std::exception& e) {
-        LOG_ERROR("Exception setting session initialization state: ", e.what());
+    // Check if session still exists
+    std::shared_ptr<session> sess = sessions_.find(session_id);
+    if (!sess) {
+        LOG_WARNING("Cannot set initialization state for non-existent session: ", session_id);
+        return;
     }
+    sess->set_initialized(initialized);
 }
 
-std::string server::generate_session_id() const {
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_int_distribution<> dis(0, 15);
-    
-    std::stringstream ss;
-    ss << std::hex;
-    
-    // UUID format: 8-4-4-4-12 hexadecimal digits
-    for (int i = 0; i < 8; ++i) {
-        ss << dis(gen);
-    }
-    ss << "-";
-    
-    for (int i = 0; i < 4; ++i) {
-        ss << dis(gen);
-    }
-    ss << "-";
-    
-    for (int i = 0; i < 4; ++i) {
-        ss << dis(gen);
-    }
-    ss << "-";
+void server::schedule_heartbeat(const std::shared_ptr<session>& sess, uint64_t count) {
+    // Jittered so sessions opened together do not beat together
+    // NOTE: DO NOT set it the same as the timeout of wait_event
+    auto delay = std::chrono::milliseconds(5000 + chacha20_rng::for_thread()() % 500);
     
-    for (int i = 0; i < 4; ++i) {
-        ss << dis(gen);
-    }
-    ss << "-";
-    
-    for (int i = 0; i < 12; ++i) {
-        ss << dis(gen);
+    sess->set_heartbeat_timer(timers_.schedule(delay, [this, weak = std::weak_ptr<session>(sess), count]() {
+        std::shared_ptr<session> s = weak.lock();
+        if (!s || !running_) {
+            return;
+        }
+        
+        const std::shared_ptr<event_dispatcher>& dispatcher = s->dispatcher();
+        if (!dispatcher->is_closed()) {
+            if (dispatcher->send_event(make_sse_frame("heartbeat", std::to_string(count)), event_kind::heartbeat)) {
+                // Update activity time (heartbeat successful)
+                sessions_.touch(*s);
+            }
+            // A dropped heartbeat means the queue is still draining, try again next time
+        }
+        
+        if (dispatcher->is_closed()) {
+            LOG_WARNING("Failed to send heartbeat, client may have closed connection: ", s->id());
+            close_session(s->id());
+            return;
+        }
+        schedule_heartbeat(s, count + 1);
+    }));
+}
+
+void server::schedule_idle_check() {
+    auto interval = std::min<std::chrono::milliseconds>(std::chrono::seconds(60), options_.session_idle_timeout);
+    timers_.schedule(interval, [this]() {
+        if (!running_) {
+            return;
+        }
+        try {
+            check_inactive_sessions();
+        } catch (const std::exception& e) {
+            LOG_ERROR("Exception while checking inactive sessions: ", e.what());
+        }
+        schedule_idle_check();
+    });
+}
+
+response_callback server::with_deadline(const json& id, response_callback send, bool send_may_block) {
+    if (options_.request_timeout.count() <= 0) {
+        return send;
     }
     
-    return ss.str();
+    // Whichever of the handler and the timer comes first answers the request
+    auto answered = std::make_shared<std::atomic<bool>>(false);
+    auto timer = timers_.schedule(options_.request_timeout, [this, answered, send, send_may_block, id]() {
+        if (answered->exchange(true)) {
+            return;
+        }
+        LOG_WARNING("Request timed out: ", id.dump());
+        auto reply = [send, id]() {
+            send(response::create_error(id, error_code::internal_error, "Request timed out").to_json());
+        };
+        if (!send_may_block) {
+            reply();
+            return;
+        }
+        // Waiting for room in a full session queue here would hold up every timer
+        reply_pool_->post(std::move(reply));
+    });
+    return [this, answered, send, timer](const json& response_json) {
+        timers_.cancel(timer);
+        if (!answered->exchange(true)) {
+            send(response_json);
+        }
+    };
 }
 
 void server::check_inactive_sessions() {
     if (!running_) return;
     
-    const auto now = std::chrono::steady_clock::now();
-    const auto timeout = std::chrono::minutes(60); // 1 hour inactive then close
-    
-    std::vector<std::string> sessions_to_close;
-    
-    {
-        std::lock_guard<std::mutex> lock(mutex_);
-        for (const auto& [session_id, dispatcher] : session_dispatchers_) {
-            if (now - dispatcher->last_activity() > timeout) {
-                // Exceeded idle time limit
-                sessions_to_close.push_back(session_id);
-            }
-        }
-    }
+    // Only the sessions at the idle end of each shard are visited
+    std::vector<std::string> sessions_to_close = sessions_.idle_sessions(options_.session_idle_timeout);
     
     // Close inactive sessions
     for (const auto& session_id : sessions_to_close) {
@@ -905,6 +1498,42 @@ bool server::set_mount_point(const std::string& mount_point, const std::string&
     return http_server_->set_mount_point(mount_point, dir, headers);
 }
 
+void server::set_options(const server_options& options) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    options_ = options;
+}
+
+server_options server::get_options() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return options_;
+}
+
+void server::set_event_queue_options(const event_queue_options& options) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    options_.event_queue = options;
+}
+
+void server::set_sse_transport(sse_transport transport) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    options_.transport = transport;
+}
+
+void server::set_streamable_http_endpoint(const std::string& endpoint) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    options_.streamable_http_endpoint = endpoint;
+}
+
+lane_stats server::get_lane_stats(request_lane lane) const {
+    if (!scheduler_) {
+        return lane_stats{};
+    }
+    return scheduler_->stats(lane);
+}
+
+std::vector<session_stats> server::get_session_stats() const {
+    return sessions_.stats();
+}
+
 void server::close_session(const std::string& session_id) {
      // Clean up resources safely
     try {
@@ -913,38 +1542,17 @@ void server::close_session(const std::string& session_id) {
         }
 
         // Copy resources to be processed
-        std::shared_ptr<event_dispatcher> dispatcher_to_close;
-        std::unique_ptr<std::thread> thread_to_release;
-        
-        {
-            std::lock_guard<std::mutex> lock(mutex_);
-            
-            // Get dispatcher pointer
-            auto dispatcher_it = session_dispatchers_.find(session_id);
-            if (dispatcher_it != session_dispatchers_.end()) {
-                dispatcher_to_close = dispatcher_it->second;
-                session_dispatchers_.erase(dispatcher_it);
-            }
-            
-            // Get thread pointer
-            auto thread_it = sse_threads_.find(session_id);
-            if (thread_it != sse_threads_.end()) {
-                thread_to_release = std::move(thread_it->second);
-                sse_threads_.erase(thread_it);
-            }
-            
-            // Clean up initialization status
-            session_initialized_.erase(session_id);
-        }
+        std::shared_ptr<session> session_to_close = sessions_.erase(session_id);
+        std::shared_ptr<event_dispatcher> dispatcher_to_close = session_to_close ? session_to_close->dispatcher() : nullptr;
         
         // Close dispatcher outside the lock
         if (dispatcher_to_close && !dispatcher_to_close->is_closed()) {
             dispatcher_to_close->close();
         }
         
-        // Release thread resources
-        if (thread_to_release) {
-            thread_to_release.release();
+        // A heartbeat that is already running sees the closed dispatcher and does not reschedule
+        if (session_to_close && session_to_close->heartbeat_timer()) {
+            timers_.cancel(session_to_close->heartbeat_timer());
         }
     } catch (const std::exception& e) {
         LOG_WARNING("Exception while cleaning up session resources: ", session_id, ", ", e.what());
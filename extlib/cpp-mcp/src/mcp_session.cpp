@@ -0,0 +1,297 @@
+/**
+ * @file mcp_session.cpp
+ * @brief Implementation of server-side sessions and the session table
+ */
+
+#include "mcp_session.h"
+#include "mcp_server.h"
+#include "mcp_random.h"
+
+namespace mcp {
+
+namespace {
+
+int hex_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// Two lowercase hex digits for every byte value
+struct hex_table {
+    char digits[256][2];
+
+    constexpr hex_table() : digits() {
+        const char* alphabet = "0123456789abcdef";
+        for (int i = 0; i < 256; ++i) {
+            digits[i][0] = alphabet[i >> 4];
+            digits[i][1] = alphabet[i & 0xf];
+        }
+    }
+};
+
+constexpr hex_table hex_pairs;
+
+// Write the bytes of value from the most significant down, two digits each
+char* put_hex(char* out, uint64_t value, int bytes) {
+    for (int shift = (bytes - 1) * 8; shift >= 0; shift -= 8) {
+        const char* pair = hex_pairs.digits[(value >> shift) & 0xff];
+        *out++ = pair[0];
+        *out++ = pair[1];
+    }
+    return out;
+}
+
+} // namespace
+
+bool session_key::parse(const std::string& id, session_key& key) {
+    // 32 hex digits with dashes after the 8th, 12th, 16th and 20th
+    if (id.size() != 36 || id[8] != '-' || id[13] != '-' || id[18] != '-' || id[23] != '-') {
+        return false;
+    }
+
+    uint64_t halves[2] = {0, 0};
+    int digits = 0;
+    for (char c : id) {
+        if (c == '-') {
+            continue;
+        }
+        int v = hex_value(c);
+        if (v < 0) {
+            return false;
+        }
+        uint64_t& half = halves[digits / 16];
+        half = (half << 4) | static_cast<uint64_t>(v);
+        ++digits;
+    }
+    if (digits != 32) {
+        return false;
+    }
+
+    key.hi = halves[0];
+    key.lo = halves[1];
+    return true;
+}
+
+session_key session_key::generate() {
+    chacha20_rng& rng = chacha20_rng::for_thread();
+    session_key key;
+    key.hi = rng();
+    key.lo = rng();
+    return key;
+}
+
+std::string session_key::to_string() const {
+    char buf[36];
+    char* p = put_hex(buf, hi >> 32, 4);
+    *p++ = '-';
+    p = put_hex(p, hi >> 16, 2);
+    *p++ = '-';
+    p = put_hex(p, hi, 2);
+    *p++ = '-';
+    p = put_hex(p, lo >> 48, 2);
+    *p++ = '-';
+    put_hex(p, lo, 6);
+    return std::string(buf, sizeof(buf));
+}
+
+session_stats session::stats() const {
+    auto now = clock::now();
+
+    session_stats s;
+    s.session_id = id_;
+    s.initialized = is_initialized();
+    s.requests = requests_.load(std::memory_order_relaxed);
+    s.notifications = notifications_.load(std::memory_order_relaxed);
+    if (dispatcher_) {
+        s.pending_events = dispatcher_->pending();
+        s.dropped_events = dispatcher_->dropped();
+    }
+    s.age = now - created_;
+    s.idle = now - last_activity();
+    return s;
+}
+
+void session_table::shard::link_back(session* s) {
+    s->lru_prev_ = lru_tail;
+    s->lru_next_ = nullptr;
+    if (lru_tail) {
+        lru_tail->lru_next_ = s;
+    } else {
+        lru_head = s;
+    }
+    lru_tail = s;
+}
+
+void session_table::shard::unlink(session* s) {
+    if (s->lru_prev_) {
+        s->lru_prev_->lru_next_ = s->lru_next_;
+    } else {
+        lru_head = s->lru_next_;
+    }
+    if (s->lru_next_) {
+        s->lru_next_->lru_prev_ = s->lru_prev_;
+    } else {
+        lru_tail = s->lru_prev_;
+    }
+    s->lru_prev_ = nullptr;
+    s->lru_next_ = nullptr;
+}
+
+session_table::session_table(size_t shard_count)
+    : shards_(shard_count > 0 ? shard_count : 1) {
+}
+
+std::shared_ptr<session> session_table::insert(const std::string& id, std::shared_ptr<event_dispatcher> dispatcher) {
+    session_key key;
+    if (!session_key::parse(id, key)) {
+        return nullptr;
+    }
+
+    auto s = std::make_shared<session>(id, key, std::move(dispatcher));
+
+    shard& sh = shard_for(key);
+    std::lock_guard<std::mutex> lock(sh.mutex);
+    if (!sh.sessions.emplace(key, s).second) {
+        return nullptr;
+    }
+    sh.link_back(s.get());
+    return s;
+}
+
+std::shared_ptr<session> session_table::insert_new(std::shared_ptr<event_dispatcher> dispatcher) {
+    while (true) {
+        session_key key = session_key::generate();
+        auto s = std::make_shared<session>(key.to_string(), key, dispatcher);
+
+        shard& sh = shard_for(key);
+        std::lock_guard<std::mutex> lock(sh.mutex);
+        if (sh.sessions.emplace(key, s).second) {
+            sh.link_back(s.get());
+            return s;
+        }
+    }
+}
+
+std::shared_ptr<session> session_table::find(const std::string& id) const {
+    session_key key;
+    if (!session_key::parse(id, key)) {
+        return nullptr;
+    }
+
+    shard& sh = shard_for(key);
+    std::lock_guard<std::mutex> lock(sh.mutex);
+    auto it = sh.sessions.find(key);
+    return it != sh.sessions.end() ? it->second : nullptr;
+}
+
+std::shared_ptr<session> session_table::touch(const std::string& id) {
+    session_key key;
+    if (!session_key::parse(id, key)) {
+        return nullptr;
+    }
+
+    shard& sh = shard_for(key);
+    std::lock_guard<std::mutex> lock(sh.mutex);
+    auto it = sh.sessions.find(key);
+    if (it == sh.sessions.end()) {
+        return nullptr;
+    }
+
+    session* s = it->second.get();
+    s->last_activity_.store(session::clock::now().time_since_epoch().count(), std::memory_order_relaxed);
+    sh.unlink(s);
+    sh.link_back(s);
+    return it->second;
+}
+
+void session_table::touch(session& s) {
+    shard& sh = shard_for(s.key());
+    std::lock_guard<std::mutex> lock(sh.mutex);
+    s.last_activity_.store(session::clock::now().time_since_epoch().count(), std::memory_order_relaxed);
+
+    // Only relink while the session is still in the table
+    auto it = sh.sessions.find(s.key());
+    if (it != sh.sessions.end() && it->second.get() == &s) {
+        sh.unlink(&s);
+        sh.link_back(&s);
+    }
+}
+
+std::shared_ptr<session> session_table::erase(const std::string& id) {
+    session_key key;
+    if (!session_key::parse(id, key)) {
+        return nullptr;
+    }
+
+    shard& sh = shard_for(key);
+    std::lock_guard<std::mutex> lock(sh.mutex);
+    auto it = sh.sessions.find(key);
+    if (it == sh.sessions.end()) {
+        return nullptr;
+    }
+
+    std::shared_ptr<session> s = std::move(it->second);
+    sh.unlink(s.get());
+    sh.sessions.erase(it);
+    return s;
+}
+
+std::vector<std::shared_ptr<session>> session_table::clear() {
+    std::vector<std::shared_ptr<session>> removed;
+    for (auto& sh : shards_) {
+        std::lock_guard<std::mutex> lock(sh.mutex);
+        for (auto& [key, s] : sh.sessions) {
+            s->lru_prev_ = nullptr;
+            s->lru_next_ = nullptr;
+            removed.push_back(std::move(s));
+        }
+        sh.sessions.clear();
+        sh.lru_head = nullptr;
+        sh.lru_tail = nullptr;
+    }
+    return removed;
+}
+
+std::vector<std::string> session_table::idle_sessions(std::chrono::steady_clock::duration timeout,
+                                                      std::chrono::steady_clock::time_point now) const {
+    std::vector<std::string> idle;
+    for (auto& sh : shards_) {
+        std::lock_guard<std::mutex> lock(sh.mutex);
+        // Stop at the first session that is still active, everything after it is newer
+        for (session* s = sh.lru_head; s && now - s->last_activity() > timeout; s = s->lru_next_) {
+            idle.push_back(s->id());
+        }
+    }
+    return idle;
+}
+
+std::vector<session_stats> session_table::stats() const {
+    std::vector<std::shared_ptr<session>> sessions;
+    for (auto& sh : shards_) {
+        std::lock_guard<std::mutex> lock(sh.mutex);
+        for (const auto& [key, s] : sh.sessions) {
+            sessions.push_back(s);
+        }
+    }
+
+    // Collect outside the shard locks, stats() takes the dispatcher lock
+    std::vector<session_stats> result;
+    result.reserve(sessions.size());
+    for (const auto& s : sessions) {
+        result.push_back(s->stats());
+    }
+    return result;
+}
+
+size_t session_table::size() const {
+    size_t total = 0;
+    for (auto& sh : shards_) {
+        std::lock_guard<std::mutex> lock(sh.mutex);
+        total += sh.sessions.size();
+    }
+    return total;
+}
+
+} // namespace mcp
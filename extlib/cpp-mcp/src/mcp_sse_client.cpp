@@ -11,13 +11,28 @@
 
 namespace mcp {
 
+namespace {
+
+// Sends notifications/cancelled for a request the caller gave up on
+call_table::cancel_sender cancel_sender_for(sse_client* client) {
+    return [client](const json& id, const std::string& reason) {
+        json params = {{"requestId", id}};
+        if (!reason.empty()) {
+            params["reason"] = reason;
+        }
+        client->send_notification("cancelled", params);
+    };
+}
+
+} // namespace
+
 sse_client::sse_client(const std::string& host, int port, const std::string& sse_endpoint)
-    : host_(host), port_(port), sse_endpoint_(sse_endpoint) {
+    : host_(host), port_(port), sse_endpoint_(sse_endpoint), calls_(cancel_sender_for(this)) {
     init_client(host, port);
 }
 
 sse_client::sse_client(const std::string& base_url, const std::string& sse_endpoint)
-    : base_url_(base_url), sse_endpoint_(sse_endpoint) {
+    : base_url_(base_url), sse_endpoint_(sse_endpoint), calls_(cancel_sender_for(this)) {
     init_client(base_url);
 }
 
@@ -26,29 +41,31 @@ sse_client::~sse_client() {
 }
 
 void sse_client::init_client(const std::string& host, int port) {
-    http_client_ = std::make_unique<httplib::Client>(host.c_str(), port);
+    post_pool_ = std::make_shared<http_client_pool>(pool_size_, [this]() { return make_http_client(); });
     sse_client_ = std::make_unique<httplib::Client>(host.c_str(), port);
-
-    http_client_->set_connection_timeout(timeout_seconds_, 0);
-    http_client_->set_read_timeout(timeout_seconds_, 0);
-    http_client_->set_write_timeout(timeout_seconds_, 0);
     
     sse_client_->set_connection_timeout(timeout_seconds_ * 2, 0);
     sse_client_->set_write_timeout(timeout_seconds_, 0);
 }
 
 void sse_client::init_client(const std::string& base_url) {
-    http_client_ = std::make_unique<httplib::Client>(base_url.c_str());
+    post_pool_ = std::make_shared<http_client_pool>(pool_size_, [this]() { return make_http_client(); });
     sse_client_ = std::make_unique<httplib::Client>(base_url.c_str());
-
-    http_client_->set_connection_timeout(timeout_seconds_, 0);
-    http_client_->set_read_timeout(timeout_seconds_, 0);
-    http_client_->set_write_timeout(timeout_seconds_, 0);
     
     sse_client_->set_connection_timeout(timeout_seconds_ * 2, 0);
     sse_client_->set_write_timeout(timeout_seconds_, 0);
 }
 
+std::unique_ptr<httplib::Client> sse_client::make_http_client() const {
+    auto http_client = base_url_.empty() ? std::make_unique<httplib::Client>(host_.c_str(), port_)
+                                         : std::make_unique<httplib::Client>(base_url_.c_str());
+
+    http_client->set_connection_timeout(timeout_seconds_, 0);
+    http_client->set_read_timeout(timeout_seconds_, 0);
+    http_client->set_write_timeout(timeout_seconds_, 0);
+    return http_client;
+}
+
 bool sse_client::initialize(const std::string& client_name, const std::string& client_version) {
     LOG_INFO("Initializing MCP client...");
     
@@ -124,36 +141,36 @@ bool sse_client::ping() {
 }
 
 void sse_client::set_auth_token(const std::string& token) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    auth_token_ = token;
-    set_header("Authorization", "Bearer " + auth_token_);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auth_token_ = token;
+    }
+    set_header("Authorization", "Bearer " + token);
 }
 
 void sse_client::set_header(const std::string& key, const std::string& value) {
+    // Sent with every request from now on, the clients themselves are left alone
+    // as other threads may be using them
     std::lock_guard<std::mutex> lock(mutex_);
     default_headers_[key] = value;
-    
-    if (http_client_) {
-        http_client_->set_default_headers({{key, value}});
-    }
-    if (sse_client_) {
-        sse_client_->set_default_headers({{key, value}});
-    }
 }
 
 void sse_client::set_timeout(int timeout_seconds) {
     std::lock_guard<std::mutex> lock(mutex_);
     timeout_seconds_ = timeout_seconds;
     
-    if (http_client_) {
-        http_client_->set_connection_timeout(timeout_seconds_, 0);
-        http_client_->set_write_timeout(timeout_seconds_, 0);
-    }
+    // Timeouts belong to the httplib clients, so new ones take over. Requests in
+    // flight keep the old pool alive until they finish; the SSE connection picks
+    // up the timeout when it next connects.
+    post_pool_ = std::make_shared<http_client_pool>(pool_size_, [this]() { return make_http_client(); });
+}
+
+void sse_client::set_connection_pool_size(size_t size) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    pool_size_ = size > 0 ? size : 1;
     
-    if (sse_client_) {
-        sse_client_->set_connection_timeout(timeout_seconds_ * 2, 0);
-        sse_client_->set_write_timeout(timeout_seconds_, 0);
-    }
+    // Requests in flight keep the old pool alive until they finish
+    post_pool_ = std::make_shared<http_client_pool>(pool_size_, [this]() { return make_http_client(); });
 }
 
 void sse_client::set_capabilities(const json& capabilities) {
@@ -173,6 +190,15 @@ response sse_client::send_request(const std::string& method, const json& params)
     return res;
 }
 
+pending_call sse_client::send_request_async(const std::string& method, const json& params, const call_options& options) {
+    std::chrono::milliseconds timeout = options.timeout;
+    if (timeout.count() <= 0) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        timeout = std::chrono::seconds(timeout_seconds_);
+    }
+    return send_async(request::create(method, params), timeout);
+}
+
 void sse_client::send_notification(const std::string& method, const json& params) {
     request req = request::create_notification(method, params);
     send_jsonrpc(req);
@@ -211,6 +237,10 @@ std::vector<tool> sse_client::get_tools() {
             t.parameters_schema = tool_json["inputSchema"];
         }
         
+        if (tool_json.contains("annotations")) {
+            t.read_only = tool_json["annotations"].value("readOnlyHint", false);
+        }
+        
         tools.push_back(t);
     }
     
@@ -271,30 +301,26 @@ void sse_client::open_sse_connection() {
             try {
                 LOG_INFO("SSE thread: Attempting to connect to ", sse_endpoint_);
                 
-                std::string buffer;
-                auto res = sse_client_->Get(sse_endpoint_, 
+                // Only this thread uses sse_client_, the settings are copied under the lock
+                httplib::Headers headers;
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    sse_client_->set_connection_timeout(timeout_seconds_ * 2, 0);
+                    sse_client_->set_write_timeout(timeout_seconds_, 0);
+                    for (const auto& [key, value] : default_headers_) {
+                        headers.emplace(key, value);
+                    }
+                }
+                
+                sse_parser parser;
+                auto res = sse_client_->Get(sse_endpoint_, headers,
                     [&,this](const char *data, size_t data_length) {
-                        buffer.append(data, data_length);
-                        
-                        // Normalize CRLF to LF
-                        size_t crlf_pos = buffer.find("\r\n");
-                        while (crlf_pos != std::string::npos) {
-                            buffer.replace(crlf_pos, 2, "\n");
-                            crlf_pos = buffer.find("\r\n", crlf_pos + 1);
-                        }
-                        
-                        // Process complete events in buffer
-                        size_t start_pos = 0;
-                        while ((start_pos = buffer.find("\n\n", start_pos)) != std::string::npos) {
-                            size_t end_pos = start_pos + 2;
-                            std::string event = buffer.substr(0, start_pos);
-                            buffer.erase(0, end_pos);
-                            start_pos = 0;
-                            
-                            if (!parse_sse_data(event.data(), event.size())) {
+                        parser.feed(data, data_length);
+                        parser.consume([this](const sse_event& event) {
+                            if (!handle_sse_event(event)) {
                                 LOG_ERROR("SSE thread: Failed to parse event");
                             }
-                        }
+                        });
                         
                         return sse_running_.load();
                     });
@@ -339,72 +365,23 @@ void sse_client::open_sse_connection() {
     });
 }
 
-bool sse_client::parse_sse_data(const char* data, size_t length) {
+bool sse_client::handle_sse_event(const sse_event& event) {
     try {
-        // Split into lines and process event fields
-        std::istringstream stream(std::string(data, length));
-        std::string line;
-        std::string event_type = "message";
-        std::vector<std::string> data_lines;
-        
-        while (std::getline(stream, line)) {
-            // Trim trailing CR if present
-            if (!line.empty() && line.back() == '\r') {
-                line.pop_back();
-            }
-            
-            if (line.substr(0, 7) == "event: ") {
-                event_type = line.substr(7);
-            } else if (line.substr(0, 6) == "data: ") {
-                data_lines.push_back(line.substr(6));
-            } else if (line.empty()) {
-                break; // End of event
-            }
-        }
-        
-        if (data_lines.empty()) {
+        if (event.type == "heartbeat") {
             return true;
-        }
-        
-        // Join data lines with newlines
-        std::string data_content;
-        for (size_t i = 0; i < data_lines.size(); ++i) {
-            if (i > 0) data_content += '\n';
-            data_content += data_lines[i];
-        }
-        
-        if (event_type == "heartbeat") {
-            return true;
-        } else if (event_type == "endpoint") {
+        } else if (event.type == "endpoint") {
             std::lock_guard<std::mutex> lock(mutex_);
-            msg_endpoint_ = data_content;
+            msg_endpoint_.assign(event.data.data(), event.data.size());
             endpoint_cv_.notify_all();
             return true;
-        } else if (event_type == "message") {
+        } else if (event.type == "message") {
             try {
-                json response = json::parse(data_content);
+                // Parsed straight from the stream buffer
+                json response = json::parse(event.data.begin(), event.data.end());
                 
                 if (response.contains("jsonrpc") && response.contains("id") && !response["id"].is_null()) {
-                    json id = response["id"];
-                    
-                    std::lock_guard<std::mutex> lock(response_mutex_);
-                    auto it = pending_requests_.find(id);
-                    if (it != pending_requests_.end()) {
-                        if (response.contains("result")) {
-                            it->second.set_value(response["result"]);
-                        } else if (response.contains("error")) {
-                            json error_result = {
-                                {"isError", true},
-                                {"error", response["error"]}
-                            };
-                            it->second.set_value(error_result);
-                        } else {
-                            it->second.set_value(json::object());
-                        }
-                        
-                        pending_requests_.erase(it);
-                    } else {
-                        LOG_WARNING("Received response for unknown request ID: ", id);
+                    if (!calls_.complete(response)) {
+                        LOG_WARNING("Received response for unknown request ID: ", response["id"]);
                     }
                 } else {
                     LOG_WARNING("Received invalid JSON-RPC response: ", response.dump());
@@ -414,7 +391,7 @@ bool sse_client::parse_sse_data(const char* data, size_t length) {
             }
             return true;
         } else {
-            LOG_WARNING("Received unknown event type: ", event_type);
+            LOG_WARNING("Received unknown event type: ", std::string(event.type));
             return true;
         }
     } catch (const std::exception& e) {
@@ -464,121 +441,88 @@ void sse_client::close_sse_connection() {
         msg_endpoint_.clear();
         endpoint_cv_.notify_all();
     }
+
+    // Responses can no longer arrive
+    calls_.fail_all(error_code::internal_error, "SSE connection closed");
     
     LOG_INFO("SSE connection successfully closed (normal exit flow)");
 }
 
-json sse_client::send_jsonrpc(const request& req) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    
-    if (msg_endpoint_.empty()) {
-        throw mcp_exception(error_code::internal_error, "Message endpoint not set, SSE connection may not be established");
-    }
-    
-    json req_json = req.to_json();
-    std::string req_body = req_json.dump();
-    
+httplib::Result sse_client::post_message(const std::string& body) {
+    std::string endpoint;
     httplib::Headers headers;
-    headers.emplace("Content-Type", "application/json");
-    
-    for (const auto& [key, value] : default_headers_) {
-        headers.emplace(key, value);
-    }
-    
-    if (req.is_notification()) {
-        auto result = http_client_->Post(msg_endpoint_, headers, req_body, "application/json");
+    std::shared_ptr<http_client_pool> pool;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
         
-        if (!result) {
-            auto err = result.error();
-            std::string error_msg = httplib::to_string(err);
-            LOG_ERROR("JSON-RPC request failed: ", error_msg);
-            throw mcp_exception(error_code::internal_error, error_msg);
+        if (msg_endpoint_.empty()) {
+            throw mcp_exception(error_code::internal_error, "Message endpoint not set, SSE connection may not be established");
         }
+        endpoint = msg_endpoint_;
+        pool = post_pool_;
         
-        return json::object();
-    }
-    
-    std::promise<json> response_promise;
-    std::future<json> response_future = response_promise.get_future();
-    
-    {
-        std::lock_guard<std::mutex> response_lock(response_mutex_);
-        pending_requests_[req.id] = std::move(response_promise);
+        headers.emplace("Content-Type", "application/json");
+        for (const auto& [key, value] : default_headers_) {
+            headers.emplace(key, value);
+        }
     }
     
-    auto result = http_client_->Post(msg_endpoint_, headers, req_body, "application/json");
+    // Concurrent callers spread over the pool's keep-alive connections
+    auto result = pool->acquire()->Post(endpoint, headers, body, "application/json");
     
     if (!result) {
-        auto err = result.error();
-        std::string error_msg = httplib::to_string(err);
-        
-        {
-            std::lock_guard<std::mutex> response_lock(response_mutex_);
-            pending_requests_.erase(req.id);
-        }
-        
+        std::string error_msg = httplib::to_string(result.error());
         LOG_ERROR("JSON-RPC request failed: ", error_msg);
         throw mcp_exception(error_code::internal_error, error_msg);
     }
+    return result;
+}
+
+pending_call sse_client::send_async(const request& req, std::chrono::milliseconds timeout) {
+    // Register before posting, the response can arrive on the SSE stream before the POST returns
+    pending_call call = calls_.add(req.id, timeout);
+    
+    httplib::Result result;
+    try {
+        result = post_message(req.to_json().dump());
+    } catch (const mcp_exception& e) {
+        calls_.fail(req.id, e.code(), e.what());
+        return call;
+    }
     
+    // A non-2xx status carries the answer in the body instead of the SSE stream
     if (result->status / 100 != 2) {
         try {
             json res_json = json::parse(result->body);
             
-            {
-                std::lock_guard<std::mutex> response_lock(response_mutex_);
-                pending_requests_.erase(req.id);
-            }
-            
             if (res_json.contains("error")) {
                 int code = res_json["error"]["code"];
                 std::string message = res_json["error"]["message"];
-                
-                throw mcp_exception(static_cast<error_code>(code), message);
-            }
-            
-            if (res_json.contains("result")) {
-                return res_json["result"];
+                calls_.fail(req.id, static_cast<error_code>(code), message);
+            } else if (res_json.contains("result")) {
+                calls_.resolve(req.id, res_json["result"]);
             } else {
-                return json::object();
+                calls_.resolve(req.id, json::object());
             }
         } catch (const json::exception& e) {
-            {
-                std::lock_guard<std::mutex> response_lock(response_mutex_);
-                pending_requests_.erase(req.id);
-            }
-            
-            throw mcp_exception(error_code::parse_error, 
-                            "Failed to parse JSON-RPC response: " + std::string(e.what()));
-        }
-    } else {
-        const auto timeout = std::chrono::seconds(timeout_seconds_);
-        
-        auto status = response_future.wait_for(timeout);
-        
-        if (status == std::future_status::ready) {
-            json response = response_future.get();
-            
-            if (response.contains("isError") && response["isError"].is_boolean() && response["isError"].get<bool>()) {
-                if (response.contains("error") && response["error"].is_object()) {
-                    const auto& err_obj = response["error"];
-                    int code = err_obj.contains("code") ? err_obj["code"].get<int>() : static_cast<int>(error_code::internal_error);
-                    std::string message = err_obj.value("message", "");
-                    // Handle error
-                    throw mcp_exception(static_cast<error_code>(code), message);
-                }
-            }
-            
-            return response;
-        } else {
-            {
-                std::lock_guard<std::mutex> response_lock(response_mutex_);
-                pending_requests_.erase(req.id);
-            }
-            
-            throw mcp_exception(error_code::internal_error, "Timeout waiting for SSE response");
+            calls_.fail(req.id, error_code::parse_error, "Failed to parse JSON-RPC response: " + std::string(e.what()));
         }
     }
+    return call;
+}
+
+json sse_client::send_jsonrpc(const request& req) {
+    if (req.is_notification()) {
+        post_message(req.to_json().dump());
+        return json::object();
+    }
+    
+    std::chrono::seconds timeout;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        timeout = std::chrono::seconds(timeout_seconds_);
+    }
+    return send_async(req, timeout).get();
 }
 
 bool sse_client::is_running() const {
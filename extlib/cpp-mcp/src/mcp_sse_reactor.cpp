@@ -0,0 +1,546 @@
+/**
+ * @file mcp_sse_reactor.cpp
+ * @brief Implementation of the event-loop SSE transport
+ */
+
+#include "mcp_sse_reactor.h"
+#include "mcp_server.h"
+
+#if defined(__linux__)
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace mcp {
+
+namespace {
+
+// Upper bound for the request head of an SSE connection
+constexpr size_t max_request_head = 8192;
+
+// Epoll user data of the wakeup eventfd
+constexpr uint64_t wake_id = 0;
+
+const char sse_response_head[] =
+    "HTTP/1.1 200 OK\r\n"
+    "Content-Type: text/event-stream\r\n"
+    "Cache-Control: no-cache\r\n"
+    "Connection: keep-alive\r\n"
+    "Access-Control-Allow-Origin: *\r\n"
+    "Transfer-Encoding: chunked\r\n"
+    "\r\n";
+
+const char bad_request_response[] =
+    "HTTP/1.1 400 Bad Request\r\n"
+    "Content-Length: 0\r\n"
+    "Connection: close\r\n"
+    "\r\n";
+
+const char chunk_trailer[] = "\r\n";
+const char last_chunk[] = "0\r\n\r\n";
+
+// Maximum buffers passed to one sendmsg call
+constexpr size_t max_iov = 64;
+
+} // namespace
+
+struct sse_reactor::connection {
+    uint64_t id = 0;
+    socket_t fd = INVALID_SOCKET;
+    bool established = false;   // Response head sent, session opened
+    bool want_write = false;    // EPOLLOUT registered
+    bool closing = false;       // Terminating chunk queued
+    bool chunk_pending = false; // A batch of frames is still being written
+    std::string request_head;
+
+    // Bytes still to be sent; segments point into static strings, chunk_head or frames
+    struct segment {
+        const char* data;
+        size_t size;
+    };
+    std::vector<segment> out;
+    size_t out_index = 0;       // First segment not fully sent
+    size_t out_offset = 0;      // Bytes of that segment already sent
+    std::vector<sse_frame> frames;  // Frames referenced by out
+    char chunk_head[24];
+    std::string session_id;
+    std::shared_ptr<event_dispatcher> dispatcher;
+    std::function<void()> touch;
+    timer_wheel::timer_id heartbeat = 0;
+    uint64_t heartbeat_count = 0;
+};
+
+sse_reactor::sse_reactor(open_handler on_open, close_handler on_close, std::chrono::milliseconds heartbeat_interval)
+    : on_open_(std::move(on_open)), on_close_(std::move(on_close)), heartbeat_interval_(heartbeat_interval) {
+}
+
+sse_reactor::~sse_reactor() {
+    stop();
+#if defined(__linux__)
+    // Closed only here: notify() and adopt() may still be waking the loop during stop()
+    int fd = wake_fd_.exchange(-1);
+    if (fd >= 0) {
+        close(fd);
+    }
+#endif
+}
+
+#if defined(__linux__)
+
+bool sse_reactor::is_supported() {
+    return true;
+}
+
+bool sse_reactor::start() {
+    if (running_) {
+        return true;
+    }
+
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd_ < 0) {
+        LOG_ERROR("Failed to create epoll instance: ", strerror(errno));
+        return false;
+    }
+
+    // Kept across stop() and start(), the destructor closes it
+    if (wake_fd_.load() < 0) {
+        int fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (fd < 0) {
+            LOG_ERROR("Failed to create eventfd: ", strerror(errno));
+            close(epoll_fd_);
+            epoll_fd_ = -1;
+            return false;
+        }
+        wake_fd_.store(fd);
+    }
+
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.u64 = wake_id;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wake_fd_.load(), &ev);
+
+    running_ = true;
+    thread_ = std::make_unique<std::thread>([this]() { run(); });
+    LOG_INFO("SSE event loop started");
+    return true;
+}
+
+void sse_reactor::stop() {
+    if (!running_.exchange(false)) {
+        return;
+    }
+
+    wake();
+    if (thread_ && thread_->joinable()) {
+        thread_->join();
+    }
+    thread_.reset();
+
+    // Sockets handed over after the loop exited
+    {
+        std::lock_guard<std::mutex> lock(pending_mutex_);
+        for (socket_t sock : adopted_) {
+            httplib::detail::close_socket(sock);
+        }
+        adopted_.clear();
+        ready_.clear();
+    }
+
+    close(epoll_fd_);
+    epoll_fd_ = -1;
+    LOG_INFO("SSE event loop stopped");
+}
+
+void sse_reactor::adopt(socket_t sock) {
+    {
+        std::lock_guard<std::mutex> lock(pending_mutex_);
+        if (!running_) {
+            httplib::detail::close_socket(sock);
+            return;
+        }
+        adopted_.push_back(sock);
+    }
+    wake();
+}
+
+void sse_reactor::notify(uint64_t conn_id) {
+    {
+        std::lock_guard<std::mutex> lock(pending_mutex_);
+        ready_.push_back(conn_id);
+    }
+    wake();
+}
+
+void sse_reactor::wake() {
+    uint64_t one = 1;
+    int fd = wake_fd_.load(std::memory_order_acquire);
+    if (fd >= 0) {
+        ssize_t ignored = write(fd, &one, sizeof(one));
+        (void)ignored;
+    }
+}
+
+void sse_reactor::run() {
+    std::vector<epoll_event> events(256);
+
+    while (running_) {
+        int timeout = static_cast<int>(timers_.next_timeout().count());
+        int n = epoll_wait(epoll_fd_, events.data(), static_cast<int>(events.size()), timeout);
+        if (n < 0 && errno != EINTR) {
+            LOG_ERROR("epoll_wait failed: ", strerror(errno));
+            break;
+        }
+
+        for (int i = 0; i < n; ++i) {
+            if (events[i].data.u64 == wake_id) {
+                uint64_t value;
+                while (read(wake_fd_.load(), &value, sizeof(value)) > 0) {}
+                continue;
+            }
+            handle_events(events[i].data.u64, events[i].events);
+        }
+
+        accept_pending();
+
+        std::vector<uint64_t> ready;
+        {
+            std::lock_guard<std::mutex> lock(pending_mutex_);
+            ready.swap(ready_);
+        }
+        for (uint64_t conn_id : ready) {
+            auto it = connections_.find(conn_id);
+            if (it != connections_.end()) {
+                flush_session(*it->second);
+            }
+        }
+
+        timers_.advance();
+    }
+
+    // Close everything still held by the loop
+    std::vector<uint64_t> ids;
+    ids.reserve(connections_.size());
+    for (const auto& [id, _] : connections_) {
+        ids.push_back(id);
+    }
+    for (uint64_t id : ids) {
+        close_connection(id);
+    }
+}
+
+void sse_reactor::accept_pending() {
+    std::vector<socket_t> adopted;
+    {
+        std::lock_guard<std::mutex> lock(pending_mutex_);
+        adopted.swap(adopted_);
+    }
+
+    for (socket_t sock : adopted) {
+        int flags = fcntl(sock, F_GETFL, 0);
+        fcntl(sock, F_SETFL, flags | O_NONBLOCK);
+
+        const uint64_t conn_id = next_conn_id_++;
+        auto conn = std::make_unique<connection>();
+        conn->id = conn_id;
+        conn->fd = sock;
+
+        epoll_event ev{};
+        ev.events = EPOLLIN | EPOLLRDHUP;
+        ev.data.u64 = conn_id;
+        if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, sock, &ev) < 0) {
+            LOG_ERROR("Failed to register SSE socket: ", strerror(errno));
+            httplib::detail::close_socket(sock);
+            continue;
+        }
+
+        connection& ref = *conn;
+        connections_.emplace(conn_id, std::move(conn));
+        connection_count_.store(connections_.size(), std::memory_order_relaxed);
+
+        // The request is usually already buffered, it was peeked before handover
+        handle_readable(ref);
+    }
+}
+
+void sse_reactor::handle_events(uint64_t conn_id, uint32_t events) {
+    auto it = connections_.find(conn_id);
+    if (it == connections_.end()) {
+        return;
+    }
+    connection& conn = *it->second;
+
+    if (events & (EPOLLERR | EPOLLHUP | EPOLLRDHUP)) {
+        close_connection(conn_id);
+        return;
+    }
+
+    if (events & EPOLLIN) {
+        handle_readable(conn);
+        if (connections_.find(conn_id) == connections_.end()) {
+            return;
+        }
+    }
+
+    if (events & EPOLLOUT) {
+        if (!write_pending(conn)) {
+            close_connection(conn_id);
+            return;
+        }
+        // Socket drained, pick up frames queued in the meantime
+        if (conn.out.empty()) {
+            flush_session(conn);
+        }
+    }
+}
+
+void sse_reactor::handle_readable(connection& conn) {
+    const uint64_t conn_id = conn.id;
+    char buf[4096];
+
+    while (true) {
+        ssize_t n = recv(conn.fd, buf, sizeof(buf), 0);
+        if (n > 0) {
+            if (conn.established) {
+                continue; // Nothing is expected from the client after the request
+            }
+            conn.request_head.append(buf, static_cast<size_t>(n));
+            if (conn.request_head.size() > max_request_head) {
+                close_connection(conn.id);
+                return;
+            }
+            continue;
+        }
+        if (n == 0) {
+            close_connection(conn.id);
+            return;
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            break;
+        }
+        close_connection(conn.id);
+        return;
+    }
+
+    if (!conn.established && conn.request_head.find("\r\n\r\n") != std::string::npos) {
+        if (!open_session(conn)) {
+            close_connection(conn_id);
+        }
+    }
+}
+
+bool sse_reactor::open_session(connection& conn) {
+    // The handover already matched "GET <sse endpoint>", only the line itself is checked here
+    size_t line_end = conn.request_head.find("\r\n");
+    if (conn.request_head.compare(0, 4, "GET ") != 0 ||
+        conn.request_head.rfind(" HTTP/1.", line_end) == std::string::npos) {
+        conn.out.push_back({bad_request_response, sizeof(bad_request_response) - 1});
+        write_pending(conn);
+        return false;
+    }
+    conn.request_head.clear();
+    conn.request_head.shrink_to_fit();
+
+    uint64_t conn_id = conn.id;
+    session_handle handle;
+    try {
+        handle = on_open_([this, conn_id]() { notify(conn_id); });
+    } catch (const std::exception& e) {
+        LOG_ERROR("Failed to open SSE session: ", e.what());
+        return false;
+    }
+    if (!handle.dispatcher) {
+        return false;
+    }
+
+    conn.session_id = std::move(handle.session_id);
+    conn.dispatcher = std::move(handle.dispatcher);
+    conn.touch = std::move(handle.touch);
+    conn.established = true;
+    conn.out.push_back({sse_response_head, sizeof(sse_response_head) - 1});
+    LOG_INFO("SSE session opened on event loop: ", conn.session_id);
+
+    // Stagger heartbeats so sessions opened together do not fire together
+    auto jitter = std::chrono::milliseconds(static_cast<int64_t>((conn_id * 97) % 500));
+    schedule_heartbeat(conn_id, heartbeat_interval_ + jitter);
+
+    flush_session(conn);
+    return connections_.find(conn_id) != connections_.end();
+}
+
+void sse_reactor::flush_session(connection& conn) {
+    if (!conn.established) {
+        return;
+    }
+
+    // Only pull more frames once the socket has taken the previous batch,
+    // so a slow client pushes back on the session queue instead of this buffer
+    if (!conn.chunk_pending) {
+        // Wrap the queued frames into one HTTP chunk without copying them
+        conn.dispatcher->drain(conn.frames);
+        if (!conn.frames.empty()) {
+            size_t total = 0;
+            for (const auto& f : conn.frames) {
+                total += f->size();
+            }
+            int n = snprintf(conn.chunk_head, sizeof(conn.chunk_head), "%zx\r\n", total);
+            conn.out.push_back({conn.chunk_head, static_cast<size_t>(n)});
+            for (const auto& f : conn.frames) {
+                conn.out.push_back({f->data(), f->size()});
+            }
+            conn.out.push_back({chunk_trailer, sizeof(chunk_trailer) - 1});
+            conn.chunk_pending = true;
+            if (conn.touch) {
+                conn.touch();
+            }
+        }
+
+        if (conn.dispatcher->is_closed() && !conn.closing) {
+            conn.closing = true;
+            conn.out.push_back({last_chunk, sizeof(last_chunk) - 1});
+        }
+    }
+
+    if (!write_pending(conn) || (conn.closing && conn.out.empty())) {
+        close_connection(conn.id);
+    }
+}
+
+bool sse_reactor::write_pending(connection& conn) {
+    while (conn.out_index < conn.out.size()) {
+        iovec iov[max_iov];
+        size_t count = 0;
+        for (size_t i = conn.out_index; i < conn.out.size() && count < max_iov; ++i, ++count) {
+            size_t skip = i == conn.out_index ? conn.out_offset : 0;
+            iov[count].iov_base = const_cast<char*>(conn.out[i].data + skip);
+            iov[count].iov_len = conn.out[i].size - skip;
+        }
+
+        msghdr msg{};
+        msg.msg_iov = iov;
+        msg.msg_iovlen = count;
+        ssize_t n = sendmsg(conn.fd, &msg, MSG_NOSIGNAL);
+        if (n > 0) {
+            // Advance over the segments the kernel took
+            size_t sent = static_cast<size_t>(n);
+            while (sent > 0) {
+                size_t left = conn.out[conn.out_index].size - conn.out_offset;
+                if (sent < left) {
+                    conn.out_offset += sent;
+                    break;
+                }
+                sent -= left;
+                ++conn.out_index;
+                conn.out_offset = 0;
+            }
+            continue;
+        }
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            if (!conn.want_write) {
+                epoll_event ev{};
+                ev.events = EPOLLIN | EPOLLRDHUP | EPOLLOUT;
+                ev.data.u64 = conn.id;
+                epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, conn.fd, &ev);
+                conn.want_write = true;
+            }
+            return true;
+        }
+        return false;
+    }
+
+    // Everything sent, the frames go back to the pool
+    conn.out.clear();
+    conn.out_index = 0;
+    conn.out_offset = 0;
+    conn.frames.clear();
+    conn.chunk_pending = false;
+    if (conn.want_write) {
+        epoll_event ev{};
+        ev.events = EPOLLIN | EPOLLRDHUP;
+        ev.data.u64 = conn.id;
+        epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, conn.fd, &ev);
+        conn.want_write = false;
+    }
+    return true;
+}
+
+void sse_reactor::schedule_heartbeat(uint64_t conn_id, std::chrono::milliseconds delay) {
+    auto it = connections_.find(conn_id);
+    if (it == connections_.end()) {
+        return;
+    }
+
+    it->second->heartbeat = timers_.schedule(delay, [this, conn_id]() {
+        auto it = connections_.find(conn_id);
+        if (it == connections_.end()) {
+            return;
+        }
+        connection& conn = *it->second;
+        conn.heartbeat = 0;
+
+        sse_frame heartbeat = make_sse_frame("heartbeat", std::to_string(conn.heartbeat_count++));
+        if (conn.dispatcher->send_event(heartbeat, event_kind::heartbeat) && conn.touch) {
+            conn.touch();
+        }
+        schedule_heartbeat(conn_id, heartbeat_interval_);
+    });
+}
+
+void sse_reactor::close_connection(uint64_t conn_id) {
+    auto it = connections_.find(conn_id);
+    if (it == connections_.end()) {
+        return;
+    }
+
+    std::unique_ptr<connection> conn = std::move(it->second);
+    connections_.erase(it);
+    connection_count_.store(connections_.size(), std::memory_order_relaxed);
+
+    if (conn->heartbeat) {
+        timers_.cancel(conn->heartbeat);
+    }
+
+    epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, conn->fd, nullptr);
+    httplib::detail::shutdown_socket(conn->fd);
+    httplib::detail::close_socket(conn->fd);
+
+    if (conn->established) {
+        conn->dispatcher->close();
+        try {
+            on_close_(conn->session_id);
+        } catch (const std::exception& e) {
+            LOG_WARNING("Exception while closing SSE session: ", conn->session_id, ", ", e.what());
+        }
+    }
+}
+
+#else
+
+bool sse_reactor::is_supported() {
+    return false;
+}
+
+bool sse_reactor::start() {
+    LOG_WARNING("SSE event loop is not supported on this platform");
+    return false;
+}
+
+void sse_reactor::stop() {
+}
+
+void sse_reactor::adopt(socket_t sock) {
+    httplib::detail::close_socket(sock);
+}
+
+#endif
+
+} // namespace mcp
@@ -17,7 +17,11 @@
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <fcntl.h>
+#include <poll.h>
 #include <signal.h>
+#if defined(__linux__)
+#include <sys/eventfd.h>
+#endif
 #endif
 
 #include <cstring>
@@ -27,8 +31,72 @@
 
 namespace mcp {
 
+#if !defined(_WIN32)
+namespace {
+
+void close_fd(int& fd) {
+    if (fd != -1) {
+        close(fd);
+        fd = -1;
+    }
+}
+
+bool open_cloexec_pipe(int fds[2]) {
+    if (pipe(fds) == -1) {
+        return false;
+    }
+    fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+    fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+    return true;
+}
+
+bool open_wake(int fds[2]) {
+#if defined(__linux__)
+    fds[0] = fds[1] = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    return fds[0] != -1;
+#else
+    if (!open_cloexec_pipe(fds)) {
+        return false;
+    }
+    fcntl(fds[1], F_SETFL, fcntl(fds[1], F_GETFL, 0) | O_NONBLOCK);
+    return true;
+#endif
+}
+
+void signal_wake(const int fds[2]) {
+    if (fds[1] == -1) {
+        return;
+    }
+#if defined(__linux__)
+    uint64_t one = 1;
+    ssize_t ignored = write(fds[1], &one, sizeof(one));
+#else
+    char one = 1;
+    ssize_t ignored = write(fds[1], &one, sizeof(one));
+#endif
+    (void)ignored;
+}
+
+void close_wake(int fds[2]) {
+    if (fds[1] != fds[0]) {
+        close_fd(fds[1]);
+    }
+    fds[1] = -1;
+    close_fd(fds[0]);
+}
+
+} // namespace
+#endif
+
 stdio_client::stdio_client(const std::string& command, const json& env_vars, const json& capabilities)
-    : command_(command), capabilities_(capabilities), env_vars_(env_vars) {
+    : command_(command), capabilities_(capabilities), env_vars_(env_vars),
+      calls_([this](const json& id, const std::string& reason) {
+          json params = {{"requestId", id}};
+          if (!reason.empty()) {
+              params["reason"] = reason;
+          }
+          write_message(request::create_notification("cancelled", params).to_json().dump() + "\n");
+      }) {
     
     LOG_INFO("Creating MCP stdio client for command: ", command);
 }
@@ -109,6 +177,14 @@ response stdio_client::send_request(const std::string& method, const json& param
     return res;
 }
 
+pending_call stdio_client::send_request_async(const std::string& method, const json& params, const call_options& options) {
+    if (!running_) {
+        throw mcp_exception(error_code::internal_error, "Server process not running");
+    }
+    
+    return send_async(request::create(method, params), options.timeout.count() > 0 ? options.timeout : std::chrono::seconds(60));
+}
+
 void stdio_client::send_notification(const std::string& method, const json& params) {
     if (!running_) {
         throw mcp_exception(error_code::internal_error, "Server process not running");
@@ -151,6 +227,10 @@ std::vector<tool> stdio_client::get_tools() {
             t.parameters_schema = tool_json["inputSchema"];
         }
         
+        if (tool_json.contains("annotations")) {
+            t.read_only = tool_json["annotations"].value("readOnlyHint", false);
+        }
+        
         tools.push_back(t);
     }
     
@@ -197,6 +277,14 @@ void stdio_client::set_environment_variables(const json& env_vars) {
     env_vars_ = env_vars;
 }
 
+void stdio_client::set_max_line_length(size_t max_length) {
+    if (running_) {
+        LOG_WARNING("Cannot set the line length limit while server is running");
+        return;
+    }
+    max_line_length_ = max_length;
+}
+
 bool stdio_client::start_server_process() {
     if (running_) {
         LOG_INFO("Server process already running");
@@ -329,16 +417,52 @@ bool stdio_client::start_server_process() {
     
 #else
     // POSIX implementation
-    // Create pipes
-    if (pipe(stdin_pipe_) == -1) {
+    // Build the argument vector before forking, the child only execs
+    std::vector<std::string> args;
+    std::istringstream iss(command_);
+    std::string arg;
+    while (iss >> arg) {
+        args.push_back(arg);
+    }
+    if (args.empty()) {
+        LOG_ERROR("Empty server command");
+        return false;
+    }
+    std::vector<char*> c_args;
+    for (auto& a : args) {
+        c_args.push_back(const_cast<char*>(a.c_str()));
+    }
+    c_args.push_back(nullptr);
+
+    std::vector<std::string> env_entries;
+    for (const auto& [key, value] : env_vars_.items()) {
+        env_entries.push_back(key + "=" + convert_to_string(value));
+    }
+
+    // Create pipes, close-on-exec so other children never hold our ends open
+    // (dup2 clears the flag on the child's stdin and stdout)
+    if (!open_cloexec_pipe(stdin_pipe_)) {
         LOG_ERROR("Failed to create stdin pipe: ", strerror(errno));
         return false;
     }
     
-    if (pipe(stdout_pipe_) == -1) {
+    if (!open_cloexec_pipe(stdout_pipe_)) {
         LOG_ERROR("Failed to create stdout pipe: ", strerror(errno));
-        close(stdin_pipe_[0]);
-        close(stdin_pipe_[1]);
+        close_fd(stdin_pipe_[0]);
+        close_fd(stdin_pipe_[1]);
+        return false;
+    }
+
+    // The child reports a failed exec through this pipe; a successful exec closes it
+    int exec_pipe[2] = {-1, -1};
+    if (!open_cloexec_pipe(exec_pipe) || !open_wake(wake_fd_)) {
+        LOG_ERROR("Failed to create pipe: ", strerror(errno));
+        close_fd(exec_pipe[0]);
+        close_fd(exec_pipe[1]);
+        close_fd(stdin_pipe_[0]);
+        close_fd(stdin_pipe_[1]);
+        close_fd(stdout_pipe_[0]);
+        close_fd(stdout_pipe_[1]);
         return false;
     }
     
@@ -347,120 +471,77 @@ bool stdio_client::start_server_process() {
     
     if (process_id_ == -1) {
         LOG_ERROR("Failed to fork process: ", strerror(errno));
-        close(stdin_pipe_[0]);
-        close(stdin_pipe_[1]);
-        close(stdout_pipe_[0]);
-        close(stdout_pipe_[1]);
+        close_fd(exec_pipe[0]);
+        close_fd(exec_pipe[1]);
+        close_fd(stdin_pipe_[0]);
+        close_fd(stdin_pipe_[1]);
+        close_fd(stdout_pipe_[0]);
+        close_fd(stdout_pipe_[1]);
+        close_wake(wake_fd_);
         return false;
     }
     
     if (process_id_ == 0) {
         // Child process
-        
-        // Set environment variables
-        if (!env_vars_.empty()) {
-            for (const auto& [key, value] : env_vars_.items()) {
-                std::string env_var = key + "=" + convert_to_string(value);
-                if (putenv(const_cast<char*>(env_var.c_str())) != 0) {
-                    LOG_ERROR("Failed to set environment variable: ", key);
-                }
-            }
+        for (auto& entry : env_entries) {
+            putenv(const_cast<char*>(entry.c_str()));
         }
         
-        // Close unnecessary pipe ends
-        close(stdin_pipe_[1]);  // Close write end
-        close(stdout_pipe_[0]); // Close read end
-        
         // Redirect standard input/output
-        if (dup2(stdin_pipe_[0], STDIN_FILENO) == -1) {
-            LOG_ERROR("Failed to redirect stdin: ", strerror(errno));
-            exit(EXIT_FAILURE);
-        }
-        
-        if (dup2(stdout_pipe_[1], STDOUT_FILENO) == -1) {
-            LOG_ERROR("Failed to redirect stdout: ", strerror(errno));
-            exit(EXIT_FAILURE);
+        if (dup2(stdin_pipe_[0], STDIN_FILENO) == -1 || dup2(stdout_pipe_[1], STDOUT_FILENO) == -1) {
+            int error = errno;
+            ssize_t ignored = write(exec_pipe[1], &error, sizeof(error));
+            (void)ignored;
+            _exit(127);
         }
         
-        // Close already redirected file descriptors
-        close(stdin_pipe_[0]);
-        close(stdout_pipe_[1]);
-        
-        // Set non-blocking mode
-        // int flags = fcntl(STDIN_FILENO, F_GETFL, 0);
-        // fcntl(STDIN_FILENO, F_SETFL, flags | O_NONBLOCK);
-        
-        // Execute command
-        std::vector<std::string> args;
-        std::istringstream iss(command_);
-        std::string arg;
-        
-        while (iss >> arg) {
-            args.push_back(arg);
-        }
-        
-        std::vector<char*> c_args;
-        for (auto& a : args) {
-            c_args.push_back(const_cast<char*>(a.c_str()));
-        }
-        c_args.push_back(nullptr);
-        
         execvp(c_args[0], c_args.data());
         
         // If execvp returns, it means an error occurred
-        LOG_ERROR("Failed to execute command: ", strerror(errno));
-        exit(EXIT_FAILURE);
+        int error = errno;
+        ssize_t ignored = write(exec_pipe[1], &error, sizeof(error));
+        (void)ignored;
+        _exit(127);
     }
     
     // Parent process
     
     // Close unnecessary pipe ends
-    close(stdin_pipe_[0]);  // Close read end
-    close(stdout_pipe_[1]); // Close write end
+    close_fd(stdin_pipe_[0]);  // Close read end
+    close_fd(stdout_pipe_[1]); // Close write end
+    close_fd(exec_pipe[1]);
+
+    // Blocks until the child has exec'd (end of file) or failed (an errno)
+    int exec_error = 0;
+    ssize_t exec_read;
+    do {
+        exec_read = read(exec_pipe[0], &exec_error, sizeof(exec_error));
+    } while (exec_read == -1 && errno == EINTR);
+    close_fd(exec_pipe[0]);
+
+    if (exec_read > 0) {
+        LOG_ERROR("Failed to execute command: ", strerror(exec_error));
+        int status;
+        waitpid(process_id_, &status, 0);
+        process_id_ = -1;
+        close_fd(stdin_pipe_[1]);
+        close_fd(stdout_pipe_[0]);
+        close_wake(wake_fd_);
+        return false;
+    }
     
-    // Set non-blocking mode
+    // Non-blocking so the read thread can drain everything poll reports
     int flags = fcntl(stdout_pipe_[0], F_GETFL, 0);
     fcntl(stdout_pipe_[0], F_SETFL, flags | O_NONBLOCK);
-    
-    // Check if process is still running
-    int status;
-    pid_t result = waitpid(process_id_, &status, WNOHANG);
-    
-    if (result == process_id_) {
-        LOG_ERROR("Server process exited immediately with status: ", WEXITSTATUS(status));
-        running_ = false;
-        
-        if (read_thread_ && read_thread_->joinable()) {
-            read_thread_->join();
-        }
-        
-        close(stdin_pipe_[1]);
-        close(stdout_pipe_[0]);
-        
-        return false;
-    } else if (result == -1) {
-        LOG_ERROR("Failed to check process status: ", strerror(errno));
-        running_ = false;
-        
-        if (read_thread_ && read_thread_->joinable()) {
-            read_thread_->join();
-        }
-        
-        close(stdin_pipe_[1]);
-        close(stdout_pipe_[0]);
-        
-        return false;
-    }
 #endif
     
+    connected_ = true;
     running_ = true;
     
-    // Start read thread
+    // Start read thread. The initialize exchange that follows is the readiness check:
+    // if the server exits instead of answering, the read thread fails the request.
     read_thread_ = std::make_unique<std::thread>(&stdio_client::read_thread_func, this);
     
-    // Wait for a while to ensure process starts
-    std::this_thread::sleep_for(std::chrono::milliseconds(500));
-    
 #if defined(_WIN32)
     // Check if process is still running
     DWORD exit_code;
@@ -533,122 +614,107 @@ void stdio_client::stop_server_process() {
     }
 #else
     // POSIX implementation
-    // Close pipes
-    if (stdin_pipe_[1] != -1) {
-        close(stdin_pipe_[1]);
-        stdin_pipe_[1] = -1;
-    }
-    
-    if (stdout_pipe_[0] != -1) {
-        close(stdout_pipe_[0]);
-        stdout_pipe_[0] = -1;
-    }
-    
-    // Wait for read thread to finish
+    // Wake the read thread, then close pipes once it has stopped using them
+    signal_wake(wake_fd_);
     if (read_thread_ && read_thread_->joinable()) {
         read_thread_->join();
     }
+    close_wake(wake_fd_);
+
+    {
+        std::lock_guard<std::mutex> lock(write_mutex_);
+        close_fd(stdin_pipe_[1]);
+    }
+    close_fd(stdout_pipe_[0]);
     
     // Terminate process
     if (process_id_ > 0) {
         LOG_INFO("Sending SIGTERM to process: ", process_id_);
         kill(process_id_, SIGTERM);
         
-        // Wait for process to finish
+        // Give it up to two seconds to exit
         int status;
         pid_t result = waitpid(process_id_, &status, WNOHANG);
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+        while (result == 0 && std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            result = waitpid(process_id_, &status, WNOHANG);
+        }
         
         if (result == 0) {
-            // Process is still running, wait for a while
-            std::this_thread::sleep_for(std::chrono::seconds(2));
-            
-            result = waitpid(process_id_, &status, WNOHANG);
-            
-            if (result == 0) {
-                // Process is still running, force termination
-                LOG_WARNING("Process did not terminate, sending SIGKILL");
-                kill(process_id_, SIGKILL);
-                waitpid(process_id_, &status, 0);
-            }
+            // Process is still running, force termination
+            LOG_WARNING("Process did not terminate, sending SIGKILL");
+            kill(process_id_, SIGKILL);
+            waitpid(process_id_, &status, 0);
         }
         
         process_id_ = -1;
     }
 #endif
+
+    calls_.fail_all(error_code::internal_error, "Server process stopped");
     
     LOG_INFO("Server process stopped");
 }
 
+void stdio_client::handle_line(const char* data, size_t length) {
+    try {
+        json message = json::parse(data, data + length);
+        
+        if (message.contains("jsonrpc") && message["jsonrpc"] == "2.0") {
+            if (message.contains("id") && !message["id"].is_null()) {
+                // This is a response
+                if (!calls_.complete(message)) {
+                    LOG_WARNING("Received response for unknown request ID: ", message["id"]);
+                }
+            } else if (message.contains("method")) {
+                // This is a request or notification
+                LOG_INFO("Received request/notification: ", message["method"]);
+                // Currently not handling requests from the server
+            }
+        }
+    } catch (const json::exception&) {
+        LOG_INFO("message: ", std::string(data, length));
+    }
+}
+
 void stdio_client::read_thread_func() {
     LOG_INFO("Read thread started");
     
-    const int buffer_size = 4096;
-    char buffer[buffer_size];
-    std::string data_buffer;
+    const size_t read_size = 64 * 1024;
+    line_buffer lines;
+    auto on_line = [this](const char* data, size_t length) {
+        handle_line(data, length);
+    };
+    
+    // Dispatch the complete lines, false once the unfinished one is over the limit
+    std::string failure = "Server process exited";
+    auto consume = [&]() {
+        lines.consume_lines(on_line);
+        if (lines.pending() > max_line_length_) {
+            LOG_ERROR("Server sent a line longer than ", max_line_length_, " bytes, closing the connection");
+            failure = "Server sent a line that is too long";
+            return false;
+        }
+        return true;
+    };
     
 #if defined(_WIN32)
     // Windows implementation
     DWORD bytes_read;
     int retry_count = 0;
     
-    // Give the process some startup time (similar to UNIX implementation)
-    std::this_thread::sleep_for(std::chrono::milliseconds(100));
-    
     while (running_) {
         // Read data
-        BOOL success = ReadFile(stdout_pipe_[0], buffer, buffer_size - 1, &bytes_read, NULL);
+        char* buffer = lines.prepare(read_size);
+        BOOL success = ReadFile(stdout_pipe_[0], buffer, static_cast<DWORD>(read_size), &bytes_read, NULL);
         
         if (success && bytes_read > 0) {
             // Successfully read data
             retry_count = 0;  // Reset retry count
-            buffer[bytes_read] = '\0';
-            data_buffer.append(buffer, bytes_read);
-            
-            // Process complete JSON-RPC message
-            size_t pos = 0;
-            while ((pos = data_buffer.find('\n')) != std::string::npos) {
-                std::string line = data_buffer.substr(0, pos);
-                data_buffer.erase(0, pos + 1);
-                
-                if (!line.empty()) {
-                    try {
-                        json message = json::parse(line);
-                        
-                        if (message.contains("jsonrpc") && message["jsonrpc"] == "2.0") {
-                            if (message.contains("id") && !message["id"].is_null()) {
-                                // This is a response
-                                json id = message["id"];
-                                
-                                std::lock_guard<std::mutex> lock(response_mutex_);
-                                auto it = pending_requests_.find(id);
-                                
-                                if (it != pending_requests_.end()) {
-                                    if (message.contains("result")) {
-                                        it->second.set_value(message["result"]);
-                                    } else if (message.contains("error")) {
-                                        json error_result = {
-                                            {"isError", true},
-                                            {"error", message["error"]}
-                                        };
-                                        it->second.set_value(error_result);
-                                    } else {
-                                        it->second.set_value(json::object());
-                                    }
-                                    
-                                    pending_requests_.erase(it);
-                                } else {
-                                    LOG_WARNING("Received response for unknown request ID: ", id);
-                                }
-                            } else if (message.contains("method")) {
-                                // This is a request or notification
-                                LOG_INFO("Received request/notification: ", message["method"]);
-                                // Currently not handling requests from the server
-                            }
-                        }
-                    } catch (const json::exception& e) {
-                        LOG_INFO("message: ", line);
-                    }
-                }
+            lines.commit(bytes_read);
+            if (!consume()) {
+                break;
             }
         } else if (!success) {
             DWORD error = GetLastError();
@@ -673,7 +739,7 @@ void stdio_client::read_thread_func() {
             } else if (error == ERROR_NO_DATA) {
                 // Simulate UNIX's EAGAIN/EWOULDBLOCK behavior
                 // The pipe is temporarily empty - this is normal for non-blocking mode
-                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
             } else if (error != ERROR_IO_PENDING) {
                 // Other errors, log and retry
                 LOG_ERROR("Error reading from pipe: ", error);
@@ -687,11 +753,11 @@ void stdio_client::read_thread_func() {
                 std::this_thread::sleep_for(std::chrono::milliseconds(20 * retry_count));
             } else {
                 // IO_PENDING is the normal state for asynchronous IO
-                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
             }
         } else {
             // ReadFile successfully but no data - similar to reading 0 bytes but not EOF on UNIX
-            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
         }
         
         // Periodically check if the process is still running (similar to UNIX's waitpid check)
@@ -705,146 +771,117 @@ void stdio_client::read_thread_func() {
     }
 #else
     // POSIX implementation
-    while (running_) {
-        // Read data
-        ssize_t bytes_read = read(stdout_pipe_[0], buffer, buffer_size - 1);
-        
-        if (bytes_read > 0) {
-            buffer[bytes_read] = '\0';
-            data_buffer.append(buffer, bytes_read);
-            
-            // Process complete JSON-RPC message
-            size_t pos = 0;
-            while ((pos = data_buffer.find('\n')) != std::string::npos) {
-                std::string line = data_buffer.substr(0, pos);
-                data_buffer.erase(0, pos + 1);
-                
-                if (!line.empty()) {
-                    try {
-                        json message = json::parse(line);
-                        
-                        if (message.contains("jsonrpc") && message["jsonrpc"] == "2.0") {
-                            if (message.contains("id") && !message["id"].is_null()) {
-                                // This is a response
-                                json id = message["id"];
-                                
-                                std::lock_guard<std::mutex> lock(response_mutex_);
-                                auto it = pending_requests_.find(id);
-                                
-                                if (it != pending_requests_.end()) {
-                                    if (message.contains("result")) {
-                                        it->second.set_value(message["result"]);
-                                    } else if (message.contains("error")) {
-                                        json error_result = {
-                                            {"isError", true},
-                                            {"error", message["error"]}
-                                        };
-                                        it->second.set_value(error_result);
-                                    } else {
-                                        it->second.set_value(json::object());
-                                    }
-                                    
-                                    pending_requests_.erase(it);
-                                } else {
-                                    LOG_WARNING("Received response for unknown request ID: ", id);
-                                }
-                            } else if (message.contains("method")) {
-                                // This is a request or notification
-                                LOG_INFO("Received request/notification: ", message["method"]);
-                                // Currently not handling requests from the server
-                            }
-                        }
-                    } catch (const json::exception& e) {
-                        LOG_INFO("message: ", line);
-                    }
-                }
+    // Sleeps in poll until the server writes, closes its output or stop wakes us
+    pollfd fds[2];
+    fds[0].fd = stdout_pipe_[0];
+    fds[0].events = POLLIN;
+    fds[1].fd = wake_fd_[0];
+    fds[1].events = POLLIN;
+
+    bool open = true;
+    while (open) {
+        fds[0].revents = 0;
+        fds[1].revents = 0;
+        if (poll(fds, 2, -1) == -1) {
+            if (errno == EINTR) {
+                continue;
             }
-        } else if (bytes_read == 0) {
-            // Pipe is closed
-            LOG_WARNING("Pipe closed by server");
+            LOG_ERROR("Error polling pipe: ", strerror(errno));
             break;
-        } else if (bytes_read == -1) {
-            if (errno == EAGAIN || errno == EWOULDBLOCK) {
-                // No data to read in non-blocking mode
-                std::this_thread::sleep_for(std::chrono::milliseconds(10));
-            } else {
+        }
+        if (fds[1].revents != 0) {
+            break;
+        }
+        if (fds[0].revents == 0) {
+            continue;
+        }
+
+        // Drain what is available, dispatching the complete lines after each read
+        while (true) {
+            ssize_t bytes_read = read(stdout_pipe_[0], lines.prepare(read_size), read_size);
+            if (bytes_read > 0) {
+                lines.commit(static_cast<size_t>(bytes_read));
+                if (!consume()) {
+                    open = false;
+                    break;
+                }
+                continue;
+            }
+            if (bytes_read == 0) {
+                LOG_WARNING("Pipe closed by server");
+                open = false;
+            } else if (errno == EINTR) {
+                continue;
+            } else if (errno != EAGAIN && errno != EWOULDBLOCK) {
                 LOG_ERROR("Error reading from pipe: ", strerror(errno));
-                break;
+                open = false;
             }
+            break;
         }
     }
 #endif
+
+    connected_ = false;
+    calls_.fail_all(error_code::internal_error, failure);
     
     LOG_INFO("Read thread stopped");
 }
 
-json stdio_client::send_jsonrpc(const request& req) {
-    if (!running_) {
-        throw mcp_exception(error_code::internal_error, "Server process not running");
-    }
-    
-    json req_json = req.to_json();
-    std::string req_str = req_json.dump() + "\n";
-    
+bool stdio_client::write_message(const std::string& message) {
+    std::lock_guard<std::mutex> lock(write_mutex_);
 #if defined(_WIN32)
     // Windows implementation
     DWORD bytes_written;
-    BOOL success = WriteFile(stdin_pipe_[1], req_str.c_str(), static_cast<DWORD>(req_str.size()), &bytes_written, NULL);
+    BOOL success = stdin_pipe_[1] != NULL &&
+        WriteFile(stdin_pipe_[1], message.c_str(), static_cast<DWORD>(message.size()), &bytes_written, NULL);
     
-    if (!success || bytes_written != static_cast<DWORD>(req_str.size())) {
+    if (!success || bytes_written != static_cast<DWORD>(message.size())) {
         LOG_ERROR("Failed to write complete request: ", GetLastError());
-        throw mcp_exception(error_code::internal_error, "Failed to write to pipe");
+        return false;
     }
 #else
     // POSIX implementation
-    ssize_t bytes_written = write(stdin_pipe_[1], req_str.c_str(), req_str.size());
-    
-    if (bytes_written != static_cast<ssize_t>(req_str.size())) {
-        LOG_ERROR("Failed to write complete request: ", strerror(errno));
-        throw mcp_exception(error_code::internal_error, "Failed to write to pipe");
+    size_t offset = 0;
+    while (offset < message.size()) {
+        ssize_t bytes_written = stdin_pipe_[1] == -1 ? -1 : write(stdin_pipe_[1], message.data() + offset, message.size() - offset);
+        if (bytes_written > 0) {
+            offset += static_cast<size_t>(bytes_written);
+        } else if (bytes_written == -1 && errno == EINTR) {
+            continue;
+        } else {
+            LOG_ERROR("Failed to write complete request: ", strerror(errno));
+            return false;
+        }
     }
 #endif
+    return true;
+}
+
+pending_call stdio_client::send_async(const request& req, std::chrono::milliseconds timeout) {
+    // Register before writing, the response can arrive before write() returns
+    pending_call call = calls_.add(req.id, timeout);
+    if (!connected_) {
+        calls_.fail(req.id, error_code::internal_error, "Server process not running");
+    } else if (!write_message(req.to_json().dump() + "\n")) {
+        calls_.fail(req.id, error_code::internal_error, "Failed to write to pipe");
+    }
+    return call;
+}
+
+json stdio_client::send_jsonrpc(const request& req) {
+    if (!running_) {
+        throw mcp_exception(error_code::internal_error, "Server process not running");
+    }
     
     // If this is a notification, no need to wait for a response
     if (req.is_notification()) {
+        if (!write_message(req.to_json().dump() + "\n")) {
+            throw mcp_exception(error_code::internal_error, "Failed to write to pipe");
+        }
         return json::object();
     }
     
-    // Create Promise and Future
-    std::promise<json> response_promise;
-    std::future<json> response_future = response_promise.get_future();
-    
-    {
-        std::lock_guard<std::mutex> lock(response_mutex_);
-        pending_requests_[req.id] = std::move(response_promise);
-    }
-    
-    // Wait for response, set timeout
-    const auto timeout = std::chrono::seconds(60);
-    auto status = response_future.wait_for(timeout);
-    
-    if (status == std::future_status::ready) {
-        json response = response_future.get();
-        
-        if (response.contains("isError") && response["isError"].is_boolean() && response["isError"].get<bool>()) {
-            if (response.contains("error") && response["error"].is_object()) {
-                const auto& err_obj = response["error"];
-                int code = err_obj.contains("code") ? err_obj["code"].get<int>() : static_cast<int>(error_code::internal_error);
-                std::string message = err_obj.value("message", "");
-                // Handle error
-                throw mcp_exception(static_cast<error_code>(code), message);
-            }
-        }
-        
-        return response;
-    } else {
-        {
-            std::lock_guard<std::mutex> lock(response_mutex_);
-            pending_requests_.erase(req.id);
-        }
-        
-        throw mcp_exception(error_code::internal_error, "Timeout waiting for response");
-    }
+    return send_async(req, std::chrono::seconds(60)).get();
 }
 
-} // namespace mcp 
+} // namespace mcp
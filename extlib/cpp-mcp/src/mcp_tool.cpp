@@ -22,6 +22,11 @@ tool_builder& tool_builder::with_description(const std::string& description) {
     return *this;
 }
 
+tool_builder& tool_builder::with_read_only(bool read_only) {
+    read_only_ = read_only;
+    return *this;
+}
+
 tool_builder& tool_builder::add_param(const std::string& name, 
                                      const std::string& description, 
                                      const std::string& type, 
@@ -102,6 +107,7 @@ tool tool_builder::build() const {
     tool t;
     t.name = name_;
     t.description = description_;
+    t.read_only = read_only_;
     
     // Create the parameters schema
     json schema = parameters_;
@@ -7,11 +7,17 @@
 
 #include <gtest/gtest.h>
 #include <gmock/gmock.h>
+#include <fstream>
+#include <random>
+#include <set>
 #include "mcp_message.h"
 #include "mcp_client.h"
 #include "mcp_server.h"
 #include "mcp_tool.h"
 #include "mcp_sse_client.h"
+#include "mcp_stdio_client.h"
+#include "mcp_timer_wheel.h"
+#include "mcp_random.h"
 
 using namespace mcp;
 using json = nlohmann::ordered_json;
@@ -93,6 +99,560 @@ TEST_F(MessageFormatTest, NotificationMessageFormat) {
     EXPECT_TRUE(notification.is_notification());
 }
 
+// Test session event queue
+class EventDispatcherTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        // Collect everything written to the sink
+        sink_.write = [this](const char* data, size_t len) {
+            writes_.emplace_back(data, len);
+            return true;
+        };
+    }
+
+    httplib::DataSink sink_;
+    std::vector<std::string> writes_;
+};
+
+// Test that events queued before the consumer waits are all delivered in one write
+TEST_F(EventDispatcherTest, DrainsAllPendingEventsInOneWrite) {
+    event_dispatcher dispatcher;
+    
+    EXPECT_TRUE(dispatcher.send_event("event: heartbeat\r\ndata: 0\r\n\r\n", event_kind::heartbeat));
+    EXPECT_TRUE(dispatcher.send_event("event: message\r\ndata: {\"id\":1}\r\n\r\n"));
+    EXPECT_TRUE(dispatcher.send_event("event: message\r\ndata: {\"id\":2}\r\n\r\n"));
+    EXPECT_EQ(dispatcher.pending(), 3);
+    
+    EXPECT_TRUE(dispatcher.wait_event(&sink_, std::chrono::milliseconds(100)));
+    ASSERT_EQ(writes_.size(), 1);
+    EXPECT_EQ(writes_[0],
+        "event: heartbeat\r\ndata: 0\r\n\r\n"
+        "event: message\r\ndata: {\"id\":1}\r\n\r\n"
+        "event: message\r\ndata: {\"id\":2}\r\n\r\n");
+    EXPECT_EQ(dispatcher.pending(), 0);
+}
+
+// Test that heartbeats are dropped before messages when the queue is full
+TEST_F(EventDispatcherTest, DropsHeartbeatsWhenFull) {
+    event_queue_options options;
+    options.capacity = 2;
+    options.policy = backpressure_policy::drop_heartbeats;
+    options.block_timeout = std::chrono::milliseconds(10);
+    event_dispatcher dispatcher(options);
+    
+    EXPECT_TRUE(dispatcher.send_event("heartbeat", event_kind::heartbeat));
+    EXPECT_TRUE(dispatcher.send_event("message 1"));
+    
+    // An incoming heartbeat is dropped
+    EXPECT_FALSE(dispatcher.send_event("heartbeat", event_kind::heartbeat));
+    
+    // A message evicts the queued heartbeat
+    EXPECT_TRUE(dispatcher.send_event("message 2"));
+    
+    // Nothing left to evict, so the producer times out
+    EXPECT_FALSE(dispatcher.send_event("message 3"));
+    EXPECT_FALSE(dispatcher.is_closed());
+    EXPECT_EQ(dispatcher.dropped(), 3);
+    
+    EXPECT_TRUE(dispatcher.wait_event(&sink_, std::chrono::milliseconds(100)));
+    ASSERT_EQ(writes_.size(), 1);
+    EXPECT_EQ(writes_[0], "message 1message 2");
+}
+
+// Test that a blocked producer resumes once the consumer drains the queue
+TEST_F(EventDispatcherTest, BlocksUntilDrained) {
+    event_queue_options options;
+    options.capacity = 1;
+    options.policy = backpressure_policy::block;
+    options.block_timeout = std::chrono::seconds(5);
+    event_dispatcher dispatcher(options);
+    
+    EXPECT_TRUE(dispatcher.send_event("message 1"));
+    
+    auto producer = std::async(std::launch::async, [&dispatcher]() {
+        return dispatcher.send_event("message 2");
+    });
+    
+    EXPECT_TRUE(dispatcher.wait_event(&sink_, std::chrono::milliseconds(100)));
+    EXPECT_TRUE(producer.get());
+    EXPECT_TRUE(dispatcher.wait_event(&sink_, std::chrono::milliseconds(100)));
+    
+    ASSERT_EQ(writes_.size(), 2);
+    EXPECT_EQ(writes_[0], "message 1");
+    EXPECT_EQ(writes_[1], "message 2");
+}
+
+// Test that the close_session policy closes the session when the queue is full
+TEST_F(EventDispatcherTest, ClosesSessionWhenFull) {
+    event_queue_options options;
+    options.capacity = 1;
+    options.policy = backpressure_policy::close_session;
+    event_dispatcher dispatcher(options);
+    
+    EXPECT_TRUE(dispatcher.send_event("message 1"));
+    EXPECT_FALSE(dispatcher.send_event("message 2"));
+    EXPECT_TRUE(dispatcher.is_closed());
+    EXPECT_FALSE(dispatcher.wait_event(&sink_, std::chrono::milliseconds(100)));
+}
+
+// A burst of large frames leaves no more than the pool's byte budget behind
+TEST_F(EventDispatcherTest, BoundsPooledFrameBytes) {
+    json payload = {{"text", std::string(1024 * 1024, 'x')}};
+    std::vector<sse_frame> burst;
+    for (int i = 0; i < 16; ++i) {
+        burst.push_back(make_sse_frame("message", payload, payload["text"].get_ref<const std::string&>().size()));
+    }
+    burst.clear();
+    EXPECT_LE(frame_pool::instance().pooled_bytes(), frame_pool::max_pooled_bytes);
+
+    // Too large to keep at all
+    make_sse_frame("message", std::string(frame_pool::max_pooled_bytes + 1, 'x'));
+    EXPECT_LE(frame_pool::instance().pooled_bytes(), frame_pool::max_pooled_bytes);
+}
+
+// Test that pooled frames match the string form and are delivered as queued
+TEST_F(EventDispatcherTest, SendsPooledFrames) {
+    json payload = {{"jsonrpc", "2.0"}, {"id", 7}, {"result", {{"text", std::string(4096, 'x')}}}};
+
+    sse_frame frame = make_sse_frame("message", payload);
+    EXPECT_EQ(*frame, "event: message\r\ndata: " + payload.dump() + "\r\n\r\n");
+    EXPECT_EQ(*make_sse_frame("endpoint", std::string("/message?session_id=1")),
+              "event: endpoint\r\ndata: /message?session_id=1\r\n\r\n");
+
+    // A released frame buffer is handed out again
+    frame.reset();
+    uint64_t reused = frame_pool::instance().reused();
+    frame = make_sse_frame("message", payload);
+    EXPECT_GT(frame_pool::instance().reused(), reused);
+
+    event_dispatcher dispatcher;
+    EXPECT_TRUE(dispatcher.send_event(frame));
+    EXPECT_TRUE(dispatcher.send_event(make_sse_frame("heartbeat", std::string("1")), event_kind::heartbeat));
+    EXPECT_TRUE(dispatcher.wait_event(&sink_, std::chrono::milliseconds(100)));
+    ASSERT_EQ(writes_.size(), 1);
+    EXPECT_EQ(writes_[0], *frame + "event: heartbeat\r\ndata: 1\r\n\r\n");
+}
+
+// Test timer wheel scheduling and cancellation
+TEST(TimerWheelTest, FiresInOrderAndCancels) {
+    timer_wheel wheel(std::chrono::milliseconds(10), 8);
+    std::vector<int> fired;
+    
+    wheel.schedule(std::chrono::milliseconds(30), [&]() { fired.push_back(2); });
+    wheel.schedule(std::chrono::milliseconds(10), [&]() { fired.push_back(1); });
+    auto cancelled = wheel.schedule(std::chrono::milliseconds(20), [&]() { fired.push_back(0); });
+    // Longer than one revolution of the wheel
+    wheel.schedule(std::chrono::milliseconds(150), [&]() { fired.push_back(3); });
+    
+    EXPECT_EQ(wheel.size(), 4);
+    EXPECT_TRUE(wheel.cancel(cancelled));
+    EXPECT_FALSE(wheel.cancel(cancelled));
+    
+    auto now = timer_wheel::clock::now();
+    wheel.advance(now + std::chrono::milliseconds(50));
+    EXPECT_EQ(fired, std::vector<int>({1, 2}));
+    
+    wheel.advance(now + std::chrono::milliseconds(200));
+    EXPECT_EQ(fired, std::vector<int>({1, 2, 3}));
+    EXPECT_EQ(wheel.size(), 0);
+}
+
+// Test that far timers cascade down the levels and fire on time
+TEST(TimerWheelTest, CascadesFarTimers) {
+    // Innermost level covers 80 ms, the next 640 ms, the outermost 5.12 s
+    timer_wheel wheel(std::chrono::milliseconds(10), 8, 3);
+    std::vector<int> fired;
+    
+    wheel.schedule(std::chrono::milliseconds(500), [&]() { fired.push_back(500); });
+    wheel.schedule(std::chrono::milliseconds(90), [&]() { fired.push_back(90); });
+    wheel.schedule(std::chrono::milliseconds(3000), [&]() { fired.push_back(3000); });
+    // Beyond the outermost level
+    wheel.schedule(std::chrono::milliseconds(12000), [&]() { fired.push_back(12000); });
+    auto cancelled = wheel.schedule(std::chrono::milliseconds(700), [&]() { fired.push_back(700); });
+    EXPECT_TRUE(wheel.cancel(cancelled));
+    
+    auto now = timer_wheel::clock::now();
+    wheel.advance(now + std::chrono::milliseconds(480));
+    EXPECT_EQ(fired, std::vector<int>({90}));
+    wheel.advance(now + std::chrono::milliseconds(520));
+    EXPECT_EQ(fired, std::vector<int>({90, 500}));
+    wheel.advance(now + std::chrono::milliseconds(2980));
+    EXPECT_EQ(fired.size(), 2);
+    wheel.advance(now + std::chrono::milliseconds(3020));
+    EXPECT_EQ(fired, std::vector<int>({90, 500, 3000}));
+    wheel.advance(now + std::chrono::milliseconds(11980));
+    EXPECT_EQ(fired.size(), 3);
+    wheel.advance(now + std::chrono::milliseconds(12020));
+    EXPECT_EQ(fired, std::vector<int>({90, 500, 3000, 12000}));
+    EXPECT_EQ(wheel.size(), 0);
+    
+    // The service thread fires callbacks that reschedule themselves, and stops without waiting for timers
+    timer_service service;
+    service.start();
+    std::promise<void> done;
+    std::atomic<int> beats{0};
+    std::function<void()> beat = [&]() {
+        if (++beats == 3) {
+            done.set_value();
+        } else {
+            service.schedule(std::chrono::milliseconds(20), beat);
+        }
+    };
+    service.schedule(std::chrono::milliseconds(20), beat);
+    service.schedule(std::chrono::hours(1), []() {});
+    EXPECT_EQ(done.get_future().wait_for(std::chrono::seconds(2)), std::future_status::ready);
+    
+    auto stop_start = std::chrono::steady_clock::now();
+    service.stop();
+    EXPECT_LT(std::chrono::steady_clock::now() - stop_start, std::chrono::milliseconds(100));
+    EXPECT_EQ(service.size(), 0);
+}
+
+// Test tasks submitted from workers and from many producers all run
+TEST(ThreadPoolTest, RunsNestedAndExternalTasks) {
+    std::atomic<int> counter{0};
+    {
+        thread_pool pool(4);
+
+        // Each task fans out onto the submitting worker's own deque
+        std::vector<std::future<void>> parents;
+        for (int i = 0; i < 10; ++i) {
+            parents.push_back(pool.enqueue([&pool, &counter]() {
+                for (int j = 0; j < 100; ++j) {
+                    pool.post([&counter]() { counter.fetch_add(1); });
+                }
+            }));
+        }
+        for (auto& f : parents) {
+            f.get();
+        }
+
+        std::vector<std::thread> producers;
+        for (int p = 0; p < 8; ++p) {
+            producers.emplace_back([&pool, &counter]() {
+                for (int j = 0; j < 100; ++j) {
+                    pool.post([&counter]() { counter.fetch_add(1); });
+                }
+            });
+        }
+        for (auto& t : producers) {
+            t.join();
+        }
+
+        EXPECT_EQ(pool.enqueue([](int a, int b) { return a + b; }, 2, 3).get(), 5);
+
+        // Destruction drains everything already submitted
+    }
+    EXPECT_EQ(counter.load(), 1800);
+}
+
+// Test lanes are served by priority and sessions take turns within a lane
+TEST(RequestSchedulerTest, PrioritizesLanesAndRotatesSessions) {
+    EXPECT_EQ(request_scheduler::classify("ping"), request_lane::control);
+    EXPECT_EQ(request_scheduler::classify("notifications/initialized"), request_lane::control);
+    EXPECT_EQ(request_scheduler::classify("tools/list"), request_lane::metadata);
+    EXPECT_EQ(request_scheduler::classify("tools/call"), request_lane::heavy);
+
+    thread_pool pool(1);
+    request_scheduler scheduler(pool);
+
+    // Hold the only worker while the queue fills up
+    std::promise<void> release;
+    std::shared_future<void> gate = release.get_future().share();
+    scheduler.submit(request_lane::control, "gate", [gate]() { gate.wait(); });
+    while (scheduler.stats(request_lane::control).running == 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    std::mutex order_mutex;
+    std::vector<std::string> order;
+    auto record = [&](const std::string& name) {
+        return [&order_mutex, &order, name]() {
+            std::lock_guard<std::mutex> lock(order_mutex);
+            order.push_back(name);
+        };
+    };
+
+    scheduler.submit(request_lane::heavy, "a", record("heavy-a1"));
+    scheduler.submit(request_lane::metadata, "a", record("list-a1"));
+    scheduler.submit(request_lane::metadata, "a", record("list-a2"));
+    scheduler.submit(request_lane::metadata, "a", record("list-a3"));
+    scheduler.submit(request_lane::metadata, "b", record("list-b1"));
+    scheduler.submit(request_lane::control, "b", record("ping-b1"));
+
+    lane_stats metadata = scheduler.stats(request_lane::metadata);
+    EXPECT_EQ(metadata.queued, 4);
+    EXPECT_EQ(metadata.sessions, 2);
+
+    release.set_value();
+    while (scheduler.stats(request_lane::heavy).completed < 1) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    EXPECT_EQ(order, std::vector<std::string>({"ping-b1", "list-a1", "list-b1", "list-a2", "list-a3", "heavy-a1"}));
+
+    metadata = scheduler.stats(request_lane::metadata);
+    EXPECT_EQ(metadata.queued, 0);
+    EXPECT_EQ(metadata.completed, 4);
+    EXPECT_GT(metadata.wait_max.count(), 0);
+    EXPECT_LE(metadata.wait_p50, metadata.wait_p99);
+}
+
+// Test readers see consistent tool snapshots while tools are registered
+TEST(RegistryTest, ReadsWhileRegistering) {
+    server srv("localhost", 8090);
+    std::atomic<bool> done{false};
+    std::atomic<bool> consistent{true};
+
+    std::thread reader([&]() {
+        size_t last = 0;
+        while (!done.load()) {
+            std::vector<tool> tools = srv.get_tools();
+            if (tools.size() < last) {
+                consistent = false;
+            }
+            for (size_t i = 1; i < tools.size(); ++i) {
+                if (!(tools[i - 1].name < tools[i].name)) {
+                    consistent = false;
+                }
+            }
+            last = tools.size();
+        }
+    });
+
+    for (int i = 0; i < 200; ++i) {
+        char name[16];
+        std::snprintf(name, sizeof(name), "tool_%03d", 199 - i);
+        srv.register_tool(tool_builder(name).with_description("Test").build(),
+                          [](const json&, const std::string&) -> json { return json::array(); });
+    }
+    done = true;
+    reader.join();
+
+    EXPECT_TRUE(consistent.load());
+    std::vector<tool> tools = srv.get_tools();
+    ASSERT_EQ(tools.size(), 200);
+    EXPECT_EQ(tools.front().name, "tool_000");
+    EXPECT_EQ(tools.back().name, "tool_199");
+}
+
+// Test session ids, lookups and idle expiry order
+TEST(SessionTableTest, ResolvesAndExpiresSessions) {
+    session_key key;
+    EXPECT_TRUE(session_key::parse("0123abcd-4567-89ef-0123-456789abcdef", key));
+    EXPECT_EQ(key.hi, 0x0123abcd456789efULL);
+    EXPECT_EQ(key.lo, 0x0123456789abcdefULL);
+    EXPECT_FALSE(session_key::parse("0123abcd-4567-89ef-0123-456789abcde", key));
+    EXPECT_FALSE(session_key::parse("0123abcd-4567-89ef-0123-456789abcdeg", key));
+    EXPECT_FALSE(session_key::parse("0123abcd04567-89ef-0123-456789abcdef", key));
+
+    session_table table(4);
+    const std::string a = "00000000-0000-0000-0000-00000000000a";
+    const std::string b = "00000000-0000-0000-0000-00000000000b";
+    auto sa = table.insert(a, std::make_shared<event_dispatcher>());
+    auto sb = table.insert(b, std::make_shared<event_dispatcher>());
+    ASSERT_TRUE(sa && sb);
+    EXPECT_FALSE(table.insert(a, std::make_shared<event_dispatcher>()));
+    EXPECT_FALSE(table.insert("not-a-session", std::make_shared<event_dispatcher>()));
+    EXPECT_EQ(table.size(), 2);
+
+    EXPECT_EQ(table.find(a), sa);
+    EXPECT_EQ(table.find("00000000-0000-0000-0000-00000000000c"), nullptr);
+
+    sa->set_initialized(true);
+    sa->count_message(false);
+    sa->count_message(true);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    EXPECT_EQ(table.touch(a), sa);
+    EXPECT_EQ(table.idle_sessions(std::chrono::milliseconds(25)), std::vector<std::string>({b}));
+
+    auto later = std::chrono::steady_clock::now() + std::chrono::hours(2);
+    EXPECT_EQ(table.idle_sessions(std::chrono::hours(1), later).size(), 2);
+
+    std::vector<session_stats> stats = table.stats();
+    ASSERT_EQ(stats.size(), 2);
+    for (const auto& s : stats) {
+        if (s.session_id == a) {
+            EXPECT_TRUE(s.initialized);
+            EXPECT_EQ(s.requests, 1);
+            EXPECT_EQ(s.notifications, 1);
+        }
+    }
+
+    EXPECT_EQ(table.erase(b), sb);
+    EXPECT_EQ(table.erase(b), nullptr);
+    EXPECT_EQ(table.clear().size(), 1);
+    EXPECT_EQ(table.size(), 0);
+}
+
+// Test the ChaCha20 generator and generated session ids
+TEST(SessionIdTest, GeneratesDistinctWellFormedIds) {
+    // RFC 7539 section 2.3.2: key 00..1f, block counter 1, nonce 000000090000004a00000000
+    chacha20_rng::key_type key;
+    for (uint32_t i = 0; i < 8; ++i) {
+        key[i] = (4 * i) | ((4 * i + 1) << 8) | ((4 * i + 2) << 16) | ((4 * i + 3) << 24);
+    }
+    chacha20_rng rng(key, 0x4a000000, (0x09000000ULL << 32) | 1);
+    unsigned char block[16];
+    rng.fill(block, sizeof(block));
+    const unsigned char expected[16] = {0x10, 0xf1, 0xe7, 0xe4, 0xd1, 0x3b, 0x59, 0x15,
+                                        0x50, 0x0f, 0xdd, 0x1f, 0xa3, 0x20, 0x71, 0xc4};
+    EXPECT_EQ(std::memcmp(block, expected, sizeof(block)), 0);
+
+    session_key fixed{0x0123abcd456789efULL, 0x0123456789abcdefULL};
+    EXPECT_EQ(fixed.to_string(), "0123abcd-4567-89ef-0123-456789abcdef");
+
+    std::set<std::string> ids;
+    for (int i = 0; i < 10000; ++i) {
+        session_key generated = session_key::generate();
+        std::string id = generated.to_string();
+        session_key parsed;
+        ASSERT_TRUE(session_key::parse(id, parsed));
+        EXPECT_TRUE(parsed == generated);
+        ids.insert(id);
+    }
+    EXPECT_EQ(ids.size(), 10000);
+
+    session_table table(4);
+    auto sess = table.insert_new(std::make_shared<event_dispatcher>());
+    ASSERT_TRUE(sess);
+    EXPECT_EQ(table.find(sess->id()), sess);
+}
+
+// Test scanning a request envelope and streaming the tool arguments
+TEST(EnvelopeTest, ScansEnvelopeAndStreamsArguments) {
+    request_envelope env = request_envelope::scan(
+        R"({"params": {"name": "set_range", "arguments": {"values": [[1, "}]"], [2, "\"x\""]]}},)"
+        R"( "jsonrpc": "2.0", "id": 42, "method": "tools\/call"})");
+    EXPECT_TRUE(env.is_valid());
+    EXPECT_FALSE(env.is_notification());
+    EXPECT_EQ(env.id, 42);
+    EXPECT_EQ(env.method, "tools/call");
+    EXPECT_EQ(env.parse_params()["arguments"]["values"][1][1], "\"x\"");
+
+    // Pull the arguments out of the params without parsing the rest
+    std::string_view raw_arguments;
+    EXPECT_TRUE(scan_json_object(env.params, [&](std::string_view key, std::string_view value) {
+        if (key == "\"arguments\"") {
+            raw_arguments = value;
+        }
+    }));
+    EXPECT_EQ(raw_arguments, R"({"values": [[1, "}]"], [2, "\"x\""]]})");
+
+    // Count the cells with a SAX handler, no DOM is built
+    struct cell_counter : nlohmann::json_sax<json> {
+        int cells = 0;
+        bool null() override { return true; }
+        bool boolean(bool) override { return true; }
+        bool number_integer(number_integer_t) override { ++cells; return true; }
+        bool number_unsigned(number_unsigned_t) override { ++cells; return true; }
+        bool number_float(number_float_t, const string_t&) override { ++cells; return true; }
+        bool string(string_t&) override { ++cells; return true; }
+        bool binary(binary_t&) override { return true; }
+        bool start_object(std::size_t) override { return true; }
+        bool key(string_t&) override { return true; }
+        bool end_object() override { return true; }
+        bool start_array(std::size_t) override { return true; }
+        bool end_array() override { return true; }
+        bool parse_error(std::size_t, const std::string&, const nlohmann::detail::exception&) override { return false; }
+    } counter;
+    tool_arguments args(raw_arguments);
+    EXPECT_TRUE(args.sax_parse(&counter));
+    EXPECT_EQ(counter.cells, 4);
+
+    // Arguments sent as a JSON-encoded string are unwrapped
+    tool_arguments encoded(R"("{\"location\": \"New York\"}")");
+    EXPECT_EQ(encoded.raw(), R"({"location": "New York"})");
+    EXPECT_EQ(encoded.parse()["location"], "New York");
+    EXPECT_EQ(tool_arguments("").raw(), "{}");
+
+    // Notifications, malformed bodies and non-objects
+    EXPECT_TRUE(request_envelope::scan(R"({"jsonrpc":"2.0","method":"notifications/initialized"})").is_notification());
+    EXPECT_EQ(request_envelope::scan(R"({"jsonrpc":"2.0","id":-0.5e+3,"method":"m","params":{"a":[true,false,null,"\u00e9\n"]}})").id, -500.0);
+    EXPECT_FALSE(request_envelope::scan(R"({"jsonrpc":"2.0","id":1})").is_valid());
+    for (const char* body : {R"({"jsonrpc":"2.0","params":{"a":[1,2}})", R"({"id":1,})", R"({"id":"1} extra)", "{} x",
+                             R"({"jsonrpc":"2.0","id":1,"method":"ping","params":{"a":nope}})", R"({"id":tru})",
+                             R"({"id":truex})", R"({"id":1.2.3})", R"({"id":01})", R"({"id":-})", R"({"id":1.})",
+                             R"({"id":1e+})", R"({"id":"\q"})", R"({"id":"\u12g4"})", R"({"id":1:2})"}) {
+        try {
+            request_envelope::scan(body);
+            ADD_FAILURE() << "Accepted malformed body: " << body;
+        } catch (const mcp_exception& e) {
+            EXPECT_EQ(e.code(), error_code::parse_error) << body;
+        }
+    }
+    try {
+        request_envelope::scan("[1, 2]");
+        ADD_FAILURE() << "Accepted a non-object body";
+    } catch (const mcp_exception& e) {
+        EXPECT_EQ(e.code(), error_code::invalid_request);
+    }
+}
+
+// Test that arena_json is carved from the request arena inside a scope and from the heap outside
+TEST(ArenaTest, AllocatesFromRequestArena) {
+    request_arena& arena = request_arena::for_thread();
+    arena_json outside = arena_json::array({1, 2, 3});
+    EXPECT_FALSE(arena.owns(&outside[0]));
+
+    {
+        arena_scope scope;
+        arena_json args = tool_arguments(
+            R"({"values": [[1, "a"], [2, "b"]], "sheet": "Sheet1", "a key longer than short strings": "and a value longer too"})").parse_arena();
+        EXPECT_TRUE(arena.owns(&args["values"][1]));
+        EXPECT_EQ(args["values"][1][1], "b");
+        EXPECT_EQ(json(args)["sheet"], "Sheet1");
+
+        // Keys and string values do not fall back to the heap either
+        auto last = std::prev(args.end());
+        EXPECT_TRUE(arena.owns(last.key().data()));
+        EXPECT_TRUE(arena.owns(last->get_ref<const arena_string&>().data()));
+        EXPECT_EQ(json(args)["a key longer than short strings"], "and a value longer too");
+
+        {
+            // Nested scopes share the arena and do not reset it
+            arena_scope nested;
+            arena_json more = arena_json::array({4, 5});
+            EXPECT_TRUE(arena.owns(&more[0]));
+        }
+        EXPECT_EQ(args["values"][0][0], 1);
+
+        // Heap values can still be released inside a scope
+        outside = nullptr;
+    }
+    EXPECT_EQ(request_arena::current(), nullptr);
+    EXPECT_GE(arena.capacity(), request_arena::initial_chunk_size);
+}
+
+// The server opens the request arena for raw-argument tools only
+TEST(ArenaTest, ScopesOnlyRawToolCalls) {
+    std::atomic<bool> plain_in_arena{true};
+    std::atomic<bool> raw_in_arena{false};
+
+    server srv("localhost", 8099);
+    srv.register_tool(tool_builder("plain").build(), [&](const json&, const std::string&) -> json {
+        plain_in_arena = request_arena::current() != nullptr;
+        return json::array();
+    });
+    srv.register_tool(tool_builder("raw").build(), [&](const tool_arguments& args, const std::string&) -> json {
+        raw_in_arena = request_arena::current() != nullptr;
+        arena_json parsed = args.parse_arena();
+        return json::array({{{"type", "text"}, {"text", parsed.dump()}}});
+    });
+    ASSERT_TRUE(srv.start(false));
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    sse_client client("localhost", 8099);
+    ASSERT_TRUE(client.initialize("ArenaClient", "1.0.0"));
+    client.call_tool("plain", {{"n", 1}});
+    EXPECT_EQ(client.call_tool("raw", {{"n", 2}})["content"][0]["text"], "{\"n\":2}");
+    EXPECT_FALSE(plain_in_arena.load());
+    EXPECT_TRUE(raw_in_arena.load());
+
+    srv.stop();
+}
+
 class LifecycleEnvironment : public ::testing::Environment {
 public:
     void SetUp() override {
@@ -658,6 +1218,1433 @@ TEST_F(ToolsTest, CallTool) {
     EXPECT_EQ(tool_result["content"][0]["text"], "Current weather in New York:\nTemperature: 72°F\nConditions: Partly cloudy");
 }
 
+#if defined(__linux__)
+// Test serving SSE sessions from the event loop
+class EventLoopTransportTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        server_ = std::make_unique<server>("localhost", 8084);
+        server_->set_sse_transport(sse_transport::event_loop);
+        server_->start(false);
+    }
+
+    void TearDown() override {
+        server_->stop();
+        server_.reset();
+    }
+
+    std::unique_ptr<server> server_;
+};
+
+// Test that several clients can initialize and ping over the event loop
+TEST_F(EventLoopTransportTest, InitializeAndPing) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    
+    std::vector<std::unique_ptr<sse_client>> clients;
+    for (int i = 0; i < 3; ++i) {
+        auto client = std::make_unique<sse_client>("localhost", 8084);
+        EXPECT_TRUE(client->initialize("TestClient", "1.0.0"));
+        clients.push_back(std::move(client));
+    }
+    
+    for (auto& client : clients) {
+        EXPECT_TRUE(client->ping());
+    }
+}
+
+// A request line split across segments is still handed to the loop, without polling
+TEST_F(EventLoopTransportTest, HandsOverSplitRequestLine) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    addrinfo hints{};
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* addresses = nullptr;
+    ASSERT_EQ(getaddrinfo("localhost", "8084", &hints, &addresses), 0);
+    int fd = -1;
+    for (addrinfo* a = addresses; a && fd < 0; a = a->ai_next) {
+        fd = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+        if (fd >= 0 && connect(fd, a->ai_addr, a->ai_addrlen) != 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(addresses);
+    ASSERT_GE(fd, 0);
+
+    timeval timeout{2, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    const std::string head = "GET /s";
+    const std::string rest = "se HTTP/1.1\r\nHost: localhost\r\n\r\n";
+    ASSERT_EQ(send(fd, head.data(), head.size(), 0), static_cast<ssize_t>(head.size()));
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    ASSERT_EQ(send(fd, rest.data(), rest.size(), 0), static_cast<ssize_t>(rest.size()));
+
+    std::string received;
+    char buf[1024];
+    while (received.find("event: endpoint") == std::string::npos) {
+        ssize_t n = recv(fd, buf, sizeof(buf), 0);
+        if (n <= 0) {
+            break;
+        }
+        received.append(buf, static_cast<size_t>(n));
+    }
+    close(fd);
+
+    EXPECT_NE(received.find("text/event-stream"), std::string::npos);
+    EXPECT_NE(received.find("event: endpoint"), std::string::npos);
+}
+#endif
+
+// Test that concurrent slow calls cannot starve the thread pool
+class DispatchStressTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        server_ = std::make_unique<server>("localhost", 8085);
+        
+        tool slow_tool = tool_builder("slow")
+            .with_description("Sleep for a while")
+            .build();
+        server_->register_tool(slow_tool, [](const json& /* params */, const std::string& /* session_id */) -> json {
+            std::this_thread::sleep_for(std::chrono::milliseconds(200));
+            return json::array({{{"type", "text"}, {"text", "done"}}});
+        });
+        
+        server_->start(false);
+    }
+
+    void TearDown() override {
+        server_->stop();
+        server_.reset();
+    }
+
+    std::unique_ptr<server> server_;
+};
+
+// Fire more concurrent slow calls than there are workers and wait for all of them
+TEST_F(DispatchStressTest, MoreSlowCallsThanWorkers) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    
+    const int call_count = static_cast<int>(std::max(4u, std::thread::hardware_concurrency() * 2));
+    
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::string endpoint;
+    std::set<int> responses;
+    std::atomic<bool> sse_running{true};
+    
+    // Collect responses from the SSE stream
+    httplib::Client sse_http("localhost", 8085);
+    std::thread sse_thread([&]() {
+        std::string buffer;
+        sse_http.Get("/sse", [&](const char* data, size_t len) {
+            buffer.append(data, len);
+            size_t pos;
+            while ((pos = buffer.find("\r\n\r\n")) != std::string::npos) {
+                std::string event = buffer.substr(0, pos);
+                buffer.erase(0, pos + 4);
+                
+                size_t data_pos = event.find("data: ");
+                if (data_pos == std::string::npos) {
+                    continue;
+                }
+                std::string content = event.substr(data_pos + 6);
+                
+                std::lock_guard<std::mutex> lock(mutex);
+                if (event.find("event: endpoint") == 0) {
+                    endpoint = content;
+                } else if (event.find("event: message") == 0) {
+                    json message = json::parse(content);
+                    if (message.contains("result")) {
+                        responses.insert(message["id"].get<int>());
+                    }
+                }
+                cv.notify_all();
+            }
+            return sse_running.load();
+        });
+    });
+    
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        ASSERT_TRUE(cv.wait_for(lock, std::chrono::seconds(5), [&] { return !endpoint.empty(); }));
+    }
+    
+    httplib::Client http("localhost", 8085);
+    json init = request::create_with_id(0, "initialize", {{"protocolVersion", MCP_VERSION}}).to_json();
+    ASSERT_TRUE(http.Post(endpoint, init.dump(), "application/json"));
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        ASSERT_TRUE(cv.wait_for(lock, std::chrono::seconds(5), [&] { return responses.count(0) > 0; }));
+    }
+    json initialized = request::create_notification("initialized").to_json();
+    ASSERT_TRUE(http.Post(endpoint, initialized.dump(), "application/json"));
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    
+    // All calls are posted at once from separate connections
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> callers;
+    for (int i = 1; i <= call_count; ++i) {
+        callers.emplace_back([&, i]() {
+            httplib::Client caller("localhost", 8085);
+            json call = request::create_with_id(i, "tools/call", {{"name", "slow"}, {"arguments", json::object()}}).to_json();
+            auto res = caller.Post(endpoint, call.dump(), "application/json");
+            EXPECT_TRUE(res && res->status == 202);
+        });
+    }
+    for (auto& caller : callers) {
+        caller.join();
+    }
+    
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        bool all_done = cv.wait_for(lock, std::chrono::seconds(30), [&] {
+            return static_cast<int>(responses.size()) == call_count + 1;
+        });
+        EXPECT_TRUE(all_done) << "Only " << responses.size() - 1 << " of " << call_count << " calls completed";
+    }
+    
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+    GTEST_LOG_(INFO) << call_count << " slow calls completed in " << elapsed.count() << " ms";
+    
+    sse_running.store(false);
+    server_->stop();
+    sse_thread.join();
+}
+
+// Test JSON-RPC batches on the message endpoint
+class BatchRequestTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        server_ = std::make_unique<server>("localhost", 8086);
+
+        server_->register_tool(tool_builder("read").with_read_only().build(), [](const json& args, const std::string&) -> json {
+            return json::array({{{"type", "text"}, {"text", "read " + args["cell"].get<std::string>()}}});
+        });
+        server_->register_tool(tool_builder("write").build(), [this](const json& args, const std::string&) -> json {
+            std::lock_guard<std::mutex> lock(mutex_);
+            writes_.push_back(args["cell"].get<std::string>());
+            return json::array({{{"type", "text"}, {"text", "ok"}}});
+        });
+
+        server_->start(false);
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+        // Collect messages from the SSE stream
+        sse_thread_ = std::thread([this]() {
+            httplib::Client sse_http("localhost", 8086);
+            std::string buffer;
+            sse_http.Get("/sse", [&](const char* data, size_t len) {
+                buffer.append(data, len);
+                size_t pos;
+                while ((pos = buffer.find("\r\n\r\n")) != std::string::npos) {
+                    std::string event = buffer.substr(0, pos);
+                    buffer.erase(0, pos + 4);
+
+                    std::string content = event.substr(event.find("data: ") + 6);
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    if (event.find("event: endpoint") == 0) {
+                        endpoint_ = content;
+                    } else if (event.find("event: message") == 0) {
+                        messages_.push_back(json::parse(content));
+                    }
+                    cv_.notify_all();
+                }
+                return sse_running_.load();
+            });
+        });
+    }
+
+    void TearDown() override {
+        sse_running_.store(false);
+        server_->stop();
+        sse_thread_.join();
+        server_.reset();
+    }
+
+    // Wait until n messages have arrived
+    bool wait_for_messages(size_t n) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        return cv_.wait_for(lock, std::chrono::seconds(5), [&] { return messages_.size() >= n; });
+    }
+
+    std::unique_ptr<server> server_;
+    std::thread sse_thread_;
+    std::atomic<bool> sse_running_{true};
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::string endpoint_;
+    std::vector<json> messages_;
+    std::vector<std::string> writes_;
+};
+
+// Test that a batch is answered with one event holding every response in order
+TEST_F(BatchRequestTest, AnswersBatchInOneEvent) {
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        ASSERT_TRUE(cv_.wait_for(lock, std::chrono::seconds(5), [&] { return !endpoint_.empty(); }));
+    }
+
+    // Initialize in one batch with the initialized notification, which adds no response
+    httplib::Client http("localhost", 8086);
+    json init = json::array({
+        request::create_with_id("init", "initialize", {{"protocolVersion", MCP_VERSION}}).to_json(),
+    });
+    ASSERT_TRUE(http.Post(endpoint_, init.dump(), "application/json"));
+    ASSERT_TRUE(wait_for_messages(1));
+    ASSERT_TRUE(http.Post(endpoint_, json::array({request::create_notification("initialized").to_json()}).dump(), "application/json"));
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    json batch = json::array({
+        request::create_with_id(1, "ping").to_json(),
+        request::create_with_id(2, "tools/call", {{"name", "write"}, {"arguments", {{"cell", "A1"}}}}).to_json(),
+        request::create_with_id(3, "tools/call", {{"name", "read"}, {"arguments", {{"cell", "B2"}}}}).to_json(),
+        request::create_notification("progress").to_json(),
+        request::create_with_id(4, "tools/call", {{"name", "write"}, {"arguments", {{"cell", "C3"}}}}).to_json(),
+        42,
+        request::create_with_id(5, "no/such/method").to_json()
+    });
+    auto res = http.Post(endpoint_, batch.dump(), "application/json");
+    ASSERT_TRUE(res);
+    EXPECT_EQ(res->status, 202);
+    ASSERT_TRUE(wait_for_messages(2));
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    ASSERT_EQ(messages_.size(), 2);
+    const json& responses = messages_[1];
+    ASSERT_TRUE(responses.is_array());
+    ASSERT_EQ(responses.size(), 6);
+    EXPECT_EQ(responses[0]["id"], 1);
+    EXPECT_EQ(responses[1]["id"], 2);
+    EXPECT_EQ(responses[2]["result"]["content"][0]["text"], "read B2");
+    EXPECT_EQ(responses[3]["id"], 4);
+    EXPECT_TRUE(responses[4]["id"].is_null());
+    EXPECT_EQ(responses[4]["error"]["code"], static_cast<int>(error_code::invalid_request));
+    EXPECT_EQ(responses[5]["error"]["code"], static_cast<int>(error_code::method_not_found));
+
+    // Calls to tools that are not read-only ran in batch order
+    EXPECT_EQ(writes_, std::vector<std::string>({"A1", "C3"}));
+
+    // An empty batch is rejected outright
+    auto empty = http.Post(endpoint_, "[]", "application/json");
+    ASSERT_TRUE(empty);
+    EXPECT_EQ(empty->status, 400);
+}
+
+// Test the streamable HTTP transport
+TEST(StreamableHttpTest, AnswersInlineAndStreamsProgress) {
+    server srv("localhost", 8087);
+    srv.set_streamable_http_endpoint("/mcp");
+    srv.register_tool(tool_builder("echo").build(), [](const json& args, const std::string&) -> json {
+        return json::array({{{"type", "text"}, {"text", args["text"]}}});
+    });
+    srv.register_tool(tool_builder("slow").build(), [&srv](const json&, const std::string& session_id) -> json {
+        for (int i = 1; i <= 2; ++i) {
+            srv.send_request(session_id, request::create_notification("progress", {{"progress", i}, {"total", 2}}));
+        }
+        return json::array({{{"type", "text"}, {"text", "finished"}}});
+    });
+    srv.start(false);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    httplib::Client http("localhost", 8087);
+
+    // Initialize opens the session and is answered in the body
+    auto init = http.Post("/mcp", request::create_with_id(1, "initialize", {{"protocolVersion", MCP_VERSION}}).to_json().dump(), "application/json");
+    ASSERT_TRUE(init);
+    EXPECT_EQ(init->status, 200);
+    EXPECT_EQ(init->get_header_value("Content-Type"), "application/json");
+    EXPECT_EQ(json::parse(init->body)["result"]["protocolVersion"], MCP_VERSION);
+    std::string session_id = init->get_header_value("Mcp-Session-Id");
+    ASSERT_FALSE(session_id.empty());
+
+    httplib::Headers headers = {{"Mcp-Session-Id", session_id}};
+    auto initialized = http.Post("/mcp", headers, request::create_notification("initialized").to_json().dump(), "application/json");
+    ASSERT_TRUE(initialized);
+    EXPECT_EQ(initialized->status, 202);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    // A plain call comes back as JSON
+    auto echo = http.Post("/mcp", headers,
+        request::create_with_id(2, "tools/call", {{"name", "echo"}, {"arguments", {{"text", "hi"}}}}).to_json().dump(), "application/json");
+    ASSERT_TRUE(echo);
+    EXPECT_EQ(echo->status, 200);
+    json echo_response = json::parse(echo->body);
+    EXPECT_EQ(echo_response["id"], 2);
+    EXPECT_EQ(echo_response["result"]["content"][0]["text"], "hi");
+
+    // A call that reports progress is upgraded to an event stream ending with the response
+    auto slow = http.Post("/mcp", headers,
+        request::create_with_id(3, "tools/call", {{"name", "slow"}, {"arguments", json::object()}}).to_json().dump(), "application/json");
+    ASSERT_TRUE(slow);
+    EXPECT_EQ(slow->status, 200);
+    EXPECT_EQ(slow->get_header_value("Content-Type"), "text/event-stream");
+    std::vector<json> events;
+    for (size_t pos = 0; (pos = slow->body.find("data: ", pos)) != std::string::npos; pos += 6) {
+        events.push_back(json::parse(slow->body.substr(pos + 6, slow->body.find("\r\n", pos) - pos - 6)));
+    }
+    ASSERT_EQ(events.size(), 3);
+    EXPECT_EQ(events[0]["method"], "notifications/progress");
+    EXPECT_EQ(events[1]["params"]["progress"], 2);
+    EXPECT_EQ(events[2]["id"], 3);
+    EXPECT_EQ(events[2]["result"]["content"][0]["text"], "finished");
+
+    // Requests without a known session are rejected, a deleted session is gone
+    auto missing = http.Post("/mcp", request::create_with_id(4, "ping").to_json().dump(), "application/json");
+    ASSERT_TRUE(missing);
+    EXPECT_EQ(missing->status, 400);
+    auto deleted = http.Delete("/mcp", headers);
+    ASSERT_TRUE(deleted);
+    EXPECT_EQ(deleted->status, 200);
+    auto unknown = http.Post("/mcp", headers, request::create_with_id(5, "ping").to_json().dump(), "application/json");
+    ASSERT_TRUE(unknown);
+    EXPECT_EQ(unknown->status, 404);
+
+    srv.stop();
+}
+
+// Test that server options are validated and applied to the listener
+// A failed initialize opens no session, and notification-only posts do not hold their messages back
+TEST(StreamableHttpTest, ValidatesInitializeAndRoutesNotifications) {
+    server srv("localhost", 8100);
+    srv.set_streamable_http_endpoint("/mcp");
+    srv.register_notification("notifications/poke", [&srv](const json&, const std::string& session_id) {
+        srv.send_request(session_id, request::create_notification("poked"));
+    });
+    srv.start(false);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    httplib::Client http("localhost", 8100);
+    auto sessions = [&http]() {
+        auto metrics = http.Get("/metrics");
+        size_t pos = metrics ? metrics->body.find("\nmcp_sessions ") : std::string::npos;
+        return pos == std::string::npos ? -1 : std::stoi(metrics->body.substr(pos + 14));
+    };
+
+    auto failed = http.Post("/mcp", request::create_with_id(1, "initialize", json::object()).to_json().dump(), "application/json");
+    ASSERT_TRUE(failed);
+    EXPECT_EQ(json::parse(failed->body)["error"]["code"], static_cast<int>(error_code::invalid_params));
+    EXPECT_EQ(json::parse(failed->body)["id"], 1);
+    EXPECT_FALSE(failed->has_header("Mcp-Session-Id"));
+    EXPECT_EQ(sessions(), 0);
+
+    auto init = http.Post("/mcp", request::create_with_id(2, "initialize", {{"protocolVersion", MCP_VERSION}}).to_json().dump(), "application/json");
+    ASSERT_TRUE(init);
+    std::string session_id = init->get_header_value("Mcp-Session-Id");
+    ASSERT_FALSE(session_id.empty());
+    EXPECT_EQ(sessions(), 1);
+    httplib::Headers headers = {{"Mcp-Session-Id", session_id}};
+
+    // The session's own stream receives what a notification handler sends
+    std::promise<void> poked;
+    std::atomic<bool> seen{false};
+    std::thread listener([&]() {
+        httplib::Client stream_client("localhost", 8100);
+        stream_client.Get("/mcp", headers, [&](const char* data, size_t len) {
+            if (std::string(data, len).find("notifications/poked") != std::string::npos && !seen.exchange(true)) {
+                poked.set_value();
+                return false;
+            }
+            return true;
+        });
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    json batch = json::array({request::create_notification("initialized").to_json(), request::create_notification("ready").to_json()});
+    auto batch_notify = http.Post("/mcp", headers, batch.dump(), "application/json");
+    ASSERT_TRUE(batch_notify);
+    EXPECT_EQ(batch_notify->status, 202);
+    EXPECT_TRUE(batch_notify->body.empty());
+    auto notify = http.Post("/mcp", headers, request::create_notification("poke").to_json().dump(), "application/json");
+    ASSERT_TRUE(notify);
+    EXPECT_EQ(notify->status, 202);
+    EXPECT_EQ(poked.get_future().wait_for(std::chrono::seconds(5)), std::future_status::ready);
+
+    srv.stop();
+    listener.join();
+}
+
+TEST(ServerOptionsTest, ValidatesAndAppliesListenerSettings) {
+    server_options defaults;
+    EXPECT_EQ(defaults.validate(), "");
+
+    server_options no_workers;
+    no_workers.worker_threads = 0;
+    EXPECT_NE(no_workers.validate(), "");
+
+    server_options heavy;
+    heavy.worker_threads = 2;
+    heavy.heavy_limit = 3;
+    EXPECT_NE(heavy.validate(), "");
+
+    server rejected("localhost", 8088);
+    server_options relative;
+    relative.streamable_http_endpoint = "mcp";
+    rejected.set_options(relative);
+    EXPECT_FALSE(rejected.start(false));
+
+    server srv("localhost", 8088);
+    server_options options;
+    options.listener_threads = 2;
+    options.worker_threads = 2;
+    options.keep_alive_max_count = 1000;
+    options.payload_max_length = 1024;
+    srv.set_options(options);
+    srv.set_streamable_http_endpoint("/mcp");
+    EXPECT_EQ(srv.get_options().payload_max_length, 1024);
+    EXPECT_EQ(srv.get_options().streamable_http_endpoint, "/mcp");
+    ASSERT_TRUE(srv.start(false));
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    httplib::Client http("localhost", 8088);
+    http.set_keep_alive(true);
+
+    auto init = http.Post("/mcp", request::create_with_id(1, "initialize", {{"protocolVersion", MCP_VERSION}}).to_json().dump(), "application/json");
+    ASSERT_TRUE(init);
+    EXPECT_EQ(init->status, 200);
+    httplib::Headers headers = {{"Mcp-Session-Id", init->get_header_value("Mcp-Session-Id")}};
+
+    // Many requests share the kept-alive connection
+    for (int i = 2; i < 50; ++i) {
+        auto ping = http.Post("/mcp", headers, request::create_with_id(i, "ping").to_json().dump(), "application/json");
+        ASSERT_TRUE(ping);
+        EXPECT_EQ(json::parse(ping->body)["id"], i);
+    }
+
+    // Bodies over the cap are refused before they reach a handler
+    auto oversized = http.Post("/mcp", headers, std::string(4096, ' '), "application/json");
+    ASSERT_TRUE(oversized);
+    EXPECT_EQ(oversized->status, 413);
+
+    srv.stop();
+}
+
+// Test that a request outliving its deadline is answered with an error
+TEST(ServerOptionsTest, AnswersTimedOutRequests) {
+    server srv("localhost", 8089);
+    server_options options;
+    options.request_timeout = std::chrono::milliseconds(200);
+    options.streamable_http_endpoint = "/mcp";
+    srv.set_options(options);
+    srv.register_tool(tool_builder("stall").build(), [](const json&, const std::string&) -> json {
+        std::this_thread::sleep_for(std::chrono::milliseconds(600));
+        return json::array({{{"type", "text"}, {"text", "late"}}});
+    });
+    ASSERT_TRUE(srv.start(false));
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    httplib::Client http("localhost", 8089);
+    auto init = http.Post("/mcp", request::create_with_id(1, "initialize", {{"protocolVersion", MCP_VERSION}}).to_json().dump(), "application/json");
+    ASSERT_TRUE(init);
+    httplib::Headers headers = {{"Mcp-Session-Id", init->get_header_value("Mcp-Session-Id")}};
+    http.Post("/mcp", headers, request::create_notification("initialized").to_json().dump(), "application/json");
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    auto start = std::chrono::steady_clock::now();
+    auto stalled = http.Post("/mcp", headers,
+        request::create_with_id(2, "tools/call", {{"name", "stall"}, {"arguments", json::object()}}).to_json().dump(), "application/json");
+    ASSERT_TRUE(stalled);
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(550));
+    json response = json::parse(stalled->body);
+    EXPECT_EQ(response["id"], 2);
+    EXPECT_EQ(response["error"]["code"], static_cast<int>(error_code::internal_error));
+    EXPECT_EQ(response["error"]["message"], "Request timed out");
+
+    // Fast requests are not affected once the stalled handler has freed its worker
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    auto ping = http.Post("/mcp", headers, request::create_with_id(3, "ping").to_json().dump(), "application/json");
+    ASSERT_TRUE(ping);
+    EXPECT_TRUE(json::parse(ping->body).contains("result"));
+
+    srv.stop();
+}
+
+// Test that stop() is quick with many sessions and still answers the request in flight
+#if defined(__linux__)
+// A timed out request whose session queue is full must not hold up the deadlines of other sessions
+TEST(ServerOptionsTest, BlockedTimeoutReplyDoesNotDelayOtherTimers) {
+    server srv("localhost", 8101);
+    server_options options;
+    options.worker_threads = 6;
+    options.heavy_limit = 4;
+    options.request_timeout = std::chrono::milliseconds(300);
+    options.drain_timeout = std::chrono::milliseconds(500);
+    options.streamable_http_endpoint = "/mcp";
+    options.event_queue.capacity = 1;
+    options.event_queue.policy = backpressure_policy::block;
+    options.event_queue.block_timeout = std::chrono::milliseconds(3000);
+    srv.set_options(options);
+    srv.register_tool(tool_builder("flood").build(), [&srv](const json&, const std::string& session_id) -> json {
+        json payload = {{"data", std::string(1024 * 1024, 'x')}};
+        for (int i = 0; i < 32; ++i) {
+            srv.send_request(session_id, request::create_notification("flood", payload));
+        }
+        return json::array();
+    });
+    srv.register_tool(tool_builder("stall").build(), [](const json&, const std::string&) -> json {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1500));
+        return json::array({{{"type", "text"}, {"text", "late"}}});
+    });
+    ASSERT_TRUE(srv.start(false));
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    // Session A: an SSE consumer that stops reading after the endpoint event
+    addrinfo hints{};
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* addresses = nullptr;
+    ASSERT_EQ(getaddrinfo("localhost", "8101", &hints, &addresses), 0);
+    int fd = -1;
+    for (addrinfo* a = addresses; a && fd < 0; a = a->ai_next) {
+        fd = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+        int small = 4096;
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &small, sizeof(small));
+        if (fd >= 0 && connect(fd, a->ai_addr, a->ai_addrlen) != 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(addresses);
+    ASSERT_GE(fd, 0);
+    const std::string get = "GET /sse HTTP/1.1\r\nHost: localhost\r\n\r\n";
+    ASSERT_EQ(send(fd, get.data(), get.size(), 0), static_cast<ssize_t>(get.size()));
+    std::string received;
+    char buf[1024];
+    while (received.find("session_id=") == std::string::npos || received.find("\r\n\r\n", received.find("session_id=")) == std::string::npos) {
+        ssize_t n = recv(fd, buf, sizeof(buf), 0);
+        ASSERT_GT(n, 0);
+        received.append(buf, static_cast<size_t>(n));
+    }
+    size_t uri = received.find("data: ") + 6;
+    std::string endpoint = received.substr(uri, received.find("\r\n", uri) - uri);
+
+    httplib::Client http("localhost", 8101);
+    http.Post(endpoint, request::create_with_id(1, "initialize", {{"protocolVersion", MCP_VERSION}}).to_json().dump(), "application/json");
+    http.Post(endpoint, request::create_notification("initialized").to_json().dump(), "application/json");
+
+    // Session B on the streamable transport
+    auto init = http.Post("/mcp", request::create_with_id(1, "initialize", {{"protocolVersion", MCP_VERSION}}).to_json().dump(), "application/json");
+    ASSERT_TRUE(init);
+    httplib::Headers headers = {{"Mcp-Session-Id", init->get_header_value("Mcp-Session-Id")}};
+    http.Post("/mcp", headers, request::create_notification("initialized").to_json().dump(), "application/json");
+
+    // Fill A's socket and queue, then let a request of A time out into the full queue
+    http.Post(endpoint, request::create_with_id(2, "tools/call", {{"name", "flood"}, {"arguments", json::object()}}).to_json().dump(), "application/json");
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    http.Post(endpoint, request::create_with_id(3, "tools/call", {{"name", "stall"}, {"arguments", json::object()}}).to_json().dump(), "application/json");
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    // B's deadline fires on time
+    auto start = std::chrono::steady_clock::now();
+    auto stalled = http.Post("/mcp", headers,
+        request::create_with_id(4, "tools/call", {{"name", "stall"}, {"arguments", json::object()}}).to_json().dump(), "application/json");
+    ASSERT_TRUE(stalled);
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(1000));
+    EXPECT_EQ(json::parse(stalled->body)["error"]["message"], "Request timed out");
+
+    srv.stop();
+    close(fd);
+}
+#endif
+
+TEST(ShutdownTest, StopsQuicklyWithManySessions) {
+    server srv("localhost", 8091);
+    server_options options;
+    options.streamable_http_endpoint = "/mcp";
+    srv.set_options(options);
+    srv.register_tool(tool_builder("wait").build(), [&srv](const json&, const std::string&) -> json {
+        stop_token token = srv.get_stop_token();
+        auto give_up = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (!token.stop_requested() && std::chrono::steady_clock::now() < give_up) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return json::array({{{"type", "text"}, {"text", token.stop_requested() ? "stopped" : "timeout"}}});
+    });
+    ASSERT_TRUE(srv.start(false));
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    httplib::Client http("localhost", 8091);
+    http.set_keep_alive(true);
+    http.set_tcp_nodelay(true);
+    std::string session_id;
+    for (int i = 0; i < 1000; ++i) {
+        auto init = http.Post("/mcp", request::create_with_id(i, "initialize", {{"protocolVersion", MCP_VERSION}}).to_json().dump(), "application/json");
+        ASSERT_TRUE(init);
+        session_id = init->get_header_value("Mcp-Session-Id");
+    }
+    httplib::Headers headers = {{"Mcp-Session-Id", session_id}};
+    http.Post("/mcp", headers, request::create_notification("initialized").to_json().dump(), "application/json");
+
+    // A few open event streams
+    std::vector<std::thread> streams;
+    for (int i = 0; i < 4; ++i) {
+        streams.emplace_back([]() {
+            httplib::Client sse("localhost", 8091);
+            sse.Get("/sse", [](const char*, size_t) { return true; });
+        });
+    }
+
+    json in_flight;
+    std::thread caller([&]() {
+        httplib::Client client("localhost", 8091);
+        auto res = client.Post("/mcp", headers,
+            request::create_with_id(2, "tools/call", {{"name", "wait"}, {"arguments", json::object()}}).to_json().dump(), "application/json");
+        if (res) {
+            in_flight = json::parse(res->body);
+        }
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    auto start = std::chrono::steady_clock::now();
+    srv.stop();
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    EXPECT_LT(elapsed, std::chrono::milliseconds(250));
+
+    caller.join();
+    for (auto& t : streams) {
+        t.join();
+    }
+    ASSERT_TRUE(in_flight.contains("result"));
+    EXPECT_EQ(in_flight["result"]["content"][0]["text"], "stopped");
+
+    // Callbacks registered after the stop run right away
+    bool ran = false;
+    stop_callback late(srv.get_stop_token(), [&ran]() { ran = true; });
+    EXPECT_TRUE(ran);
+}
+
+#if defined(__linux__)
+// Test that requests arriving while in-flight calls drain are turned away
+TEST(ShutdownTest, RejectsRequestsDuringDrain) {
+    server srv("localhost", 8102);
+    server_options options;
+    options.streamable_http_endpoint = "/mcp";
+    options.drain_timeout = std::chrono::milliseconds(2000);
+    srv.set_options(options);
+    srv.register_tool(tool_builder("slow").build(), [](const json&, const std::string&) -> json {
+        std::this_thread::sleep_for(std::chrono::milliseconds(800));
+        return json::array({{{"type", "text"}, {"text", "done"}}});
+    });
+    ASSERT_TRUE(srv.start(false));
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    httplib::Client http("localhost", 8102);
+    auto init = http.Post("/mcp", request::create_with_id(1, "initialize", {{"protocolVersion", MCP_VERSION}}).to_json().dump(), "application/json");
+    ASSERT_TRUE(init);
+    httplib::Headers headers = {{"Mcp-Session-Id", init->get_header_value("Mcp-Session-Id")}};
+    http.Post("/mcp", headers, request::create_notification("initialized").to_json().dump(), "application/json");
+
+    // A connection that was accepted before the stop and sends its request during the drain
+    addrinfo hints{};
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* addresses = nullptr;
+    ASSERT_EQ(getaddrinfo("localhost", "8102", &hints, &addresses), 0);
+    int fd = -1;
+    for (addrinfo* a = addresses; a && fd < 0; a = a->ai_next) {
+        fd = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+        if (fd >= 0 && connect(fd, a->ai_addr, a->ai_addrlen) != 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(addresses);
+    ASSERT_GE(fd, 0);
+    timeval timeout{2, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    const std::string head = "POST /mcp HTTP/1.1\r\n";
+    ASSERT_EQ(send(fd, head.data(), head.size(), 0), static_cast<ssize_t>(head.size()));
+
+    json in_flight;
+    std::thread caller([&]() {
+        httplib::Client client("localhost", 8102);
+        auto res = client.Post("/mcp", headers,
+            request::create_with_id(2, "tools/call", {{"name", "slow"}, {"arguments", json::object()}}).to_json().dump(), "application/json");
+        if (res) {
+            in_flight = json::parse(res->body);
+        }
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    std::thread stopper([&srv]() { srv.stop(); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    // New connections are refused right away
+    auto start = std::chrono::steady_clock::now();
+    httplib::Client late("localhost", 8102);
+    late.set_connection_timeout(1);
+    auto refused = late.Post("/mcp", headers, request::create_with_id(3, "ping").to_json().dump(), "application/json");
+    EXPECT_FALSE(refused);
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(200));
+
+    // The request on the open connection gets an error instead of being run
+    const std::string body = request::create_with_id(4, "ping").to_json().dump();
+    const std::string rest = "Host: localhost\r\nContent-Type: application/json\r\nMcp-Session-Id: " +
+        headers.begin()->second + "\r\nContent-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body;
+    ASSERT_EQ(send(fd, rest.data(), rest.size(), 0), static_cast<ssize_t>(rest.size()));
+    std::string received;
+    char buf[1024];
+    while (received.find("\r\n\r\n") == std::string::npos) {
+        ssize_t n = recv(fd, buf, sizeof(buf), 0);
+        if (n <= 0) {
+            break;
+        }
+        received.append(buf, static_cast<size_t>(n));
+    }
+    close(fd);
+    EXPECT_EQ(received.rfind("HTTP/1.1 503", 0), 0u) << received;
+
+    stopper.join();
+    caller.join();
+    ASSERT_TRUE(in_flight.contains("result"));
+    EXPECT_EQ(in_flight["result"]["content"][0]["text"], "done");
+}
+#endif
+
+// Test that filtered log calls skip their arguments and queued lines keep per-thread order
+TEST(LoggerTest, SkipsFilteredArgumentsAndFlushesInOrder) {
+    int evaluated = 0;
+    auto expensive = [&evaluated]() {
+        ++evaluated;
+        return std::string("expensive");
+    };
+    set_log_level(log_level::warning);
+    LOG_INFO("filtered ", expensive());
+    LOG_DEBUG("filtered ", expensive());
+    EXPECT_EQ(evaluated, 0);
+    set_log_level(log_level::info);
+
+    const int threads = 4;
+    const int lines = 500;
+    testing::internal::CaptureStderr();
+    std::vector<std::thread> writers;
+    for (int t = 0; t < threads; ++t) {
+        writers.emplace_back([t]() {
+            for (int i = 0; i < lines; ++i) {
+                LOG_INFO("logger-test ", t, " ", i, " ", 1.5, " ", true);
+            }
+        });
+    }
+    for (auto& w : writers) {
+        w.join();
+    }
+    logger::instance().flush();
+    std::string output = testing::internal::GetCapturedStderr();
+
+    std::vector<int> next(threads, 0);
+    std::istringstream in(output);
+    std::string line;
+    while (std::getline(in, line)) {
+        auto pos = line.find("logger-test ");
+        if (pos == std::string::npos) {
+            continue;
+        }
+        int t = -1;
+        int i = -1;
+        std::istringstream fields(line.substr(pos + 12));
+        fields >> t >> i;
+        ASSERT_GE(t, 0);
+        ASSERT_LT(t, threads);
+        EXPECT_EQ(i, next[t]++);
+        EXPECT_NE(line.find(" 1.5 1"), std::string::npos);
+    }
+    for (int t = 0; t < threads; ++t) {
+        EXPECT_EQ(next[t], lines);
+    }
+}
+
+// Test that a sink receives the request fields with each message logged while handling it
+TEST(LoggerTest, CarriesRequestContextToSink) {
+    struct entry {
+        std::string message;
+        std::string fields;
+    };
+    std::mutex mutex;
+    std::vector<entry> entries;
+    logger::instance().set_sink([&](log_level, std::string_view message, const log_context* context) {
+        entry e{std::string(message), std::string()};
+        if (context) {
+            context->append_json_fields(e.fields);
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        entries.push_back(std::move(e));
+    });
+
+    server srv("localhost", 8092);
+    srv.set_streamable_http_endpoint("/mcp");
+    srv.register_tool(tool_builder("echo").build(), [](const json&, const std::string&) -> json {
+        LOG_INFO("inside \"echo\"");
+        return json::array({{{"type", "text"}, {"text", "ok"}}});
+    });
+    ASSERT_TRUE(srv.start(false));
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    httplib::Client http("localhost", 8092);
+    auto init = http.Post("/mcp", request::create_with_id(1, "initialize", {{"protocolVersion", MCP_VERSION}}).to_json().dump(), "application/json");
+    ASSERT_TRUE(init);
+    std::string session_id = init->get_header_value("Mcp-Session-Id");
+    httplib::Headers headers = {{"Mcp-Session-Id", session_id}};
+    http.Post("/mcp", headers, request::create_notification("initialized").to_json().dump(), "application/json");
+    auto call = http.Post("/mcp", headers,
+        request::create_with_id("call-7", "tools/call", {{"name", "echo"}, {"arguments", json::object()}}).to_json().dump(), "application/json");
+    ASSERT_TRUE(call);
+    srv.stop();
+    logger::instance().set_sink(nullptr);
+
+    bool found = false;
+    for (const auto& e : entries) {
+        if (e.message != "inside \"echo\"") {
+            continue;
+        }
+        found = true;
+        json fields = json::parse("{" + e.fields + "}");
+        EXPECT_EQ(fields["session_id"], session_id);
+        EXPECT_EQ(fields["request_id"], "call-7");
+        EXPECT_EQ(fields["method"], "tools/call");
+        EXPECT_EQ(fields["tool"], "echo");
+        EXPECT_GE(fields["elapsed_us"].get<int64_t>(), 0);
+    }
+    EXPECT_TRUE(found);
+}
+
+// Test that request stages are recorded per method and tool and served to Prometheus
+TEST(MetricsTest, RecordsStagesAndServesPrometheus) {
+    // Buckets hold every value within an eighth of its size
+    for (uint64_t v : {0ull, 7ull, 8ull, 15ull, 16ull, 100ull, 999ull, 123456ull, 98765432ull}) {
+        size_t bucket = latency_histogram::bucket_of(v);
+        EXPECT_GE(latency_histogram::upper_bound(bucket), v);
+        EXPECT_LE(latency_histogram::upper_bound(bucket), v + v / 8);
+    }
+
+    server srv("localhost", 8093);
+    srv.set_streamable_http_endpoint("/mcp");
+    srv.register_tool(tool_builder("sleepy").build(), [](const json&, const std::string&) -> json {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        return json::array({{{"type", "text"}, {"text", "ok"}}});
+    });
+    ASSERT_TRUE(srv.start(false));
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    httplib::Client http("localhost", 8093);
+    auto init = http.Post("/mcp", request::create_with_id(1, "initialize", {{"protocolVersion", MCP_VERSION}}).to_json().dump(), "application/json");
+    ASSERT_TRUE(init);
+    httplib::Headers headers = {{"Mcp-Session-Id", init->get_header_value("Mcp-Session-Id")}};
+    http.Post("/mcp", headers, request::create_notification("initialized").to_json().dump(), "application/json");
+    for (int i = 0; i < 5; ++i) {
+        auto call = http.Post("/mcp", headers,
+            request::create_with_id(10 + i, "tools/call", {{"name", "sleepy"}, {"arguments", json::object()}}).to_json().dump(), "application/json");
+        ASSERT_TRUE(call);
+    }
+    http.Post("/mcp", headers, request::create_with_id(20, "no/such/method").to_json().dump(), "application/json");
+
+    // A session that never finished initializing does not get to name series either
+    auto idle = http.Post("/mcp", request::create_with_id(21, "initialize", {{"protocolVersion", MCP_VERSION}}).to_json().dump(), "application/json");
+    ASSERT_TRUE(idle);
+    httplib::Headers idle_headers = {{"Mcp-Session-Id", idle->get_header_value("Mcp-Session-Id")}};
+    auto early = http.Post("/mcp", idle_headers, request::create_with_id(22, "junk/before/init").to_json().dump(), "application/json");
+    ASSERT_TRUE(early);
+    EXPECT_NE(early->body.find("Session not initialized"), std::string::npos);
+
+    // The SSE transport times the response queue as well
+    sse_client client("localhost", 8093);
+    ASSERT_TRUE(client.initialize("MetricsClient", "1.0.0"));
+    EXPECT_TRUE(client.call_tool("sleepy").contains("content"));
+
+    // The worker records after the response is queued
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    server_stats stats = srv.stats();
+    const method_stats* tool = stats.find("tools/call", "sleepy");
+    ASSERT_NE(tool, nullptr);
+    EXPECT_EQ(tool->stage(request_stage::handler).count, 6u);
+    EXPECT_GE(tool->stage(request_stage::handler).p99, std::chrono::milliseconds(20));
+    EXPECT_GE(tool->stage(request_stage::total).p50, tool->stage(request_stage::handler).p50 / 2);
+    EXPECT_EQ(tool->stage(request_stage::queue_wait).count, 6u);
+    EXPECT_NE(stats.find("initialize"), nullptr);
+    EXPECT_NE(stats.find("unknown"), nullptr);
+    EXPECT_EQ(stats.find("no/such/method"), nullptr);
+    EXPECT_EQ(stats.find("junk/before/init"), nullptr);
+    const method_stats* queued = stats.find("");
+    ASSERT_NE(queued, nullptr);
+    EXPECT_GT(queued->stage(request_stage::delivery).count, 0u);
+
+    auto metrics = http.Get("/metrics");
+    ASSERT_TRUE(metrics);
+    EXPECT_EQ(metrics->status, 200);
+    EXPECT_NE(metrics->body.find("mcp_request_duration_seconds_bucket{stage=\"handler\",method=\"tools/call\",tool=\"sleepy\",le=\"+Inf\"} 6"),
+              std::string::npos);
+    EXPECT_NE(metrics->body.find("mcp_request_duration_quantile_seconds{stage=\"total\",method=\"tools/call\",tool=\"sleepy\",quantile=\"0.99\"}"),
+              std::string::npos);
+    EXPECT_NE(metrics->body.find("mcp_sessions 3"), std::string::npos);
+
+    srv.stop();
+}
+
+// One thread keeps many calls in flight; deadlines and cancel() notify the server
+TEST(AsyncClientTest, PipelinesCallsWithDeadlinesAndCancellation) {
+    server srv("localhost", 8094);
+    srv.register_tool(tool_builder("echo").with_number_param("n", "Value to echo").build(), [](const json& args, const std::string&) -> json {
+        return json::array({{{"type", "text"}, {"text", std::to_string(args["n"].get<int>())}}});
+    });
+    srv.register_tool(tool_builder("slow").build(), [](const json&, const std::string&) -> json {
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+        return json::array({{{"type", "text"}, {"text", "late"}}});
+    });
+    std::mutex cancelled_mutex;
+    std::vector<json> cancelled;
+    srv.register_notification("notifications/cancelled", [&](const json& params, const std::string&) {
+        std::lock_guard<std::mutex> lock(cancelled_mutex);
+        cancelled.push_back(params);
+    });
+    ASSERT_TRUE(srv.start(false));
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    sse_client client("localhost", 8094);
+    ASSERT_TRUE(client.initialize("AsyncClient", "1.0.0"));
+
+    const int calls = 200;
+    std::atomic<int> answered{0};
+    std::vector<pending_call> pending;
+    for (int i = 0; i < calls; ++i) {
+        pending.push_back(client.call_tool_async("echo", {{"n", i}}));
+        pending.back().then([&answered](const json& result, const mcp_exception* error) {
+            if (!error && result.contains("content")) {
+                answered++;
+            }
+        });
+    }
+    for (int i = 0; i < calls; ++i) {
+        EXPECT_EQ(pending[i].get()["content"][0]["text"], std::to_string(i));
+    }
+    EXPECT_EQ(answered.load(), calls);
+
+    // A deadline fails the call long before the tool returns
+    call_options options;
+    options.timeout = std::chrono::milliseconds(100);
+    auto start = std::chrono::steady_clock::now();
+    pending_call timed_out = client.call_tool_async("slow", json::object(), options);
+    EXPECT_THROW(timed_out.get(), mcp_exception);
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(400));
+
+    pending_call abandoned = client.call_tool_async("slow");
+    EXPECT_TRUE(abandoned.cancel("no longer needed"));
+    EXPECT_FALSE(abandoned.cancel());
+    EXPECT_TRUE(abandoned.ready());
+    EXPECT_THROW(abandoned.get(), mcp_exception);
+
+    for (int i = 0; i < 100; ++i) {
+        {
+            std::lock_guard<std::mutex> lock(cancelled_mutex);
+            if (cancelled.size() >= 2) {
+                break;
+            }
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    {
+        std::lock_guard<std::mutex> lock(cancelled_mutex);
+        ASSERT_EQ(cancelled.size(), 2u);
+        // Sent on different pooled connections, so either may arrive first
+        if (cancelled[0]["requestId"] != timed_out.id()) {
+            std::swap(cancelled[0], cancelled[1]);
+        }
+        EXPECT_EQ(cancelled[0]["requestId"], timed_out.id());
+        EXPECT_EQ(cancelled[1]["requestId"], abandoned.id());
+        EXPECT_EQ(cancelled[1]["reason"], "no longer needed");
+    }
+
+    // Late responses to abandoned calls are dropped, the connection stays usable
+    EXPECT_TRUE(client.ping());
+
+    srv.stop();
+}
+
+// Ids from many threads are unique, and more calls than the stripes hold still complete by id
+TEST(CallTableTest, CorrelatesConcurrentCallsBeyondStripeCapacity) {
+    std::mutex cancelled_mutex;
+    std::vector<json> cancelled;
+    call_table table([&](const json& id, const std::string&) {
+        std::lock_guard<std::mutex> lock(cancelled_mutex);
+        cancelled.push_back(id);
+    });
+
+    const int threads = 4;
+    const int per_thread = 2000;
+    std::vector<std::vector<pending_call>> calls(threads);
+    std::vector<std::thread> senders;
+    for (int t = 0; t < threads; ++t) {
+        senders.emplace_back([&table, &calls, t]() {
+            for (int i = 0; i < per_thread; ++i) {
+                calls[t].push_back(table.add(request::create("ping").id, std::chrono::milliseconds(0)));
+            }
+        });
+    }
+    for (auto& t : senders) {
+        t.join();
+    }
+
+    std::set<int64_t> ids;
+    for (const auto& list : calls) {
+        for (const auto& call : list) {
+            ids.insert(call.id().get<int64_t>());
+        }
+    }
+    EXPECT_EQ(ids.size(), static_cast<size_t>(threads * per_thread));
+    EXPECT_EQ(table.size(), ids.size());
+
+    // Answered out of order from several readers, and one id that is not a number
+    pending_call named = table.add("named", std::chrono::milliseconds(0));
+    std::vector<std::thread> readers;
+    for (int t = 0; t < threads; ++t) {
+        readers.emplace_back([&table, &calls, t]() {
+            const auto& list = calls[(t + 1) % threads];
+            for (auto it = list.rbegin(); it != list.rend(); ++it) {
+                table.complete({{"jsonrpc", "2.0"}, {"id", it->id()}, {"result", {{"n", it->id()}}}});
+            }
+        });
+    }
+    for (auto& t : readers) {
+        t.join();
+    }
+    EXPECT_TRUE(table.complete({{"jsonrpc", "2.0"}, {"id", "named"}, {"result", {{"n", "named"}}}}));
+    EXPECT_FALSE(table.complete({{"jsonrpc", "2.0"}, {"id", "named"}, {"result", json::object()}}));
+
+    for (const auto& list : calls) {
+        for (const auto& call : list) {
+            ASSERT_TRUE(call.ready());
+            EXPECT_EQ(call.get()["n"], call.id());
+        }
+    }
+    EXPECT_EQ(named.get()["n"], "named");
+    EXPECT_EQ(table.size(), 0u);
+
+    // Recycled call states start clean: a deadline and a cancellation after the burst
+    pending_call expiring = table.add(request::create("ping").id, std::chrono::milliseconds(20));
+    pending_call abandoned = table.add(request::create("ping").id, std::chrono::milliseconds(0));
+    EXPECT_FALSE(expiring.ready());
+    EXPECT_TRUE(abandoned.cancel("no longer needed"));
+    EXPECT_THROW(expiring.get(), mcp_exception);
+    EXPECT_THROW(abandoned.get(), mcp_exception);
+    EXPECT_EQ(table.size(), 0u);
+    auto give_up = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+    while (std::chrono::steady_clock::now() < give_up) {
+        std::lock_guard<std::mutex> lock(cancelled_mutex);
+        if (cancelled.size() >= 2) {
+            break;
+        }
+    }
+    std::lock_guard<std::mutex> lock(cancelled_mutex);
+    ASSERT_EQ(cancelled.size(), 2u);
+}
+
+// A cancellation that is slow to send holds up neither cancel() nor other deadlines
+TEST(CallTableTest, SendsCancellationsOffTheCaller) {
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool release = false;
+    std::vector<json> sent;
+    call_table table([&](const json& id, const std::string&) {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait_for(lock, std::chrono::seconds(2), [&release] { return release; });
+        sent.push_back(id);
+    });
+
+    pending_call abandoned = table.add(request::create("ping").id, std::chrono::milliseconds(0));
+    pending_call first = table.add(request::create("ping").id, std::chrono::milliseconds(20));
+    pending_call second = table.add(request::create("ping").id, std::chrono::milliseconds(60));
+
+    auto start = std::chrono::steady_clock::now();
+    EXPECT_TRUE(abandoned.cancel());
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(100));
+
+    // The first deadline queues a send behind the blocked one, the second still fires on time
+    EXPECT_TRUE(second.wait_for(std::chrono::milliseconds(500)));
+    EXPECT_TRUE(first.ready());
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(500));
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        EXPECT_TRUE(sent.empty());
+        release = true;
+    }
+    cv.notify_all();
+    auto give_up = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+    while (std::chrono::steady_clock::now() < give_up) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (sent.size() >= 3) {
+            break;
+        }
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    EXPECT_EQ(sent.size(), 3u);
+}
+
+// Malformed error members still finish the call instead of leaving it without a deadline
+TEST(CallTableTest, FinishesCallsOnMalformedErrors) {
+    call_table table(nullptr);
+    pending_call text_code = table.add(1, std::chrono::milliseconds(0));
+    pending_call null_message = table.add(2, std::chrono::milliseconds(0));
+    EXPECT_TRUE(table.complete({{"jsonrpc", "2.0"}, {"id", 1}, {"error", {{"code", "oops"}, {"message", "bad code"}}}}));
+    EXPECT_TRUE(table.complete({{"jsonrpc", "2.0"}, {"id", 2}, {"error", {{"code", -32001}, {"message", nullptr}}}}));
+
+    ASSERT_TRUE(text_code.ready());
+    ASSERT_TRUE(null_message.ready());
+    try {
+        text_code.get();
+        FAIL() << "expected an error";
+    } catch (const mcp_exception& e) {
+        EXPECT_EQ(e.code(), error_code::internal_error);
+        EXPECT_STREQ(e.what(), "bad code");
+    }
+    try {
+        null_message.get();
+        FAIL() << "expected an error";
+    } catch (const mcp_exception& e) {
+        EXPECT_EQ(static_cast<int>(e.code()), -32001);
+    }
+}
+
+// A cancel racing the table's destruction either finishes first or sees the call closed
+TEST(CallTableTest, CancelRacesDestruction) {
+    std::atomic<int> sent{0};
+    for (int i = 0; i < 200; ++i) {
+        auto table = std::make_unique<call_table>([&sent](const json&, const std::string&) {
+            sent.fetch_add(1);
+        });
+        pending_call call = table->add(i, std::chrono::milliseconds(0));
+        std::atomic<bool> go{false};
+        std::thread canceller([&call, &go]() {
+            while (!go.load()) {
+            }
+            call.cancel("racing");
+        });
+        go.store(true);
+        table.reset();
+        canceller.join();
+        ASSERT_TRUE(call.ready());
+        EXPECT_THROW(call.get(), mcp_exception);
+    }
+    EXPECT_LE(sent.load(), 200);
+}
+
+// Overlapping requests go to the least busy connection, sequential ones reuse the first
+TEST(HttpClientPoolTest, LeasesLeastOutstandingConnection) {
+    http_client_pool pool(3, []() { return std::make_unique<httplib::Client>("localhost", 8098); });
+    {
+        auto first = pool.acquire();
+        auto second = pool.acquire();
+        auto third = pool.acquire();
+        EXPECT_EQ(pool.outstanding(0), 1u);
+        EXPECT_EQ(pool.outstanding(1), 1u);
+        EXPECT_EQ(pool.outstanding(2), 1u);
+        EXPECT_NE(&*first, &*second);
+        EXPECT_NE(&*second, &*third);
+        {
+            auto fourth = pool.acquire();
+            EXPECT_EQ(&*fourth, &*first);
+        }
+        httplib::Client* freed = &*second;
+        { auto moved = std::move(second); }
+        EXPECT_EQ(&*pool.acquire(), freed);
+    }
+    EXPECT_EQ(pool.outstanding(0) + pool.outstanding(1) + pool.outstanding(2), 0u);
+
+    server srv("localhost", 8098);
+    srv.register_tool(tool_builder("echo").with_number_param("n", "Value to echo").build(), [](const json& args, const std::string&) -> json {
+        return json::array({{{"type", "text"}, {"text", std::to_string(args["n"].get<int>())}}});
+    });
+    ASSERT_TRUE(srv.start(false));
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    sse_client client("localhost", 8098);
+    client.set_connection_pool_size(3);
+    ASSERT_TRUE(client.initialize("PoolClient", "1.0.0"));
+
+    std::atomic<int> correct{0};
+    std::vector<std::thread> callers;
+    for (int t = 0; t < 6; ++t) {
+        callers.emplace_back([&client, &correct, t]() {
+            for (int i = 0; i < 20; ++i) {
+                int n = t * 100 + i;
+                if (client.call_tool("echo", {{"n", n}})["content"][0]["text"] == std::to_string(n)) {
+                    correct++;
+                }
+            }
+        });
+    }
+    for (auto& t : callers) {
+        t.join();
+    }
+    EXPECT_EQ(correct.load(), 120);
+
+    srv.stop();
+}
+
+// Random events, line endings and chunk boundaries, with multi-megabyte payloads
+TEST(SseParserTest, FuzzedChunksMatchGeneratedEvents) {
+    struct expected_event {
+        std::string type;
+        std::string data;
+        std::string id;
+    };
+
+    std::mt19937 rng(20240501);
+    auto pick = [&rng](size_t n) {
+        return static_cast<size_t>(rng() % n);
+    };
+    const char* endings[] = {"\n", "\r\n", "\r"};
+    auto random_text = [&](size_t length) {
+        std::string text(length, ' ');
+        for (auto& c : text) {
+            c = static_cast<char>(' ' + pick(95));
+        }
+        return text;
+    };
+
+    std::string stream;
+    std::vector<expected_event> expected;
+    for (int i = 0; i < 400; ++i) {
+        const char* eol = endings[pick(3)];
+        expected_event event{"message", "", ""};
+        if (pick(4) == 0) {
+            stream += ": comment " + random_text(pick(20)) + eol;
+        }
+        if (pick(2) == 0) {
+            event.type = pick(2) ? "endpoint" : "message";
+            stream += "event: " + event.type + eol;
+        }
+        if (pick(5) == 0) {
+            event.id = std::to_string(i);
+            stream += "id:" + event.id + eol;
+        }
+        size_t lines = pick(4);
+        for (size_t l = 0; l < lines; ++l) {
+            size_t length = i == 100 && l == 0 ? 3 * 1024 * 1024 : (i == 200 ? 700 * 1024 : pick(64));
+            std::string line = random_text(length);
+            if (pick(8) == 0) {
+                line.clear();
+                stream += std::string("data") + eol;
+            } else {
+                stream += "data: " + line + eol;
+            }
+            event.data += (l > 0 ? "\n" : "") + line;
+        }
+        stream += eol;
+        if (lines > 0) {
+            expected.push_back(event);
+        }
+    }
+    ASSERT_GT(stream.size(), 3u * 1024 * 1024);
+
+    auto parse = [&stream](size_t max_chunk, unsigned seed) {
+        std::mt19937 chunks(seed);
+        sse_parser parser;
+        std::vector<expected_event> events;
+        for (size_t offset = 0; offset < stream.size();) {
+            size_t count = std::min<size_t>(stream.size() - offset, 1 + chunks() % max_chunk);
+            parser.feed(stream.data() + offset, count);
+            offset += count;
+            parser.consume([&events](const sse_event& event) {
+                events.push_back({std::string(event.type), std::string(event.data), std::string(event.id)});
+            });
+        }
+        EXPECT_EQ(parser.pending(), 0u);
+        return events;
+    };
+
+    for (auto [max_chunk, seed] : {std::pair<size_t, unsigned>{stream.size(), 1}, {7, 2}, {4096, 3}, {65536, 4}, {1, 5}}) {
+        std::vector<expected_event> events = parse(max_chunk, seed);
+        ASSERT_EQ(events.size(), expected.size()) << "max_chunk=" << max_chunk;
+        for (size_t i = 0; i < events.size(); ++i) {
+            ASSERT_EQ(events[i].type, expected[i].type) << "event " << i;
+            ASSERT_EQ(events[i].data, expected[i].data) << "event " << i;
+            ASSERT_EQ(events[i].id, expected[i].id) << "event " << i;
+        }
+    }
+}
+
+// Lines split across reads, CRLF endings and a burst far larger than one read
+TEST(LineBufferTest, SplitsChunkedInput) {
+    std::string input = "{\"a\":1}\r\n\n{\"b\":";
+    input += std::string(200000, ' ');
+    input += "2}\n{\"c\":3}";
+
+    line_buffer buffer;
+    std::vector<std::string> lines;
+    auto collect = [&lines](const char* data, size_t length) {
+        lines.emplace_back(data, length);
+    };
+    for (size_t offset = 0; offset < input.size(); offset += 4093) {
+        size_t count = std::min<size_t>(4093, input.size() - offset);
+        std::memcpy(buffer.prepare(count), input.data() + offset, count);
+        buffer.commit(count);
+        buffer.consume_lines(collect);
+    }
+
+    ASSERT_EQ(lines.size(), 2u);
+    EXPECT_EQ(lines[0], "{\"a\":1}");
+    EXPECT_EQ(json::parse(lines[1])["b"], 2);
+    EXPECT_EQ(buffer.pending(), std::string("{\"c\":3}").size());
+}
+
+#if !defined(_WIN32)
+// A shell server that answers every request with an empty result
+TEST(StdioClientTest, StartsWithoutFixedDelayAndAnswersPromptly) {
+    std::string script = testing::TempDir() + "mcp_stdio_echo.sh";
+    {
+        std::ofstream out(script);
+        out << "while IFS= read -r line; do\n"
+               "  case \"$line\" in *'\"id\":'*) ;; *) continue ;; esac\n"
+               "  id=${line#*\\\"id\\\":}; id=${id%%[,\\}]*}\n"
+               "  printf '{\"jsonrpc\":\"2.0\",\"id\":%s,\"result\":{}}\\n' \"$id\"\n"
+               "done\n";
+    }
+
+    auto client = std::make_unique<stdio_client>("sh " + script);
+    auto start = std::chrono::steady_clock::now();
+    ASSERT_TRUE(client->initialize("StdioTestClient", "1.0.0"));
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(400));
+
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < 50; ++i) {
+        ASSERT_TRUE(client->ping());
+    }
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(250));
+
+    // A command that cannot be executed fails at once instead of after a timeout
+    stdio_client missing("/nonexistent/mcp-server");
+    start = std::chrono::steady_clock::now();
+    EXPECT_FALSE(missing.initialize("StdioTestClient", "1.0.0"));
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(200));
+
+    // The server exits on end of input, so stopping needs no SIGKILL grace period
+    start = std::chrono::steady_clock::now();
+    client.reset();
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(500));
+}
+
+// A shell server that answers initialize, then floods a line that never ends
+TEST(StdioClientTest, FailsOnOverlongLine) {
+    std::string script = testing::TempDir() + "mcp_stdio_flood.sh";
+    {
+        std::ofstream out(script);
+        out << "while IFS= read -r line; do\n"
+               "  case \"$line\" in *'\"id\":'*) ;; *) continue ;; esac\n"
+               "  id=${line#*\\\"id\\\":}; id=${id%%[,\\}]*}\n"
+               "  case \"$line\" in\n"
+               "    *initialize*) printf '{\"jsonrpc\":\"2.0\",\"id\":%s,\"result\":{}}\\n' \"$id\" ;;\n"
+               "    *) head -c 1048576 /dev/zero | tr '\\0' a ;;\n"
+               "  esac\n"
+               "done\n";
+    }
+
+    stdio_client client("sh " + script);
+    client.set_max_line_length(64 * 1024);
+    ASSERT_TRUE(client.initialize("StdioTestClient", "1.0.0"));
+
+    auto start = std::chrono::steady_clock::now();
+    EXPECT_FALSE(client.ping());
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(1000));
+    EXPECT_THROW(client.send_request("tools/list"), mcp_exception);
+}
+#endif
+
 int main(int argc, char **argv) {
     ::testing::InitGoogleTest(&argc, argv);
     
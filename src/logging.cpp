@@ -0,0 +1,181 @@
+#include "logging.h"
+
+#include "mcp_logger.h"
+
+#include <spdlog/async.h>
+#include <spdlog/pattern_formatter.h>
+#include <spdlog/sinks/rotating_file_sink.h>
+#include <spdlog/sinks/stdout_color_sinks.h>
+#include <spdlog/spdlog.h>
+
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace logging {
+
+namespace {
+
+// The async queue formats on its own thread, where the request's context is no
+// longer current. Every message of the mcp logger therefore ends with this
+// separator and the context's JSON fields, which may be empty. The fields are
+// JSON-escaped and never contain the separator, so splitting at the last one
+// cannot be fooled by a message that contains it.
+constexpr char kContextSeparator = '\x1f';
+constexpr const char* kMcpLoggerName = "mcp";
+
+const char* kConsolePattern = "%^%L%$(%H:%M:%S) %v";
+
+// The JSON lines file rotates at 10 MiB and keeps 5 old files
+constexpr size_t kJsonLinesMaxBytes = 10 * 1024 * 1024;
+constexpr size_t kJsonLinesMaxFiles = 5;
+
+// Splits a payload into the message and the context fields, other loggers have no fields
+void splitPayload(const spdlog::details::log_msg& msg, std::string_view& message, std::string_view& fields) {
+    std::string_view text(msg.payload.data(), msg.payload.size());
+    size_t pos = std::string_view(msg.logger_name.data(), msg.logger_name.size()) == kMcpLoggerName
+        ? text.rfind(kContextSeparator) : std::string_view::npos;
+    message = text.substr(0, pos);
+    fields = pos == std::string_view::npos ? std::string_view() : text.substr(pos + 1);
+}
+
+// Console output: the usual pattern without the context fields
+class ConsoleFormatter : public spdlog::formatter {
+public:
+    ConsoleFormatter() : pattern_(kConsolePattern) {}
+
+    void format(const spdlog::details::log_msg& msg, spdlog::memory_buf_t& dest) override {
+        std::string_view message;
+        std::string_view fields;
+        splitPayload(msg, message, fields);
+
+        spdlog::details::log_msg stripped = msg;
+        stripped.payload = spdlog::string_view_t(message.data(), message.size());
+        pattern_.format(stripped, dest);
+        msg.color_range_start = stripped.color_range_start;
+        msg.color_range_end = stripped.color_range_end;
+    }
+
+    std::unique_ptr<spdlog::formatter> clone() const override {
+        return std::make_unique<ConsoleFormatter>();
+    }
+
+private:
+    spdlog::pattern_formatter pattern_;
+};
+
+// One JSON object per line, e.g.
+// {"ts":"2025-05-01T12:00:00.123","level":"info","logger":"mcp","thread":42,"msg":"...","session_id":"...",...}
+class JsonLinesFormatter : public spdlog::formatter {
+public:
+    void format(const spdlog::details::log_msg& msg, spdlog::memory_buf_t& dest) override {
+        std::string_view message;
+        std::string_view fields;
+        splitPayload(msg, message, fields);
+
+        line_.assign("{\"ts\":\"");
+        appendTimestamp(msg.time);
+        line_ += "\",\"level\":\"";
+        auto level = spdlog::level::to_string_view(msg.level);
+        line_.append(level.data(), level.size());
+        line_ += "\",\"logger\":";
+        mcp::log_context::append_json_string(line_, std::string_view(msg.logger_name.data(), msg.logger_name.size()));
+        line_ += ",\"thread\":";
+        line_ += std::to_string(msg.thread_id);
+        line_ += ",\"msg\":";
+        mcp::log_context::append_json_string(line_, message);
+        if (!fields.empty()) {
+            line_ += ',';
+            line_.append(fields.data(), fields.size());
+        }
+        line_ += "}\n";
+
+        dest.append(line_.data(), line_.data() + line_.size());
+    }
+
+    std::unique_ptr<spdlog::formatter> clone() const override {
+        return std::make_unique<JsonLinesFormatter>();
+    }
+
+private:
+    // Local time with milliseconds, the seconds part formatted once per second
+    void appendTimestamp(spdlog::log_clock::time_point time) {
+        auto seconds = std::chrono::time_point_cast<std::chrono::seconds>(time);
+        if (seconds != cachedSecond_) {
+            std::tm tm = spdlog::details::os::localtime(spdlog::log_clock::to_time_t(time));
+            std::strftime(cachedStamp_, sizeof(cachedStamp_), "%Y-%m-%dT%H:%M:%S", &tm);
+            cachedSecond_ = seconds;
+        }
+        auto millis = std::chrono::duration_cast<std::chrono::milliseconds>(time - seconds).count();
+        char fraction[8];
+        std::snprintf(fraction, sizeof(fraction), ".%03d", static_cast<int>(millis));
+        line_ += cachedStamp_;
+        line_ += fraction;
+    }
+
+    std::string line_;
+    std::chrono::time_point<spdlog::log_clock, std::chrono::seconds> cachedSecond_{};
+    char cachedStamp_[32] = {0};
+};
+
+spdlog::level::level_enum toSpdlogLevel(mcp::log_level level) {
+    switch (level) {
+        case mcp::log_level::debug:
+            return spdlog::level::debug;
+        case mcp::log_level::info:
+            return spdlog::level::info;
+        case mcp::log_level::warning:
+            return spdlog::level::warn;
+        case mcp::log_level::error:
+            return spdlog::level::err;
+    }
+    return spdlog::level::info;
+}
+
+} // namespace
+
+void init(const std::string& jsonLinesPath) {
+    spdlog::init_thread_pool(8192, 1);
+
+    auto console = std::make_shared<spdlog::sinks::stdout_color_sink_mt>();
+    console->set_formatter(std::make_unique<ConsoleFormatter>());
+    auto jsonLines = std::make_shared<spdlog::sinks::rotating_file_sink_mt>(jsonLinesPath, kJsonLinesMaxBytes, kJsonLinesMaxFiles);
+    jsonLines->set_formatter(std::make_unique<JsonLinesFormatter>());
+
+    auto app = std::make_shared<spdlog::async_logger>(
+        "app", spdlog::sinks_init_list{console, jsonLines}, spdlog::thread_pool(), spdlog::async_overflow_policy::block);
+    app->set_level(spdlog::get_level());
+    spdlog::set_default_logger(app);
+
+    // cpp-mcp logs every request to the JSON lines file, the console only shows its errors
+    auto mcpConsole = std::make_shared<spdlog::sinks::stdout_color_sink_mt>();
+    mcpConsole->set_formatter(std::make_unique<ConsoleFormatter>());
+    mcpConsole->set_level(spdlog::level::err);
+
+    // A full queue drops the oldest message instead of stalling a request
+    auto mcpLogger = std::make_shared<spdlog::async_logger>(
+        kMcpLoggerName, spdlog::sinks_init_list{mcpConsole, jsonLines}, spdlog::thread_pool(), spdlog::async_overflow_policy::overrun_oldest);
+    mcpLogger->set_level(spdlog::level::info);
+    spdlog::register_logger(mcpLogger);
+
+    mcp::set_log_level(mcp::log_level::info);
+    mcp::logger::instance().set_sink([mcpLogger](mcp::log_level level, std::string_view message, const mcp::log_context* context) {
+        static thread_local std::string payload;
+        payload.assign(message.data(), message.size());
+        payload += kContextSeparator;
+        if (context) {
+            context->append_json_fields(payload);
+        }
+        mcpLogger->log(toSpdlogLevel(level), spdlog::string_view_t(payload.data(), payload.size()));
+    });
+}
+
+void shutdown() {
+    mcp::logger::instance().set_sink(nullptr);
+    spdlog::shutdown();
+}
+
+} // namespace logging
@@ -0,0 +1,20 @@
+#ifndef LOGGING_H
+#define LOGGING_H
+
+#include <string>
+
+namespace logging {
+
+// Sets up one asynchronous spdlog pipeline for the application and cpp-mcp.
+// The console keeps the short "I(12:00:00) message" pattern, and every message
+// is also written to jsonLinesPath as one JSON object per line; the file rotates
+// at 10 MiB and keeps 5 old files. Messages logged by cpp-mcp while it handles a
+// request carry session_id, request_id, method, tool and elapsed_us fields.
+void init(const std::string& jsonLinesPath);
+
+// Detaches cpp-mcp and flushes everything queued. Call before exiting.
+void shutdown();
+
+} // namespace logging
+
+#endif // LOGGING_H
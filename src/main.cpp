@@ -1,6 +1,7 @@
 // Include project headers first
 #include "embedded_translations.h" // Include the embedded translations
 #include "i18n.h"                  // Include the i18n header
+#include "logging.h"               // Shared spdlog pipeline
 // Include the precompiled header last among project headers
 #include "main.h"
 #include "minidocx.hpp"
@@ -26,24 +27,8 @@ std::string g_current_excel_file_path;
 
 static void s_spdlog_init()
 {
-
-    spdlog::set_pattern("%^%L%$(%H:%M:%S) %v");
-
-    bool console_sink_exists = false;
-    for (const auto &sink : spdlog::default_logger()->sinks())
-    {
-        if (std::dynamic_pointer_cast<spdlog::sinks::stdout_color_sink_mt>(sink))
-        {
-            console_sink_exists = true;
-            break;
-        }
-    }
-
-    if (!console_sink_exists)
-    {
-        auto console_sink = std::make_shared<spdlog::sinks::stdout_color_sink_mt>();
-        spdlog::default_logger()->sinks().push_back(console_sink);
-    }
+    // Application and cpp-mcp share one async pipeline: console plus a JSON lines file
+    logging::init("WordAutoCpp.log.jsonl");
 }
 
 static void s_mcpServer_init(mcp::server &server, bool blocking_mode)
@@ -277,8 +262,9 @@ int main()
 
 
     mcp::server server("localhost", SERVER_PORT);
-    mcp::set_log_level(mcp::log_level::error); // Keep MCP library logs concise
     s_mcpServer_init(server, true);
 
+    logging::shutdown();
+
     return 0;
 }